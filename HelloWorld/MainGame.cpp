@@ -103,6 +103,22 @@ struct GameState // A global scope structure used to 'remember' the overall stat
 };
 GameState gameState;
 
+struct AutoplayState // Everything the autoplay bot keeps track of (see AUTOPLAY BOT below)!
+{
+	bool enabled = false;
+	double budgetMs = 0; // The 95th percentile frame time budget (0 for no budget)
+	unsigned int seed = 1; // The random seed the game is played with, so every run plays the same game unless it's changed
+	std::vector<double> vFrameMs[5]; // Frame times for levels 1 to 4 (so index 0 isn't used)
+	std::chrono::steady_clock::time_point lastFrame; // When the previous frame started
+	int lastLevel = 0; // The level the previous frame was on
+	int frames = 0; // Frames played by the bot
+	int deaths = 0; // How many times Agent 8 hit a meteor
+	int waitFrames = 0; // How long the bot has been waiting on an asteroid for a clear launch
+	bool dead = false; // Whether Agent 8 was dead last frame (so each death is only counted once)
+	bool finished = false; // Set once the bot has completed all four levels
+};
+AutoplayState autoplay;
+
 // An enumeration to represent the GameObject types in Sky High Spy:
 enum GameObjectType 
 {
@@ -127,6 +143,15 @@ float x_asteroidAttached_velocity = {0};
 float y_asteroidAttached_velocity = {0};
 float asteroidAttached_rotation = {0};
 
+// GameObject types which survive a level reset (all of the asteroids, meteors and gems are dropped by Play::ResetWorld):
+const std::vector<int> vPersistentTypes = { TYPE_AGENT8, TYPE_ASTEROID_ATTACHED, TYPE_BROKEN_ASTEROID, TYPE_DESTROYED };
+
+// Archetypes for the GameObjects which are spawned during the game (registered in MainGameEntry once the sprites are loaded):
+int archetype_asteroid = -1;
+int archetype_meteor = -1;
+int archetype_gem = -1;
+int archetype_broken_asteroid_piece = -1;
+
 // DECLARING GAME FUNCTIONS:
 
 void HandleFlightControls();
@@ -139,8 +164,12 @@ void UpdateAsteroidAttached();
 
 void UpdateBrokenAsteroidPieces();
 
+void DrawBrokenAsteroidPieces();
+
 void UpdateGems();
 
+void DrawGems();
+
 void UpdateMeteors();
 
 void UpdateDestroyed();
@@ -149,6 +178,10 @@ void UpdateAgent8();
 
 void UpdateGameLevel();
 
+void AutoplayBot(int frame);
+
+bool ReportAutoplay();
+
 // CREATING A DISPLAY AREA FOR THE GAME:
 
 // ------------------------------------------
@@ -163,10 +196,34 @@ double DISPLAY_SCALE { 1 };
 
 // This is the Windows entry point for a PlayBuffer program:
 
-void MainGameEntry ( PLAY_IGNORE_COMMAND_LINE ) // Function MainGameEntry (uses a macro to skip the command line interface?)
+void MainGameEntry ( int argc, char* argv[] ) // Function MainGameEntry (the command line can switch on the autoplay bot)
 {
 	Play::CreateManager ( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE ); // Calling the PlayManager to create a game display of the chosen dimensions
 
+	for (int i = 1; i < argc; i++) // Checking the command line for the autoplay bot's options!
+	{
+		std::string arg(argv[i]);
+		if (arg == "--autoplay")
+			autoplay.enabled = true;
+		else if (arg.rfind("--autoplay-budget=", 0) == 0)
+			autoplay.budgetMs = atof(arg.c_str() + 18);
+		else if (arg.rfind("--autoplay-seed=", 0) == 0)
+			autoplay.seed = static_cast<unsigned int>(strtoul(arg.c_str() + 16, nullptr, 10));
+	}
+
+	if (autoplay.enabled)
+	{
+		Play::SetInputDriver(AutoplayBot); // The bot presses the keys instead of the player!
+		Play::SetRandomSeed(autoplay.seed); // The asteroids and meteors start off the same way every run, so the budget check always measures the same game!
+	}
+
+	Play::SetFixedTickRate(60); // All the movement is tuned for 60 updates per second, so the game runs at the same speed however fast the display refreshes (drawing is smoothed in between)!
+
+	Play::SetPresentQueueDepth(1); // The window gets the finished frame on another thread while the next one is drawn << fine because the background is redrawn in full every frame!
+
+	// The autoplay bot leaves the drawing on the main thread, as any frames the render thread skipped would be missing from its frame times:
+	Play::SetRenderThread(!autoplay.enabled); // The drawing is handed to a render thread as a snapshot, so the next update can start straight away << everything is drawn through Play:: functions so this is safe!
+
 	Play::CentreAllSpriteOrigins(); // Sets the local origin and the centre of each sprite to its centre << radial collisions will be detected from the centre as well!
 	
 	Play::LoadBackground("Data\\Backgrounds\\spr_background.png"); // Loads the chosen PNG image as the main background (note that a double backslash means an actual backslash)
@@ -174,6 +231,27 @@ void MainGameEntry ( PLAY_IGNORE_COMMAND_LINE ) // Function MainGameEntry (uses
 	Play::StartAudioLoop("snd_music"); // Automatically scans the Data\\Audio directory and plays the first file named "snd_music"
 
 	Play::CreateGameObject(TYPE_AGENT8, { DISPLAY_WIDTH /2, 720 }, 20, "spr_agent8_fly"); // This creates our Agent 8 object!
+
+	// Archetypes look up each sprite once, rather than every time one of these objects is spawned:
+	archetype_asteroid = Play::RegisterArchetype(TYPE_ASTEROID, "spr_asteroid_strip2", 100, 0.9f); // Type, sprite name, collision radius, animation speed!
+	archetype_meteor = Play::RegisterArchetype(TYPE_METEOR, "spr_meteor_strip2", 50, 0.95f);
+	archetype_gem = Play::RegisterArchetype(TYPE_GEM, "spr_gem", 25, 0.0f, { 0.0f, 0.0f }, 0.0f, 0.05f); // Gems spin slowly!
+	archetype_broken_asteroid_piece = Play::RegisterArchetype(TYPE_BROKEN_ASTEROID, "spr_asteroid_pieces_strip3", 0, 0.0f, { 0.0f, 0.0f }, 0.0f, 0.1f);
+
+	// Registering the update systems along with what each of them reads and writes (in the order they should draw):
+	// Systems which don't share anything (like moving the broken asteroid pieces and the gems) can run at the same time!
+	const unsigned int DRAWING = Play::RESOURCE_DRAWING, AUDIO = Play::RESOURCE_AUDIO, RANDOM = Play::RESOURCE_RANDOM, STATE = Play::RESOURCE_GAME_STATE;
+
+	Play::RegisterSystem("Agent8", UpdateAgent8, { {}, { Play::ALL_TYPES }, 0, DRAWING | AUDIO | RANDOM | STATE }); // Restarting the game resets the whole world
+	Play::RegisterSystem("GameLevel", UpdateGameLevel, { {}, { Play::ALL_TYPES }, 0, DRAWING | AUDIO | STATE }); // Starting a new level resets the whole world
+	Play::RegisterSystem("Asteroids", UpdateAsteroids, { { TYPE_AGENT8 }, { TYPE_ASTEROID, TYPE_ASTEROID_ATTACHED, TYPE_DESTROYED }, 0, DRAWING | RANDOM | STATE });
+	Play::RegisterSystem("AsteroidAttached", UpdateAsteroidAttached, { {}, { TYPE_ASTEROID_ATTACHED }, STATE, DRAWING });
+	Play::RegisterSystem("BrokenAsteroidPieces", UpdateBrokenAsteroidPieces, { {}, { TYPE_BROKEN_ASTEROID }, 0, 0 });
+	Play::RegisterSystem("Gems", UpdateGems, { { TYPE_AGENT8 }, { TYPE_GEM, TYPE_DESTROYED }, 0, AUDIO | STATE });
+	Play::RegisterSystem("DrawBrokenAsteroidPieces", DrawBrokenAsteroidPieces, { { TYPE_BROKEN_ASTEROID }, {}, 0, DRAWING });
+	Play::RegisterSystem("DrawGems", DrawGems, { { TYPE_GEM }, {}, 0, DRAWING });
+	Play::RegisterSystem("Meteors", UpdateMeteors, { { TYPE_AGENT8 }, { TYPE_METEOR, TYPE_DESTROYED }, 0, DRAWING | AUDIO | RANDOM | STATE });
+	Play::RegisterSystem("Destroyed", UpdateDestroyed, { {}, { TYPE_DESTROYED }, 0, DRAWING });
 }
 
 // UPDATING THE GAME:
@@ -186,32 +264,18 @@ bool MainGameUpdate ( float elapsedTime ) // Uses the elapsed time to update the
 
 	Play::DrawBackground(); // Replaces Play::ClearDrawingBuffer() as both completely reset the drawing buffer to draw a new one each frame!
 
-	UpdateAgent8();
-
-	UpdateGameLevel();
-
-	UpdateAsteroids();
-
-	UpdateAsteroidAttached();
-
-	UpdateBrokenAsteroidPieces();
-
-	UpdateGems();
-
-	UpdateMeteors();
+	Play::RunSystems(); // Runs UpdateAgent8, UpdateGameLevel, UpdateAsteroids and the rest (registered in MainGameEntry)!
 
 	//HandleFlightControls();
 
 	//HandleSpinControls();
 
-	UpdateDestroyed();
-
 	// Testing drawing with the font sprites:
 	//Play::DrawFontText( "64px", "Sky High Spy Game!", { DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 }, Play::CENTRE ); // Displaying text in the centre of the display area!
 	
 	// Drawing the background in the display window:
 	Play::PresentDrawingBuffer (); // Adding the new background drawn in the DrawingBuffer to the display window
-	return Play::KeyDown ( VK_ESCAPE ); // End the game update function (close the game) when the escape key is pressed (virtual key) 
+	return Play::KeyDown ( VK_ESCAPE ) || autoplay.finished; // End the game update function (close the game) when the escape key is pressed (virtual key) or the bot has won
 }
 
 // FLYING CONTROLS:
@@ -307,8 +371,10 @@ void HandleSpinControls()
 
 		gameState.rad += 0.025; // Incrent the radians (angle of rotation)
 
-		int adjacent = (cos(gameState.rad) * 67); // Find Agent 8's new x-coordiante
-		int opposite = (sin(gameState.rad) * 67); // Find Agent 8's new y-coordinate
+		float sinRad, cosRad;
+		Play::FastSinCos(gameState.rad, sinRad, cosRad); // Work out the sine and cosine together, much faster than calling sin and cos!
+		int adjacent = (cosRad * 67); // Find Agent 8's new x-coordiante
+		int opposite = (sinRad * 67); // Find Agent 8's new y-coordinate
 
 		obj_agent8.pos.x = obj_agent8.pos.x + adjacent; // Move Agent 8's x position
 		obj_agent8.pos.y = obj_agent8.pos.y + opposite; // Move Agent 8's y position
@@ -324,8 +390,10 @@ void HandleSpinControls()
 
 		gameState.rad -= 0.025; // Incrent the radians (angle of rotation)
 
-		int adjacent = (cos(gameState.rad) * 67); // Find Agent 8's new x-coordiante
-		int opposite = (sin(gameState.rad) * 67); // Find Agent 8's new y-coordinate
+		float sinRad, cosRad;
+		Play::FastSinCos(gameState.rad, sinRad, cosRad); // Work out the sine and cosine together, much faster than calling sin and cos!
+		int adjacent = (cosRad * 67); // Find Agent 8's new x-coordiante
+		int opposite = (sinRad * 67); // Find Agent 8's new y-coordinate
 
 		obj_agent8.pos.x = obj_agent8.pos.x - adjacent; // Move Agent 8's x position
 		obj_agent8.pos.y = obj_agent8.pos.y + opposite; // Move Agent 8's y position
@@ -343,21 +411,20 @@ void HandleSpinControls()
 
 		// Making a gem:
 
-		int id = Play::CreateGameObject(TYPE_GEM, obj_asteroid_attached.pos, 25, "spr_gem");
-		GameObject& obj_gem = Play::GetGameObject(id);
-		obj_gem.velocity = Point2f(Play::RandomRollRange(-1, 1) * 0.75f, Play::RandomRollRange(-1, 1) * 0.75f);
-		obj_gem.rotSpeed = 0.05f;
+		Play::SpawnBatch(archetype_gem, 1, [&](GameObject& obj_gem, int)
+		{
+			obj_gem.pos = obj_asteroid_attached.pos;
+			obj_gem.velocity = Point2f(Play::RandomRollRange(-1, 1) * 0.75f, Play::RandomRollRange(-1, 1) * 0.75f);
+		});
 
 		// Broken asteroid pieces:
 
-		for (float rad{ 0.0f }; rad < 2.0f; rad += 0.66666f) // cycle through 0.0, 0.66666 (recurring) and 1.33333 (recurring) rad (for broken asteroid placement)
+		Play::SpawnBatch(archetype_broken_asteroid_piece, 4, [&](GameObject& obj_broken_asteroid_piece, int piece)
 		{
-			int id = Play::CreateGameObject(TYPE_BROKEN_ASTEROID, obj_asteroid_attached.pos, 0, "spr_asteroid_pieces_strip3");
-			GameObject& obj_broken_asteroid_piece = Play::GetGameObject(id);
-			obj_broken_asteroid_piece.rotSpeed = 0.1f;
-			obj_broken_asteroid_piece.acceleration = { 0.0f, 0.0f }; // Let each piece of the broken asteroid accelerate in its given direction!
-			Play::SetGameObjectDirection(obj_broken_asteroid_piece, 16, rad * PLAY_PI);
-		}
+			float rad = piece * 0.66666f; // cycle through 0.0, 0.66666, 1.33332 and 1.99998 rad (for broken asteroid placement)
+			obj_broken_asteroid_piece.pos = obj_asteroid_attached.pos;
+			Play::SetGameObjectDirection(obj_broken_asteroid_piece, 16, rad * PLAY_PI); // Let each piece of the broken asteroid move in its given direction!
+		});
 
 		// Switching game states:
 		gameState.agentState = STATE_LAUNCHING; // Switch Agent 8's state so that he launches of the asteroid!
@@ -420,12 +487,13 @@ void UpdateAsteroids()
 
 	if (gameState.level >= 1 && (Play::RandomRoll(100) == 19) && gameState.asteroids_TL == TRUE) // Roll a 100 sided dice every frame (60 times per second) and check to see if it lands on the number 19 (asteroid spawn rate)
 	{
-		int id = Play::CreateGameObject(TYPE_ASTEROID, { Play::RandomRollRange(0, 150), 0 }, 100, "spr_asteroid_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the asteroid can be created around the top left corner (from 0 to 150 pixels)!
-		GameObject& obj_asteroid = Play::GetGameObject(id);
-		Play::SetSprite( obj_asteroid, "spr_asteroid_strip2", 0.9f ); // Set the animation for the asteroid to play!
-		obj_asteroid.velocity = { 1, 1 }; // The components of the asteroid's velocity are always [1,1] (slow enough velocity to collide with)!
-		obj_asteroid.rotation = (1.0f); // Set the asteroid's rotation so that it faces its direction of movement!
+		Play::SpawnBatch(archetype_asteroid, 1, [](GameObject& obj_asteroid, int) // The archetype already has the asteroid's sprite, collision radius and animation!
+		{
+			obj_asteroid.pos = { Play::RandomRollRange(0, 150), 0 };
+			// Here the asteroid can be created around the top left corner (from 0 to 150 pixels)!
+			obj_asteroid.velocity = { 1, 1 }; // The components of the asteroid's velocity are always [1,1] (slow enough velocity to collide with)!
+			obj_asteroid.rotation = (1.0f); // Set the asteroid's rotation so that it faces its direction of movement!
+		});
 		gameState.asteroids_TL = FALSE; // Boolean condition used to make only one asteroid!
 	} 
 
@@ -433,12 +501,13 @@ void UpdateAsteroids()
 	
 	if (gameState.level >= 3 && (Play::RandomRoll(100) == 23) && gameState.asteroids_TR == TRUE)
 	{
-		int id = Play::CreateGameObject(TYPE_ASTEROID, { Play::RandomRollRange(1130, 1280), 0 }, 100, "spr_asteroid_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the asteroid can be created around the top right corner!
-		GameObject& obj_asteroid = Play::GetGameObject(id);
-		Play::SetSprite(obj_asteroid, "spr_asteroid_strip2", 0.9f); // Set the animation for the asteroid to play!
-		obj_asteroid.velocity = Point2f(-1, 1);
-		obj_asteroid.rotation = (2.5f);
+		Play::SpawnBatch(archetype_asteroid, 1, [](GameObject& obj_asteroid, int) // The archetype already has the asteroid's sprite, collision radius and animation!
+		{
+			obj_asteroid.pos = { Play::RandomRollRange(1130, 1280), 0 };
+			// Here the asteroid can be created around the top right corner!
+			obj_asteroid.velocity = Point2f(-1, 1);
+			obj_asteroid.rotation = (2.5f);
+		});
 		gameState.asteroids_TR = FALSE; // Boolean condition used to make only one asteroid!
 	}
 		
@@ -446,12 +515,13 @@ void UpdateAsteroids()
 
 	if (gameState.level >= 4 && (Play::RandomRoll(100) == 24) && gameState.asteroids_BL == TRUE)
 	{
-		int id = Play::CreateGameObject(TYPE_ASTEROID, { Play::RandomRollRange(0, 150), 720 }, 100, "spr_asteroid_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the asteroid can be created around the bottom left corner!
-		GameObject& obj_asteroid = Play::GetGameObject(id);
-		Play::SetSprite(obj_asteroid, "spr_asteroid_strip2", 0.9f); // Set the animation for the asteroid to play!
-		obj_asteroid.velocity = Point2f(1, -1);
-		obj_asteroid.rotation = (5.5f);
+		Play::SpawnBatch(archetype_asteroid, 1, [](GameObject& obj_asteroid, int) // The archetype already has the asteroid's sprite, collision radius and animation!
+		{
+			obj_asteroid.pos = { Play::RandomRollRange(0, 150), 720 };
+			// Here the asteroid can be created around the bottom left corner!
+			obj_asteroid.velocity = Point2f(1, -1);
+			obj_asteroid.rotation = (5.5f);
+		});
 		gameState.asteroids_BL = FALSE; // Boolean condition used to make only one asteroid!
 	}
 
@@ -459,12 +529,13 @@ void UpdateAsteroids()
 
 	if (gameState.level >=2 && (Play::RandomRoll(100) == 42) && gameState.asteroids_BR == TRUE) // Roll a 100 sided dice every frame (60 times per second) and check to see if it lands on the number 42 (asteroid spawn rate)
 	{
-		int id = Play::CreateGameObject(TYPE_ASTEROID, { Play::RandomRollRange(1130, 1280), 720 }, 100, "spr_asteroid_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the asteroid can be created around the bottom right corner!
-		GameObject& obj_asteroid = Play::GetGameObject(id);
-		Play::SetSprite(obj_asteroid, "spr_asteroid_strip2", 0.9f); // Set the animation for the asteroid to play!
-		obj_asteroid.velocity = Point2f(-1, -1);
-		obj_asteroid.rotation = (4.0f);
+		Play::SpawnBatch(archetype_asteroid, 1, [](GameObject& obj_asteroid, int) // The archetype already has the asteroid's sprite, collision radius and animation!
+		{
+			obj_asteroid.pos = { Play::RandomRollRange(1130, 1280), 720 };
+			// Here the asteroid can be created around the bottom right corner!
+			obj_asteroid.velocity = Point2f(-1, -1);
+			obj_asteroid.rotation = (4.0f);
+		});
 		gameState.asteroids_BR = FALSE; // Boolean condition used to make only one asteroid!
 	}
 
@@ -602,17 +673,20 @@ void UpdateAsteroidAttached()
 
 void UpdateBrokenAsteroidPieces()
 {
-	std::vector<int> vBrokenAsteroidPieces = Play::CollectGameObjectIDsByType(TYPE_BROKEN_ASTEROID);
+	Play::UpdateGameObjects(TYPE_BROKEN_ASTEROID); // Moves all of the pieces at once using every CPU core!
+}
 
-	for (int id_identifier : vBrokenAsteroidPieces) // Simple update loop for the broken asteroid pieces
+void DrawBrokenAsteroidPieces()
+{
+	// Pieces are only queued for destruction, so the list can be looped over without copying it
+	for (int id_identifier : Play::GetGameObjectIDsByType(TYPE_BROKEN_ASTEROID)) // Simple draw loop for the broken asteroid pieces (drawing has to happen one at a time)
 	{
 		GameObject& obj_broken_asteroid_piece = Play::GetGameObject(id_identifier);
 
-		Play::UpdateGameObject(obj_broken_asteroid_piece);
 		Play::DrawObjectRotated(obj_broken_asteroid_piece);
 
 		if (!Play::IsVisible(obj_broken_asteroid_piece))
-			Play::DestroyGameObject(id_identifier);
+			Play::QueueDestroy(id_identifier);
 	}
 }
 
@@ -679,8 +753,14 @@ void UpdateGems()
 		}
 
 		Play::UpdateGameObject(obj_gem);
-		Play::DrawObjectRotated(obj_gem);
+	}
+}
 
+void DrawGems() // Drawing is kept separate so that updating the gems doesn't have to wait for other systems to finish drawing!
+{
+	for (int id_identifier : Play::GetGameObjectIDsByType(TYPE_GEM))
+	{
+		Play::DrawObjectRotated(Play::GetGameObject(id_identifier));
 	}
 }
 
@@ -699,12 +779,12 @@ void UpdateMeteors()
 
 	if (gameState.level >= 1 && (Play::RandomRoll(100) == 19) && gameState.meteors_L1 == TRUE) // Roll a 100 sided dice every frame (60 times per second) and check to see if it lands on the number 19 (meteor spawn rate)
 	{
-		int id = Play::CreateGameObject( TYPE_METEOR, { 0, Play::RandomRollRange( 540, 690 ) }, 50, "spr_meteor_strip2" ); // Type, position, collision radius, sprite name!
-		// In the line above the meteor can be created around the top left corner (from 0 to 150 pixels)!
-		GameObject& obj_meteor = Play::GetGameObject(id);
-		Play::SetSprite(obj_meteor, "spr_meteor_strip2", 0.95f); // Set the animation for the meteor to play!
-		obj_meteor.velocity = Point2f( 3, 0 ); // The meteors velocity components!
-		obj_meteor.rotation = (6.35f); // Set the meteor's rotation so that it faces its direction of movement!
+		Play::SpawnBatch(archetype_meteor, 1, [](GameObject& obj_meteor, int) // The archetype already has the meteor's sprite, collision radius and animation!
+		{
+			obj_meteor.pos = { 0, Play::RandomRollRange( 540, 690 ) };
+			obj_meteor.velocity = Point2f( 3, 0 ); // The meteors velocity components!
+			obj_meteor.rotation = (6.35f); // Set the meteor's rotation so that it faces its direction of movement!
+		});
 		gameState.meteors_L1 = FALSE; // Boolean condition used to make only one meteor!
 	}
 
@@ -712,12 +792,12 @@ void UpdateMeteors()
 
 	if (gameState.level >= 2 && (Play::RandomRoll(100) == 23) && gameState.meteors_R1 == TRUE)
 	{
-		int id = Play::CreateGameObject(TYPE_METEOR, { 0, Play::RandomRollRange( 70, 240 ) }, 50, "spr_meteor_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the meteor can be created around the top left corner (from 0 to 150 pixels)!
-		GameObject& obj_meteor = Play::GetGameObject(id);
-		Play::SetSprite(obj_meteor, "spr_meteor_strip2", 0.95f); // Set the animation for the meteor to play!
-		obj_meteor.velocity = Point2f( -3, 0 ); // The meteors velocity components!
-		obj_meteor.rotation = (3.2f);
+		Play::SpawnBatch(archetype_meteor, 1, [](GameObject& obj_meteor, int) // The archetype already has the meteor's sprite, collision radius and animation!
+		{
+			obj_meteor.pos = { 0, Play::RandomRollRange( 70, 240 ) };
+			obj_meteor.velocity = Point2f( -3, 0 ); // The meteors velocity components!
+			obj_meteor.rotation = (3.2f);
+		});
 		gameState.meteors_R1 = FALSE; // Boolean condition used to make only one meteor!
 	}
 
@@ -725,12 +805,12 @@ void UpdateMeteors()
 
 	if (gameState.level >= 3 && (Play::RandomRoll(100) == 24) && gameState.meteors_R2 == TRUE)
 	{
-		int id = Play::CreateGameObject(TYPE_METEOR, { 0, Play::RandomRollRange( 400, 520 ) }, 50, "spr_meteor_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the meteor can be created around the top left corner (from 0 to 150 pixels)!
-		GameObject& obj_meteor = Play::GetGameObject(id);
-		Play::SetSprite(obj_meteor, "spr_meteor_strip2", 0.95f); // Set the animation for the meteor to play!
-		obj_meteor.velocity = Point2f( -3, 0 ); // The meteors velocity components!
-		obj_meteor.rotation = (3.2f);
+		Play::SpawnBatch(archetype_meteor, 1, [](GameObject& obj_meteor, int) // The archetype already has the meteor's sprite, collision radius and animation!
+		{
+			obj_meteor.pos = { 0, Play::RandomRollRange( 400, 520 ) };
+			obj_meteor.velocity = Point2f( -3, 0 ); // The meteors velocity components!
+			obj_meteor.rotation = (3.2f);
+		});
 		gameState.meteors_R2 = FALSE; // Boolean condition used to make only one meteor!
 	}
 
@@ -738,12 +818,12 @@ void UpdateMeteors()
 
 	if (gameState.level >= 4 && (Play::RandomRoll(100) == 42) && gameState.meteors_L2 == TRUE)
 	{
-		int id = Play::CreateGameObject(TYPE_METEOR, { 0, Play::RandomRollRange( 250, 390 ) }, 50, "spr_meteor_strip2"); // Type, position, collision radius, sprite name!
-		// In the line above the meteor can be created around the top left corner (from 0 to 150 pixels)!
-		GameObject& obj_meteor = Play::GetGameObject(id);
-		Play::SetSprite(obj_meteor, "spr_meteor_strip2", 0.95f); // Set the animation for the meteor to play!
-		obj_meteor.velocity = Point2f(3, 0); // The meteors velocity components!
-		obj_meteor.rotation = (6.35f);
+		Play::SpawnBatch(archetype_meteor, 1, [](GameObject& obj_meteor, int) // The archetype already has the meteor's sprite, collision radius and animation!
+		{
+			obj_meteor.pos = { 0, Play::RandomRollRange( 250, 390 ) };
+			obj_meteor.velocity = Point2f(3, 0); // The meteors velocity components!
+			obj_meteor.rotation = (6.35f);
+		});
 		gameState.meteors_L2 = FALSE; // Boolean condition used to make only one meteor!
 	}
 
@@ -817,13 +897,15 @@ void UpdateMeteors()
 
 void UpdateDestroyed() // Picks up controll of destroyed object types!
 {
-	std::vector<int> vDead = Play::CollectGameObjectIDsByType(TYPE_DESTROYED);
-
-	for (int id_dead : vDead)
+	Play::ParallelForEach(TYPE_DESTROYED, [](GameObject& obj_dead) // Updates all of the destroyed objects at once using every CPU core!
 	{
-		GameObject& obj_dead = Play::GetGameObject(id_dead);
 		obj_dead.animSpeed = 0.2f; // Reduces destroyed objects animation speed so it actually lives for longer (reduced frame rate)
 		Play::UpdateGameObject(obj_dead);
+	});
+
+	for (int id_dead : Play::GetGameObjectIDsByType(TYPE_DESTROYED)) // Dead objects are queued for destruction at the end of the frame
+	{
+		GameObject& obj_dead = Play::GetGameObject(id_dead);
 
 		if (obj_dead.frame % 2) // Checks for odd and even frames!
 		{
@@ -832,7 +914,7 @@ void UpdateDestroyed() // Picks up controll of destroyed object types!
 
 		if (!Play::IsVisible(obj_dead) || obj_dead.frame >= 10)
 		{
-			Play::DestroyGameObject(id_dead);
+			Play::QueueDestroy(id_dead);
 		}		
 	}
 }
@@ -895,19 +977,8 @@ void UpdateAgent8()
 				gameState.score = 0;
 				gameState.gemCount = gameState.level;
 
-				// Reset all asteroids and meteors and gems:
-				for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_ASTEROID))
-				{
-					Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-				}
-				for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_METEOR))
-				{
-					Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-				}
-				for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_GEM))
-				{
-					Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-				}
+				// Reset all asteroids and meteors and gems (in one go, however many there are):
+				Play::ResetWorld(vPersistentTypes);
 				gameState.asteroids_TL = TRUE;
 				gameState.asteroids_TR = TRUE;
 				gameState.asteroids_BL = TRUE;
@@ -944,19 +1015,8 @@ void UpdateGameLevel()
 	}
 	if (gameState.level - gameState.gemCount == gameState.level) // If all of the gems in a level are collected...
 	{
-		// Reset all asteroids and meteors and gems:
-		for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_ASTEROID))
-		{
-			Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-		}
-		for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_METEOR))
-		{
-			Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-		}
-		for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_GEM))
-		{
-			Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-		}
+		// Reset all asteroids and meteors and gems (in one go, however many there are):
+		Play::ResetWorld(vPersistentTypes);
 		gameState.asteroids_TL = TRUE; // Spawn all of the new asteroids meteors and gems for the next level!
 		gameState.asteroids_TR = TRUE;
 		gameState.asteroids_BL = TRUE;
@@ -972,19 +1032,8 @@ void UpdateGameLevel()
 	}
 	else if (gameState.level > 4) // If the current level is higher than the last level in the game
 	{
-		// Destroy all asteroids and meteors and gems:
-		for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_ASTEROID))
-		{
-			Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-		}
-		for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_METEOR))
-		{
-			Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-		}
-		for (int id_obj : Play::CollectGameObjectIDsByType(TYPE_GEM))
-		{
-			Play::GetGameObject(id_obj).type = TYPE_DESTROYED;
-		}
+		// Destroy all asteroids and meteors and gems (in one go, however many there are):
+		Play::ResetWorld(vPersistentTypes);
 		gameState.asteroids_TL = FALSE;
 		gameState.asteroids_TR = FALSE;
 		gameState.asteroids_BL = FALSE;
@@ -1023,12 +1072,266 @@ void UpdateGameLevel()
 	// ------------------------------------------
 }
 
+// AUTOPLAY BOT:
+
+// ------------------------------------------
+// Running the game with --autoplay hands the controls over to a bot which plays through all four levels on its own!
+// The bot holds keys down through Play::SetKeyDown() at the start of each frame, just like a player would...
+// ... it flies towards the nearest gem (or the nearest asteroid if there aren't any), dodging any meteors in the way...
+// ... and only launches off an asteroid once the way is clear!
+// Without a window the frames run back to back, so a whole playthrough only takes a few seconds
+// The time taken by every frame is recorded against the level it was on and reported when the game exits
+// --autoplay-budget=<ms> makes the game exit with an error if the bot doesn't finish or any level's 95th percentile frame time is over budget
+// (so it can be used as a performance regression test!)
+// The bot always plays with the same random seed (1 unless --autoplay-seed=<n> chooses another), so a failing run can be repeated exactly
+// ------------------------------------------
+
+enum BotAction // The three ways Agent 8 can fly
+{
+	BOT_STRAIGHT = 0,
+	BOT_LEFT,
+	BOT_RIGHT,
+};
+
+const float BOT_STEP_X[3] = { 2.0f, -3.0f, 3.0f }; // How far Agent 8 moves each update with no key, the left key or the right key held...
+const float BOT_STEP_Y[3] = { -4.0f, -2.0f, -2.0f }; // ... (his velocity gets applied twice per update)!
+const int BOT_KEYS[3] = { 0, VK_LEFT, VK_RIGHT };
+const int BOT_LOOKAHEAD = 90; // How many updates ahead the bot checks for meteors
+const int BOT_TURN_TIMES[5] = { BOT_LOOKAHEAD, 60, 40, 20, 10 }; // How long the bot considers holding a key for before flying straight again
+const int BOT_MAX_WAIT = 600; // Launch anyway after waiting this long on an asteroid
+
+float WrapDelta(float d, float period) // The shortest distance between two points on a screen which wraps around
+{
+	d = fmodf(d, period);
+	if (d > period / 2)
+		d -= period;
+	else if (d < -period / 2)
+		d += period;
+	return d;
+}
+
+Point2f WrapLikeTheGame(Point2f pos, Vector2f origin) // Wraps a position around the display area in the same way as the update functions!
+{
+	if (pos.x - origin.x - 50 > DISPLAY_WIDTH)
+		pos.x = 0.0f - 50 + origin.x;
+	else if (pos.x + origin.x + 50 < 0)
+		pos.x = DISPLAY_WIDTH + 50 - origin.x;
+	if (pos.y - origin.y - 50 > DISPLAY_HEIGHT)
+		pos.y = 0.0f - 50 + origin.y;
+	else if (pos.y + origin.y + 50 < 0)
+		pos.y = DISPLAY_HEIGHT + 50 - origin.y;
+	return pos;
+}
+
+GameObject* FindBotTarget(GameObject& obj_agent8) // Picks the nearest gem, or the nearest asteroid when there aren't any gems!
+{
+	for (int type : { TYPE_GEM, TYPE_ASTEROID })
+	{
+		GameObject* pNearest = nullptr;
+		float nearest = 0;
+		for (int id : Play::CollectGameObjectIDsByType(type))
+		{
+			GameObject& obj = Play::GetGameObject(id);
+			float dx = WrapDelta(obj.pos.x - obj_agent8.pos.x, DISPLAY_WIDTH + 100.0f);
+			float dy = WrapDelta(obj.pos.y - obj_agent8.pos.y, DISPLAY_HEIGHT + 100.0f);
+			if (!pNearest || dx * dx + dy * dy < nearest)
+			{
+				pNearest = &obj;
+				nearest = dx * dx + dy * dy;
+			}
+		}
+		if (pNearest)
+			return pNearest;
+	}
+	return nullptr;
+}
+
+BotAction SteerTowards(GameObject& obj_agent8, GameObject& obj_target) // Picks the action which passes closest to the target!
+{
+	// Agent 8 always flies upwards, so try holding each key for a while then flying straight...
+	// ... and work out how far to the side he'd miss the target by when he reaches its height!
+	float period = DISPLAY_HEIGHT + 100.0f;
+	float lowest = DISPLAY_HEIGHT + 50 - Play::GetSpriteOrigin("spr_agent8_fly").y; // Agent 8 wraps back in above anything right at the bottom, so he has to line up with it there!
+	float closing = -BOT_STEP_Y[BOT_STRAIGHT] + obj_target.velocity.y * 2; // How fast the gap closes vertically when flying straight
+	if (closing <= 0.1f)
+		return BOT_STRAIGHT;
+
+	BotAction best = BOT_STRAIGHT;
+	float bestMiss = 0;
+	for (int action = BOT_STRAIGHT; action <= BOT_RIGHT; action++)
+	{
+		for (int turnFor : BOT_TURN_TIMES)
+		{
+			if (action == BOT_STRAIGHT)
+				turnFor = 0;
+			Point2f agentPos = obj_agent8.pos + Vector2f(BOT_STEP_X[action], BOT_STEP_Y[action]) * static_cast<float>(turnFor);
+			Point2f targetPos = obj_target.pos + obj_target.velocity * 2 * static_cast<float>(turnFor);
+			float distance = fmodf(fmodf(agentPos.y - std::min(targetPos.y, lowest), period) + period, period);
+			float time = distance / closing;
+			float miss = fabsf(WrapDelta(targetPos.x + obj_target.velocity.x * 2 * time - agentPos.x - BOT_STEP_X[BOT_STRAIGHT] * time, DISPLAY_WIDTH + 100.0f));
+			miss += (turnFor + time) * 0.25f; // ... preferring the quicker route when they're close!
+			if ((action == BOT_STRAIGHT && turnFor == 0) || miss < bestMiss)
+			{
+				best = static_cast<BotAction>(action);
+				bestMiss = miss;
+			}
+			if (action == BOT_STRAIGHT)
+				break;
+		}
+	}
+	return best;
+}
+
+int UpdatesUntilHit(GameObject& obj_agent8, int action, int turnFor, const std::vector<int>& vMeteors) // Looks ahead to see when Agent 8 would hit a meteor if he held a key for a while then flew straight!
+{
+	std::vector<Point2f> vMeteorPos;
+	for (int id : vMeteors)
+		vMeteorPos.push_back(Play::GetGameObject(id).pos);
+
+	Point2f agentPos = obj_agent8.pos;
+	Vector2f agentOrigin = Play::GetSpriteOrigin("spr_agent8_fly");
+
+	for (int t = 1; t <= BOT_LOOKAHEAD; t++)
+	{
+		int step = t <= turnFor ? action : BOT_STRAIGHT;
+		agentPos = WrapLikeTheGame(agentPos + Vector2f(BOT_STEP_X[step], BOT_STEP_Y[step]), agentOrigin);
+
+		for (size_t i = 0; i < vMeteors.size(); i++)
+		{
+			GameObject& obj_meteor = Play::GetGameObject(vMeteors[i]);
+			vMeteorPos[i] = WrapLikeTheGame(vMeteorPos[i] + obj_meteor.velocity * 2, PlayGraphics::Instance().GetSpriteOrigin(obj_meteor.spriteId));
+
+			float dx = vMeteorPos[i].x - agentPos.x;
+			float dy = vMeteorPos[i].y - agentPos.y;
+			float clearance = obj_meteor.radius + obj_agent8.radius + 15.0f; // A little extra room for safety!
+			if (dx * dx + dy * dy < clearance * clearance)
+				return t;
+		}
+	}
+	return BOT_LOOKAHEAD + 1; // Safe!
+}
+
+int PickSafeAction(GameObject& obj_agent8, int preferred, const std::vector<int>& vMeteors, int* pClearFor) // Swerves if the preferred action would hit a meteor, taking whichever way stays clear the longest!
+{
+	int best = preferred;
+	int bestClearFor = -1;
+	for (int action : { preferred, static_cast<int>(BOT_STRAIGHT), static_cast<int>(BOT_LEFT), static_cast<int>(BOT_RIGHT) })
+	{
+		for (int turnFor : BOT_TURN_TIMES)
+		{
+			int clearFor = UpdatesUntilHit(obj_agent8, action, turnFor, vMeteors);
+			if (clearFor > bestClearFor)
+			{
+				best = action;
+				bestClearFor = clearFor;
+			}
+			if (bestClearFor > BOT_LOOKAHEAD)
+			{
+				*pClearFor = bestClearFor;
+				return best;
+			}
+		}
+	}
+	*pClearFor = bestClearFor;
+	return best;
+}
+
+void AutoplayBot(int frame) // Called by PlayInput at the start of every frame to press the keys!
+{
+	// Recording how long the last frame took against the level it was on:
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (autoplay.frames > 0 && autoplay.lastLevel >= 1 && autoplay.lastLevel <= 4)
+		autoplay.vFrameMs[autoplay.lastLevel].push_back(std::chrono::duration<double, std::milli>(now - autoplay.lastFrame).count());
+	autoplay.lastFrame = now;
+	autoplay.lastLevel = gameState.level;
+	autoplay.frames++;
+
+	Play::SetKeyDown(VK_LEFT, false); // Let go of everything from the last frame!
+	Play::SetKeyDown(VK_RIGHT, false);
+	Play::SetKeyDown(VK_SPACE, false);
+
+	if (gameState.level > 4) // All four levels done!
+	{
+		autoplay.finished = true;
+		return;
+	}
+
+	GameObject& obj_agent8 = Play::GetGameObjectByType(TYPE_AGENT8);
+	std::vector<int> vMeteors = Play::CollectGameObjectIDsByType(TYPE_METEOR);
+	int clearFor = 0;
+
+	if (gameState.agentState == STATE_DEAD)
+	{
+		if (!autoplay.dead)
+			autoplay.deaths++;
+		autoplay.dead = true;
+		Play::SetKeyDown(VK_SPACE, frame % 2 == 0); // KeyPressed() only sees the space bar again once it has been released!
+		return;
+	}
+
+	autoplay.dead = false;
+
+	if (gameState.agentState == STATE_ATTACHED)
+	{
+		// Agent 8 is safe on an asteroid, so wait there until there's a way of flying off it which is clear of meteors...
+		// ... and the gem won't be left right at the bottom of the screen, where Agent 8 can't reach it if it doesn't drift away!
+		GameObject& obj_asteroid_attached = Play::GetGameObjectByType(TYPE_ASTEROID_ATTACHED);
+		bool reachable = obj_asteroid_attached.pos.y < DISPLAY_HEIGHT + 50 - Play::GetSpriteOrigin("spr_agent8_fly").y;
+		PickSafeAction(obj_agent8, BOT_STRAIGHT, vMeteors, &clearFor);
+		if ((reachable && clearFor > BOT_LOOKAHEAD) || ++autoplay.waitFrames > BOT_MAX_WAIT)
+		{
+			Play::SetKeyDown(VK_SPACE, true);
+			autoplay.waitFrames = 0;
+		}
+	}
+	else
+	{
+		GameObject* pTarget = FindBotTarget(obj_agent8);
+		int action = PickSafeAction(obj_agent8, pTarget ? SteerTowards(obj_agent8, *pTarget) : BOT_STRAIGHT, vMeteors, &clearFor);
+		if (BOT_KEYS[action])
+			Play::SetKeyDown(BOT_KEYS[action], true);
+	}
+}
+
+float FramePercentile(std::vector<double> vFrameMs, float percentile) // Sorts a copy of the frame times to pick out a percentile!
+{
+	if (vFrameMs.empty())
+		return 0;
+	size_t index = std::min(vFrameMs.size() - 1, static_cast<size_t>(vFrameMs.size() * percentile));
+	std::nth_element(vFrameMs.begin(), vFrameMs.begin() + index, vFrameMs.end());
+	return static_cast<float>(vFrameMs[index]);
+}
+
+bool ReportAutoplay() // Prints the frame time stats for each level, returning false if the bot failed or went over budget!
+{
+	bool passed = autoplay.finished;
+	printf("Autoplay: %s after %d frames with %d deaths (seed %u)\n", autoplay.finished ? "completed all four levels" : "did not finish", autoplay.frames, autoplay.deaths, autoplay.seed);
+	printf("Level  Frames  Mean ms   p50 ms   p95 ms   p99 ms   Max ms\n");
+	for (int level = 1; level <= 4; level++)
+	{
+		const std::vector<double>& vFrameMs = autoplay.vFrameMs[level];
+		double total = 0;
+		for (double ms : vFrameMs)
+			total += ms;
+		float p95 = FramePercentile(vFrameMs, 0.95f);
+		printf("%5d  %6zu  %7.3f  %7.3f  %7.3f  %7.3f  %7.3f\n", level, vFrameMs.size(), vFrameMs.empty() ? 0.0 : total / vFrameMs.size(),
+			FramePercentile(vFrameMs, 0.5f), p95, FramePercentile(vFrameMs, 0.99f), FramePercentile(vFrameMs, 1.0f));
+		if (autoplay.budgetMs > 0 && p95 > autoplay.budgetMs)
+		{
+			printf("Autoplay: level %d is over the %.3f ms budget\n", level, autoplay.budgetMs);
+			passed = false;
+		}
+	}
+	return passed;
+}
+
 // This function gets called once when the player quits the game (VK_ESCAPE):
 
 int MainGameExit( void )
 {
+	bool passed = !autoplay.enabled || ReportAutoplay(); // Reporting how the bot got on (the exit code tells a test script whether it passed)!
 	Play::DestroyManager(); // Clears all game information to free up space
-	return PLAY_OK;
+	return passed ? PLAY_OK : PLAY_ERROR;
 }
 
 // Code to check sprite origins:
@@ -27,20 +27,51 @@
 #define PLAY_VERSION	"1.1.21.10.11"
 
 #include <cstdint>
+#include <climits>
 #include <cstdlib>
+#include <cerrno>
 #include <cmath> 
 
 #include <string>
 #include <sstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <memory>
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 #include <chrono>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <thread>
 #include <future>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <cstring>
+#include <cstdarg>
+#include <cstdio>
+#include <cctype>
+
+// SSE2 is available on every x64 CPU, and is used to speed up some of the simpler pixel operations
+#if defined( _M_X64 ) || defined( __SSE2__ )
+#define PLAY_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// Builds for Windows by default, or for the headless platform (no window, sound or keyboard) everywhere else
+// > Define PLAY_PLATFORM_HEADLESS to run headless on Windows too
+// > Define PLAY_PLATFORM_X11 to show the headless platform in an X11 window on Linux (link with -lX11 -lXext)
+#if !defined( PLAY_PLATFORM_HEADLESS ) && ( !defined( _WIN32 ) || defined( PLAY_PLATFORM_X11 ) )
+#define PLAY_PLATFORM_HEADLESS
+#endif
+
+#ifndef PLAY_PLATFORM_HEADLESS
+#define PLAY_PLATFORM_WINDOWS
 
 #define WIN32_LEAN_AND_MEAN // Exclude rarely-used content from the Windows headers
 #define NOMINMAX // Stop windows macros defining their own min and max macros
@@ -67,6 +98,98 @@ namespace Gdiplus
 #include <GdiPlus.h>
 #pragma warning(pop)
 
+#define PLAY_DEBUG_BREAK() __debugbreak()
+
+#else
+
+#ifdef __linux__
+#include <time.h>
+#include <cerrno>
+#endif
+
+#include <csignal>
+
+// For the shared memory PlayMetrics are published in, which is a file mapping on Windows even when running headless
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef PLAY_PLATFORM_X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#if defined( _MSC_VER )
+#define PLAY_DEBUG_BREAK() __debugbreak()
+#elif defined( SIGTRAP )
+#define PLAY_DEBUG_BREAK() raise( SIGTRAP )
+#else
+#define PLAY_DEBUG_BREAK() abort()
+#endif
+
+// Windows definitions used by games, so the same code builds on every platform
+#define TRUE 1
+#define FALSE 0
+#define UNREFERENCED_PARAMETER( P ) static_cast<void>( P )
+
+// Milliseconds since an arbitrary starting point, like the Windows multimedia timer
+inline uint32_t timeGetTime()
+{
+	return static_cast<uint32_t>( std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+}
+
+// Virtual key codes with the same values as Windows
+// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
+#define VK_LBUTTON	0x01
+#define VK_RBUTTON	0x02
+#define VK_BACK		0x08
+#define VK_TAB		0x09
+#define VK_RETURN	0x0D
+#define VK_SHIFT	0x10
+#define VK_CONTROL	0x11
+#define VK_MENU		0x12
+#define VK_ESCAPE	0x1B
+#define VK_SPACE	0x20
+#define VK_PRIOR	0x21
+#define VK_NEXT		0x22
+#define VK_END		0x23
+#define VK_HOME		0x24
+#define VK_LEFT		0x25
+#define VK_UP		0x26
+#define VK_RIGHT	0x27
+#define VK_DOWN		0x28
+#define VK_INSERT	0x2D
+#define VK_DELETE	0x2E
+#define VK_F1		0x70
+#define VK_F2		0x71
+#define VK_F3		0x72
+#define VK_F4		0x73
+#define VK_F5		0x74
+#define VK_F6		0x75
+#define VK_F7		0x76
+#define VK_F8		0x77
+#define VK_F9		0x78
+#define VK_F10		0x79
+#define VK_F11		0x7A
+#define VK_F12		0x7B
+
+#endif
+
 // Macros for Assertion and Tracing
 void TracePrintf(const char* file, int line, const char* fmt, ...);
 void AssertFailMessage(const char* message, const char* file, long line );
@@ -74,9 +197,9 @@ void DebugOutput( const char* s );
 void DebugOutput( std::string s );
 
 #ifdef _DEBUG
-#define PLAY_TRACE(fmt, ...) TracePrintf(__FILE__, __LINE__, fmt, __VA_ARGS__);
-#define PLAY_ASSERT(x) if(!(x)){ PLAY_TRACE(" *** ASSERT FAIL *** !("#x")\n\n"); AssertFailMessage(#x, __FILE__, __LINE__), __debugbreak(); }
-#define PLAY_ASSERT_MSG(x,y) if(!(x)){ PLAY_TRACE(" *** ASSERT FAIL *** !("#x")\n\n"); AssertFailMessage(y, __FILE__, __LINE__), __debugbreak(); }
+#define PLAY_TRACE(fmt, ...) TracePrintf(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
+#define PLAY_ASSERT(x) if(!(x)){ PLAY_TRACE(" *** ASSERT FAIL *** !("#x")\n\n"); AssertFailMessage(#x, __FILE__, __LINE__), PLAY_DEBUG_BREAK(); }
+#define PLAY_ASSERT_MSG(x,y) if(!(x)){ PLAY_TRACE(" *** ASSERT FAIL *** !("#x")\n\n"); AssertFailMessage(y, __FILE__, __LINE__), PLAY_DEBUG_BREAK(); }
 #else
 #define PLAY_TRACE(fmt, ...)
 #define PLAY_ASSERT(x) if(!(x)){ AssertFailMessage(#x, __FILE__, __LINE__);  }
@@ -117,6 +240,15 @@ constexpr float PLAY_PI	= 3.14159265358979323846f;   // pi
 	#define PrintAllocations( x )
 #endif
 
+// Define PLAY_COUNT_ALLOCATIONS as 1 to count allocations outside _DEBUG builds too, for the shared memory metrics
+// > Replaces the global operator new and delete with versions which count and then call malloc and free
+#ifndef PLAY_COUNT_ALLOCATIONS
+#define PLAY_COUNT_ALLOCATIONS 0
+#endif
+
+// Gets the number of allocations made with new so far (always 0 unless _DEBUG or PLAY_COUNT_ALLOCATIONS is defined)
+unsigned long long GetAllocationCount();
+
 #endif
 #ifndef PLAY_PLAYMATHS_H
 #define PLAY_PLAYMATHS_H
@@ -375,6 +507,26 @@ inline Vector2f normalize( const Vector2f& v )
 	return v / length( v );
 }
 
+// Fast trigonometry
+//**************************************************************************************************
+
+namespace Play
+{
+	// Calculates the sine and cosine of an angle in radians from a 256 entry table and a short polynomial, several times faster than std::sin and std::cos
+	// > Within 1.5e-7 of the exact values for angles up to +/-1500 radians. Beyond that the error is about half the gap between floats of that size
+	void FastSinCos( float angle, float& sinOut, float& cosOut );
+	// Calculates the angle in radians of the vector (x, y) from the x axis, from -PI to PI, with a polynomial
+	// > Within 3.5e-7 radians of the exact angle, against 2.5e-7 for std::atan2 on floats. Signed zeros give the same results as std::atan2
+	float FastAtan2( float y, float x );
+	// Calculates FastSinCos for an array of angles, four at a time with SSE2, and gives exactly the same results
+	void FastSinCos( const float* pAngles, float* pSinOut, float* pCosOut, int count );
+	// Calculates FastAtan2 for arrays of y and x, four at a time with SSE2, and gives exactly the same results
+	void FastAtan2( const float* pY, const float* pX, float* pAnglesOut, int count );
+	// Measures the accuracy and speed of the fast trigonometry against the standard library, and prints the results
+	// > Also run with --play-benchmark-trig on the command line, which exits after printing them
+	void BenchmarkFastTrig( int count = 1 << 20 );
+}
+
 #endif
 
 
@@ -451,17 +603,142 @@ struct MouseData
 
 #endif
 
+#ifndef PLAY_PLAYFRAMEPACER_H
+#define PLAY_PLAYFRAMEPACER_H
+//********************************************************************************************************************************
+// File:		PlayFramePacer.h
+// Description:	Holds the main loop to a steady frame rate without spinning the CPU while it waits
+// Platform:	Independent
+// Notes:		Sleeps on a high resolution timer, then spins for the last fraction of a millisecond
+//********************************************************************************************************************************
+
+// How closely the frames have been kept to their target times
+struct FramePacingStats
+{
+	// The number of frames paced since the stats were reset
+	int frames{ 0 };
+	// Frames where the game took longer than the frame time, so there was no time to wait
+	int lateFrames{ 0 };
+	// The average difference between when a frame was due and when it started
+	double meanErrorMs{ 0.0 };
+	// The largest difference between when a frame was due and when it started
+	double maxErrorMs{ 0.0 };
+	// The average time spent spinning rather than sleeping each frame
+	double meanSpinMs{ 0.0 };
+};
+
+// Waits for the start of each frame at a fixed frame rate
+// > Owned by PlayWindow, so only one of these exists
+class PlayFramePacer
+{
+public:
+	// Creates the high resolution timer used for sleeping
+	PlayFramePacer( int framesPerSecond );
+	// Releases the timer
+	~PlayFramePacer();
+	// The assignment operator is removed to prevent copying the timer
+	PlayFramePacer& operator=( const PlayFramePacer& ) = delete;
+	// The copy constructor is removed to prevent copying the timer
+	PlayFramePacer( const PlayFramePacer& ) = delete;
+
+	// Sets the target number of frames per second
+	void SetFrameRate( int framesPerSecond );
+	// Waits until the next frame is due
+	// > Returns the time since the previous frame started in seconds
+	double WaitForNextFrame();
+	// Gets the target time between frames in seconds
+	double GetFrameTime() const { return std::chrono::duration<double>( m_frameTime ).count(); }
+	// Gets the pacing statistics since they were last reset
+	const FramePacingStats& GetStats() const { return m_stats; }
+	// Starts collecting the pacing statistics again
+	void ResetStats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Sleeps until the given time using the most accurate timer available
+	void SleepUntil( Clock::time_point wakeTime );
+
+	Clock::duration m_frameTime;
+	Clock::time_point m_lastFrame;
+	Clock::time_point m_nextFrame;
+	// How long before the deadline to wake up and start spinning, based on how late recent sleeps have woken up
+	Clock::duration m_spinMargin;
+	FramePacingStats m_stats;
+	double m_totalErrorMs{ 0.0 };
+	double m_totalSpinMs{ 0.0 };
+#ifdef PLAY_PLATFORM_WINDOWS
+	// A high resolution waitable timer, or nullptr on versions of Windows without one
+	HANDLE m_hTimer{ nullptr };
+#endif
+};
+
+// The number of recent frame times kept for the percentiles and the F1 overlay
+constexpr int FRAME_TIME_HISTORY = 4096;
+// How far over budget a frame has to be to count as a hitch, so the pacer's usual timing jitter isn't counted
+constexpr double FRAME_HITCH_MARGIN_MS = 1.0;
+
+// The spread of the frame times in a FrameTimeHistory, in milliseconds
+// > Averages hide the occasional long frame, so this looks at the slowest ones
+struct FrameTimeStats
+{
+	// The number of frames the stats cover
+	int frames{ 0 };
+	double p50Ms{ 0.0 };
+	double p95Ms{ 0.0 };
+	double p99Ms{ 0.0 };
+	double maxMs{ 0.0 };
+	// The time a frame should take, which the hitches are counted against
+	double budgetMs{ 0.0 };
+	// Frames which took longer than the budget, by more than FRAME_HITCH_MARGIN_MS
+	int hitches{ 0 };
+	// Frames which took longer than twice the budget, so at least one whole frame was missed
+	int bigHitches{ 0 };
+};
+
+// A rolling history of how long the most recent frames took, from the start of one to the start of the next
+// > Owned by PlayWindow, which adds to it at the start of every frame
+class FrameTimeHistory
+{
+public:
+	// Adds a frame time, replacing the oldest once the history is full
+	void Add( float ms );
+	// Gets the number of frame times held
+	int GetCount() const { return static_cast<int>( std::min<long long>( m_total, FRAME_TIME_HISTORY ) ); }
+	// Gets the total number of frame times added, including the ones which have since been replaced
+	long long GetTotal() const { return m_total; }
+	// Gets a frame time, where 0 is the oldest one held
+	float Get( int index ) const { return m_ms[( m_next - GetCount() + index + FRAME_TIME_HISTORY ) % FRAME_TIME_HISTORY]; }
+	// Works out the percentiles and counts the hitches against the given budget
+	FrameTimeStats GetStats( double budgetMs ) const;
+	// Writes the frame times to a CSV file, oldest first, returning false if it can't be written
+	bool ExportCsv( const char* filename, double budgetMs ) const;
+
+private:
+	float m_ms[FRAME_TIME_HISTORY]{};
+	// Where the next frame time goes
+	int m_next{ 0 };
+	long long m_total{ 0 };
+};
+
+#endif
+
 #ifndef PLAY_PLAYWINDOW_H
 #define PLAY_PLAYWINDOW_H
 //********************************************************************************************************************************
 // File:		PlayWindow.h
 // Description:	Platform specific code to provide a window to draw into
-// Platform:	Windows
-// Notes:		Uses a 32-bit ARGB display buffer
+// Platform:	Windows / Headless / X11
+// Notes:		Uses a 32-bit ARGB display buffer. The headless platform presents into an offscreen framebuffer instead,
+//				or into an X11 window when PLAY_PLATFORM_X11 is defined.
 //********************************************************************************************************************************
 
 // The target frame rate
 constexpr int FRAMES_PER_SECOND = 60;
+// The most fixed rate ticks which will be run to catch up in a single frame
+constexpr int MAX_TICKS_PER_FRAME = 5;
+// The most finished frames which can wait for the present thread
+constexpr int MAX_PRESENT_QUEUE_DEPTH = 2;
 
 // Some defines to hide the complexity of arguments 
 #define PLAY_IGNORE_COMMAND_LINE	int, char*[]
@@ -469,6 +746,34 @@ constexpr int FRAMES_PER_SECOND = 60;
 constexpr int PLAY_OK = 0;
 constexpr int PLAY_ERROR = -1;
 
+// Counts how long each Present() took in power of two sized buckets
+struct PresentHistogram
+{
+	static constexpr int BUCKETS = 16;
+	// Gets the upper limit of a bucket: 0.01ms, 0.02ms, 0.04ms ... with the last bucket catching everything slower
+	static double BucketLimitMs( int bucket ) { return 0.01 * ( 1 << bucket ); }
+	// Adds a present time to the histogram
+	void Add( double ms );
+
+	int counts[BUCKETS]{};
+	int presents{ 0 };
+	double totalMs{ 0.0 };
+	double maxMs{ 0.0 };
+};
+
+// Statistics on the frames handed to the present thread
+struct PresentQueueStats
+{
+	int queued{ 0 };
+	int presented{ 0 };
+	// Time from a frame being queued to it being in the window
+	double meanLatencyMs{ 0.0 };
+	double maxLatencyMs{ 0.0 };
+	// Time the game thread spent waiting for the present thread to free up a drawing buffer
+	double meanWaitMs{ 0.0 };
+	double maxWaitMs{ 0.0 };
+};
+
 // Encapsulates the platform specific functionality of creating and managing a window 
 // > Singleton class accessed using PlayWindow::Instance()
 class PlayWindow
@@ -485,6 +790,7 @@ public:
 	// Destroys the PlayWindow instance
 	static void Destroy();
 
+#ifdef PLAY_PLATFORM_WINDOWS
 	// Windows functions
 	//********************************************************************************************************************************
 
@@ -492,21 +798,110 @@ public:
 	int HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow, LPCWSTR windowName );
 	// Handles Windows messages for the PlayWindow  
 	static LRESULT CALLBACK WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam );
+#else
+	// Headless functions
+	//********************************************************************************************************************************
+
+	// Call within main to run the game without a window until it quits, the frame limit is reached or a replay runs out
+	// > --play-frames=N stops after N frames, --play-realtime paces the frames rather than running them back to back,
+	// > --play-input=<file> plays back a PlayInput script, --play-checksum prints a checksum of the last frame on exit,
+	// > --play-frame-times=<file> writes the most recent frame times to a CSV file on exit
+	// > (--play-record=<file>, --play-replay=<file>, --play-profile=<file> and --play-metrics[=<name>] are handled by main,
+	// > see Play::RecordInput, Play::ReplayInput, Play::ExportProfile and Play::PublishMetrics)
+	int HandleHeadless( int argc, char* argv[] );
+	// Gets the pixels copied to the offscreen framebuffer by the last Present(), scaled up by the display scale
+	// > Call FlushPresents() first if there's a present thread
+	const std::vector<Pixel>& GetFramebuffer() const { return m_vFramebuffer; }
+#endif
+#ifdef PLAY_PLATFORM_X11
+	// Call within main to open an X11 window and run the game in it, paced in real time
+	// > Runs headless into the offscreen framebuffer if there's no X display to connect to
+	// > With --play-checksum the last frame is also checked against what the window shows
+	int HandleX11( int argc, char* argv[] );
+	// Presents through XPutImage even if the X server supports MIT-SHM (--play-x11-no-shm)
+	// > Call before Play::CreateManager, as that's when the display buffers are created
+	static void DisableX11SharedMemory() { s_bX11NoShm = true; }
+#endif
+
 	// Copies the display buffer pixels to the window
-	// > Returns the time taken for the present in seconds
+	// > Returns the time taken for the present in milliseconds
 	double Present();
 	// Sets the pointer to write mouse input data to
 	void RegisterMouse( MouseData* pMouseData ) { m_pMouseData = pMouseData; }
+	// Sets the function which redraws the window on frames where no fixed rate tick was run
+	void RegisterRedraw( void( *pRedraw )() ) { m_pRedraw = pRedraw; }
+	// Gets the histogram of how long each Present() has taken
+	PresentHistogram GetPresentHistogram() const;
+
+	// Present thread functions
+	//********************************************************************************************************************************
+
+	// Sets how many finished frames can wait to be presented while the next one is drawn (0 to MAX_PRESENT_QUEUE_DEPTH)
+	// > 0 presents on the game thread (the default), anything more presents on a separate thread
+	void SetPresentQueueDepth( int depth );
+	// Gets how many finished frames can wait to be presented
+	int GetPresentQueueDepth() const { return m_presentQueueDepth; }
+	// Hands a finished frame to the present thread, waiting first if the queue is full
+	// > The pixels mustn't be drawn into until at least GetPresentQueueDepth() more frames have been queued
+	// > The frame can be smaller than the display buffer, if it was drawn at a reduced resolution
+	void QueuePresent( const PixelData& frame );
+	// Waits until every queued frame has been presented
+	void FlushPresents();
+	// Gets statistics on the frames handed to the present thread
+	PresentQueueStats GetPresentQueueStats() const;
+
+	// Display buffer functions
+	//********************************************************************************************************************************
+
+	// Allocates the pixels for a display buffer (call before creating the PlayWindow)
+	// > On X11 the pixels live in memory shared with the X server so they can be presented without copying them
+	static Pixel* CreateDisplayPixels( int width, int height );
+	// Frees pixels allocated by CreateDisplayPixels()
+	static void DestroyDisplayPixels( Pixel* pPixels );
+
+	// Timing functions
+	//********************************************************************************************************************************
+
+	// Sets the target number of frames per second
+	void SetFrameRate( int framesPerSecond ) { m_pacer.SetFrameRate( framesPerSecond ); }
+	// Gets the pacing statistics for the frames so far
+	const FramePacingStats& GetFramePacingStats() const { return m_pacer.GetStats(); }
+	// Gets the target time between frames in seconds
+	double GetFrameTime() const { return m_pacer.GetFrameTime(); }
+	// Gets how long the current frame has been running in milliseconds, not counting the wait for it to be due
+	double GetFrameElapsedMs() const { return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - m_frameStart ).count(); }
+	// Gets the history of the most recent frame times
+	// > Call from the game thread, which is the one that adds to it
+	const FrameTimeHistory& GetFrameTimeHistory() const { return m_frameTimes; }
+	// Gets the percentiles and hitches of the most recent frames, against the time between frames at the target frame rate
+	FrameTimeStats GetFrameTimeStats() const { return m_frameTimes.GetStats( GetFrameTime() * 1000.0 ); }
+	// Writes the most recent frame times to a CSV file, returning false if it can't be written
+	bool ExportFrameTimes( const char* filename ) const { return m_frameTimes.ExportCsv( filename, GetFrameTime() * 1000.0 ); }
+	// Calls MainGameUpdate() a fixed number of times per second, however many frames are being drawn
+	// > A tick rate of 0 calls MainGameUpdate() once per frame (the default)
+	void SetTickRate( int ticksPerSecond );
+	// Gets the fixed tick rate, or 0 if MainGameUpdate() is called once per frame
+	int GetTickRate() const { return m_tickRate; }
+	// Returns true while MainGameUpdate() is being called at the fixed tick rate
+	bool IsFixedTick() const { return m_bInFixedTick; }
+	// Returns true if the current fixed tick is the last one before the frame is drawn
+	bool IsDrawingTick() const { return m_bDrawingTick; }
+	// Gets the total number of fixed rate ticks run so far
+	unsigned long long GetTickCount() const { return m_tickCount; }
+	// Gets how far the frame is between the last tick and the next one (0.0f to 1.0f)
+	float GetInterpolation() const { return m_interpolation; }
 
 	// Getter functions
 	//********************************************************************************************************************************
 
 	// Gets the width of the display buffer in pixels
-	int GetWidth() const { return m_pPlayBuffer->width; }
+	int GetWidth() const { return m_width; }
 	// Gets the height of the display buffer in pixels 
-	int GetHeight() const { return m_pPlayBuffer->height; }
+	int GetHeight() const { return m_height; }
 	// Gets the scale of the display buffer in pixels
 	int GetScale() const { return m_scale; }
+	// Sets how many bands of rows the display buffer is split into, to be scaled up on different threads (1 by default)
+	void SetUpscaleBands( int bands );
 
 	// Loading functions
 	//********************************************************************************************************************************
@@ -515,6 +910,9 @@ public:
 	static int ReadPNGImage( std::string& fileAndPath, int& width, int& height );
 	// Loads a png image and puts the image data into the destination image provided
 	static int LoadPNGImage( std::string& fileAndPath, PixelData& destImage );
+	// Converts the Windows style paths used by PlayBuffer (e.g. "Data\\Sprites\\") into ones which work on the current platform
+	// > On case sensitive file systems the case of existing files is matched too
+	static std::string NativePath( const std::string& path );
 
 private:
 
@@ -533,19 +931,131 @@ private:
 	// Miscellaneous internal functions
 	//********************************************************************************************************************************
 
+	// Runs as many fixed rate ticks as fit into the elapsed time and returns true if the game wants to quit
+	bool RunFixedTicks( double elapsedSeconds );
+	// Marks the start of a frame, adding the time since the last one started to the frame time history
+	void StartFrame();
+	// Copies the given frame to the window and returns the time taken in milliseconds
+	double PresentPixels( const PixelData& frame );
+	// Scales the given frame up to the size of the window into pDest
+	void Upscale( const PixelData& frame, Pixel* pDest );
+	// Presents queued frames until told to stop
+	void PresentThread();
+	// Presents anything left in the queue then stops the present thread
+	void StopPresentThread();
+#ifdef PLAY_PLATFORM_X11
+	// An XImage along with the shared memory segment holding its pixels, if it has one
+	// > Kept at a fixed address as XShmCreateImage() holds on to a pointer to the segment info
+	struct X11Image
+	{
+		XImage* pImage{ nullptr };
+		XShmSegmentInfo shmInfo{};
+		bool bShared{ false };
+	};
+
+	// Creates an image in memory shared with the X server if possible, or in normal memory if not
+	// > Call with s_displayMutex locked
+	static X11Image* CreateX11Image( int width, int height );
+	// Frees an image created by CreateX11Image()
+	// > Call with s_displayMutex locked
+	static void DestroyX11Image( X11Image* pImage );
+	// Closes the connection to the X server once there's no window or display buffer using it
+	// > Call with s_displayMutex locked
+	static void CloseX11Display();
+	// Handles any waiting X11 events and returns false if the window has been closed
+	bool HandleX11Events();
+	// Converts an X11 key symbol into a virtual key code, or returns 0 if there isn't one
+	static int KeySymToVirtualKey( KeySym keySym );
+	// Opens the connection to the X server if it hasn't been tried already, returning false if there isn't one
+	// > Call with s_displayMutex locked
+	static bool OpenX11Display();
+	// Copies the frame to the window, returning false if there isn't one
+	bool PresentX11( const PixelData& frame );
+	// Reads the window back from the X server and checks it shows the last frame in the offscreen framebuffer
+	// > Only the colour is compared, as the X server doesn't keep the alpha byte
+	// > Call with s_displayMutex locked
+	bool X11WindowMatchesFramebuffer() const;
+#endif
+
 	// Display buffer dimensions
+	// > Kept separately as the display buffer shrinks when it's drawn at a reduced resolution
+	int m_width{ 0 };
+	int m_height{ 0 };
 	int m_scale{ 0 };
+	int m_upscaleBands{ 1 };
+
+	// Frame timing
+	PlayFramePacer m_pacer{ FRAMES_PER_SECOND };
+	std::chrono::steady_clock::time_point m_frameStart;
+	FrameTimeHistory m_frameTimes;
+	int m_tickRate{ 0 };
+	double m_tickAccumulator{ 0.0 };
+	unsigned long long m_tickCount{ 0 };
+	float m_interpolation{ 1.0f };
+	bool m_bInFixedTick{ false };
+	bool m_bDrawingTick{ true };
+	void( *m_pRedraw )() { nullptr };
 
 	// Buffer pointers
 	PixelData* m_pPlayBuffer{ nullptr };
 	//Pointer to external mouse data
 	MouseData* m_pMouseData{ nullptr };
-	// Pointer to the instance.
-	static PlayWindow* s_pInstance;
+#ifdef PLAY_PLATFORM_WINDOWS
 	// The handle to the Window 
 	HWND m_hWindow{ nullptr };
+	// The display buffer scaled up to the size of the window
+	std::vector<Pixel> m_vScaledPixels;
 	// A GDI+ token
 	static unsigned long long s_pGDIToken;
+#else
+	// Stands in for the window's pixels
+	std::vector<Pixel> m_vFramebuffer;
+	// Whether the frames are paced in real time
+	bool m_bRealtime{ false };
+	// Whether to print a checksum of the framebuffer when the window is destroyed
+	// > The frames shown in an X11 window are copied to the framebuffer as well, so the checksum is the same with or without one
+	bool m_bPrintChecksum{ false };
+#endif
+#ifdef PLAY_PLATFORM_X11
+	// The connection to the X server, opened by CreateDisplayPixels() so the display buffer can be shared with it
+	static Display* s_pDisplay;
+	// Whether opening the display has already been tried (and failed)
+	static bool s_bDisplayTried;
+	// Whether MIT-SHM has been turned off by DisableX11SharedMemory()
+	static bool s_bX11NoShm;
+	// The images allocated by CreateDisplayPixels()
+	static std::vector<X11Image*> s_vDisplayImages;
+	// The number of windows open on the display, across every context
+	static int s_nWindows;
+	// Guards the display statics, as each context can be on its own thread
+	static std::mutex s_displayMutex;
+	// A window sized image to scale frames up into when they're smaller than the window
+	X11Image* m_pScaledImage{ nullptr };
+	::Window m_xWindow{ 0 };
+	GC m_gc{ nullptr };
+	Atom m_wmDeleteWindow{ 0 };
+#endif
+
+	// Present thread
+	struct QueuedPresent
+	{
+		PixelData frame;
+		std::chrono::steady_clock::time_point queueTime;
+	};
+
+	int m_presentQueueDepth{ 0 };
+	std::thread m_presentThread;
+	bool m_bStopPresentThread{ false };
+	std::deque<QueuedPresent> m_presentQueue;
+	// Frames queued or being presented
+	int m_presentsInFlight{ 0 };
+	// Guards the queue and the present statistics
+	mutable std::mutex m_presentMutex;
+	std::condition_variable m_presentCondition;
+	PresentQueueStats m_presentQueueStats;
+	double m_totalLatencyMs{ 0.0 };
+	double m_totalWaitMs{ 0.0 };
+	PresentHistogram m_presentHistogram;
 };
 
 #endif
@@ -560,6 +1070,44 @@ private:
 // Platform:	Independent
 //********************************************************************************************************************************
 
+// Define PLAY_BLITTER_STATS as 1 to count the pixels each blit works on, for the F1 overlay
+// > Also counts how many times each pixel is drawn to, shown as a heatmap by pressing F2
+// > Without it the counting isn't compiled in at all
+#ifndef PLAY_BLITTER_STATS
+#define PLAY_BLITTER_STATS 0
+#endif
+
+#if PLAY_BLITTER_STATS
+#define PLAY_BLIT_STAT( ... ) __VA_ARGS__
+#else
+#define PLAY_BLIT_STAT( ... )
+#endif
+
+// Counts of the pixels covered by one or more blits
+// > Every pixel a blit covers is either visited, skipped or clipped
+struct BlitStats
+{
+	unsigned long long calls{ 0 };
+	// Pixels the inner loop looked at one at a time
+	unsigned long long visited{ 0 };
+	// Visited pixels which were written to the render target
+	unsigned long long blended{ 0 };
+	// Pixels passed over without being looked at, as part of a run of transparent pixels
+	unsigned long long skipped{ 0 };
+	// Pixels outside the render target
+	unsigned long long clipped{ 0 };
+
+	BlitStats& operator+=( const BlitStats& rhs )
+	{
+		calls += rhs.calls;
+		visited += rhs.visited;
+		blended += rhs.blended;
+		skipped += rhs.skipped;
+		clipped += rhs.clipped;
+		return *this;
+	}
+};
+
 // A software pixel renderer for drawing 2D primitives into a PixelData buffer
 // > A singleton class accessed using PlayBlitter::Instance()
 class PlayBlitter
@@ -574,6 +1122,8 @@ public:
 	// Set the render target for all subsequent drawing operations
 	// Returns a pointer to any previous render target
 	PixelData* SetRenderTarget( PixelData* pRenderTarget ) { PixelData* old = m_pRenderTarget; m_pRenderTarget = pRenderTarget; return old; }
+	// Gets the current render target
+	PixelData* GetRenderTarget() const { return m_pRenderTarget; }
 
 	// Primitive drawing functions
 	//********************************************************************************************************************************
@@ -592,10 +1142,39 @@ public:
 	void ClearRenderTarget( Pixel colour );
 	// Copies a background image of the correct size to the render target
 	void BlitBackground( PixelData& backgroundImage );
+	// Copies rows startRow to endRow - 1 of the source image to the render target, scaled up a whole number of times by repeating pixels
+	// > The render target must be exactly scale times the size of the source image
+	// > Different rows can be scaled on different threads at the same time
+	void UpscalePixels( const PixelData& srcImage, int scale, int startRow, int endRow ) const;
+	// Fills rows startRow to endRow - 1 of the render target with the source image stretched to fit, using the nearest pixels
+	// > Slower than UpscalePixels() but works for any pair of sizes
+	void ResamplePixels( const PixelData& srcImage, int startRow, int endRow ) const;
+
+#if PLAY_BLITTER_STATS
+	// Gets the pixel counts for the last BlitPixels(), RotateScalePixels() or BlitBackground() call
+	const BlitStats& GetLastBlitStats() const { return m_lastBlitStats; }
+	// Counts how many times each pixel of the given render target is written to, one count per pixel laid out the same way
+	// > Pass nullptr to stop counting
+	void SetOverdrawCounts( const PixelData* pTarget, uint8_t* pCounts ) { m_pOverdrawTarget = pTarget; m_pOverdrawCounts = pCounts; }
+#endif
 
 private:
 
+#if PLAY_BLITTER_STATS
+	// Gets the overdraw counts, or nullptr if the current render target isn't the one they're for
+	uint8_t* GetOverdrawCounts() const { return m_pRenderTarget == m_pOverdrawTarget ? m_pOverdrawCounts : nullptr; }
+	// Adds one to an overdraw count, stopping at 255 rather than wrapping round to 0
+	static void AddOverdraw( uint8_t& count ) { count += ( count < 255 ); }
+	// Adds one to a run of overdraw counts
+	static void AddOverdraw( uint8_t* pCounts, size_t n ) { for( uint8_t* pEnd = pCounts + n; pCounts < pEnd; pCounts++ ) AddOverdraw( *pCounts ); }
+#endif
+
 	PixelData* m_pRenderTarget{ nullptr };
+#if PLAY_BLITTER_STATS
+	mutable BlitStats m_lastBlitStats;
+	const PixelData* m_pOverdrawTarget{ nullptr };
+	uint8_t* m_pOverdrawCounts{ nullptr };
+#endif
 
 };
 
@@ -609,6 +1188,11 @@ private:
 // Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
 //********************************************************************************************************************************
 
+// The most buffers PlayGraphics can draw into in turn
+constexpr int MAX_DRAWING_BUFFERS = MAX_PRESENT_QUEUE_DEPTH + 1;
+// The render scales dynamic resolution steps between, from full resolution downwards
+constexpr float DYNAMIC_RENDER_SCALES[] = { 1.0f, 0.75f, 0.5f };
+
 // Manages 2D graphics operations on a PixelData buffer 
 // > Singleton class accessed using PlayGraphics::Instance()
 class PlayGraphics
@@ -731,6 +1315,7 @@ public:
 		int originX{ 0 }, originY{ 0 }; // The origin and centre of rotation for the sprite (whole pixels only)
 		PixelData canvasBuffer; // The sprite image data
 		PixelData preMultAlpha; // The sprite data pre-multiplied with its own alpha
+		bool bSharedCanvas{ false }, bSharedPreMultAlpha{ false }; // Set while the pixels belong to the sprites shared between contexts
 		Sprite() = default;
 	};
 
@@ -739,6 +1324,29 @@ public:
 
 	// Gets a pointer to the drawing buffer's pixel data
 	PixelData* GetDrawingBuffer( void ) { return &m_playBuffer; }
+	// Sets how many buffers are drawn into in turn (1 to MAX_DRAWING_BUFFERS), so finished frames can be presented while the next is drawn
+	// > The new buffers start out cleared
+	void SetDrawingBufferCount( int count );
+	// Gets the number of buffers which are drawn into in turn
+	int GetDrawingBufferCount() const { return static_cast<int>( m_vDrawingBuffers.size() ); }
+	// Moves the drawing buffer on to the next buffer in turn
+	// > Returns the pixels of the finished frame, which mustn't be drawn into until it comes round again
+	Pixel* NextDrawingBuffer();
+
+	// Render scale functions
+	//********************************************************************************************************************************
+
+	// Draws into a reduced area of the display buffer, to be scaled up to the window when it's presented (0.0f < scale <= 1.0f)
+	// > Positions and sizes are still given at full resolution and scaled as they're drawn, so the game doesn't need to know
+	void SetRenderScale( float scale );
+	// Gets the fraction of the full resolution being drawn at
+	float GetRenderScale() const { return m_renderScale; }
+	// Steps the render scale through DYNAMIC_RENDER_SCALES to keep frames within the given time budget in milliseconds
+	// > Pass 0 to turn it off and go back to full resolution
+	void SetDynamicResolution( double frameBudgetMs );
+	// Adjusts the render scale for the frames to come from how long the last one took in milliseconds
+	// > Call between frames, from the thread which draws them
+	void UpdateDynamicResolution( double frameMs );
 	// Resets the timing bar data and sets the current timing bar segment to a specific colour
 	void TimingBarBegin( Pixel pix );
 	// Sets the current timing bar segment to a specific colour
@@ -748,6 +1356,57 @@ public:
 	void DrawTimingBar( Point2f pos, Point2f size );
 	// Gets the duration (in milliseconds) of a specific timing segment
 	float GetTimingSegmentDuration( int id ) const;
+	// Starts counting the blits for a new frame, keeping the count for the one just finished
+	void EndBlitCountFrame() { m_lastFrameBlits.store( m_nFrameBlits, std::memory_order_relaxed ); m_nFrameBlits = 0; }
+	// Gets the number of sprites, backgrounds and other pixel data drawn in the last frame finished
+	// > Always counted, and can be called from the game thread while the render thread is drawing
+	unsigned long long GetLastFrameBlitCount() const { return m_lastFrameBlits.load( std::memory_order_relaxed ); }
+
+#if PLAY_BLITTER_STATS
+	// The blitter's pixel counts for a whole frame, in total and split up by sprite and by GameObject type
+	struct BlitFrameStats
+	{
+		BlitStats total;
+		// Indexed by sprite id
+		std::vector<BlitStats> vSprites;
+		std::map<int, BlitStats> objectTypes;
+	};
+	// Sets the GameObject type the following sprite draws are counted against (-1 for none)
+	void SetBlitStatsObjectType( int type ) { m_blitStatsObjectType = type; }
+	// Starts counting a new frame, keeping the counts for the one just finished
+	void EndBlitStatsFrame();
+	// Gets the counts for the last frame finished
+	const BlitFrameStats& GetLastFrameBlitStats() const { return m_lastFrameBlitStats; }
+	// Gets the number of pixels blended in the last frame finished
+	// > Unlike GetLastFrameBlitStats, can be called from the game thread while the render thread is drawing
+	unsigned long long GetLastFramePixelsBlended() const { return m_lastFramePixelsBlended.load( std::memory_order_relaxed ); }
+
+	// Ways of showing how many times each pixel of a frame was drawn to
+	enum OverdrawView : uint8_t { OVERDRAW_OFF, OVERDRAW_HEATMAP, OVERDRAW_BLEND, OVERDRAW_VIEW_COUNT };
+	// A summary of the overdraw in a frame
+	struct OverdrawStats
+	{
+		float mean{ 0.0f };
+		int max{ 0 };
+		// Percentage of the pixels drawn to more than OVERDRAW_HIGH times
+		float percentHigh{ 0.0f };
+	};
+	// Counts above this are considered heavy overdraw
+	static constexpr int OVERDRAW_HIGH = 3;
+	// Shows the overdraw instead of the frame, blended over it, or not at all, starting from the next frame
+	// > Can be called from the game thread while the render thread is drawing
+	void SetOverdrawView( OverdrawView view ) { m_overdrawViewRequest = view; }
+	// Gets the overdraw view last asked for
+	OverdrawView GetOverdrawView() const { return m_overdrawViewRequest; }
+	// Summarises the overdraw in the finished frame, draws it over the frame and starts counting again for the next one
+	// > Call just before the frame is presented, from the thread which draws the frames
+	void EndOverdrawFrame();
+	// Has EndOverdrawFrame write the frame's overdraw summary on a line at the given height, on top of the heatmap
+	// > Call from the thread which draws the frames, before the frame ends
+	void ShowOverdrawSummary( int textY ) { m_overdrawSummaryY = textY; }
+	// Gets the overdraw summary for the last frame finished, which is all zero while the view is off
+	const OverdrawStats& GetLastOverdrawStats() const { return m_lastOverdrawStats; }
+#endif
 	// Clears the display buffer using the given pixel colour
 	void ClearBuffer( Pixel colour ) { m_blitter.ClearRenderTarget( colour ); }
 	// Sets the render target for drawing operations
@@ -772,6 +1431,9 @@ private:
 	// Internal functions relating to drawing
 	//********************************************************************************************************************************
 
+	// Loads the sprites from all the PNGs in a directory, or shares them with another context which has already loaded it
+	void LoadSprites( const char* path );
+
 	// Multiplies the sprite image by its own alpha transparency values to save repeating this calculation on every draw
 	// > A colour multiplication can also be applied at this stage, which affects all subseqent drawing operations on the sprite
 	void PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply, Pixel colourMultiply );
@@ -787,8 +1449,10 @@ private:
 	int GetDebugStringWidth( const std::string& s );
 	// Draws the offset points from the origin in all octants
 	void DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix );
+	// Gets the scale drawing positions and sizes are multiplied by, which is only the render scale for the display buffer
+	float GetDrawScale() const { return m_blitter.GetRenderTarget() == &m_playBuffer ? m_renderScale : 1.0f; }
 	// Ends the current timing segment and calculates the duration
-	LARGE_INTEGER EndTimingSegment();
+	long long EndTimingSegment();
 
 	struct TimingSegment
 	{
@@ -802,20 +1466,72 @@ private:
 	std::vector<TimingSegment> m_vTimings;
 	std::vector<TimingSegment> m_vPrevTimings;
 
+	// Counts a blit towards the frame, and its pixels under a sprite id (-1 for anything which isn't a sprite) with PLAY_BLITTER_STATS
+	void CountBlit( int spriteId ) const
+	{
+		UNREFERENCED_PARAMETER( spriteId );
+		m_nFrameBlits++;
+		PLAY_BLIT_STAT( AddBlitStats( spriteId ); )
+	}
+
+	mutable unsigned long long m_nFrameBlits{ 0 };
+	std::atomic<unsigned long long> m_lastFrameBlits{ 0 };
+
+#if PLAY_BLITTER_STATS
+	// Adds the blitter's last call to the frame's counts under a sprite id (-1 for anything which isn't a sprite)
+	void AddBlitStats( int spriteId ) const;
+
+	mutable BlitFrameStats m_blitStats;
+	BlitFrameStats m_lastFrameBlitStats;
+	std::atomic<unsigned long long> m_lastFramePixelsBlended{ 0 };
+	int m_blitStatsObjectType{ -1 };
+
+	// The view changes between frames so a frame is never part counted
+	std::atomic<OverdrawView> m_overdrawViewRequest{ OVERDRAW_OFF };
+	OverdrawView m_overdrawView{ OVERDRAW_OFF };
+	// One count per pixel of the display buffer, only allocated while the view is on
+	std::vector<uint8_t> m_vOverdrawCounts;
+	OverdrawStats m_lastOverdrawStats;
+	// Where EndOverdrawFrame writes the summary for this frame (-1 if it isn't wanted)
+	int m_overdrawSummaryY{ -1 };
+#endif
+
 	// The PlayBlitter used for drawing
 	PlayBlitter m_blitter;
 
 	// Buffer pointers
 	PixelData m_playBuffer;
 	uint8_t* m_pDebugFontBuffer{ nullptr };
+	// The pixels of each drawing buffer, with m_playBuffer pointing at the current one
+	std::vector<Pixel*> m_vDrawingBuffers;
+	int m_drawingBufferIndex{ 0 };
+	// The full size of the drawing buffers, which m_playBuffer is smaller than at a reduced render scale
+	int m_bufferWidth{ 0 };
+	int m_bufferHeight{ 0 };
+
+	// Render scale
+	float m_renderScale{ 1.0f };
+	double m_frameBudgetMs{ 0.0 };
+	double m_averageFrameMs{ 0.0 };
+	int m_renderScaleLevel{ 0 };
+	int m_framesSinceScaleChange{ 0 };
 
 	// A vector of all the loaded sprites
 	std::vector< Sprite > vSpriteData;
 	// A vector of all the loaded backgrounds
 	std::vector< PixelData > vBackgroundData;
 
-	// A pointer to the static instance
-	static PlayGraphics* s_pInstance;
+	// Sprites loaded from a directory, shared read-only by every context which loads the same one
+	struct SharedSprites
+	{
+		std::vector< Sprite > vSprites;
+		int nUsers{ 0 };
+	};
+
+	// The directory the sprites were loaded from
+	std::string m_spriteDirectory;
+	static std::map< std::string, SharedSprites > s_sharedSprites;
+	static std::mutex s_sharedSpritesMutex;
 
 };
 
@@ -849,6 +1565,9 @@ public:
 	void StartAudio( const char* name, bool bLoop );
 	//  Stop the currently playing sound using part of all of its name
 	void StopAudio( const char* name ); 
+	// Gets the number of sounds which are still playing, counting looping sounds until they're stopped
+	// > Sounds aren't played on the headless platform, so only looping sounds are counted there
+	int GetVoiceCount() const;
 
 private:
 	// Constructor and destructor
@@ -865,8 +1584,10 @@ private:
 
 	// Vector of mp3 strings
 	std::vector< std::string > vSoundStrings;
-	// Pointer to the singleton
-	static PlayAudio* s_pInstance;
+	// The length of each sound in milliseconds, in the same order as the strings
+	std::vector< long long > vSoundLengths;
+	// When each sound will finish playing, in the same order as the strings (time_point::max() while looping)
+	std::vector< std::chrono::steady_clock::time_point > vSoundEnds;
 };
 
 #endif
@@ -876,8 +1597,8 @@ private:
 //********************************************************************************************************************************
 // File:		PlayInput.h
 // Description:	Manages keyboard and mouse input 
-// Platform:	Windows
-// Notes:		Obtains mouse data from PlayWindow via MouseData structure
+// Platform:	Windows / Headless
+// Notes:		Obtains mouse data from PlayWindow via MouseData structure. Input can also be scripted.
 //********************************************************************************************************************************
 
 // Manages keyboard and mouse input 
@@ -916,6 +1637,37 @@ public:
 
 	MouseData* GetMouseData( void ) { return &m_mouseData; }
 
+	// Scripted input functions
+	//********************************************************************************************************************************
+
+	// Holds a key down or releases it, as though it was pressed on the keyboard (on Windows the real keyboard still works too)
+	void SetKeyDown( int vKey, bool bDown );
+	// Loads a script of input events to play back, one per line: "<frame> <key> <down|up>" or "<frame> MOUSE <x> <y>"
+	// > Keys are named as virtual keys without the VK_ (LEFT, SPACE, F1, A, LBUTTON...) or given as virtual key codes
+	// > Lines which can't be understood, such as ones with unknown keys, are reported and skipped
+	void LoadInputScript( const char* filename );
+	// Sets a function to be called at the start of every frame, after the input script, which can hold keys down with SetKeyDown()
+	// > For a bot which plays the game, for example. Pass nullptr to remove it
+	void SetInputDriver( std::function<void( int frame )> driver ) { m_inputDriver = std::move( driver ); }
+	// Applies the scripted input events for a frame, then calls the input driver
+	void RunInputScript( int frame );
+
+	// Recording and replay functions
+	//********************************************************************************************************************************
+
+	// Records the state of every key, the mouse and the elapsed time each frame to a binary file, along with the random seed
+	// > Only the changes are written, so a frame where nothing changes takes a single byte
+	void StartRecording( const char* filename, unsigned int seed );
+	// Loads a recording made by StartRecording() to replay in place of the real input, returning the random seed it was made with
+	unsigned int StartReplay( const char* filename );
+	// Records this frame's input and elapsed time, or replaces them with the recorded ones when replaying
+	// > Call once a frame after RunInputScript(), returns the elapsed time to give the game
+	double UpdateRecording( double elapsedTime );
+	// Returns true if the input is coming from a recording, even once it has run out
+	bool IsReplaying() const { return m_bReplaying; }
+	// Returns true once every frame of the recording has been replayed
+	bool IsReplayFinished() const { return m_bReplaying && m_replayPos >= m_vReplay.size(); }
+
 private:
 
 	// Constructor / destructor
@@ -930,2560 +1682,8030 @@ private:
 	// The copy constructor is removed to prevent copying of a singleton class
 	PlayInput( const PlayInput& ) = delete;
 
+	// An input event from a script
+	struct ScriptedInput
+	{
+		int frame{ 0 };
+		int vKey{ -1 }; // -1 for mouse movement
+		bool bDown{ false };
+		Point2f mousePos{ 0, 0 };
+	};
+
+	// Converts a key name from an input script into a virtual key code, returning -1 if it isn't recognised
+	static int KeyFromName( const std::string& name );
 
 	MouseData m_mouseData;
-	// Pointer to the singleton
-	static PlayInput* s_pInstance;
+	// Keys held down by SetKeyDown()
+	bool m_keyDown[256]{};
+	// Keys KeyPressed() has already reported, so each press is only reported once
+	std::map< int, bool > m_keyPressed;
+	// The input script, in frame order
+	std::vector<ScriptedInput> m_vScript;
+	size_t m_nextScripted{ 0 };
+	std::function<void( int frame )> m_inputDriver;
+
+	// The flags at the start of each recorded frame, saying what changed since the frame before
+	enum RecordedChange : uint8_t
+	{
+		RECORDED_KEYS = 1, // Followed by a bit for each of the 256 keys
+		RECORDED_MOUSE = 2, // Followed by the mouse position as two floats
+		RECORDED_TIME = 4, // Followed by the elapsed time as a double
+	};
+
+	std::ofstream m_recording;
+	std::vector<uint8_t> m_vReplay;
+	size_t m_replayPos{ 0 };
+	// Read by the render thread, which holds the dynamic resolution at full scale while replaying
+	std::atomic<bool> m_bReplaying{ false };
+	// The last frame recorded or replayed, so only the changes need to be stored
+	uint8_t m_recordedKeys[32]{};
+	Point2f m_recordedMousePos{ 0, 0 };
+	double m_recordedTime{ 0.0 };
 
 };
 
 
 #endif
 
-
-#ifndef PLAY_PLAYMANAGER_H
-#define PLAY_PLAYMANAGER_H
+#ifndef PLAY_PLAYJOBS_H
+#define PLAY_PLAYJOBS_H
 //********************************************************************************************************************************
-// File:		PlayManager.h
-// Description:	A manager for providing simplified access to the PlayBuffer framework with managed GameObjects
+// File:		PlayJobs.h
+// Description:	A work-stealing job system shared by everything in PlayBuffer which runs on more than one thread
 // Platform:	Independent
-// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+// Notes:		Each thread has its own queue of jobs and steals from the others when it runs out
 //********************************************************************************************************************************
 
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+// Cache lines are 64 bytes on all the CPUs PlayBuffer targets
+#define PLAY_CACHE_LINE_SIZE 64
 
-#ifndef PLAY_ADD_GAMEOBJECT_MEMBERS
-#define PLAY_ADD_GAMEOBJECT_MEMBERS 
+// Define this before including Play.h to choose how many threads run jobs (including the main thread)
+// > 0 means one for each hardware thread
+#ifndef PLAY_THREAD_COUNT
+#define PLAY_THREAD_COUNT 0
 #endif
 
-// PlayManager manges a map of GameObject structures
-// > Additional member variables can be added with PLAY_ADD_GAMEOBJECT_MEMBERS 
-struct GameObject
-{
-	GameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+namespace Play { class Context; }
 
-	// Default member variables: don't change these!
-	int type{ -1 };
-	int spriteId{ -1 };
-	Point2D pos{ 0.0f, 0.0f };
-	Point2D oldPos{ 0.0f, 0.0f };
-	Vector2D velocity{ 0.0f, 0.0f };
-	Vector2D acceleration{ 0.0f, 0.0f };
-	float rotation{ 0.0f };
-	float rotSpeed{ 0.0f };
-	float oldRot{ 0.0f };
-	int frame{ 0 };
-	float framePos{ 0.0f };
-	float animSpeed{ 0.0f };
-	int radius{ 0 };
-	float scale{ 1 };
-	PLAY_ADD_GAMEOBJECT_MEMBERS
+// Counts the jobs in a group which haven't finished yet
+// > Pass one to PlayJobs::Run to add a job to the group, then to PlayJobs::Wait or PlayJobs::RunAfter to depend on the whole group
+class JobCounter
+{
+public:
+	JobCounter() = default;
 
-	int GetId() { return m_id; }
+	// Returns true once every job added to the counter has finished
+	bool IsDone() const { return m_count == 0; }
 
 private:
-	// The GameObject's id should never be changed manually so we make it private!
-	int m_id{ -1 };
+	friend class PlayJobs;
 
-	// Preventing assignment and copying reduces the potential for bugs
-	GameObject& operator=( const GameObject& ) = delete;
-	GameObject( const GameObject& ) = delete;
-};
+	// A job waiting for the counter to reach zero
+	struct Continuation
+	{
+		std::function<void()> fn;
+		JobCounter* pCounter;
+		Play::Context* pContext;
+	};
 
-#endif
+	std::atomic<int> m_count{ 0 };
+	// Protects the jobs waiting for the counter to reach zero
+	std::mutex m_mutex;
+	std::vector<Continuation> m_vContinuations;
 
-namespace Play
+	// Counters are shared by reference, so they can't be copied
+	JobCounter& operator=( const JobCounter& ) = delete;
+	JobCounter( const JobCounter& ) = delete;
+};
+
+// A work-stealing job system shared by everything in PlayBuffer which runs on more than one thread
+// > Created by Play::CreateManager with a worker thread for each of the other hardware threads
+// > The main thread runs jobs too whenever it waits for them
+// > Every Play::Context shares the same workers, and each job runs in the context it was queued from
+// > Singleton class accessed using PlayJobs::Instance()
+class PlayJobs
 {
-	// Alignment for font drawing operations
-	enum Align
-	{
-		LEFT = 0,
-		RIGHT,
-		CENTRE,
-	};
+public:
+	// Instance functions
+	//********************************************************************************************************************************
 
-	enum Direction
+	// Creates / Returns the PlayJobs instance
+	static PlayJobs& Instance();
+	// Destroys the PlayJobs instance, waiting for the worker threads to finish their current jobs
+	static void Destroy();
+
+	// Job functions
+	//********************************************************************************************************************************
+
+	// Queues fn to run on any thread
+	// > If pCounter is given it is incremented now and decremented when fn has finished
+	void Run( std::function<void()> fn, JobCounter* pCounter = nullptr );
+	// Queues fn to run once every job in the dependency group has finished
+	void RunAfter( JobCounter& dependency, std::function<void()> fn, JobCounter* pCounter = nullptr );
+	// Returns once every job in the counter's group has finished, running queued jobs on this thread in the meantime
+	// > When there's nothing left to run it yields while the last jobs finish on other threads, then sleeps between checks
+	void Wait( JobCounter& counter );
+	// Calls fn( chunk ) once for each chunk from 0 to nChunks-1 and returns when all of them have finished
+	// > The chunks can run in any order on any thread, so they must not write to anything another chunk uses
+	void ParallelFor( int nChunks, const std::function<void( int )>& fn );
+	// Gets the number of threads which run jobs (including the main thread)
+	int GetThreadCount() const { return static_cast<int>( m_vQueues.size() ); }
+	// Gets the index of the calling thread: 0 for the main thread, 1 upwards for the workers and -1 for threads PlayJobs didn't create
+	static int GetCallingThreadIndex() { return s_threadIndex; }
+
+private:
+	// Constructor / destructor
+	//********************************************************************************************************************************
+
+	// Private constructor
+	PlayJobs();
+	// Private destructor
+	~PlayJobs();
+	// The assignment operator is removed to prevent copying of a singleton class
+	PlayJobs& operator=( const PlayJobs& ) = delete;
+	// The copy constructor is removed to prevent copying of a singleton class
+	PlayJobs( const PlayJobs& ) = delete;
+
+	struct Job
 	{
-		HORIZONTAL = 0,
-		VERTICAL,
-		ALL,
+		std::function<void()> fn;
+		JobCounter* pCounter{ nullptr };
+		Play::Context* pContext{ nullptr };
 	};
 
-	// PlayManager uses colour values from 0-100 for red, green, blue and alpha
-	struct Colour
+	// Each thread pushes and pops jobs at the back of its own queue, while other threads steal from the front
+	struct JobQueue
 	{
-		Colour( float r, float g, float b ) : red( r ), green( g ), blue( b ) {}
-		Colour( int r, int g, int b ) : red( static_cast<float>( r ) ), green( static_cast<float>( g ) ), blue( static_cast<float>( b ) ) {}
-		float red, green, blue;
+		std::mutex mutex;
+		std::deque<Job> jobs;
 	};
 
-	extern Colour cBlack, cRed, cGreen, cBlue, cMagenta, cCyan, cYellow, cOrange, cWhite, cGrey;
-
-	// Manager creation and deletion
-	//**************************************************************************************************
+	// How many times Wait yields with nothing to run before it starts sleeping instead
+	static constexpr int WAIT_YIELDS = 64;
+	// How long Wait sleeps between checks once it has stopped yielding
+	static constexpr int WAIT_SLEEP_US = 50;
+
+	// The function each worker thread runs until PlayJobs is destroyed
+	void WorkerLoop( int threadIndex );
+	// Adds a job to the queue for the calling thread and wakes up a worker to take it
+	void Push( Job&& job );
+	// Runs one job from this thread's queue, or steals one from another thread if it is empty
+	// > Returns false if there weren't any jobs to run
+	bool RunOneJob( int threadIndex );
+	// Decrements a counter and queues the jobs which were waiting for it if it reaches zero
+	void FinishJob( JobCounter* pCounter );
+	// Gets the queue index for the calling thread (threads which PlayJobs didn't create share the main thread's queue)
+	int GetThreadIndex() const { return s_threadIndex < 0 ? 0 : s_threadIndex; }
+
+	std::vector<JobQueue> m_vQueues;
+	std::vector<std::thread> m_vWorkers;
+	// Number of jobs in all the queues, so sleeping workers know when to wake up
+	std::atomic<int> m_nQueuedJobs{ 0 };
+	// Protects the sleep condition
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCondition;
+	bool m_bQuit{ false };
+
+	// The index of the queue belonging to the current thread (-1 for threads PlayJobs didn't create)
+	static thread_local int s_threadIndex;
+	// Pointer to the singleton, which every context shares
+	static std::atomic<PlayJobs*> s_pInstance;
+	// Stops two contexts creating the singleton at the same time
+	static std::mutex s_instanceMutex;
+};
 
-	// Initialises the managers and creates a window of the required dimensions
-	void CreateManager( int width, int height, int scale );
-	// Shuts down the managers and closes the window
-	void DestroyManager();
+#endif
 
-	// PlayWindow functions
-	//**************************************************************************************************
+#ifndef PLAY_PLAYTRIPLEBUFFER_H
+#define PLAY_PLAYTRIPLEBUFFER_H
+//********************************************************************************************************************************
+// File:		PlayTripleBuffer.h
+// Description:	Hands the latest version of some data from one thread to another without either of them waiting
+// Platform:	Independent
+// Notes:		One writer thread and one reader thread only. The reader skips any versions it was too slow to pick up.
+//********************************************************************************************************************************
 
-	// Copies the contents of the drawing buffer to the window
-	void PresentDrawingBuffer();
-	// Gets the co-ordinates of the mouse cursor within the display buffer
-	Point2D GetMousePos();
-	// Gets the status of the left or right mouse buttons
-	bool GetMouseButton( Align button );
-	// Gets the width of the display buffer
-	int GetBufferWidth();
-	// Gets the height of the display buffer
-	int GetBufferHeight();
+// Three copies of T: one being written, one being read, and one in the middle holding the latest published version
+template< typename T >
+class PlayTripleBuffer
+{
+public:
+	// Gets the buffer for the writer to fill in before calling Publish()
+	// > Holds whatever was in it last time round, so clear it first if necessary
+	T& GetWriteBuffer() { return m_buffers[m_writeIndex]; }
+	// Hands the write buffer to the reader, replacing any published version it hasn't picked up yet
+	void Publish() { m_writeIndex = m_middle.exchange( m_writeIndex | FRESH, std::memory_order_acq_rel ) & INDEX_MASK; }
+
+	// Returns true if a version has been published since the reader last picked one up
+	bool HasNew() const { return ( m_middle.load( std::memory_order_acquire ) & FRESH ) != 0; }
+	// Picks up the latest published version for the reader, returning false if there isn't a new one
+	bool Acquire()
+	{
+		if( !HasNew() )
+			return false;
 
-	// PlayAudio functions
-	//**************************************************************************************************
+		m_readIndex = m_middle.exchange( m_readIndex, std::memory_order_acq_rel ) & INDEX_MASK;
+		return true;
+	}
+	// Gets the version picked up by the last Acquire()
+	T& GetReadBuffer() { return m_buffers[m_readIndex]; }
 
-	// Plays an mp3 audio file from the "Data\Sounds" directory
-	void PlayAudio( const char* mp3Filename );
-	// Loops an mp3 audio file from the "Data\Sounds" directory
-	void StartAudioLoop( const char* mp3Filename );
-	// Stops a looping mp3 audio file started with Play::StartSoundLoop()
-	void StopAudioLoop( const char* mp3Filename );
+private:
+	// The middle index is stored with a flag saying whether it's been published since the reader last took it
+	static constexpr int INDEX_MASK = 3;
+	static constexpr int FRESH = 4;
+
+	T m_buffers[3];
+	int m_writeIndex{ 0 };
+	// Kept apart from the other two so the reader and writer don't share a cache line with it
+	alignas( PLAY_CACHE_LINE_SIZE ) std::atomic<int> m_middle{ 1 };
+	alignas( PLAY_CACHE_LINE_SIZE ) int m_readIndex{ 2 };
+};
 
-	// PlayGraphics functions
-	//**************************************************************************************************
+#endif
 
-	// Clears the display buffer using the colour provided
-	void ClearDrawingBuffer( Colour col );
-	// Loads a PNG file as the background image for the window
-	int LoadBackground( const char* pngFilename );
-	// Draws the background image previously loaded with Play::LoadBackground() into the drawing buffer
-	void DrawBackground( int background = 0 );
-	// Draws text to the screen using the built-in debug font
-	void DrawDebugText( Point2D pos, const char* text, Colour col = cWhite, bool centred = true );
 
-	// Gets the sprite id of the first matching sprite whose filename contains the given text
-	int GetSpriteId( const char* spriteName );
-	// Gets the pixel height of a sprite
-	int GetSpriteHeight( const char* spriteName );
-	// Gets the pixel width of a sprite
-	int GetSpriteWidth( const char* spriteName );
-	// Gets the pixel height of a sprite
-	int GetSpriteHeight( int spriteId );
-	// Gets the pixel width of a sprite
-	int GetSpriteWidth( int spriteId );
-	// Gets the stem filename for the sprite (without path or extension)
-	const char* GetSpriteName( int spriteId );
-	// Gets the total number of frames in the sprite
-	int GetSpriteFrames( int spriteId );
-	// Blends the sprite with the given colour (works best on white sprites)
-	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
-	void ColourSprite( const char* spriteName, Colour col );
+#ifndef PLAY_PLAYRANDOM_H
+#define PLAY_PLAYRANDOM_H
+//********************************************************************************************************************************
+// File:		PlayRandom.h
+// Description:	A small, fast random number generator which gives the same numbers every run from the same seed
+// Platform:	Independent
+// Notes:		Uses xoshiro128** (Blackman and Vigna). Jump() splits one seed into separate streams for different threads.
+//********************************************************************************************************************************
 
-	// Centres the origin of the first sprite found matching the given name
-	void CentreSpriteOrigin( const char* spriteName );
-	// Centres the origin of all sprites found matching the given name
-	void CentreMatchingSpriteOrigins( const char* partName );
-	// Centres the origins of all loaded sprites
-	void CentreAllSpriteOrigins();
-	// Moves the origin of the first sprite found matching the given name
-	void MoveSpriteOrigin( const char* spriteName, int xOffset, int yOffset );
-	// Moves the origin of all sprites found matching the given name
-	void MoveMatchingSpriteOrigins( const char* partName, int xoffset, int yoffset );
-	// Moves the origin of all loaded sprites
-	void MoveAllSpriteOrigins( int xoffset, int yoffset );
-	// Sets the origin of the first sprite found matching the given name
-	void SetSpriteOrigin( const char* spriteName, int xOrigin, int yOrigin );
-	// Sets the origin of the sprite with a specific ID
-	void SetSpriteOrigin( int spriteId, int xOrigin, int yOrigin );
-	// Gets the origin of the first sprite found matching the given name
-	Point2D GetSpriteOrigin( const char* spriteName );
-	// Gets the origin of the sprite with a specific ID
-	Point2D GetSpriteOrigin( int spriteId );
+// One stream of random numbers. It isn't thread safe, so each thread needs its own (RandomRoll looks after this)
+class PlayRandom
+{
+public:
+	explicit PlayRandom( uint64_t seed = 0 ) { Seed( seed ); }
 
-	// Draws the first matching sprite whose filename contains the given text
-	void DrawSprite( const char* spriteName, Point2D pos, int frameIndex );
-	// Draws the sprite using its unique sprite ID
-	void DrawSprite( int spriteID, Point2D pos, int frame );
-	// Draws the sprite with transparency (slower than DrawSprite)
-	void DrawSpriteTransparent( const char* spriteName, Point2D pos, int frame, float opacity );
-	// Draws the sprite with transparency (slower than DrawSprite)
-	void DrawSpriteTransparent( int spriteID, Point2D pos, int frame, float opacity );
-	// Draws the sprite with rotation and transparency (slowest DrawSprite)
-	void DrawSpriteRotated( const char* spriteName, Point2D pos, int frame, float angle, float scale = 1.0f, float opacity = 1.0f );
-	// Draws the sprite with rotation and transparency (slowest DrawSprite)
-	void DrawSpriteRotated( int spriteID, Point2D pos, int frame, float angle, float scale, float opacity = 1.0f );
-	// Draws a single-pixel wide line between two points in the given colour
-	void DrawLine( Point2D start, Point2D end, Colour col );
-	// Draws a single-pixel wide circle in the given colour
-	void DrawCircle( Point2D pos, int radius, Colour col );
-	// Draws a rectangle in the given colour
-	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour col, bool fill = false );
-	// Draws a line between two points using a sprite
-	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
-	void DrawSpriteLine( Point2D startPos, Point2D endPos, const char* penSprite, Colour c = cWhite );
-	// Draws a circle using a sprite
-	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
-	void DrawSpriteCircle( int x, int y, int radius, const char* penSprite, Colour c = cWhite );
-	// Draws text using a sprite-based font exported from PlayFontTool
-	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify = LEFT );
-	// Adds a sprite dynamically from memory (custom asset pipelines)
+	// Restarts the stream from a seed. Similar seeds still give completely different streams
+	void Seed( uint64_t seed )
+	{
+		// SplitMix64 spreads the seed's bits over the whole state
+		for( int i = 0; i < 4; i += 2 )
+		{
+			uint64_t z = ( seed += 0x9E3779B97F4A7C15ull );
+			z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+			z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+			z ^= z >> 31;
+			m_state[i] = static_cast<uint32_t>( z );
+			m_state[i + 1] = static_cast<uint32_t>( z >> 32 );
+		}
+		// An all zero state would only ever give zeros
+		if( ( m_state[0] | m_state[1] | m_state[2] | m_state[3] ) == 0 )
+			m_state[0] = 1;
+	}
 
-	// Resets the timing bar data and sets the current timing bar segment to a specific colour
-	void BeginTimingBar( Pixel pix );
-	// Sets the current timing bar segment to a specific colour
-	// > Returns the number of timing segments
-	int ColourTimingBar( Pixel pix );
-	// Draws the timing bar for the previous frame at the given position and size
-	void DrawTimingBar( Point2f pos, Point2f size );
+	// Returns 32 random bits
+	uint32_t Next()
+	{
+		uint32_t result = Rotate( m_state[1] * 5, 7 ) * 9;
+		uint32_t t = m_state[1] << 9;
+		m_state[2] ^= m_state[0];
+		m_state[3] ^= m_state[1];
+		m_state[1] ^= m_state[2];
+		m_state[0] ^= m_state[3];
+		m_state[2] ^= t;
+		m_state[3] = Rotate( m_state[3], 11 );
+		return result;
+	}
 
-	// GameObject functions
-	//**************************************************************************************************
+	// Returns a number from 0 to bound-1 with every value equally likely (unlike Next() % bound)
+	// > Lemire's method: only draws again for the few values which would favour the low numbers
+	uint32_t Bounded( uint32_t bound )
+	{
+		uint64_t m = static_cast<uint64_t>( Next() ) * bound;
+		if( static_cast<uint32_t>( m ) < bound )
+		{
+			uint32_t threshold = ( 0u - bound ) % bound;
+			while( static_cast<uint32_t>( m ) < threshold )
+				m = static_cast<uint64_t>( Next() ) * bound;
+		}
+		return static_cast<uint32_t>( m >> 32 );
+	}
 
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+	// Returns a number from min to max inclusive with every value equally likely
+	int Range( int min, int max )
+	{
+		PLAY_ASSERT_MSG( min <= max, "PlayRandom::Range needs min <= max" );
+		// Worked out unsigned so that ranges as wide as INT_MIN to INT_MAX don't overflow
+		uint32_t span = static_cast<uint32_t>( max ) - static_cast<uint32_t>( min ) + 1u;
+		uint32_t offset = span == 0 ? Next() : Bounded( span );
+		return static_cast<int>( static_cast<uint32_t>( min ) + offset );
+	}
 
-	// Creates a new GameObject and adds it to the managed list.
-	// > Returns the new object's unique id
-	int CreateGameObject( int type, Point2D pos, int collisionRadius, const char* spriteName );
-	// Retrieves a GameObject based on its id
-	// > Returns an object with a type of -1 if no object can be found
-	GameObject& GetGameObject( int id );
-	// Retrieves the first GameObject matching the given type
-	// > Returns an object with a type of -1 if no object can be found
-	GameObject& GetGameObjectByType( int type );
-	// Collects the IDs of all of the GameObjects with the matching type
-	std::vector<int> CollectGameObjectIDsByType( int type );
-	// Collects the IDs of all of the GameObjects
-	std::vector<int> CollectAllGameObjectIDs();
-	// Performs a typical update of the object's position and animation
-	void UpdateGameObject( GameObject& object, bool bWrap = false, int wrapBorderSize = 0 );
-	// Deletes the GameObject with the corresponding id
-	//> Use GameObject.GetId() to find out its unique id
-	void DestroyGameObject( int id );
-	// Deletes all GameObjects with the corresponding type
-	void DestroyGameObjectsByType( int type );
-	
-	// Checks whether the two objects are within each other's collision radii
-	bool IsColliding( GameObject& obj1, GameObject& obj2 );
-	// Checks whether any part of the object is visible within the DisplayBuffer
-	bool IsVisible( GameObject& obj );
-	// Checks whether the object is overlapping the edge of the screen and moving outwards 
-	bool IsLeavingDisplayArea( GameObject& obj, Direction dirn = ALL );
-	// Checks whether the animation has completed playing
-	bool IsAnimationComplete( GameObject& obj );
+	// Returns a float from 0 up to (but not including) 1
+	float NextFloat() { return static_cast<float>( Next() >> 8 ) * ( 1.0f / 16777216.0f ); }
 
-	// Sets the velocity of the object based on a target rotation angle
-	void SetGameObjectDirection( GameObject& obj, int speed, float rotation );
-	// Set the velocity and rotation of the object based on a target point
-	void PointGameObject( GameObject& obj, int speed, int targetX, int targetY );
+	// Fills an array with numbers from min to max inclusive, giving the same numbers as calling Range() count times
+	void Fill( int* pDest, int count, int min, int max )
+	{
+		PLAY_ASSERT_MSG( min <= max, "PlayRandom::Fill needs min <= max" );
+		uint32_t span = static_cast<uint32_t>( max ) - static_cast<uint32_t>( min ) + 1u;
+		if( span == 0 )
+		{
+			for( int i = 0; i < count; i++ )
+				pDest[i] = static_cast<int>( Next() );
+			return;
+		}
+		// The threshold only needs working out once for the whole array
+		uint32_t threshold = ( 0u - span ) % span;
+		for( int i = 0; i < count; i++ )
+		{
+			uint64_t m = static_cast<uint64_t>( Next() ) * span;
+			while( static_cast<uint32_t>( m ) < threshold )
+				m = static_cast<uint64_t>( Next() ) * span;
+			pDest[i] = static_cast<int>( static_cast<uint32_t>( min ) + static_cast<uint32_t>( m >> 32 ) );
+		}
+	}
 
-	// Changes the object's current spite and resets its animation frame to the start
-	void SetSprite( GameObject& obj, const char* spriteName, float animSpeed );
-	// Draws the object's sprite without rotation or transparency (fastest)
-	void DrawObject( GameObject& obj );
-	// Draws the object's sprite with transparency (slower than DrawObject)
-	void DrawObjectTransparent( GameObject& obj, float opacity );
-	// Draws the object's sprite with rotation and transparency (slower than DrawObject)
-	void DrawObjectRotated( GameObject& obj, float opacity = 1.0f );
+	// Combines two numbers into a seed, so every pair gives a different stream
+	static uint64_t Mix( uint64_t a, uint64_t b )
+	{
+		uint64_t z = a * 0x9E3779B97F4A7C15ull + b + 0xD1B54A32D192ED03ull;
+		z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+		z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+		return z ^ ( z >> 31 );
+	}
+
+	// Fills an array with floats from 0 up to (but not including) 1
+	void Fill( float* pDest, int count )
+	{
+		for( int i = 0; i < count; i++ )
+			pDest[i] = NextFloat();
+	}
+
+	// Skips 2^64 numbers ahead, so streams seeded the same and jumped a different number of times never overlap
+	void Jump()
+	{
+		static constexpr uint32_t JUMP[4] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+		uint32_t jumped[4] = { 0, 0, 0, 0 };
+		for( uint32_t word : JUMP )
+		{
+			for( int bit = 0; bit < 32; bit++ )
+			{
+				if( word & ( 1u << bit ) )
+				{
+					for( int i = 0; i < 4; i++ )
+						jumped[i] ^= m_state[i];
+				}
+				Next();
+			}
+		}
+		for( int i = 0; i < 4; i++ )
+			m_state[i] = jumped[i];
+	}
+
+private:
+	static uint32_t Rotate( uint32_t x, int k ) { return ( x << k ) | ( x >> ( 32 - k ) ); }
+
+	uint32_t m_state[4];
+};
+
+// Gives one chunk of work split between threads its own stream of random numbers, which RandomRoll uses while it runs
+// > The stream is made from a key for the work rather than the thread, so the numbers are the same every run however
+// > the chunks are shared out. Work split up inside a chunk gets its keys from the chunk, so nesting is repeatable too
+class PlayRandomScope
+{
+public:
+	explicit PlayRandomScope( uint64_t key ) : m_random( key ), m_key( key ), m_pPrevious( s_pCurrent ) { s_pCurrent = this; }
+	~PlayRandomScope() { s_pCurrent = m_pPrevious; }
+	PlayRandomScope& operator=( const PlayRandomScope& ) = delete;
+	PlayRandomScope( const PlayRandomScope& ) = delete;
+
+	// Gets the innermost scope on the calling thread, or nullptr if it isn't running a chunk
+	static PlayRandomScope* Current() { return s_pCurrent; }
+	// Gets the scope's stream
+	PlayRandom& Random() { return m_random; }
+	// Gets a key for the next piece of work split up inside this chunk
+	uint64_t NextKey() { return PlayRandom::Mix( m_key, ++m_nKeys ); }
+	// Gets the key the scope was made from
+	uint64_t GetKey() const { return m_key; }
+	// Counts the changes the chunk has made which have to wait, so they can be applied in the same order every run
+	uint64_t NextChange() { return m_nChanges++; }
+
+private:
+	PlayRandom m_random;
+	uint64_t m_key;
+	uint64_t m_nKeys{ 0 };
+	uint64_t m_nChanges{ 0 };
+	PlayRandomScope* m_pPrevious;
+	static thread_local PlayRandomScope* s_pCurrent;
+};
 
 #endif
 
-	// Miscellaneous functions
-	//**************************************************************************************************
 
-	// Returns true if the key has been pressed since it was last released
-	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
-	bool KeyPressed( int vKey );
-	// Returns true if the key is currently being held down
-	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
-	bool KeyDown( int vKey );
+#ifndef PLAY_PLAYPROFILER_H
+#define PLAY_PLAYPROFILER_H
+//********************************************************************************************************************************
+// File:		PlayProfiler.h
+// Description:	Times named, nested scopes on every thread for the F1 overlay and for exporting to a Chrome trace
+// Platform:	Independent
+// Notes:		Each thread records into its own ring buffer without locking. Define PLAY_PROFILING as 0 to compile the scopes out.
+//********************************************************************************************************************************
 
-	// Returns a random number as if you rolled a die with this many sides
-	int RandomRoll( int sides );
-	// Returns a random number from min to max inclusive
-	int RandomRollRange( int min, int max );
+#ifndef PLAY_PROFILING
+#define PLAY_PROFILING 1
+#endif
 
-	// Converts radians to degrees
-	constexpr float RadToDeg( float radians )
+// A completed scope
+struct ProfileEvent
+{
+	const char* name{ nullptr };
+	// Nanoseconds from PlayProfiler::Now()
+	long long begin{ 0 };
+	long long end{ 0 };
+	// The number of scopes it was nested inside
+	int depth{ 0 };
+};
+
+// One line of a frame's breakdown, with every call to the same scope from the same parent added together
+struct ProfileLine
+{
+	const char* name;
+	int depth;
+	double ms;
+	int calls;
+};
+
+// The breakdown of a frame on the thread which ran it, plus how long the other threads were busy during it
+struct ProfileFrame
+{
+	double ms{ 0.0 };
+	std::vector<ProfileLine> vLines;
+	std::vector<std::pair<std::string, double>> vOtherThreadMs;
+};
+
+// The profiler is shared by every context in the process, as the job system's workers are
+class PlayProfiler
+{
+public:
+	// The scope the main loop puts around each frame
+	static constexpr const char* FRAME_SCOPE = "Frame";
+	// The number of scopes each thread remembers before it overwrites the oldest (a power of two)
+	static constexpr int BUFFER_SIZE = 1 << 14;
+
+	// One thread's ring buffer
+	// > Each slot has a sequence number, so readers on other threads can tell if it was overwritten while they copied it
+	struct ThreadBuffer
 	{
-		return ( radians / PLAY_PI ) * 180.0f;
+		struct Slot
+		{
+			std::atomic<long long> sequence{ 0 };
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<long long> begin{ 0 };
+			std::atomic<long long> end{ 0 };
+			std::atomic<int> depth{ 0 };
+		};
+
+		// Only ever written by the thread which owns the buffer
+		void Record( const char* name, long long begin, long long end )
+		{
+			long long index = writeCount.load( std::memory_order_relaxed );
+			Slot& slot = pSlots[index & ( BUFFER_SIZE - 1 )];
+			slot.sequence.store( index * 2 + 1, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_release );
+			slot.name.store( name, std::memory_order_relaxed );
+			slot.begin.store( begin, std::memory_order_relaxed );
+			slot.end.store( end, std::memory_order_relaxed );
+			slot.depth.store( depth, std::memory_order_relaxed );
+			slot.sequence.store( index * 2 + 2, std::memory_order_release );
+			writeCount.store( index + 1, std::memory_order_release );
+		}
+
+		std::unique_ptr<Slot[]> pSlots{ new Slot[BUFFER_SIZE] };
+		std::atomic<long long> writeCount{ 0 };
+		// How many scopes the owning thread is inside
+		int depth{ 0 };
+		// Only used with the profiler's mutex locked
+		std::string threadName;
+		bool bInUse{ true };
+	};
+
+	// Gets a timestamp in nanoseconds from the steady clock (QueryPerformanceCounter on Windows and CLOCK_MONOTONIC on Linux)
+	static long long Now() { return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count(); }
+	// Gets the calling thread's buffer, creating it on first use
+	static ThreadBuffer& GetThreadBuffer()
+	{
+		ThreadBuffer* pBuffer = s_threadBuffer.pBuffer;
+		return pBuffer ? *pBuffer : CreateThreadBuffer();
 	}
+	// Names the calling thread in the overlay and the trace (job system threads are named automatically)
+	static void SetThreadName( const char* name );
+	// Returns a copy of a name which lasts as long as the program, for scopes whose names aren't string literals
+	static const char* InternName( const std::string& name );
+
+	// Gets the breakdown of the last frame the calling thread finished, returning false if it hasn't finished one yet
+	static bool GetLastFrame( ProfileFrame& frame );
+	// Writes the last few frames the calling thread finished, on every thread, as JSON for chrome://tracing or ui.perfetto.dev
+	// > Writes everything still in the buffers if the calling thread hasn't run any frames. Returns false if the file can't be written
+	static bool ExportChromeTrace( const char* filename, int nFrames );
+	// Sets a file for ExportOnExit() to write the last few frames to (--play-profile=<file> on the command line)
+	static void SetExitExport( const char* filename, int nFrames ) { s_exitExportFile = filename; s_nExitExportFrames = nFrames; }
+	// Called by the main loop when it finishes
+	static void ExportOnExit();
 
-	// Converts radians to degrees
-	constexpr float DegToRad( float degrees )
+private:
+	// Hands the buffer back for another thread to reuse when its thread ends
+	struct ThreadBufferOwner
 	{
-		return ( degrees / 180.0f ) * PLAY_PI;
+		ThreadBuffer* pBuffer{ nullptr };
+		~ThreadBufferOwner();
+	};
+
+	static ThreadBuffer& CreateThreadBuffer();
+	// Copies the events still in a buffer which overlap the given time, skipping any overwritten while they were being copied
+	static void CopyEvents( const ThreadBuffer& buffer, long long from, long long to, std::vector<ProfileEvent>& vEvents );
+	// Finds the calling thread's most recent frames, newest first
+	static std::vector<ProfileEvent> FindFrames( int nFrames );
+
+	static thread_local ThreadBufferOwner s_threadBuffer;
+	static std::mutex s_mutex;
+	static std::vector<std::unique_ptr<ThreadBuffer>> s_vBuffers;
+	static std::set<std::string> s_internedNames;
+	static std::string s_exitExportFile;
+	static int s_nExitExportFrames;
+};
+
+// Times the rest of the block it's in, nested inside any other scope on the same thread
+class PlayProfileScope
+{
+public:
+	// The name has to last until the profile has been looked at, which string literals do
+	explicit PlayProfileScope( const char* name ) : m_buffer( PlayProfiler::GetThreadBuffer() ), m_name( name )
+	{
+		m_buffer.depth++;
+		m_begin = PlayProfiler::Now();
+	}
+	~PlayProfileScope()
+	{
+		long long end = PlayProfiler::Now();
+		m_buffer.depth--;
+		m_buffer.Record( m_name, m_begin, end );
 	}
+	PlayProfileScope( const PlayProfileScope& ) = delete;
+	PlayProfileScope& operator=( const PlayProfileScope& ) = delete;
 
-}
+private:
+	PlayProfiler::ThreadBuffer& m_buffer;
+	const char* m_name;
+	long long m_begin{ 0 };
+};
+
+#define PLAY_PROFILE_CONCAT_INNER( a, b ) a##b
+#define PLAY_PROFILE_CONCAT( a, b ) PLAY_PROFILE_CONCAT_INNER( a, b )
 
+#if PLAY_PROFILING
+// Times the rest of the enclosing block under the given name
+#define PLAY_PROFILE_SCOPE( name ) PlayProfileScope PLAY_PROFILE_CONCAT( playProfileScope, __LINE__ )( name )
+#else
+#define PLAY_PROFILE_SCOPE( name )
 #endif
 
+#endif
 
 
+#ifndef PLAY_PLAYMETRICS_H
+#define PLAY_PLAYMETRICS_H
+//********************************************************************************************************************************
+// File:		PlayMetrics.h
+// Description:	A fixed layout block of per-frame metrics in named shared memory, for watching a running game from another process
+// Platform:	Windows / Headless
+// Notes:		A named file mapping on Windows (headless or not) and POSIX shared memory (shm_open) everywhere else. Everything here is inline, so
+//				a reader like PlayMetrics/PlayMetrics.cpp can include Play.h without PLAY_IMPLEMENTATION
+//********************************************************************************************************************************
 
-#endif // PLAYPCH_H
+// One frame's metrics, as published by the game and copied out by a reader
+struct PlayMetricsFrame
+{
+	// The most GameObject types listed
+	static constexpr int MAX_TYPES = 32;
+	// Bits in flags saying which of the optional counts are being kept
+	enum Flags : uint32_t { PIXEL_COUNTS = 1, ALLOCATION_COUNTS = 2 };
+
+	uint32_t flags;
+	uint32_t processId;
+	// Frames published so far
+	uint64_t frame;
+	// The time from the start of the frame before to the start of this one
+	float frameMs;
+	// Frames over the frame time budget (by more than FRAME_HITCH_MARGIN_MS) since publishing started
+	uint32_t hitches;
+	// Live GameObjects, in total and for each of the first typeCount types
+	uint32_t objects;
+	uint32_t typeCount;
+	int32_t types[MAX_TYPES];
+	uint32_t typeObjects[MAX_TYPES];
+	// Blits in the last frame drawn, and the pixels they wrote (PIXEL_COUNTS, with PLAY_BLITTER_STATS)
+	uint64_t blits;
+	uint64_t pixelsBlended;
+	// Allocations made with new since the frame before (ALLOCATION_COUNTS, in _DEBUG builds or with PLAY_COUNT_ALLOCATIONS)
+	uint64_t allocations;
+	// Sounds playing
+	uint32_t audioVoices;
+};
 
+// The shared memory itself: a PlayMetricsFrame guarded by a sequence number
+// > There's only ever one writer. The sequence is odd while it writes, so readers retry if it was odd or changed while they copied
+// > The frame is held in atomic words so copying it is never a data race, even while it's being written
+struct PlayMetricsBlock
+{
+	static constexpr uint32_t MAGIC = 0x504C4159; // "PLAY"
+	// Changes whenever the layout of PlayMetricsFrame does
+	static constexpr uint32_t VERSION = 2;
+	static constexpr int WORDS = ( sizeof( PlayMetricsFrame ) + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t );
+
+	// Written last when the block is created, so readers can tell it's ready
+	std::atomic<uint32_t> magic;
+	std::atomic<uint32_t> version;
+	std::atomic<uint64_t> sequence;
+	std::atomic<uint64_t> words[WORDS];
+
+	// Writes a frame into the block
+	void Publish( const PlayMetricsFrame& frame )
+	{
+		uint64_t buffer[WORDS]{};
+		memcpy( buffer, &frame, sizeof( frame ) );
+
+		uint64_t seq = sequence.load( std::memory_order_relaxed );
+		sequence.store( seq + 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		for( int i = 0; i < WORDS; i++ )
+			words[i].store( buffer[i], std::memory_order_relaxed );
+		sequence.store( seq + 2, std::memory_order_release );
+	}
 
+	// Copies the latest frame out of the block
+	// > Returns false if it was being written at the time, in which case try again
+	bool Read( PlayMetricsFrame& frame ) const
+	{
+		uint64_t seq = sequence.load( std::memory_order_acquire );
+		uint64_t buffer[WORDS];
+		for( int i = 0; i < WORDS; i++ )
+			buffer[i] = words[i].load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
 
+		if( ( seq & 1 ) || sequence.load( std::memory_order_relaxed ) != seq )
+			return false;
 
+		memcpy( &frame, buffer, sizeof( frame ) );
+		return true;
+	}
+};
 
-//*******************************************************************
-//*******************************************************************
-#ifdef PLAY_IMPLEMENTATION
-//*******************************************************************
-//*******************************************************************
-//********************************************************************************************************************************
-//* File:			PlayMemory.cpp
-//* Platform:		Independent
-//* Description:	Implementation of a simple memory tracker to prevent leaks. Uses #define new which looks neat and tidy
-//*                 (especially for new C++ programmers), but doesn't work for placement new, so you are likely to get compile 
-//*                 errors if you start including it in your own header files.  
-//*                 Avoids use of STL or anything else which allocates memory as this could create infinite loops!
-//* Notes:          This is a simple approach to support your understanding of overriding the new operator.
-//*                 See below for more advanced approaches:
-//*                 1) The CRT Debug Heap Library (a more advanced version of this approach)
-//*                 https://docs.microsoft.com/en-us/visualstudio/debugger/crt-debug-heap-details?view=vs-2019
-//*                 2) Heap Profiling in the debugger 
-//*                 https://docs.microsoft.com/en-us/visualstudio/profiling/memory-usage?view=vs-2019
-//********************************************************************************************************************************
+static_assert( std::atomic<uint64_t>::is_always_lock_free, "The metrics block needs lock free atomics to be shared between processes" );
 
+// Maps a PlayMetricsBlock in named shared memory into the process
+class PlayMetricsMapping
+{
+public:
+	PlayMetricsMapping() = default;
+	~PlayMetricsMapping() { Close(); }
+	PlayMetricsMapping& operator=( const PlayMetricsMapping& ) = delete;
+	PlayMetricsMapping( const PlayMetricsMapping& ) = delete;
+
+	// Creates the named block for writing, or opens an existing one read only, returning false if it can't
+	// > A block is only opened for reading once its creator has finished setting it up
+	bool Open( const char* name, bool bCreate )
+	{
+		Close();
+		size_t size = sizeof( PlayMetricsBlock );
+#ifdef _WIN32
+		std::string mappingName = std::string( "Local\\" ) + name;
+		m_hMapping = bCreate ? CreateFileMappingA( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>( size ), mappingName.c_str() )
+							 : OpenFileMappingA( FILE_MAP_READ, FALSE, mappingName.c_str() );
+		if( !m_hMapping )
+			return false;
+		void* pMemory = MapViewOfFile( m_hMapping, bCreate ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size );
+#else
+		m_name = std::string( "/" ) + name;
+		int fd = bCreate ? shm_open( m_name.c_str(), O_RDWR | O_CREAT, 0644 ) : shm_open( m_name.c_str(), O_RDONLY, 0 );
+		if( fd < 0 )
+			return false;
+		void* pMemory = nullptr;
+		if( !bCreate || ftruncate( fd, static_cast<off_t>( size ) ) == 0 )
+			pMemory = mmap( nullptr, size, bCreate ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+		close( fd );
+		if( pMemory == MAP_FAILED )
+			pMemory = nullptr;
+#endif
+		m_pBlock = static_cast<PlayMetricsBlock*>( pMemory );
+		m_bCreated = bCreate;
 
-#ifdef _DEBUG
+		if( !m_pBlock )
+		{
+			Close();
+			return false;
+		}
+
+		if( bCreate )
+		{
+			// Starts again from nothing, in case an earlier run left the block behind
+			m_pBlock->magic.store( 0, std::memory_order_relaxed );
+			m_pBlock->version.store( PlayMetricsBlock::VERSION, std::memory_order_relaxed );
+			m_pBlock->sequence.store( 0, std::memory_order_relaxed );
+			m_pBlock->Publish( PlayMetricsFrame() );
+			m_pBlock->magic.store( PlayMetricsBlock::MAGIC, std::memory_order_release );
+		}
+		else if( m_pBlock->magic.load( std::memory_order_acquire ) != PlayMetricsBlock::MAGIC || m_pBlock->version.load( std::memory_order_relaxed ) != PlayMetricsBlock::VERSION )
+		{
+			// Not set up yet, or written by a different version of Play.h
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	// Unmaps the block, and removes its name if this process created it
+	void Close()
+	{
+#ifdef _WIN32
+		if( m_pBlock )
+			UnmapViewOfFile( m_pBlock );
+		if( m_hMapping )
+			CloseHandle( m_hMapping );
+		m_hMapping = nullptr;
+#else
+		if( m_pBlock )
+			munmap( m_pBlock, sizeof( PlayMetricsBlock ) );
+		if( m_bCreated && !m_name.empty() )
+			shm_unlink( m_name.c_str() );
+		m_name.clear();
+#endif
+		m_pBlock = nullptr;
+		m_bCreated = false;
+	}
+
+	// Gets the mapped block, or nullptr if it isn't open
+	PlayMetricsBlock* Get() const { return m_pBlock; }
+
+private:
+	PlayMetricsBlock* m_pBlock{ nullptr };
+	bool m_bCreated{ false };
+#ifdef _WIN32
+	HANDLE m_hMapping{ nullptr };
+#else
+	std::string m_name;
+#endif
+};
+
+#endif
+#ifndef PLAY_PLAYMANAGER_H
+#define PLAY_PLAYMANAGER_H
+//********************************************************************************************************************************
+// File:		PlayManager.h
+// Description:	A manager for providing simplified access to the PlayBuffer framework with managed GameObjects
+// Platform:	Independent
+// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+//********************************************************************************************************************************
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+#ifndef PLAY_ADD_GAMEOBJECT_MEMBERS
+#define PLAY_ADD_GAMEOBJECT_MEMBERS 
+#endif
+
+struct GameObject;
+
+// The type of a GameObject behaves just like an int, but changing it keeps the PlayManager's per-type lists up to date
+class GameObjectTypeField
+{
+public:
+	GameObjectTypeField( int type, GameObject* pOwner ) : m_type( type ), m_pOwner( pOwner ) {}
+	operator int() const { return m_type; }
+	GameObjectTypeField& operator=( int newType );
+	GameObjectTypeField& operator=( const GameObjectTypeField& other ) { return *this = static_cast<int>( other ); }
+
+private:
+	// Copy construction would detach the type from the object which owns it
+	GameObjectTypeField( const GameObjectTypeField& ) = delete;
+
+	int m_type{ -1 };
+	GameObject* m_pOwner{ nullptr };
+};
+
+// A lightweight view of the ids of all the GameObjects of a particular type (no copying or allocation)
+// > Becomes invalid as soon as an object of that type is created, destroyed or has its type changed
+struct GameObjectIdSpan
+{
+	// Steps through the objects in the type's list, giving the id of each one
+	struct Iterator
+	{
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = int;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const int*;
+		using reference = int;
+
+		GameObject* const* p;
+
+		int operator*() const;
+		Iterator& operator++() { ++p; return *this; }
+		Iterator operator++( int ) { Iterator i = *this; ++p; return i; }
+		bool operator==( const Iterator& rhs ) const { return p == rhs.p; }
+		bool operator!=( const Iterator& rhs ) const { return p != rhs.p; }
+	};
+
+	GameObject* const* pBegin{ nullptr };
+	GameObject* const* pEnd{ nullptr };
+
+	Iterator begin() const { return { pBegin }; }
+	Iterator end() const { return { pEnd }; }
+	size_t size() const { return static_cast<size_t>( pEnd - pBegin ); }
+	bool empty() const { return pBegin == pEnd; }
+	int operator[]( size_t i ) const;
+};
+
+// PlayManager manges a map of GameObject structures
+// > Additional member variables can be added with PLAY_ADD_GAMEOBJECT_MEMBERS 
+struct GameObject
+{
+	GameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+
+	// Default member variables: don't change these!
+	GameObjectTypeField type{ -1, this };
+	int spriteId{ -1 };
+	Point2D pos{ 0.0f, 0.0f };
+	Point2D oldPos{ 0.0f, 0.0f };
+	Vector2D velocity{ 0.0f, 0.0f };
+	Vector2D acceleration{ 0.0f, 0.0f };
+	float rotation{ 0.0f };
+	float rotSpeed{ 0.0f };
+	float oldRot{ 0.0f };
+	int frame{ 0 };
+	float framePos{ 0.0f };
+	float animSpeed{ 0.0f };
+	int radius{ 0 };
+	float scale{ 1 };
+	PLAY_ADD_GAMEOBJECT_MEMBERS
+
+	int GetId() { return m_id; }
+
+private:
+	// The PlayManager's internal object lists need to update the private bookkeeping below
+	friend class PlayObjects;
+
+	// The GameObject's id should never be changed manually so we make it private!
+	int m_id{ -1 };
+	// Position of the object in the PlayManager's list for its type (-1 if it isn't managed, and stale once ResetWorld drops it)
+	int m_typeSlot{ -1 };
+	// The type whose list the object is in (only differs from type while a change is deferred by Play::ParallelForEach)
+	int m_listType{ -1 };
+
+	// Preventing assignment and copying reduces the potential for bugs
+	GameObject& operator=( const GameObject& ) = delete;
+	GameObject( const GameObject& ) = delete;
+};
+
+inline int GameObjectIdSpan::Iterator::operator*() const { return ( *p )->GetId(); }
+inline int GameObjectIdSpan::operator[]( size_t i ) const { return pBegin[i]->GetId(); }
+
+// Describes which GameObject types and other resources an update system uses (see Play::RegisterSystem)
+// > Writing a type includes creating objects of that type and changing objects to or from it
+// > Objects created in a step with other systems only join their type's list when the step ends: the other systems in the step
+// > and those in earlier steps don't see them until the next frame, but declaring the write puts readers such as drawing in a later step
+struct SystemAccess
+{
+	std::vector<int> readTypes;
+	std::vector<int> writeTypes;
+	unsigned int readResources{ 0 };
+	unsigned int writeResources{ 0 };
+};
+
+// A reference to something which can be called, such as a lambda, for a function which only calls it before returning
+// > Unlike std::function it never copies what it refers to, so it never allocates
+template< typename Signature > class PlayFunctionRef;
+
+template< typename R, typename... Args >
+class PlayFunctionRef<R( Args... )>
+{
+public:
+	PlayFunctionRef( std::nullptr_t = nullptr ) {}
+
+	template< typename Fn, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Fn>, PlayFunctionRef>> >
+	PlayFunctionRef( Fn&& fn )
+		: m_pCallable( const_cast<void*>( static_cast<const void*>( std::addressof( fn ) ) ) ),
+		m_pCall( []( void* pCallable, Args... args ) -> R { return ( *static_cast<std::remove_reference_t<Fn>*>( pCallable ) )( std::forward<Args>( args )... ); } )
+	{
+	}
+
+	R operator()( Args... args ) const { return m_pCall( m_pCallable, std::forward<Args>( args )... ); }
+	explicit operator bool() const { return m_pCall != nullptr; }
+
+private:
+	void* m_pCallable{ nullptr };
+	R( *m_pCall )( void*, Args... ){ nullptr };
+};
+
+// A template for GameObjects which all start off the same way (see Play::RegisterArchetype)
+struct GameObjectArchetype
+{
+	int type{ -1 };
+	int spriteId{ -1 };
+	int radius{ 0 };
+	float animSpeed{ 0.0f };
+	Vector2D velocity{ 0.0f, 0.0f };
+	float rotation{ 0.0f };
+	float rotSpeed{ 0.0f };
+};
+
+#endif
+
+class PlayObjects;
+class PlaySystems;
+
+namespace Play
+{
+	// Alignment for font drawing operations
+	enum Align
+	{
+		LEFT = 0,
+		RIGHT,
+		CENTRE,
+	};
+
+	enum Direction
+	{
+		HORIZONTAL = 0,
+		VERTICAL,
+		ALL,
+	};
+
+	// PlayManager uses colour values from 0-100 for red, green, blue and alpha
+	struct Colour
+	{
+		Colour( float r, float g, float b ) : red( r ), green( g ), blue( b ) {}
+		Colour( int r, int g, int b ) : red( static_cast<float>( r ) ), green( static_cast<float>( g ) ), blue( static_cast<float>( b ) ) {}
+		float red, green, blue;
+	};
+
+	extern Colour cBlack, cRed, cGreen, cBlue, cMagenta, cCyan, cYellow, cOrange, cWhite, cGrey;
+
+	// The state behind the Play:: functions for a single game
+	struct ManagerState;
+
+	// Everything belonging to one running game, so that several can run side by side in the same process
+	// > The Play:: functions and the subsystem Instance() functions use the calling thread's current context
+	// > Threads use a default context until given another, so a game which only runs once never needs to create one
+	// > Sprites loaded from the same directory are shared between contexts, everything else belongs to just one
+	class Context
+	{
+	public:
+		// Creates an empty context: make it current then call CreateManager() to start a game in it
+		Context();
+		// Frees the context, which must have had DestroyManager() called for it first
+		~Context();
+		// The assignment operator is removed as a context owns its subsystems
+		Context& operator=( const Context& ) = delete;
+		// The copy constructor is removed as a context owns its subsystems
+		Context( const Context& ) = delete;
+
+		// Makes this the current context for the calling thread and returns the one it replaces
+		Context* MakeCurrent();
+		// Gets the calling thread's current context
+		static Context& Current() { return s_pCurrent ? *s_pCurrent : Default(); }
+		// Gets the context threads use until they're given another
+		static Context& Default();
+
+		// The subsystems, created and destroyed by their own Instance() and Destroy() functions
+		PlayWindow* pWindow{ nullptr };
+		PlayGraphics* pGraphics{ nullptr };
+		PlayAudio* pAudio{ nullptr };
+		PlayInput* pInput{ nullptr };
+		PlayObjects* pObjects{ nullptr };
+		PlaySystems* pSystems{ nullptr };
+		ManagerState* pManager{ nullptr };
+
+		// Anything the game wants to keep with the context, such as its own state (the context doesn't own or free it)
+		void* pUserData{ nullptr };
+		// Gets pUserData as the type the game stored there
+		template< typename T > T* GetUserData() const { return static_cast<T*>( pUserData ); }
+
+	private:
+		static thread_local Context* s_pCurrent;
+	};
+
+	// Manager creation and deletion
+	//**************************************************************************************************
+
+	// Initialises the managers and creates a window of the required dimensions
+	void CreateManager( int width, int height, int scale );
+	// Shuts down the managers and closes the window
+	void DestroyManager();
+
+	// PlayWindow functions
+	//**************************************************************************************************
+
+	// Copies the contents of the drawing buffer to the window
+	void PresentDrawingBuffer();
+	// Gets the co-ordinates of the mouse cursor within the display buffer
+	Point2D GetMousePos();
+	// Gets the status of the left or right mouse buttons
+	bool GetMouseButton( Align button );
+	// Gets the width of the display buffer
+	int GetBufferWidth();
+	// Gets the height of the display buffer
+	int GetBufferHeight();
+	// Sets the target number of frames drawn per second (60 by default)
+	void SetFrameRate( int framesPerSecond );
+	// Gets statistics on how accurately frames have started on time, to help spot stutter
+	FramePacingStats GetFramePacingStats();
+	// Gets a histogram of how long it has taken to copy each frame to the window
+	PresentHistogram GetPresentHistogram();
+	// Gets the median, 95th and 99th percentile and longest of the last few thousand frame times, and how many went over budget
+	// > Also shown in the F1 overlay, with a graph of the most recent frames
+	FrameTimeStats GetFrameTimeStats();
+	// Writes the last few thousand frame times to a CSV file, returning false if it can't be written
+	// > Also written by pressing F3 (to frame_times.csv), or on exit with --play-frame-times=<file> when running headless
+	bool ExportFrameTimes( const char* filename );
+	// Publishes each frame's time, hitches, GameObject counts, blits, allocations and sounds to named shared memory
+	// > Read them from another process with PlayMetrics/PlayMetrics.cpp. Also turned on with --play-metrics[=<name>] on the command line
+	// > Returns false if the shared memory can't be created
+	bool PublishMetrics( const char* name = "PlayMetrics" );
+	// Lets up to depth finished frames (0 to 2) wait to be presented on another thread while the next frame is drawn
+	// > Every frame must be drawn in full, as the drawing buffer holds whatever was drawn depth + 1 frames ago
+	void SetPresentQueueDepth( int depth );
+	// Splits scaling the display buffer up to the window size into bands of rows which run on different threads (1 by default)
+	void SetUpscaleBands( int bands );
+	// Draws at 75% or 50% resolution when frames are taking too long, and back at full resolution once there's time to spare
+	// > The reduced frame is scaled up to the window, so nothing in the game needs to change. Call after SetFrameRate()
+	void SetDynamicResolution( bool bEnable );
+	// Gets the latency and waiting times of the frames handed to the present thread
+	PresentQueueStats GetPresentQueueStats();
+	// Draws and presents frames on a render thread, so the game thread can carry straight on with the next update
+	// > Every drawing operation is recorded and handed over in a snapshot, so only draw through the Play:: functions
+	void SetRenderThread( bool bEnable );
+	// Calls MainGameUpdate() a fixed number of times per second and draws GameObjects part way between their last two updates
+	// > Pass 0 to go back to one MainGameUpdate() per frame (the default)
+	void SetFixedTickRate( int ticksPerSecond );
+
+	// PlayAudio functions
+	//**************************************************************************************************
+
+	// Plays an mp3 audio file from the "Data\Sounds" directory
+	void PlayAudio( const char* mp3Filename );
+	// Loops an mp3 audio file from the "Data\Sounds" directory
+	void StartAudioLoop( const char* mp3Filename );
+	// Stops a looping mp3 audio file started with Play::StartSoundLoop()
+	void StopAudioLoop( const char* mp3Filename );
+
+	// PlayGraphics functions
+	//**************************************************************************************************
+
+	// Clears the display buffer using the colour provided
+	void ClearDrawingBuffer( Colour col );
+	// Loads a PNG file as the background image for the window
+	int LoadBackground( const char* pngFilename );
+	// Draws the background image previously loaded with Play::LoadBackground() into the drawing buffer
+	void DrawBackground( int background = 0 );
+	// Draws text to the screen using the built-in debug font
+	void DrawDebugText( Point2D pos, const char* text, Colour col = cWhite, bool centred = true );
+
+	// Gets the sprite id of the first matching sprite whose filename contains the given text
+	int GetSpriteId( const char* spriteName );
+	// Gets the pixel height of a sprite
+	int GetSpriteHeight( const char* spriteName );
+	// Gets the pixel width of a sprite
+	int GetSpriteWidth( const char* spriteName );
+	// Gets the pixel height of a sprite
+	int GetSpriteHeight( int spriteId );
+	// Gets the pixel width of a sprite
+	int GetSpriteWidth( int spriteId );
+	// Gets the stem filename for the sprite (without path or extension)
+	const char* GetSpriteName( int spriteId );
+	// Gets the total number of frames in the sprite
+	int GetSpriteFrames( int spriteId );
+	// Blends the sprite with the given colour (works best on white sprites)
+	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
+	void ColourSprite( const char* spriteName, Colour col );
+
+	// Centres the origin of the first sprite found matching the given name
+	void CentreSpriteOrigin( const char* spriteName );
+	// Centres the origin of all sprites found matching the given name
+	void CentreMatchingSpriteOrigins( const char* partName );
+	// Centres the origins of all loaded sprites
+	void CentreAllSpriteOrigins();
+	// Moves the origin of the first sprite found matching the given name
+	void MoveSpriteOrigin( const char* spriteName, int xOffset, int yOffset );
+	// Moves the origin of all sprites found matching the given name
+	void MoveMatchingSpriteOrigins( const char* partName, int xoffset, int yoffset );
+	// Moves the origin of all loaded sprites
+	void MoveAllSpriteOrigins( int xoffset, int yoffset );
+	// Sets the origin of the first sprite found matching the given name
+	void SetSpriteOrigin( const char* spriteName, int xOrigin, int yOrigin );
+	// Sets the origin of the sprite with a specific ID
+	void SetSpriteOrigin( int spriteId, int xOrigin, int yOrigin );
+	// Gets the origin of the first sprite found matching the given name
+	Point2D GetSpriteOrigin( const char* spriteName );
+	// Gets the origin of the sprite with a specific ID
+	Point2D GetSpriteOrigin( int spriteId );
+
+	// Draws the first matching sprite whose filename contains the given text
+	void DrawSprite( const char* spriteName, Point2D pos, int frameIndex );
+	// Draws the sprite using its unique sprite ID
+	void DrawSprite( int spriteID, Point2D pos, int frame );
+	// Draws the sprite with transparency (slower than DrawSprite)
+	void DrawSpriteTransparent( const char* spriteName, Point2D pos, int frame, float opacity );
+	// Draws the sprite with transparency (slower than DrawSprite)
+	void DrawSpriteTransparent( int spriteID, Point2D pos, int frame, float opacity );
+	// Draws the sprite with rotation and transparency (slowest DrawSprite)
+	void DrawSpriteRotated( const char* spriteName, Point2D pos, int frame, float angle, float scale = 1.0f, float opacity = 1.0f );
+	// Draws the sprite with rotation and transparency (slowest DrawSprite)
+	void DrawSpriteRotated( int spriteID, Point2D pos, int frame, float angle, float scale, float opacity = 1.0f );
+	// Draws a single-pixel wide line between two points in the given colour
+	void DrawLine( Point2D start, Point2D end, Colour col );
+	// Draws a single-pixel wide circle in the given colour
+	void DrawCircle( Point2D pos, int radius, Colour col );
+	// Draws a rectangle in the given colour
+	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour col, bool fill = false );
+	// Draws a line between two points using a sprite
+	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
+	void DrawSpriteLine( Point2D startPos, Point2D endPos, const char* penSprite, Colour c = cWhite );
+	// Draws a circle using a sprite
+	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
+	void DrawSpriteCircle( int x, int y, int radius, const char* penSprite, Colour c = cWhite );
+	// Draws text using a sprite-based font exported from PlayFontTool
+	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify = LEFT );
+	// Adds a sprite dynamically from memory (custom asset pipelines)
+
+	// Resets the timing bar data and sets the current timing bar segment to a specific colour
+	void BeginTimingBar( Pixel pix );
+	// Sets the current timing bar segment to a specific colour
+	// > Returns the number of timing segments
+	int ColourTimingBar( Pixel pix );
+	// Draws the timing bar for the previous frame at the given position and size
+	void DrawTimingBar( Point2f pos, Point2f size );
+
+	// GameObject functions
+	//**************************************************************************************************
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+	// Creates a new GameObject and adds it to the managed list.
+	// > Returns the new object's unique id
+	// > Ids are never reused, so each context can create about 2^31 GameObjects in all (2048 in each of 2^20 slots) before this asserts
+	int CreateGameObject( int type, Point2D pos, int collisionRadius, const char* spriteName );
+	// Retrieves a GameObject based on its id
+	// > Returns an object with a type of -1 if no object can be found
+	GameObject& GetGameObject( int id );
+	// Retrieves the first GameObject matching the given type (ideal for types with a single object like the player)
+	// > The first is the one which has had the type longest. Returns an object with a type of -1 if no object can be found
+	GameObject& GetGameObjectByType( int type );
+	// Collects the IDs of all of the GameObjects with the matching type
+	// > In the order they were created or changed to the type, so looping over them to draw keeps the same draw order
+	std::vector<int> CollectGameObjectIDsByType( int type );
+	// Gets the IDs of all of the GameObjects with the matching type without making a copy
+	// > Don't create, destroy or change the type of objects of this type while looping over the span (use CollectGameObjectIDsByType instead)
+	GameObjectIdSpan GetGameObjectIDsByType( int type );
+	// Counts the GameObjects with the matching type
+	int CountGameObjectsByType( int type );
+	// Collects the IDs of all of the GameObjects
+	// > In the order they were created
+	std::vector<int> CollectAllGameObjectIDs();
+	// Performs a typical update of the object's position and animation
+	void UpdateGameObject( GameObject& object, bool bWrap = false, int wrapBorderSize = 0 );
+	// Performs UpdateGameObject on all of the GameObjects with the matching type, shared out between worker threads
+	void UpdateGameObjects( int type, bool bWrap = false, int wrapBorderSize = 0 );
+	// Calls fn on each of the GameObjects with the matching type, shared out between worker threads
+	// > fn should only change the object it is given, and mustn't draw anything (the drawing functions aren't thread safe)
+	// > Objects can be created, have their type changed or be passed to QueueDestroy, but the type lists aren't updated until every object has been visited
+	// > The lists are then updated in the same order every run, but objects created here get their ids in whichever order the threads reach them
+	void ParallelForEach( int type, const std::function<void( GameObject& )>& fn );
+	// Deletes the GameObject with the corresponding id
+	//> Use GameObject.GetId() to find out its unique id
+	void DestroyGameObject( int id );
+	// Flags the GameObject with the corresponding id to be deleted at the end of the frame (in PresentDrawingBuffer)
+	// > Safe to call while looping over GetGameObjectIDsByType, as the object isn't moved or removed until then
+	// > Until then it can still be found by its id, is still listed with its type and is still drawn if the game draws it
+	void QueueDestroy( int id );
+	// Deletes all GameObjects with the corresponding type
+	void DestroyGameObjectsByType( int type );
+	// Deletes all GameObjects except those with one of the given types (e.g. when starting a new level)
+	// > Takes the same time however many objects are deleted, and their memory is reused for new GameObjects
+	// > Any references to the deleted objects are no longer valid, but their ids are safe to use with GetGameObject
+	void ResetWorld( const std::vector<int>& keepTypes );
+	// Registers a template for GameObjects which all start off the same way
+	// > The sprite is looked up once here rather than every time an object is spawned
+	// > Returns the archetype's id to pass to SpawnBatch
+	int RegisterArchetype( int type, const char* spriteName, int collisionRadius, float animSpeed = 0.0f, Vector2D velocity = { 0.0f, 0.0f }, float rotation = 0.0f, float rotSpeed = 0.0f );
+	// Creates count GameObjects from an archetype and calls initializer( obj, index ) on each one (e.g. to set its position)
+	// > The storage for the whole batch is reserved before any of them are created, and the initializer is only referred to, so at most one allocation is made
+	// > Returns the id of the first object created
+	int SpawnBatch( int archetypeId, int count, PlayFunctionRef<void( GameObject&, int )> initializer = nullptr );
+
+	// Resources other than GameObjects which update systems can declare in their SystemAccess
+	enum SystemResource : unsigned int
+	{
+		RESOURCE_DRAWING = 1 << 0, // The drawing buffer: every system which draws anything writes this
+		RESOURCE_AUDIO = 1 << 1, // Playing and stopping sounds
+		RESOURCE_RANDOM = 1 << 2, // The order of RandomRoll's numbers: each parallel system has its own stream, so this only matters for repeatable runs
+		RESOURCE_GAME_STATE = 1 << 3, // The game's own global variables
+		RESOURCE_USER = 1 << 8, // The first of the bits which are free for a game's own resources
+	};
+	// Put this in a system's writeTypes if it needs all of the GameObjects to itself (e.g. to call ResetWorld)
+	constexpr int ALL_TYPES = INT_MIN;
+
+	// Registers an update system for RunSystems along with the GameObject types and resources it reads and writes
+	// > Systems which conflict always run in the order they were registered, so drawing happens in the same order every frame
+	// > Systems which don't conflict can run at the same time on different threads
+	void RegisterSystem( const char* name, const std::function<void()>& fn, const SystemAccess& access );
+	// Runs all of the registered systems as a series of steps, where the systems in each step don't conflict with each other
+	// > Within a step objects can be created, have their type changed or be passed to QueueDestroy, but the type lists aren't updated until the step ends
+	// > So a new object is drawn the frame it's created as long as the drawing system reads its type, but systems which ran before it was created first update it next frame
+	void RunSystems();
+	// Runs every step's systems one at a time on this thread in registration order (for debugging)
+	// > The steps are the same as in the parallel schedule, so differences in behaviour point to a system with a missing declaration
+	void SetSystemsSerial( bool bSerial );
+	
+	// Checks whether the two objects are within each other's collision radii
+	bool IsColliding( GameObject& obj1, GameObject& obj2 );
+	// Checks whether any part of the object is visible within the DisplayBuffer
+	bool IsVisible( GameObject& obj );
+	// Checks whether the object is overlapping the edge of the screen and moving outwards 
+	bool IsLeavingDisplayArea( GameObject& obj, Direction dirn = ALL );
+	// Checks whether the animation has completed playing
+	bool IsAnimationComplete( GameObject& obj );
+
+	// Sets the velocity of the object based on a target rotation angle
+	void SetGameObjectDirection( GameObject& obj, int speed, float rotation );
+	// Set the velocity and rotation of the object based on a target point
+	void PointGameObject( GameObject& obj, int speed, int targetX, int targetY );
+
+	// Changes the object's current spite and resets its animation frame to the start
+	void SetSprite( GameObject& obj, const char* spriteName, float animSpeed );
+	// Draws the object's sprite without rotation or transparency (fastest)
+	void DrawObject( GameObject& obj );
+	// Draws the object's sprite with transparency (slower than DrawObject)
+	void DrawObjectTransparent( GameObject& obj, float opacity );
+	// Draws the object's sprite with rotation and transparency (slower than DrawObject)
+	void DrawObjectRotated( GameObject& obj, float opacity = 1.0f );
+
+#endif
+
+	// Miscellaneous functions
+	//**************************************************************************************************
+
+	// Returns true if the key has been pressed since it was last released
+	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
+	bool KeyPressed( int vKey );
+	// Returns true if the key is currently being held down
+	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
+	bool KeyDown( int vKey );
+	// Holds a key down or releases it, as though it was pressed on the keyboard
+	void SetKeyDown( int vKey, bool bDown );
+	// Sets a function to be called at the start of every frame to drive the input with SetKeyDown(), such as a bot which plays the game
+	// > Pass nullptr to go back to the keyboard
+	void SetInputDriver( std::function<void( int frame )> driver );
+
+	// Starts the random numbers given by RandomRoll and RandomRollRange from a seed, so they're the same every run
+	// > CreateManager seeds them from the time unless a seed has already been set
+	void SetRandomSeed( unsigned int seed );
+	// Gets the seed the random numbers were last started from
+	unsigned int GetRandomSeed();
+
+	// Records the input, the frame times and the random seed to a binary file, so the run can be replayed exactly
+	// > Also started with --play-record=<file> on the command line. Restarts the random numbers from their seed
+	void RecordInput( const char* filename );
+	// Replays a file made by RecordInput in place of the real input, from the same random seed, so the game draws exactly the same frames
+	// > Also started with --play-replay=<file> on the command line. Call it before the first frame
+	// > Dynamic resolution stays at whatever scale it was at, and a headless run stops when the replay runs out
+	void ReplayInput( const char* filename );
+
+	// Writes the last few frames' PLAY_PROFILE_SCOPE timings on every thread to a JSON file for chrome://tracing or ui.perfetto.dev
+	// > Also written when the game exits with --play-profile=<file> on the command line. Returns false if the file can't be written
+	bool ExportProfile( const char* filename, int frames = 120 );
+
+	// Returns a random number as if you rolled a die with this many sides
+	// > Every chunk of ParallelForEach and every system in a parallel step has its own stream of numbers made from the seed,
+	// > so rolling never waits on another thread and gives the same numbers every run whichever threads do the work
+	int RandomRoll( int sides );
+	// Returns a random number from min to max inclusive
+	int RandomRollRange( int min, int max );
+	// Returns a random float from 0 up to (but not including) 1
+	float RandomFloat();
+	// Fills an array with random numbers from min to max inclusive, which is quicker than calling RandomRollRange for each one
+	void RandomRollFill( int* pResults, int count, int min, int max );
+
+	// Converts radians to degrees
+	constexpr float RadToDeg( float radians )
+	{
+		return ( radians / PLAY_PI ) * 180.0f;
+	}
+
+	// Converts radians to degrees
+	constexpr float DegToRad( float degrees )
+	{
+		return ( degrees / 180.0f ) * PLAY_PI;
+	}
+
+}
+
+#endif
+
+
+
+
+#endif // PLAYPCH_H
+
+
+
+
+
+//*******************************************************************
+//*******************************************************************
+#ifdef PLAY_IMPLEMENTATION
+//*******************************************************************
+//*******************************************************************
+//********************************************************************************************************************************
+//* File:			PlayMemory.cpp
+//* Platform:		Independent
+//* Description:	Implementation of a simple memory tracker to prevent leaks. Uses #define new which looks neat and tidy
+//*                 (especially for new C++ programmers), but doesn't work for placement new, so you are likely to get compile 
+//*                 errors if you start including it in your own header files.  
+//*                 Avoids use of STL or anything else which allocates memory as this could create infinite loops!
+//* Notes:          This is a simple approach to support your understanding of overriding the new operator.
+//*                 See below for more advanced approaches:
+//*                 1) The CRT Debug Heap Library (a more advanced version of this approach)
+//*                 https://docs.microsoft.com/en-us/visualstudio/debugger/crt-debug-heap-details?view=vs-2019
+//*                 2) Heap Profiling in the debugger 
+//*                 https://docs.microsoft.com/en-us/visualstudio/profiling/memory-usage?view=vs-2019
+//********************************************************************************************************************************
+
+
+#ifdef _DEBUG
+
+// Undefine 'new' in this compilation unit only.
+#pragma push_macro("new")
+#undef new
+
+constexpr int MAX_ALLOCATIONS = 8192 * 4;
+constexpr int MAX_FILENAME = 1024;
+
+unsigned int g_allocId = 0;
+
+// A structure to store data on each memory allocation
+struct ALLOC
+{
+	void* address = 0;
+	char file[MAX_FILENAME] = { 0 };
+	int line = 0;
+	size_t size = 0;
+	int id = 0;
+
+	ALLOC( void* a, const char* fn, int l, size_t s ) { address = a; line = l; size = s; id = g_allocId++; snprintf( file, MAX_FILENAME, "%s", fn ); };
+	ALLOC( void ) {};
+};
+
+ALLOC g_allocations[MAX_ALLOCATIONS];
+unsigned int g_allocCount = 0;
+
+
+void CreateStaticObject( void );
+void PrintAllocation( const char* tagText, ALLOC& a );
+
+//********************************************************************************************************************************
+// Overrides for new operator (x4)
+//********************************************************************************************************************************
+
+// The file and line are passed through using the macro defined in PlayMemory.h which redefines new. This will only happen if 
+// PlayMemory.h has been parsed in advance of the use of new in the relevant code. This approach is problematic for classes 
+// the safest approach. The two definitions of new without the file and line pick up any other memory allocations for completeness.
+void* operator new( size_t size, const char* file, int line )
+{
+	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
+	CreateStaticObject();
+	void* p = malloc( size );
+	g_allocations[g_allocCount++] = ALLOC{ p, file, line, size };
+	return p;
+}
+
+void* operator new[]( size_t size, const char* file, int line )
+{
+	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
+	CreateStaticObject();
+	void* p = malloc( size );
+	g_allocations[g_allocCount++] = ALLOC{ p, file, line, size };
+	return p;
+}
+
+void* operator new( size_t size )
+{
+	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
+	CreateStaticObject();
+	void* p = malloc( size );
+	g_allocations[g_allocCount++] = ALLOC{ p, "Unknown", 0, size };
+	return p;
+}
+
+void* operator new[]( size_t size )
+{
+	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
+	CreateStaticObject();
+	void* p = malloc( size );
+	g_allocations[g_allocCount++] = ALLOC{ p, "Unknown", 0, size };
+	return p;
+}
+
+//********************************************************************************************************************************
+// Overrides for delete operator (x4)
+//********************************************************************************************************************************
+
+// The definitions with file and line are only included for exception handling, where it looks for a form of delete that matches 
+// the new that was used to allocate it.
+void operator delete( void* p, const char* file, int line )
+{
+	UNREFERENCED_PARAMETER( line );
+	UNREFERENCED_PARAMETER( file );
+	operator delete( p );
+}
+
+int g_id = -1;
+
+void operator delete( void* p )
+{
+	for( unsigned int a = 0; a < g_allocCount; a++ )
+	{
+		if( g_allocations[a].address == p )
+		{
+			if( g_allocations[a].id == g_id )
+				g_allocations[a].id = g_id;
+
+			g_allocations[a] = g_allocations[g_allocCount - 1];
+			g_allocations[g_allocCount - 1].address = nullptr;
+			g_allocCount--;
+		}
+	}
+	free( p );
+}
+
+void operator delete[]( void* p, const char* file, int line )
+{
+	UNREFERENCED_PARAMETER( line );
+	UNREFERENCED_PARAMETER( file );
+	operator delete[]( p );
+}
+
+void operator delete[]( void* p )
+{
+	for( unsigned int a = 0; a < g_allocCount; a++ )
+	{
+		if( g_allocations[a].address == p )
+		{
+			if( g_allocations[a].id == g_id )
+				g_allocations[a].id = g_id;
+
+			g_allocations[a] = g_allocations[g_allocCount - 1];
+			g_allocations[g_allocCount - 1].address = nullptr;
+			g_allocCount--;
+		}
+	}
+	free( p );
+}
+
+//********************************************************************************************************************************
+// Printing allocations
+//********************************************************************************************************************************
+
+// A method for printing out all the memory allocation immediately before program exit (or as close as you can get)
+// This is achieved by creating a class as a static object before the first memory allocation, which stays in scope until
+// after everything else is destroyed. When it is cleaned up its destructor prints the allocations to show us any leaks!
+class DestroyedLast
+{
+public:
+	DestroyedLast()
+	{
+		PrintAllocations( "<STARTUP>" );
+	}
+	~DestroyedLast()
+	{
+		if( g_allocCount > 0 )
+		{
+			PrintAllocations( "<MEMORY LEAK>" );
+		}
+		else
+		{
+			DebugOutput( "**************************************************\n" );
+			DebugOutput( "NO MEMORY LEAKS!\n" );
+			DebugOutput( "**************************************************\n" );
+		}
+
+	}
+};
+
+void CreateStaticObject( void )
+{
+	static DestroyedLast last;
+}
+
+void PrintAllocation( const char* tagText, ALLOC& a )
+{
+	char buffer[MAX_FILENAME * 2] = { 0 };
+
+	if( a.address != nullptr )
+	{
+		char* lastSlash = strrchr( a.file, std::filesystem::path::preferred_separator );
+		if( lastSlash )
+		{
+			snprintf( buffer, sizeof( buffer ), "%s", lastSlash + 1 );
+			snprintf( a.file, MAX_FILENAME, "%s", buffer );
+		}
+		// Format in such a way that VS can double click to jump to the allocation.
+		snprintf( buffer, sizeof( buffer ), "%s %s(%d): 0x%02X %d bytes [%d]\n", tagText, a.file, a.line, static_cast<int>( reinterpret_cast<long long>( a.address ) ), static_cast<int>( a.size ), a.id );
+		DebugOutput( buffer );
+	}
+}
+
+void PrintAllocations( const char* tagText )
+{
+	int bytes = 0;
+	char buffer[MAX_FILENAME * 2] = { 0 };
+	DebugOutput( "****************************************************\n" );
+	DebugOutput( "MEMORY ALLOCATED\n" );
+	DebugOutput( "****************************************************\n" );
+	for( unsigned int n = 0; n < g_allocCount; n++ )
+	{
+		ALLOC& a = g_allocations[n];
+		PrintAllocation( tagText, a );
+		bytes += a.size;
+	}
+	snprintf( buffer, sizeof( buffer ), "%s Total = %d bytes\n", tagText, bytes );
+	DebugOutput( buffer );
+	DebugOutput( "**************************************************\n" );
+
+}
+
+unsigned long long GetAllocationCount()
+{
+	return g_allocId;
+}
+
+#pragma pop_macro("new")
+
+#elif PLAY_COUNT_ALLOCATIONS
+
+//********************************************************************************************************************************
+// Counting overrides for new and delete
+//********************************************************************************************************************************
+
+std::atomic<unsigned long long> g_allocTotal{ 0 };
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // GCC sees the free() in delete once it's inlined next to the malloc() in new
+#endif
+
+void* operator new( size_t size )
+{
+	g_allocTotal.fetch_add( 1, std::memory_order_relaxed );
+	if( void* p = malloc( size ? size : 1 ) )
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void operator delete( void* p ) noexcept
+{
+	free( p );
+}
+
+void operator delete[]( void* p ) noexcept
+{
+	free( p );
+}
+
+void operator delete( void* p, size_t ) noexcept
+{
+	free( p );
+}
+
+void operator delete[]( void* p, size_t ) noexcept
+{
+	free( p );
+}
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+unsigned long long GetAllocationCount()
+{
+	return g_allocTotal.load( std::memory_order_relaxed );
+}
+
+#else
+
+unsigned long long GetAllocationCount()
+{
+	return 0;
+}
+
+#endif
+
+//********************************************************************************************************************************
+// File:		PlayMaths.cpp
+// Description:	Fast approximations of the trigonometry functions
+// Platform:	Independent
+// Notes:		The scalar and SSE2 versions do the same operations in the same order, so their results are identical
+//********************************************************************************************************************************
+
+namespace Play
+{
+	constexpr int SIN_TABLE_SIZE = 256;
+	constexpr float SIN_TABLE_STEPS_PER_RADIAN = SIN_TABLE_SIZE / ( 2.0f * PLAY_PI );
+	// The table's step split into three parts. The first two only have 8 bits each, so multiplying them by any step
+	// number below 65536 is exact and the remainder keeps its precision
+	constexpr float SIN_TABLE_STEP_HI = 0.0245361328125f;
+	constexpr float SIN_TABLE_STEP_MID = 7.539987564086914e-06f;
+	constexpr float SIN_TABLE_STEP_LO = 1.9806106976716364e-08f;
+	// Adding and subtracting 1.5 * 2^23 rounds a float to the nearest whole number
+	constexpr float ROUNDING_MAGIC = 12582912.0f;
+
+	// sin( i * 2PI / 256 ) for every step of the table
+	static const std::vector<float> s_vSinTable = []()
+	{
+		std::vector<float> vTable( SIN_TABLE_SIZE );
+		for( int i = 0; i < SIN_TABLE_SIZE; i++ )
+			vTable[i] = static_cast<float>( std::sin( i * ( 2.0 * 3.14159265358979323846 / SIN_TABLE_SIZE ) ) );
+		return vTable;
+	}();
+
+	// A minimax fit of atan( t ) for t from 0 to 1 as an odd polynomial in t
+	constexpr float ATAN_COEFFICIENTS[8] = { 9.999993352e-01f, -3.332985949e-01f, 1.994655157e-01f, -1.390856264e-01f,
+		9.642034434e-02f, -5.591020402e-02f, 2.186154894e-02f, -4.054193032e-03f };
+
+	void FastSinCos( float angle, float& sinOut, float& cosOut )
+	{
+		// Split the angle into the nearest step of the table plus a remainder of less than half a step
+		float n = ( angle * SIN_TABLE_STEPS_PER_RADIAN + ROUNDING_MAGIC ) - ROUNDING_MAGIC;
+		float r = ( ( angle - n * SIN_TABLE_STEP_HI ) - n * SIN_TABLE_STEP_MID ) - n * SIN_TABLE_STEP_LO;
+		int index = static_cast<int>( n );
+		float sinA = s_vSinTable[index & ( SIN_TABLE_SIZE - 1 )];
+		float cosA = s_vSinTable[( index + SIN_TABLE_SIZE / 4 ) & ( SIN_TABLE_SIZE - 1 )];
+		// The remainder is small enough that two terms of each Taylor series are accurate to well below a float's precision
+		float r2 = r * r;
+		float sinR = r - r * r2 * ( 1.0f / 6.0f );
+		float cosR = 1.0f - r2 * 0.5f;
+		sinOut = sinA * cosR + cosA * sinR;
+		cosOut = cosA * cosR - sinA * sinR;
+	}
+
+	float FastAtan2( float y, float x )
+	{
+		float ax = std::abs( x );
+		float ay = std::abs( y );
+		float big = std::max( ax, ay );
+		float t = big > 0.0f ? std::min( ax, ay ) / big : 0.0f;
+		float t2 = t * t;
+		float poly = ATAN_COEFFICIENTS[7];
+		for( int i = 6; i >= 0; i-- )
+			poly = poly * t2 + ATAN_COEFFICIENTS[i];
+		float angle = poly * t;
+		// Unfold the octant the polynomial covers back out to the whole circle
+		angle = ay > ax ? ( PLAY_PI * 0.5f ) - angle : angle;
+		angle = std::signbit( x ) ? PLAY_PI - angle : angle;
+		return std::copysign( angle, y );
+	}
+
+	void FastSinCos( const float* pAngles, float* pSinOut, float* pCosOut, int count )
+	{
+		int i = 0;
+
+#ifdef PLAY_SIMD_SSE2
+		const __m128 stepsPerRadian = _mm_set1_ps( SIN_TABLE_STEPS_PER_RADIAN );
+		const __m128 magic = _mm_set1_ps( ROUNDING_MAGIC );
+		const __m128i indexMask = _mm_set1_epi32( SIN_TABLE_SIZE - 1 );
+		const __m128i quarterTurn = _mm_set1_epi32( SIN_TABLE_SIZE / 4 );
+		const float* pTable = s_vSinTable.data();
+
+		for( ; i + 4 <= count; i += 4 )
+		{
+			__m128 angle = _mm_loadu_ps( pAngles + i );
+			__m128 n = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( angle, stepsPerRadian ), magic ), magic );
+			__m128 r = _mm_sub_ps( angle, _mm_mul_ps( n, _mm_set1_ps( SIN_TABLE_STEP_HI ) ) );
+			r = _mm_sub_ps( r, _mm_mul_ps( n, _mm_set1_ps( SIN_TABLE_STEP_MID ) ) );
+			r = _mm_sub_ps( r, _mm_mul_ps( n, _mm_set1_ps( SIN_TABLE_STEP_LO ) ) );
+
+			// SSE2 can't gather, so the table is read one lane at a time
+			alignas( 16 ) int sinIndex[4];
+			alignas( 16 ) int cosIndex[4];
+			__m128i index = _mm_cvttps_epi32( n );
+			_mm_store_si128( reinterpret_cast<__m128i*>( sinIndex ), _mm_and_si128( index, indexMask ) );
+			_mm_store_si128( reinterpret_cast<__m128i*>( cosIndex ), _mm_and_si128( _mm_add_epi32( index, quarterTurn ), indexMask ) );
+			__m128 sinA = _mm_setr_ps( pTable[sinIndex[0]], pTable[sinIndex[1]], pTable[sinIndex[2]], pTable[sinIndex[3]] );
+			__m128 cosA = _mm_setr_ps( pTable[cosIndex[0]], pTable[cosIndex[1]], pTable[cosIndex[2]], pTable[cosIndex[3]] );
+
+			__m128 r2 = _mm_mul_ps( r, r );
+			__m128 sinR = _mm_sub_ps( r, _mm_mul_ps( _mm_mul_ps( r, r2 ), _mm_set1_ps( 1.0f / 6.0f ) ) );
+			__m128 cosR = _mm_sub_ps( _mm_set1_ps( 1.0f ), _mm_mul_ps( r2, _mm_set1_ps( 0.5f ) ) );
+			_mm_storeu_ps( pSinOut + i, _mm_add_ps( _mm_mul_ps( sinA, cosR ), _mm_mul_ps( cosA, sinR ) ) );
+			_mm_storeu_ps( pCosOut + i, _mm_sub_ps( _mm_mul_ps( cosA, cosR ), _mm_mul_ps( sinA, sinR ) ) );
+		}
+#endif
+
+		for( ; i < count; i++ )
+			FastSinCos( pAngles[i], pSinOut[i], pCosOut[i] );
+	}
+
+	void FastAtan2( const float* pY, const float* pX, float* pAnglesOut, int count )
+	{
+		int i = 0;
+
+#ifdef PLAY_SIMD_SSE2
+		const __m128 signBit = _mm_set1_ps( -0.0f );
+		const __m128 halfPi = _mm_set1_ps( PLAY_PI * 0.5f );
+		const __m128 pi = _mm_set1_ps( PLAY_PI );
+
+		for( ; i + 4 <= count; i += 4 )
+		{
+			__m128 y = _mm_loadu_ps( pY + i );
+			__m128 x = _mm_loadu_ps( pX + i );
+			__m128 ax = _mm_andnot_ps( signBit, x );
+			__m128 ay = _mm_andnot_ps( signBit, y );
+			__m128 big = _mm_max_ps( ax, ay );
+			// Lanes where x and y are both zero would divide 0 by 0, so they're masked back to 0
+			__m128 t = _mm_and_ps( _mm_div_ps( _mm_min_ps( ax, ay ), big ), _mm_cmpgt_ps( big, _mm_setzero_ps() ) );
+			__m128 t2 = _mm_mul_ps( t, t );
+			__m128 poly = _mm_set1_ps( ATAN_COEFFICIENTS[7] );
+			for( int c = 6; c >= 0; c-- )
+				poly = _mm_add_ps( _mm_mul_ps( poly, t2 ), _mm_set1_ps( ATAN_COEFFICIENTS[c] ) );
+			__m128 angle = _mm_mul_ps( poly, t );
+
+			__m128 steep = _mm_cmpgt_ps( ay, ax );
+			angle = _mm_or_ps( _mm_and_ps( steep, _mm_sub_ps( halfPi, angle ) ), _mm_andnot_ps( steep, angle ) );
+			// Compare the sign bit itself so that -0 counts as negative, like std::signbit
+			__m128 negativeX = _mm_castsi128_ps( _mm_srai_epi32( _mm_castps_si128( x ), 31 ) );
+			angle = _mm_or_ps( _mm_and_ps( negativeX, _mm_sub_ps( pi, angle ) ), _mm_andnot_ps( negativeX, angle ) );
+			_mm_storeu_ps( pAnglesOut + i, _mm_or_ps( angle, _mm_and_ps( signBit, y ) ) );
+		}
+#endif
+
+		for( ; i < count; i++ )
+			pAnglesOut[i] = FastAtan2( pY[i], pX[i] );
+	}
+
+	// Returns the largest difference between an array and the exact values
+	static double MaxError( const std::vector<float>& vApprox, const std::vector<double>& vExact )
+	{
+		double maxError = 0.0;
+		for( size_t i = 0; i < vApprox.size(); i++ )
+			maxError = std::max( maxError, std::abs( vApprox[i] - vExact[i] ) );
+		return maxError;
+	}
+
+	// Times fn() in nanoseconds per element, taking the best of a few runs to ignore the odd interruption
+	static double TimeNsPerElement( int count, const std::function<void()>& fn )
+	{
+		double best = 1e30;
+		for( int run = 0; run < 5; run++ )
+		{
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min( best, elapsed.count() / count );
+		}
+		return best;
+	}
+
+	void BenchmarkFastTrig( int count )
+	{
+		// The same random angles and vectors every run
+		PlayRandom random( 1 );
+		std::vector<float> vAngles( count ), vX( count ), vY( count );
+		for( int i = 0; i < count; i++ )
+		{
+			vAngles[i] = ( random.NextFloat() * 2.0f - 1.0f ) * 1000.0f;
+			vX[i] = ( random.NextFloat() * 2.0f - 1.0f ) * 1000.0f;
+			vY[i] = ( random.NextFloat() * 2.0f - 1.0f ) * 1000.0f;
+		}
+
+		// The errors are measured against double precision, since the float versions of the standard functions are rounded too
+		std::vector<double> vExactSin( count ), vExactCos( count ), vExactAtan( count );
+		for( int i = 0; i < count; i++ )
+		{
+			vExactSin[i] = std::sin( static_cast<double>( vAngles[i] ) );
+			vExactCos[i] = std::cos( static_cast<double>( vAngles[i] ) );
+			vExactAtan[i] = std::atan2( static_cast<double>( vY[i] ), static_cast<double>( vX[i] ) );
+		}
+
+		std::vector<float> vSin( count ), vCos( count ), vAtan( count );
+		std::vector<float> vFastSin( count ), vFastCos( count ), vFastAtan( count );
+
+		double stdSinCos = TimeNsPerElement( count, [&]()
+		{
+			for( int i = 0; i < count; i++ )
+			{
+				vSin[i] = std::sin( vAngles[i] );
+				vCos[i] = std::cos( vAngles[i] );
+			}
+		} );
+		double stdSinCosError = std::max( MaxError( vSin, vExactSin ), MaxError( vCos, vExactCos ) );
+		double scalarSinCos = TimeNsPerElement( count, [&]()
+		{
+			for( int i = 0; i < count; i++ )
+				FastSinCos( vAngles[i], vFastSin[i], vFastCos[i] );
+		} );
+		double scalarSinCosError = std::max( MaxError( vFastSin, vExactSin ), MaxError( vFastCos, vExactCos ) );
+		double arraySinCos = TimeNsPerElement( count, [&]() { FastSinCos( vAngles.data(), vFastSin.data(), vFastCos.data(), count ); } );
+		double arraySinCosError = std::max( MaxError( vFastSin, vExactSin ), MaxError( vFastCos, vExactCos ) );
+
+		double stdAtan = TimeNsPerElement( count, [&]()
+		{
+			for( int i = 0; i < count; i++ )
+				vAtan[i] = std::atan2( vY[i], vX[i] );
+		} );
+		double stdAtanError = MaxError( vAtan, vExactAtan );
+		double scalarAtan = TimeNsPerElement( count, [&]()
+		{
+			for( int i = 0; i < count; i++ )
+				vFastAtan[i] = FastAtan2( vY[i], vX[i] );
+		} );
+		double scalarAtanError = MaxError( vFastAtan, vExactAtan );
+		double arrayAtan = TimeNsPerElement( count, [&]() { FastAtan2( vY.data(), vX.data(), vFastAtan.data(), count ); } );
+		double arrayAtanError = MaxError( vFastAtan, vExactAtan );
+
+		printf( "PlayBuffer: trig benchmark over %d values (ns per value, with the max error in brackets)\n", count );
+		printf( "  sin+cos  std %6.2f (%.2e)   FastSinCos %6.2f (%.2e)   array %6.2f (%.2e)\n", stdSinCos, stdSinCosError, scalarSinCos, scalarSinCosError, arraySinCos, arraySinCosError );
+		printf( "  atan2    std %6.2f (%.2e)   FastAtan2  %6.2f (%.2e)   array %6.2f (%.2e)\n", stdAtan, stdAtanError, scalarAtan, scalarAtanError, arrayAtan, arrayAtanError );
+	}
+}
+
+//********************************************************************************************************************************
+// File:		PlayProfiler.cpp
+// Description:	Times named, nested scopes on every thread for the F1 overlay and for exporting to a Chrome trace
+// Platform:	Independent
+//********************************************************************************************************************************
+
+thread_local PlayProfiler::ThreadBufferOwner PlayProfiler::s_threadBuffer;
+std::mutex PlayProfiler::s_mutex;
+std::vector<std::unique_ptr<PlayProfiler::ThreadBuffer>> PlayProfiler::s_vBuffers;
+std::set<std::string> PlayProfiler::s_internedNames;
+std::string PlayProfiler::s_exitExportFile;
+int PlayProfiler::s_nExitExportFrames = 0;
+
+PlayProfiler::ThreadBufferOwner::~ThreadBufferOwner()
+{
+	if( !pBuffer )
+		return;
+
+	std::lock_guard<std::mutex> lock( s_mutex );
+	pBuffer->bInUse = false;
+}
+
+PlayProfiler::ThreadBuffer& PlayProfiler::CreateThreadBuffer()
+{
+	std::lock_guard<std::mutex> lock( s_mutex );
+
+	// Threads come and go (e.g. render threads), so reuse a finished thread's buffer before making a new one
+	ThreadBuffer* pBuffer = nullptr;
+	for( std::unique_ptr<ThreadBuffer>& pFree : s_vBuffers )
+	{
+		if( !pFree->bInUse )
+		{
+			pBuffer = pFree.get();
+			break;
+		}
+	}
+	if( !pBuffer )
+	{
+		s_vBuffers.push_back( std::make_unique<ThreadBuffer>() );
+		pBuffer = s_vBuffers.back().get();
+	}
+
+	int threadIndex = PlayJobs::GetCallingThreadIndex();
+	if( threadIndex == 0 )
+		pBuffer->threadName = "Main";
+	else if( threadIndex > 0 )
+		pBuffer->threadName = "Worker " + std::to_string( threadIndex );
+	else
+		pBuffer->threadName = "Thread " + std::to_string( s_vBuffers.size() );
+
+	pBuffer->bInUse = true;
+	pBuffer->depth = 0;
+	s_threadBuffer.pBuffer = pBuffer;
+	return *pBuffer;
+}
+
+void PlayProfiler::SetThreadName( const char* name )
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock( s_mutex );
+	buffer.threadName = name;
+}
+
+const char* PlayProfiler::InternName( const std::string& name )
+{
+	std::lock_guard<std::mutex> lock( s_mutex );
+	return s_internedNames.insert( name ).first->c_str();
+}
+
+void PlayProfiler::CopyEvents( const ThreadBuffer& buffer, long long from, long long to, std::vector<ProfileEvent>& vEvents )
+{
+	long long count = buffer.writeCount.load( std::memory_order_acquire );
+
+	for( long long index = std::max( 0LL, count - BUFFER_SIZE ); index < count; index++ )
+	{
+		const ThreadBuffer::Slot& slot = buffer.pSlots[index & ( BUFFER_SIZE - 1 )];
+		long long sequence = slot.sequence.load( std::memory_order_acquire );
+		ProfileEvent event;
+		event.name = slot.name.load( std::memory_order_relaxed );
+		event.begin = slot.begin.load( std::memory_order_relaxed );
+		event.end = slot.end.load( std::memory_order_relaxed );
+		event.depth = slot.depth.load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
+
+		// The slot has moved on to a newer event since the write count was read
+		if( sequence != index * 2 + 2 || slot.sequence.load( std::memory_order_relaxed ) != sequence )
+			continue;
+
+		if( event.end >= from && event.begin <= to )
+			vEvents.push_back( event );
+	}
+}
+
+std::vector<ProfileEvent> PlayProfiler::FindFrames( int nFrames )
+{
+	std::vector<ProfileEvent> vFrames;
+	std::vector<ProfileEvent> vEvents;
+	CopyEvents( GetThreadBuffer(), LLONG_MIN, LLONG_MAX, vEvents );
+
+	for( auto it = vEvents.rbegin(); it != vEvents.rend() && static_cast<int>( vFrames.size() ) < nFrames; ++it )
+	{
+		if( strcmp( it->name, FRAME_SCOPE ) == 0 )
+			vFrames.push_back( *it );
+	}
+	return vFrames;
+}
+
+bool PlayProfiler::GetLastFrame( ProfileFrame& frame )
+{
+	frame.ms = 0.0;
+	frame.vLines.clear();
+	frame.vOtherThreadMs.clear();
+
+	std::vector<ProfileEvent> vFrames = FindFrames( 1 );
+	if( vFrames.empty() )
+		return false;
+
+	const ProfileEvent& last = vFrames[0];
+	frame.ms = ( last.end - last.begin ) / 1e6;
+
+	ThreadBuffer& ownBuffer = GetThreadBuffer();
+	std::vector<ProfileEvent> vEvents;
+	CopyEvents( ownBuffer, last.begin, last.end, vEvents );
+
+	// Parents start before their children, or at the same time but less deeply nested
+	std::sort( vEvents.begin(), vEvents.end(), []( const ProfileEvent& a, const ProfileEvent& b )
+	{
+		return a.begin != b.begin ? a.begin < b.begin : a.depth < b.depth;
+	} );
+
+	// A tree of the scopes inside the frame, merging repeated calls from the same parent
+	struct Node
+	{
+		const char* name;
+		long long ns;
+		int calls;
+		std::vector<int> vChildren;
+	};
+	std::vector<Node> vNodes{ { FRAME_SCOPE, 0, 1, {} } };
+	// The node at each level of nesting below the frame on the way to the current scope
+	std::vector<int> vPath{ 0 };
+
+	for( const ProfileEvent& event : vEvents )
+	{
+		int level = event.depth - last.depth;
+		if( level <= 0 || event.begin < last.begin || event.end > last.end || level > static_cast<int>( vPath.size() ) )
+			continue;
+
+		vPath.resize( level );
+		int parent = vPath.back();
+		int child = -1;
+		for( int i : vNodes[parent].vChildren )
+		{
+			if( vNodes[i].name == event.name || strcmp( vNodes[i].name, event.name ) == 0 )
+				child = i;
+		}
+		if( child < 0 )
+		{
+			child = static_cast<int>( vNodes.size() );
+			vNodes.push_back( { event.name, 0, 0, {} } );
+			vNodes[parent].vChildren.push_back( child );
+		}
+		vNodes[child].ns += event.end - event.begin;
+		vNodes[child].calls++;
+		vPath.push_back( child );
+	}
+
+	std::function<void( int, int )> addLines = [&]( int node, int depth )
+	{
+		for( int child : vNodes[node].vChildren )
+		{
+			frame.vLines.push_back( { vNodes[child].name, depth, vNodes[child].ns / 1e6, vNodes[child].calls } );
+			addLines( child, depth + 1 );
+		}
+	};
+	addLines( 0, 0 );
+
+	// The time the other threads spent in their outermost scopes, clipped to the frame
+	std::lock_guard<std::mutex> lock( s_mutex );
+	for( std::unique_ptr<ThreadBuffer>& pBuffer : s_vBuffers )
+	{
+		if( pBuffer.get() == &ownBuffer )
+			continue;
+
+		vEvents.clear();
+		CopyEvents( *pBuffer, last.begin, last.end, vEvents );
+		long long busy = 0;
+		for( const ProfileEvent& event : vEvents )
+		{
+			if( event.depth == 0 )
+				busy += std::min( event.end, last.end ) - std::max( event.begin, last.begin );
+		}
+		if( busy > 0 )
+			frame.vOtherThreadMs.push_back( { pBuffer->threadName, busy / 1e6 } );
+	}
+
+	return true;
+}
+
+// Writes a string into JSON with any quotes, backslashes and control characters escaped
+static void WriteJsonString( std::ofstream& file, const char* s )
+{
+	file << '"';
+	for( ; *s; s++ )
+	{
+		if( *s == '"' || *s == '\\' )
+			file << '\\' << *s;
+		else if( static_cast<unsigned char>( *s ) >= ' ' )
+			file << *s;
+	}
+	file << '"';
+}
+
+bool PlayProfiler::ExportChromeTrace( const char* filename, int nFrames )
+{
+	std::vector<ProfileEvent> vFrames = FindFrames( nFrames );
+	long long from = vFrames.empty() ? LLONG_MIN : vFrames.back().begin;
+	long long to = vFrames.empty() ? LLONG_MAX : vFrames.front().end;
+
+	std::ofstream file( filename );
+	if( !file )
+		return false;
+
+	std::lock_guard<std::mutex> lock( s_mutex );
+
+	// Timestamps are in microseconds, which the nanoseconds are rounded to
+	std::vector<std::vector<ProfileEvent>> vThreadEvents( s_vBuffers.size() );
+	long long start = LLONG_MAX;
+	for( size_t thread = 0; thread < s_vBuffers.size(); thread++ )
+	{
+		CopyEvents( *s_vBuffers[thread], from, to, vThreadEvents[thread] );
+		for( const ProfileEvent& event : vThreadEvents[thread] )
+			start = std::min( start, event.begin );
+	}
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool bFirst = true;
+	char number[64];
+	for( size_t thread = 0; thread < s_vBuffers.size(); thread++ )
+	{
+		file << ( bFirst ? "" : ",\n" ) << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":";
+		WriteJsonString( file, s_vBuffers[thread]->threadName.c_str() );
+		file << "}}";
+		bFirst = false;
+
+		for( const ProfileEvent& event : vThreadEvents[thread] )
+		{
+			file << ",\n{\"name\":";
+			WriteJsonString( file, event.name );
+			snprintf( number, sizeof( number ), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", ( event.begin - start ) / 1e3, ( event.end - event.begin ) / 1e3 );
+			file << number << ",\"pid\":1,\"tid\":" << thread << "}";
+		}
+	}
+	file << "\n]}\n";
+
+	return static_cast<bool>( file );
+}
+
+void PlayProfiler::ExportOnExit()
+{
+	if( s_exitExportFile.empty() )
+		return;
+
+	if( !ExportChromeTrace( s_exitExportFile.c_str(), s_nExitExportFrames ) )
+		PLAY_ASSERT_MSG( false, ( "Couldn't write the profile to " + s_exitExportFile ).c_str() );
+}
+
+//********************************************************************************************************************************
+// File:		PlayFramePacer.cpp
+// Description:	Holds the main loop to a steady frame rate without spinning the CPU while it waits
+// Platform:	Independent
+// Notes:		Sleeps on a high resolution timer, then spins for the last fraction of a millisecond
+//********************************************************************************************************************************
+
+// The spin margin adapts between these limits
+constexpr std::chrono::microseconds PACER_MIN_SPIN{ 200 };
+constexpr std::chrono::microseconds PACER_MAX_SPIN{ 4000 };
+
+PlayFramePacer::PlayFramePacer( int framesPerSecond )
+{
+#ifdef PLAY_PLATFORM_WINDOWS
+	// Only available from Windows 10 (1803) onwards, otherwise Sleep() is used with a 1ms timer resolution
+	m_hTimer = CreateWaitableTimerExW( nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS );
+	if( !m_hTimer )
+		timeBeginPeriod( 1 );
+	m_spinMargin = m_hTimer ? std::chrono::microseconds( 1000 ) : std::chrono::microseconds( 2000 );
+#else
+	m_spinMargin = std::chrono::microseconds( 1000 );
+#endif
+	SetFrameRate( framesPerSecond );
+	ResetStats();
+}
+
+PlayFramePacer::~PlayFramePacer()
+{
+#ifdef PLAY_PLATFORM_WINDOWS
+	if( m_hTimer )
+		CloseHandle( m_hTimer );
+	else
+		timeEndPeriod( 1 );
+#endif
+}
+
+void PlayFramePacer::SetFrameRate( int framesPerSecond )
+{
+	PLAY_ASSERT_MSG( framesPerSecond > 0, "The frame rate must be greater than zero" );
+	m_frameTime = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / framesPerSecond ) );
+}
+
+void PlayFramePacer::ResetStats()
+{
+	m_stats = FramePacingStats();
+	m_totalErrorMs = 0.0;
+	m_totalSpinMs = 0.0;
+	m_lastFrame = Clock::now();
+	m_nextFrame = m_lastFrame + m_frameTime;
+}
+
+double PlayFramePacer::WaitForNextFrame()
+{
+	Clock::time_point now = Clock::now();
+	Clock::time_point spinStart = now;
+
+	if( now >= m_nextFrame )
+	{
+		m_stats.lateFrames++;
+	}
+	else
+	{
+		if( m_nextFrame - now > m_spinMargin )
+		{
+			Clock::time_point wakeTime = m_nextFrame - m_spinMargin;
+			SleepUntil( wakeTime );
+			spinStart = Clock::now();
+
+			// Widen the margin straight away if the sleep overran, and narrow it slowly when it doesn't
+			Clock::duration overrun = spinStart - wakeTime;
+			if( overrun > m_spinMargin / 2 )
+				m_spinMargin = std::min<Clock::duration>( overrun * 2, PACER_MAX_SPIN );
+			else
+				m_spinMargin = std::max<Clock::duration>( m_spinMargin - m_spinMargin / 64, PACER_MIN_SPIN );
+		}
+
+		do
+		{
+			now = Clock::now();
+		} while( now < m_nextFrame );
+	}
+
+	double errorMs = std::chrono::duration<double, std::milli>( now - m_nextFrame ).count();
+	m_stats.frames++;
+	m_totalErrorMs += errorMs;
+	m_totalSpinMs += std::chrono::duration<double, std::milli>( now - spinStart ).count();
+	m_stats.maxErrorMs = std::max( m_stats.maxErrorMs, errorMs );
+	m_stats.meanErrorMs = m_totalErrorMs / m_stats.frames;
+	m_stats.meanSpinMs = m_totalSpinMs / m_stats.frames;
+
+	// Deadlines are kept on a fixed grid so small errors don't add up, unless a frame has overrun so far that catching up would mean a burst of short frames
+	m_nextFrame += m_frameTime;
+	if( m_nextFrame < now )
+		m_nextFrame = now + m_frameTime;
+
+	double elapsed = std::chrono::duration<double>( now - m_lastFrame ).count();
+	m_lastFrame = now;
+	return elapsed;
+}
+
+void PlayFramePacer::SleepUntil( Clock::time_point wakeTime )
+{
+#if defined( PLAY_PLATFORM_WINDOWS )
+	if( m_hTimer )
+	{
+		// Negative due times are relative, in 100ns units
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10000000>>>( wakeTime - Clock::now() ).count();
+		if( dueTime.QuadPart < 0 && SetWaitableTimer( m_hTimer, &dueTime, 0, nullptr, nullptr, FALSE ) )
+		{
+			WaitForSingleObject( m_hTimer, INFINITE );
+			return;
+		}
+	}
+
+	long long ms = std::chrono::duration_cast<std::chrono::milliseconds>( wakeTime - Clock::now() ).count();
+	if( ms > 0 )
+		Sleep( static_cast<DWORD>( ms ) );
+#elif defined( __linux__ )
+	// steady_clock is CLOCK_MONOTONIC, so the deadline can be used directly as an absolute wake up time
+	std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>( wakeTime.time_since_epoch() );
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>( ns.count() / 1000000000 );
+	ts.tv_nsec = static_cast<long>( ns.count() % 1000000000 );
+	while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr ) == EINTR ) {}
+#else
+	std::this_thread::sleep_until( wakeTime );
+#endif
+}
+
+void FrameTimeHistory::Add( float ms )
+{
+	m_ms[m_next] = ms;
+	m_next = ( m_next + 1 ) % FRAME_TIME_HISTORY;
+	m_total++;
+}
+
+FrameTimeStats FrameTimeHistory::GetStats( double budgetMs ) const
+{
+	FrameTimeStats stats;
+	stats.frames = GetCount();
+	stats.budgetMs = budgetMs;
+	if( stats.frames == 0 )
+		return stats;
+
+	std::vector<float> vSorted( m_ms, m_ms + stats.frames );
+	std::sort( vSorted.begin(), vSorted.end() );
+
+	// Nearest rank, so every percentile is a frame time which actually happened
+	auto percentile = [&vSorted]( double p ) { return vSorted[static_cast<size_t>( std::ceil( p * vSorted.size() ) ) - 1]; };
+	stats.p50Ms = percentile( 0.50 );
+	stats.p95Ms = percentile( 0.95 );
+	stats.p99Ms = percentile( 0.99 );
+	stats.maxMs = vSorted.back();
+
+	// Counted down from the top, as the sorted times are already to hand
+	for( auto it = vSorted.rbegin(); it != vSorted.rend() && *it > budgetMs + FRAME_HITCH_MARGIN_MS; ++it )
+	{
+		stats.hitches++;
+		stats.bigHitches += ( *it > 2.0 * budgetMs );
+	}
+	return stats;
+}
+
+bool FrameTimeHistory::ExportCsv( const char* filename, double budgetMs ) const
+{
+	FILE* pFile = fopen( filename, "w" );
+	if( !pFile )
+		return false;
+
+	fprintf( pFile, "frame,ms,hitch\n" );
+	int count = GetCount();
+	long long firstFrame = m_total - count;
+	for( int i = 0; i < count; i++ )
+		fprintf( pFile, "%lld,%.3f,%d\n", firstFrame + i, Get( i ), Get( i ) > budgetMs + FRAME_HITCH_MARGIN_MS ? 1 : 0 );
+
+	return fclose( pFile ) == 0;
+}
+
+#ifdef PLAY_PLATFORM_HEADLESS
+//********************************************************************************************************************************
+// File:		PlayPNG.cpp
+// Description:	A portable PNG decoder for platforms without GDI+
+// Platform:	Independent
+// Notes:		Handles every colour type and bit depth, but not interlaced images
+//********************************************************************************************************************************
+
+// Decodes PNG files into 32-bit ARGB pixel data
+class PlayPNG
+{
+public:
+	// Reads the width and height from the PNG header
+	// > Returns 1 on success or a negative error code
+	static int ReadSize( const std::string& fileAndPath, int& width, int& height );
+	// Decodes a PNG file, allocating the pixels in the destination image
+	// > Returns 1 on success or a negative error code
+	static int Load( const std::string& fileAndPath, PixelData& destImage );
+
+	static constexpr int ERROR_FILE = -1;
+	static constexpr int ERROR_NOT_PNG = -2;
+	static constexpr int ERROR_UNSUPPORTED = -3;
+	static constexpr int ERROR_CORRUPT = -4;
+
+private:
+	// Reads bits from a DEFLATE stream, least significant bit first
+	struct BitReader
+	{
+		const uint8_t* pData{ nullptr };
+		size_t size{ 0 };
+		size_t pos{ 0 };
+		uint32_t bitBuffer{ 0 };
+		int bitCount{ 0 };
+		bool bOverrun{ false };
+
+		int GetBits( int n );
+	};
+
+	// A canonical Huffman code stored as the number of codes of each length followed by the symbols in code order
+	struct Huffman
+	{
+		uint16_t counts[16]{};
+		uint16_t symbols[288]{};
+	};
+
+	static bool ReadFile( const std::string& fileAndPath, std::vector<uint8_t>& data );
+	static uint32_t ReadBigEndian( const uint8_t* p ) { return ( p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) | p[3]; }
+	static void BuildHuffman( Huffman& h, const uint8_t* lengths, int n );
+	static int DecodeSymbol( BitReader& br, const Huffman& h );
+	static bool InflateBlock( BitReader& br, const Huffman& literals, const Huffman& distances, std::vector<uint8_t>& dest );
+	// Decompresses a zlib stream
+	static bool Inflate( const std::vector<uint8_t>& src, std::vector<uint8_t>& dest );
+};
+
+int PlayPNG::BitReader::GetBits( int n )
+{
+	while( bitCount < n )
+	{
+		if( pos >= size )
+		{
+			bOverrun = true;
+			return 0;
+		}
+		bitBuffer |= static_cast<uint32_t>( pData[pos++] ) << bitCount;
+		bitCount += 8;
+	}
+
+	int value = static_cast<int>( bitBuffer & ( ( 1u << n ) - 1 ) );
+	bitBuffer >>= n;
+	bitCount -= n;
+	return value;
+}
+
+bool PlayPNG::ReadFile( const std::string& fileAndPath, std::vector<uint8_t>& data )
+{
+	std::ifstream file( fileAndPath, std::ios::binary | std::ios::ate );
+	if( !file )
+		return false;
+
+	data.resize( static_cast<size_t>( file.tellg() ) );
+	file.seekg( 0 );
+	return static_cast<bool>( file.read( reinterpret_cast<char*>( data.data() ), data.size() ) );
+}
+
+void PlayPNG::BuildHuffman( Huffman& h, const uint8_t* lengths, int n )
+{
+	uint16_t offsets[16]{};
+
+	for( int len = 0; len < 16; len++ )
+		h.counts[len] = 0;
+	for( int i = 0; i < n; i++ )
+		h.counts[lengths[i]]++;
+	h.counts[0] = 0;
+
+	for( int len = 1; len < 15; len++ )
+		offsets[len + 1] = offsets[len] + h.counts[len];
+
+	for( int i = 0; i < n; i++ )
+	{
+		if( lengths[i] )
+			h.symbols[offsets[lengths[i]]++] = static_cast<uint16_t>( i );
+	}
+}
+
+int PlayPNG::DecodeSymbol( BitReader& br, const Huffman& h )
+{
+	// Canonical codes of each length follow on from the codes of the previous length
+	int code = 0;
+	int first = 0;
+	int index = 0;
+
+	for( int len = 1; len < 16; len++ )
+	{
+		code |= br.GetBits( 1 );
+		int count = h.counts[len];
+
+		if( code - count < first )
+			return h.symbols[index + ( code - first )];
+
+		index += count;
+		first = ( first + count ) << 1;
+		code <<= 1;
+
+		if( br.bOverrun )
+			break;
+	}
+
+	return -1;
+}
+
+bool PlayPNG::InflateBlock( BitReader& br, const Huffman& literals, const Huffman& distances, std::vector<uint8_t>& dest )
+{
+	static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	while( !br.bOverrun )
+	{
+		int symbol = DecodeSymbol( br, literals );
+
+		if( symbol < 0 )
+			return false;
+
+		if( symbol < 256 )
+		{
+			dest.push_back( static_cast<uint8_t>( symbol ) );
+			continue;
+		}
+
+		if( symbol == 256 )
+			return true;
+
+		symbol -= 257;
+		if( symbol >= 29 )
+			return false;
+
+		int length = lengthBase[symbol] + br.GetBits( lengthExtra[symbol] );
+
+		int distanceSymbol = DecodeSymbol( br, distances );
+		if( distanceSymbol < 0 || distanceSymbol >= 30 )
+			return false;
+
+		size_t distance = distanceBase[distanceSymbol] + br.GetBits( distanceExtra[distanceSymbol] );
+		if( distance > dest.size() )
+			return false;
+
+		// The copy can overlap the bytes it is writing, so it has to go a byte at a time
+		size_t from = dest.size() - distance;
+		for( int i = 0; i < length; i++ )
+			dest.push_back( dest[from + i] );
+	}
+
+	return false;
+}
+
+bool PlayPNG::Inflate( const std::vector<uint8_t>& src, std::vector<uint8_t>& dest )
+{
+	// The zlib header: DEFLATE compression with no preset dictionary
+	if( src.size() < 2 || ( src[0] & 0x0F ) != 8 || ( ( src[0] << 8 ) | src[1] ) % 31 != 0 || ( src[1] & 0x20 ) )
+		return false;
+
+	BitReader br;
+	br.pData = src.data() + 2;
+	br.size = src.size() - 2;
+
+	int lastBlock = 0;
+	do
+	{
+		lastBlock = br.GetBits( 1 );
+		int blockType = br.GetBits( 2 );
+
+		if( blockType == 0 )
+		{
+			// Stored blocks start on a byte boundary, and only whole bytes are ever read into the bit buffer
+			br.bitBuffer = 0;
+			br.bitCount = 0;
+
+			if( br.pos + 4 > br.size )
+				return false;
+
+			size_t length = br.pData[br.pos] | ( br.pData[br.pos + 1] << 8 );
+			size_t check = br.pData[br.pos + 2] | ( br.pData[br.pos + 3] << 8 );
+			br.pos += 4;
+
+			if( length != ( ~check & 0xFFFF ) || br.pos + length > br.size )
+				return false;
+
+			dest.insert( dest.end(), br.pData + br.pos, br.pData + br.pos + length );
+			br.pos += length;
+		}
+		else if( blockType == 1 )
+		{
+			// Built by the first block which needs them, safely even when contexts on other threads are loading images too
+			static const std::pair<Huffman, Huffman> fixed = []()
+			{
+				std::pair<Huffman, Huffman> tables;
+				uint8_t lengths[288];
+				for( int i = 0; i < 288; i++ )
+					lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+				BuildHuffman( tables.first, lengths, 288 );
+
+				for( int i = 0; i < 30; i++ )
+					lengths[i] = 5;
+				BuildHuffman( tables.second, lengths, 30 );
+
+				return tables;
+			}();
+
+			if( !InflateBlock( br, fixed.first, fixed.second, dest ) )
+				return false;
+		}
+		else if( blockType == 2 )
+		{
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			int nLiterals = br.GetBits( 5 ) + 257;
+			int nDistances = br.GetBits( 5 ) + 1;
+			int nCodeLengths = br.GetBits( 4 ) + 4;
+
+			if( nLiterals > 286 || nDistances > 30 )
+				return false;
+
+			uint8_t lengths[286 + 30]{};
+			for( int i = 0; i < nCodeLengths; i++ )
+				lengths[order[i]] = static_cast<uint8_t>( br.GetBits( 3 ) );
+
+			Huffman codeLengths;
+			BuildHuffman( codeLengths, lengths, 19 );
+
+			// The literal and distance code lengths are themselves Huffman coded, with run lengths for repeats
+			int index = 0;
+			while( index < nLiterals + nDistances )
+			{
+				int symbol = DecodeSymbol( br, codeLengths );
+				if( symbol < 0 )
+					return false;
+
+				if( symbol < 16 )
+				{
+					lengths[index++] = static_cast<uint8_t>( symbol );
+					continue;
+				}
+
+				uint8_t value = 0;
+				int repeat = 0;
+
+				if( symbol == 16 )
+				{
+					if( index == 0 )
+						return false;
+					value = lengths[index - 1];
+					repeat = 3 + br.GetBits( 2 );
+				}
+				else if( symbol == 17 )
+				{
+					repeat = 3 + br.GetBits( 3 );
+				}
+				else
+				{
+					repeat = 11 + br.GetBits( 7 );
+				}
+
+				if( index + repeat > nLiterals + nDistances )
+					return false;
+
+				while( repeat-- )
+					lengths[index++] = value;
+			}
+
+			Huffman literals, distances;
+			BuildHuffman( literals, lengths, nLiterals );
+			BuildHuffman( distances, lengths + nLiterals, nDistances );
+
+			if( !InflateBlock( br, literals, distances, dest ) )
+				return false;
+		}
+		else
+		{
+			return false;
+		}
+
+	} while( !lastBlock && !br.bOverrun );
+
+	return !br.bOverrun;
+}
+
+int PlayPNG::ReadSize( const std::string& fileAndPath, int& width, int& height )
+{
+	uint8_t header[24];
+	std::ifstream file( fileAndPath, std::ios::binary );
+
+	if( !file )
+		return ERROR_FILE;
+
+	// The IHDR chunk always comes first, straight after the signature
+	if( !file.read( reinterpret_cast<char*>( header ), sizeof( header ) ) || memcmp( header, "\x89PNG\r\n\x1A\n", 8 ) != 0 || memcmp( header + 12, "IHDR", 4 ) != 0 )
+		return ERROR_NOT_PNG;
+
+	width = static_cast<int>( ReadBigEndian( header + 16 ) );
+	height = static_cast<int>( ReadBigEndian( header + 20 ) );
+	return 1;
+}
+
+int PlayPNG::Load( const std::string& fileAndPath, PixelData& destImage )
+{
+	std::vector<uint8_t> file;
+	if( !ReadFile( fileAndPath, file ) )
+		return ERROR_FILE;
+
+	if( file.size() < 8 || memcmp( file.data(), "\x89PNG\r\n\x1A\n", 8 ) != 0 )
+		return ERROR_NOT_PNG;
+
+	int width = 0, height = 0, bitDepth = 0, colourType = 0, interlace = 0;
+	std::vector<Pixel> palette;
+	std::vector<uint8_t> compressed;
+	int transparentKey[3]{ -1, -1, -1 }; // tRNS colour for greyscale and RGB images
+
+	// Read the chunks we're interested in and skip over the rest
+	size_t pos = 8;
+	while( pos + 12 <= file.size() )
+	{
+		size_t length = ReadBigEndian( &file[pos] );
+		const uint8_t* pType = &file[pos + 4];
+		const uint8_t* pChunk = &file[pos + 8];
+
+		if( length > file.size() - pos - 12 )
+			return ERROR_CORRUPT;
+
+		if( memcmp( pType, "IHDR", 4 ) == 0 && length >= 13 )
+		{
+			width = static_cast<int>( ReadBigEndian( pChunk ) );
+			height = static_cast<int>( ReadBigEndian( pChunk + 4 ) );
+			bitDepth = pChunk[8];
+			colourType = pChunk[9];
+			interlace = pChunk[12];
+		}
+		else if( memcmp( pType, "PLTE", 4 ) == 0 )
+		{
+			for( size_t i = 0; i + 2 < length; i += 3 )
+				palette.push_back( Pixel( pChunk[i], pChunk[i + 1], pChunk[i + 2] ) );
+		}
+		else if( memcmp( pType, "tRNS", 4 ) == 0 )
+		{
+			if( colourType == 3 )
+			{
+				for( size_t i = 0; i < length && i < palette.size(); i++ )
+					palette[i].a = pChunk[i];
+			}
+			else
+			{
+				for( size_t i = 0; i < 3 && i * 2 + 1 < length; i++ )
+					transparentKey[i] = ( pChunk[i * 2] << 8 ) | pChunk[i * 2 + 1];
+			}
+		}
+		else if( memcmp( pType, "IDAT", 4 ) == 0 )
+		{
+			compressed.insert( compressed.end(), pChunk, pChunk + length );
+		}
+		else if( memcmp( pType, "IEND", 4 ) == 0 )
+		{
+			break;
+		}
+
+		pos += length + 12; // Length, type and CRC
+	}
+
+	int channels = 0;
+	switch( colourType )
+	{
+		case 0: channels = 1; break; // Greyscale
+		case 2: channels = 3; break; // RGB
+		case 3: channels = 1; break; // Palette
+		case 4: channels = 2; break; // Greyscale and alpha
+		case 6: channels = 4; break; // RGBA
+		default: return ERROR_UNSUPPORTED;
+	}
+
+	if( width <= 0 || height <= 0 || interlace != 0 || ( bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 && bitDepth != 16 ) )
+		return ERROR_UNSUPPORTED;
+
+	if( colourType == 3 && palette.empty() )
+		return ERROR_CORRUPT;
+
+	size_t stride = ( static_cast<size_t>( width ) * channels * bitDepth + 7 ) / 8;
+	size_t filterStep = std::max<size_t>( 1, channels * bitDepth / 8 ); // Bytes per pixel, rounded up to one
+
+	std::vector<uint8_t> raw;
+	raw.reserve( ( stride + 1 ) * height );
+	if( !Inflate( compressed, raw ) || raw.size() < ( stride + 1 ) * height )
+		return ERROR_CORRUPT;
+
+	// Undo the filter on each row, in place, using the row above which has already been unfiltered
+	std::vector<uint8_t> zeroRow( stride, 0 );
+	for( int y = 0; y < height; y++ )
+	{
+		uint8_t filter = raw[y * ( stride + 1 )];
+		uint8_t* pRow = &raw[y * ( stride + 1 ) + 1];
+		const uint8_t* pPrior = y > 0 ? pRow - ( stride + 1 ) : zeroRow.data();
+
+		for( size_t i = 0; i < stride; i++ )
+		{
+			int left = i >= filterStep ? pRow[i - filterStep] : 0;
+			int up = pPrior[i];
+			int upLeft = i >= filterStep ? pPrior[i - filterStep] : 0;
+
+			switch( filter )
+			{
+				case 0: break;
+				case 1: pRow[i] = static_cast<uint8_t>( pRow[i] + left ); break;
+				case 2: pRow[i] = static_cast<uint8_t>( pRow[i] + up ); break;
+				case 3: pRow[i] = static_cast<uint8_t>( pRow[i] + ( ( left + up ) >> 1 ) ); break;
+				case 4:
+				{
+					int p = left + up - upLeft;
+					int pa = abs( p - left ), pb = abs( p - up ), pc = abs( p - upLeft );
+					int predictor = ( pa <= pb && pa <= pc ) ? left : ( pb <= pc ) ? up : upLeft;
+					pRow[i] = static_cast<uint8_t>( pRow[i] + predictor );
+					break;
+				}
+				default: return ERROR_CORRUPT;
+			}
+		}
+	}
+
+	destImage.width = width;
+	destImage.height = height;
+	destImage.pPixels = new Pixel[static_cast<size_t>( width ) * height];
+
+	int maxValue = ( 1 << bitDepth ) - 1;
+	Pixel* pDest = destImage.pPixels;
+
+	for( int y = 0; y < height; y++ )
+	{
+		const uint8_t* pRow = &raw[y * ( stride + 1 ) + 1];
+
+		// Gets a sample at its full bit depth
+		auto sample = [&]( int index ) -> int
+		{
+			if( bitDepth == 8 )
+				return pRow[index];
+			if( bitDepth == 16 )
+				return ( pRow[index * 2] << 8 ) | pRow[index * 2 + 1];
+
+			int bit = index * bitDepth;
+			return ( pRow[bit >> 3] >> ( 8 - bitDepth - ( bit & 7 ) ) ) & maxValue;
+		};
+
+		// Scales a sample to 8 bits
+		auto scale = [&]( int value ) -> int
+		{
+			return bitDepth == 16 ? value >> 8 : bitDepth == 8 ? value : value * 255 / maxValue;
+		};
+
+		for( int x = 0; x < width; x++ )
+		{
+			int i = x * channels;
+
+			switch( colourType )
+			{
+				case 0:
+				{
+					int grey = sample( i );
+					int alpha = grey == transparentKey[0] ? 0 : 0xFF;
+					*pDest++ = Pixel( alpha, scale( grey ), scale( grey ), scale( grey ) );
+					break;
+				}
+				case 2:
+				{
+					int r = sample( i ), g = sample( i + 1 ), b = sample( i + 2 );
+					int alpha = ( r == transparentKey[0] && g == transparentKey[1] && b == transparentKey[2] ) ? 0 : 0xFF;
+					*pDest++ = Pixel( alpha, scale( r ), scale( g ), scale( b ) );
+					break;
+				}
+				case 3:
+				{
+					size_t index = static_cast<size_t>( sample( i ) );
+					*pDest++ = index < palette.size() ? palette[index] : PIX_TRANS;
+					break;
+				}
+				case 4:
+				{
+					int grey = scale( sample( i ) );
+					*pDest++ = Pixel( scale( sample( i + 1 ) ), grey, grey, grey );
+					break;
+				}
+				case 6:
+					*pDest++ = Pixel( scale( sample( i + 3 ) ), scale( sample( i ) ), scale( sample( i + 1 ) ), scale( sample( i + 2 ) ) );
+					break;
+			}
+		}
+	}
+
+	return 1;
+}
+
+#endif
+
+//********************************************************************************************************************************
+// File:		PlayWindow.cpp
+// Description:	Platform specific code to provide a window to draw into
+// Platform:	Windows / Headless / X11
+// Notes:		Uses a 32-bit ARGB display buffer. The headless platform presents into an offscreen framebuffer instead,
+//				or into an X11 window when PLAY_PLATFORM_X11 is defined.
+//********************************************************************************************************************************
+
+#ifdef PLAY_PLATFORM_X11
+Display* PlayWindow::s_pDisplay = nullptr;
+bool PlayWindow::s_bDisplayTried = false;
+bool PlayWindow::s_bX11NoShm = false;
+std::vector<PlayWindow::X11Image*> PlayWindow::s_vDisplayImages;
+int PlayWindow::s_nWindows = 0;
+std::mutex PlayWindow::s_displayMutex;
+#endif
+
+// External functions which must be implemented by the user 
+extern void MainGameEntry( int argc, char* argv[] ); 
+extern bool MainGameUpdate( float ); // Called every frame
+extern int MainGameExit( void ); // Called on quit
+
+// The number of frames --play-profile writes out when the game exits
+constexpr int PROFILE_EXIT_FRAMES = 120;
+
+// Starts recording or replaying the input from the command line, before the game can use any random numbers
+// > Also handles the other options which have to be dealt with before MainGameEntry()
+static void HandleRecordingArgs( int argc, char* argv[] )
+{
+	for( int i = 1; i < argc; i++ )
+	{
+		std::string arg( argv[i] );
+
+		if( arg.rfind( "--play-record=", 0 ) == 0 )
+			Play::RecordInput( arg.substr( 14 ).c_str() );
+		else if( arg.rfind( "--play-replay=", 0 ) == 0 )
+			Play::ReplayInput( arg.substr( 14 ).c_str() );
+		else if( arg.rfind( "--play-profile=", 0 ) == 0 )
+			PlayProfiler::SetExitExport( arg.substr( 15 ).c_str(), PROFILE_EXIT_FRAMES );
+		else if( arg == "--play-metrics" || arg.rfind( "--play-metrics=", 0 ) == 0 )
+		{
+			const char* name = arg.size() > 15 ? arg.c_str() + 15 : "PlayMetrics";
+			bool bPublishing = Play::PublishMetrics( name );
+			PLAY_ASSERT_MSG( bPublishing, ( std::string( "Couldn't create the shared memory for --play-metrics: " ) + name ).c_str() );
+		}
+		else if( arg == "--play-benchmark-trig" )
+		{
+			Play::BenchmarkFastTrig();
+			exit( 0 );
+		}
+#ifdef PLAY_PLATFORM_X11
+		else if( arg == "--play-x11-no-shm" )
+			PlayWindow::DisableX11SharedMemory();
+#endif
+	}
+}
+
+#ifdef PLAY_PLATFORM_WINDOWS
+
+// Instruct Visual Studio to add these to the list of libraries to link
+#pragma comment(lib, "gdiplus.lib")
+#pragma comment(lib, "dwmapi.lib")
+
+ULONG_PTR g_pGDIToken = 0;
+
+int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd )
+{
+	// Initialize GDI+
+	Gdiplus::GdiplusStartupInput startupInput;
+	ULONG_PTR token;
+	Gdiplus::Status gdiStatus = Gdiplus::GdiplusStartup( &token, &startupInput, NULL );
+	PLAY_ASSERT( Gdiplus::Ok == gdiStatus );
+	g_pGDIToken = token;
+
+	HandleRecordingArgs( __argc, __argv );
+	MainGameEntry( __argc, __argv );
+
+	return PlayWindow::Instance().HandleWindows( hInstance, hPrevInstance, lpCmdLine, nShowCmd, L"PlayBuffer" );
+}
+
+#else
+
+int main( int argc, char* argv[] )
+{
+	HandleRecordingArgs( argc, argv );
+	MainGameEntry( argc, argv );
+
+#ifdef PLAY_PLATFORM_X11
+	return PlayWindow::Instance().HandleX11( argc, argv );
+#else
+	return PlayWindow::Instance().HandleHeadless( argc, argv );
+#endif
+}
+
+#endif
+
+//********************************************************************************************************************************
+// Constructor / Destructor (Private)
+//********************************************************************************************************************************
+
+PlayWindow::PlayWindow( PixelData* pDisplayBuffer, int nScale )
+{
+	PLAY_ASSERT( pDisplayBuffer );
+	PLAY_ASSERT( nScale > 0 );
+	m_pPlayBuffer = pDisplayBuffer;
+	m_width = pDisplayBuffer->width;
+	m_height = pDisplayBuffer->height;
+	m_scale = nScale;
+}
+
+void PlayWindow::StartFrame()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	// The first frame has nothing to be timed from
+	if( m_frameStart != std::chrono::steady_clock::time_point() )
+		m_frameTimes.Add( std::chrono::duration<float, std::milli>( now - m_frameStart ).count() );
+	m_frameStart = now;
+}
+
+PlayWindow::~PlayWindow( void )
+{
+	StopPresentThread();
+#ifdef PLAY_PLATFORM_X11
+	if( m_bPrintChecksum && m_xWindow )
+	{
+		std::lock_guard<std::mutex> lock( s_displayMutex );
+		if( !X11WindowMatchesFramebuffer() )
+			printf( "PlayBuffer: the window doesn't show the last frame presented\n" );
+	}
+#endif
+#ifdef PLAY_PLATFORM_HEADLESS
+	if( m_bPrintChecksum )
+	{
+		// FNV-1a over the last frame presented, to compare runs of the same replay
+		uint64_t checksum = 14695981039346656037ull;
+		for( Pixel pixel : m_vFramebuffer )
+		{
+			checksum ^= pixel.bits;
+			checksum *= 1099511628211ull;
+		}
+		printf( "PlayBuffer: framebuffer checksum %016llx\n", static_cast<unsigned long long>( checksum ) );
+	}
+#endif
+#ifdef PLAY_PLATFORM_X11
+	std::lock_guard<std::mutex> lock( s_displayMutex );
+	if( m_pScaledImage )
+		DestroyX11Image( m_pScaledImage );
+	if( m_gc )
+		XFreeGC( s_pDisplay, m_gc );
+	if( m_xWindow )
+	{
+		XDestroyWindow( s_pDisplay, m_xWindow );
+		s_nWindows--;
+	}
+	m_xWindow = 0;
+	CloseX11Display();
+#endif
+}
+
+//********************************************************************************************************************************
+// Instance functions
+//********************************************************************************************************************************
+
+PlayWindow& PlayWindow::Instance()
+{
+	PlayWindow* pInstance = Play::Context::Current().pWindow;
+	if( !pInstance )
+		PLAY_ASSERT_MSG( false, "Trying to use PlayBuffer without initialising it!" );
+
+	return *pInstance;
+}
+
+PlayWindow& PlayWindow::Instance( PixelData* pDisplayBuffer, int nScale )
+{
+	PlayWindow*& pInstance = Play::Context::Current().pWindow;
+	PLAY_ASSERT_MSG( !pInstance, "Trying to create multiple instances of singleton class!" );
+	pInstance = new PlayWindow( pDisplayBuffer, nScale );
+	return *pInstance;
+}
+
+void PlayWindow::Destroy()
+{
+	PlayWindow*& pInstance = Play::Context::Current().pWindow;
+	PLAY_ASSERT_MSG( pInstance, "Trying to use destroy PlayBuffer which hasn't been instanced!" );
+	delete pInstance;
+	pInstance = nullptr;
+}
+
+//********************************************************************************************************************************
+// Timing functions
+//********************************************************************************************************************************
+
+bool PlayWindow::RunFixedTicks( double elapsedSeconds )
+{
+	double tickTime = 1.0 / m_tickRate;
+	m_tickAccumulator += elapsedSeconds;
+
+	int nTicks = static_cast<int>( m_tickAccumulator / tickTime );
+	if( nTicks > MAX_TICKS_PER_FRAME )
+	{
+		// Better for the game to slow down than to fall further and further behind
+		nTicks = MAX_TICKS_PER_FRAME;
+		m_tickAccumulator = nTicks * tickTime;
+	}
+
+	m_tickAccumulator -= nTicks * tickTime;
+	m_interpolation = static_cast<float>( m_tickAccumulator / tickTime );
+
+	bool quit = false;
+	m_bInFixedTick = true;
+
+	for( int i = 0; i < nTicks && !quit; i++ )
+	{
+		// Only the last tick gets drawn, the earlier ones would just be overwritten
+		m_bDrawingTick = ( i == nTicks - 1 );
+		m_tickCount++;
+		PLAY_PROFILE_SCOPE( "Tick" );
+		quit = MainGameUpdate( static_cast<float>( tickTime ) );
+	}
+
+	m_bInFixedTick = false;
+	m_bDrawingTick = true;
+
+	// No tick this frame so redraw the last one further along
+	if( nTicks == 0 && m_pRedraw )
+		m_pRedraw();
+
+	return quit;
+}
+
+void PlayWindow::SetTickRate( int ticksPerSecond )
+{
+	PLAY_ASSERT_MSG( ticksPerSecond >= 0, "The tick rate can't be negative" );
+	m_tickRate = ticksPerSecond;
+	m_tickAccumulator = 0.0;
+	m_interpolation = 1.0f;
+}
+
+void PresentHistogram::Add( double ms )
+{
+	int bucket = 0;
+	while( bucket < BUCKETS - 1 && ms > BucketLimitMs( bucket ) )
+		bucket++;
+
+	counts[bucket]++;
+	presents++;
+	totalMs += ms;
+	maxMs = std::max( maxMs, ms );
+}
+
+//********************************************************************************************************************************
+// Display buffer functions
+//********************************************************************************************************************************
+
+PresentHistogram PlayWindow::GetPresentHistogram() const
+{
+	std::lock_guard<std::mutex> lock( m_presentMutex );
+	return m_presentHistogram;
+}
+
+Pixel* PlayWindow::CreateDisplayPixels( int width, int height )
+{
+#ifdef PLAY_PLATFORM_X11
+	std::lock_guard<std::mutex> lock( s_displayMutex );
+	if( OpenX11Display() )
+	{
+		X11Image* pImage = CreateX11Image( width, height );
+		s_vDisplayImages.push_back( pImage );
+		return reinterpret_cast<Pixel*>( pImage->pImage->data );
+	}
+#endif
+	return new Pixel[static_cast<size_t>( width ) * height];
+}
+
+void PlayWindow::DestroyDisplayPixels( Pixel* pPixels )
+{
+#ifdef PLAY_PLATFORM_X11
+	std::lock_guard<std::mutex> lock( s_displayMutex );
+	for( std::vector<X11Image*>::iterator it = s_vDisplayImages.begin(); it != s_vDisplayImages.end(); it++ )
+	{
+		if( reinterpret_cast<Pixel*>( ( *it )->pImage->data ) == pPixels )
+		{
+			DestroyX11Image( *it );
+			s_vDisplayImages.erase( it );
+			CloseX11Display();
+			return;
+		}
+	}
+#endif
+	delete[] pPixels;
+}
+
+void PlayWindow::SetUpscaleBands( int bands )
+{
+	PLAY_ASSERT_MSG( bands > 0, "There must be at least one band to upscale" );
+	m_upscaleBands = bands;
+}
+
+void PlayWindow::Upscale( const PixelData& frame, Pixel* pDest )
+{
+	PixelData dest{ m_width * m_scale, m_height * m_scale, pDest };
+	PlayBlitter blitter( &dest );
+
+	// Frames drawn at a reduced resolution don't fit a whole number of times so are resampled instead
+	bool bWholeScale = frame.width * m_scale == dest.width && frame.height * m_scale == dest.height;
+	int rows = bWholeScale ? frame.height : dest.height;
+
+	int bands = std::min( m_upscaleBands, rows );
+	PlayJobs::Instance().ParallelFor( bands, [&]( int band )
+	{
+		if( bWholeScale )
+			blitter.UpscalePixels( frame, m_scale, rows * band / bands, rows * ( band + 1 ) / bands );
+		else
+			blitter.ResamplePixels( frame, rows * band / bands, rows * ( band + 1 ) / bands );
+	} );
+}
+
+double PlayWindow::Present( void )
+{
+	// Presents can't overlap, as they share the window
+	FlushPresents();
+
+	double elapsedTime = PresentPixels( *m_pPlayBuffer );
+
+	std::lock_guard<std::mutex> lock( m_presentMutex );
+	m_presentHistogram.Add( elapsedTime );
+
+	return elapsedTime;
+}
+
+//********************************************************************************************************************************
+// Present thread functions
+//********************************************************************************************************************************
+
+void PlayWindow::SetPresentQueueDepth( int depth )
+{
+	PLAY_ASSERT_MSG( depth >= 0 && depth <= MAX_PRESENT_QUEUE_DEPTH, "The present queue depth must be between 0 and MAX_PRESENT_QUEUE_DEPTH" );
+
+	StopPresentThread();
+	m_presentQueueDepth = depth;
+
+	if( depth > 0 )
+	{
+		m_bStopPresentThread = false;
+		m_presentThread = std::thread( &PlayWindow::PresentThread, this );
+	}
+}
+
+void PlayWindow::QueuePresent( const PixelData& frame )
+{
+	PLAY_ASSERT_MSG( m_presentQueueDepth > 0, "Frames can only be queued once SetPresentQueueDepth() has started the present thread" );
+
+	std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock( m_presentMutex );
+
+	// Making room now means the buffer drawn into next has already been presented
+	m_presentCondition.wait( lock, [this]() { return m_presentsInFlight < m_presentQueueDepth; } );
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double waitMs = std::chrono::duration<double, std::milli>( now - before ).count();
+
+	m_presentQueue.push_back( { frame, now } );
+	m_presentsInFlight++;
+
+	m_presentQueueStats.queued++;
+	m_totalWaitMs += waitMs;
+	m_presentQueueStats.meanWaitMs = m_totalWaitMs / m_presentQueueStats.queued;
+	m_presentQueueStats.maxWaitMs = std::max( m_presentQueueStats.maxWaitMs, waitMs );
+
+	lock.unlock();
+	m_presentCondition.notify_all();
+}
+
+void PlayWindow::FlushPresents()
+{
+	std::unique_lock<std::mutex> lock( m_presentMutex );
+	m_presentCondition.wait( lock, [this]() { return m_presentsInFlight == 0; } );
+}
+
+PresentQueueStats PlayWindow::GetPresentQueueStats() const
+{
+	std::lock_guard<std::mutex> lock( m_presentMutex );
+	return m_presentQueueStats;
+}
+
+void PlayWindow::PresentThread()
+{
+	PlayProfiler::SetThreadName( "Present" );
+	std::unique_lock<std::mutex> lock( m_presentMutex );
+
+	for( ;; )
+	{
+		m_presentCondition.wait( lock, [this]() { return !m_presentQueue.empty() || m_bStopPresentThread; } );
+
+		// Only stops once everything queued has been presented
+		if( m_presentQueue.empty() )
+			break;
+
+		QueuedPresent present = m_presentQueue.front();
+		m_presentQueue.pop_front();
+		lock.unlock();
+
+		double elapsedTime = PresentPixels( present.frame );
+#ifdef PLAY_PLATFORM_WINDOWS
+		DwmFlush(); // Waits for DWM compositor to finish, here rather than on the game thread
+#endif
+		double latencyMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - present.queueTime ).count();
+
+		lock.lock();
+		m_presentHistogram.Add( elapsedTime );
+		m_presentsInFlight--;
+		m_presentQueueStats.presented++;
+		m_totalLatencyMs += latencyMs;
+		m_presentQueueStats.meanLatencyMs = m_totalLatencyMs / m_presentQueueStats.presented;
+		m_presentQueueStats.maxLatencyMs = std::max( m_presentQueueStats.maxLatencyMs, latencyMs );
+		m_presentCondition.notify_all();
+	}
+}
+
+void PlayWindow::StopPresentThread()
+{
+	if( !m_presentThread.joinable() )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock( m_presentMutex );
+		m_bStopPresentThread = true;
+	}
+
+	m_presentCondition.notify_all();
+	m_presentThread.join();
+}
+
+#ifdef PLAY_PLATFORM_WINDOWS
+
+//********************************************************************************************************************************
+// Windows functions
+//********************************************************************************************************************************
+
+int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow, LPCWSTR windowName )
+{
+	UNREFERENCED_PARAMETER( hPrevInstance );
+	UNREFERENCED_PARAMETER( lpCmdLine );
+
+	WNDCLASSEXW wcex;
+
+	wcex.cbSize = sizeof( WNDCLASSEX );
+
+	wcex.style = CS_HREDRAW | CS_VREDRAW;
+	wcex.lpfnWndProc = PlayWindow::WndProc;
+	wcex.cbClsExtra = 0;
+	wcex.cbWndExtra = 0;
+	wcex.hInstance = hInstance;
+	wcex.hIcon = LoadIcon( hInstance, IDI_APPLICATION );
+	wcex.hCursor = LoadCursor( nullptr, IDC_ARROW );
+	wcex.hbrBackground = (HBRUSH)( COLOR_WINDOW + 1 );
+	wcex.lpszMenuName = nullptr;
+	wcex.lpszClassName = windowName;
+	wcex.hIconSm = LoadIcon( wcex.hInstance, IDI_APPLICATION );
+
+	RegisterClassExW( &wcex );
+
+	int	w = m_width * m_scale;
+	int h = m_height * m_scale;
+
+	UINT dwStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU;
+	RECT rect = { 0, 0, w, h }; 
+	AdjustWindowRect( &rect, dwStyle, FALSE );
+	HWND hWnd = CreateWindowW( windowName, windowName, dwStyle, CW_USEDEFAULT, CW_USEDEFAULT, rect.right - rect.left, rect.bottom - rect.top, nullptr, nullptr, hInstance, nullptr );
+
+	if( !hWnd )
+		return FALSE;
+
+	m_hWindow = hWnd;
+
+	ShowWindow( hWnd, nCmdShow );
+	UpdateWindow( hWnd );
+
+	HACCEL hAccelTable = LoadAccelerators( hInstance, windowName );
+
+	double elapsedTime = 0.0;
+
+	MSG msg{};
+	bool quit = false;
+	int frame = 0;
+
+	// Start timing the frames from here
+	m_pacer.ResetStats();
+
+	// Standard windows message loop
+	while( !quit )
+	{
+		// Hangle windows messages
+		if( PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE ) )
+		{
+			if( msg.message == WM_QUIT )
+				break;
+
+			if( !TranslateAccelerator( msg.hwnd, hAccelTable, &msg ) )
+			{
+				TranslateMessage( &msg );
+				DispatchMessage( &msg );
+			}
+		}
+
+		PlayInput::Instance().RunInputScript( frame++ );
+
+		// Sleep until the next frame is due
+		elapsedTime = m_pacer.WaitForNextFrame();
+		StartFrame();
+		elapsedTime = PlayInput::Instance().UpdateRecording( elapsedTime );
+
+		// Call the main game update function
+		PLAY_PROFILE_SCOPE( PlayProfiler::FRAME_SCOPE );
+		if( m_tickRate > 0 )
+			quit = RunFixedTicks( elapsedTime );
+		else
+			quit = MainGameUpdate( static_cast<float>( elapsedTime ) );
+
+		// Waits for DWM compositor to finish (the present thread does this itself)
+		if( m_presentQueueDepth == 0 )
+			DwmFlush();
+	}
+
+	PlayProfiler::ExportOnExit();
+
+	// Call the main game cleanup function
+	MainGameExit();
+
+	PLAY_ASSERT( g_pGDIToken );
+	Gdiplus::GdiplusShutdown( g_pGDIToken );
+
+	return static_cast<int>( msg.wParam );
+}
+
+LRESULT CALLBACK PlayWindow::WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
+{
+	// Messages are dispatched on the thread running the window, which has its context current
+	PlayWindow* pInstance = Play::Context::Current().pWindow;
+
+	switch( message )
+	{
+		case WM_PAINT:
+			PAINTSTRUCT ps;
+			BeginPaint( hWnd, &ps );
+			EndPaint( hWnd, &ps );
+			break;
+
+		case WM_DESTROY:
+			PostQuitMessage( 0 );
+			break;
+		case WM_LBUTTONDOWN:
+			if( pInstance->m_pMouseData )
+				pInstance->m_pMouseData->left = true;
+			break;
+		case WM_LBUTTONUP:
+			if( pInstance->m_pMouseData )
+				pInstance->m_pMouseData->left = false;
+			break;
+		case WM_RBUTTONDOWN:
+			if( pInstance->m_pMouseData )
+				pInstance->m_pMouseData->right = true;
+			break;
+		case WM_RBUTTONUP:
+			if( pInstance->m_pMouseData )
+				pInstance->m_pMouseData->right = false;
+			break;
+		case WM_MOUSEMOVE:
+			if( pInstance->m_pMouseData )
+			{
+				pInstance->m_pMouseData->pos.x = static_cast<float>( GET_X_LPARAM( lParam ) / pInstance->m_scale );
+				pInstance->m_pMouseData->pos.y = static_cast<float>( GET_Y_LPARAM( lParam ) / pInstance->m_scale );
+			}
+			break;
+		case WM_MOUSELEAVE:
+			pInstance->m_pMouseData->pos.x = -1;
+			pInstance->m_pMouseData->pos.y = -1;
+			break;
+		default:
+			return DefWindowProc( hWnd, message, wParam, lParam );
+	}
+	return 0;
+}
+
+double PlayWindow::PresentPixels( const PixelData& frame )
+{
+	PLAY_PROFILE_SCOPE( "PresentPixels" );
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER before;
+	LARGE_INTEGER after;
+	QueryPerformanceCounter( &before );
+	QueryPerformanceFrequency( &frequency );
+
+	// Set up a BitmapInfo structure to represent the pixel format of the display buffer
+	BITMAPINFOHEADER bitmap_info_header
+	{
+			sizeof( BITMAPINFOHEADER ),								// size of its own data,
+			frame.width, frame.height,		// width and height
+			1, 32, BI_RGB,				// planes must always be set to 1 (docs), 32-bit pixel data, uncompressed 
+			0, 0, 0, 0, 0				// rest can be set to 0 as this is uncompressed and has no palette
+	};
+
+	BITMAPINFO bitmap_info{ bitmap_info_header, { 0,0,0,0 } };	// No palette data required for this bitmap
+
+	int w = m_width * m_scale;
+	int h = m_height * m_scale;
+	const Pixel* pPixels = frame.pPixels;
+
+	// Scaled up here rather than by GDI, which is slower and can't be shared with the other platforms
+	if( frame.width != w || frame.height != h )
+	{
+		m_vScaledPixels.resize( static_cast<size_t>( w ) * h );
+		Upscale( frame, m_vScaledPixels.data() );
+		pPixels = m_vScaledPixels.data();
+		bitmap_info.bmiHeader.biWidth = w;
+		bitmap_info.bmiHeader.biHeight = h;
+	}
+
+	HDC hDC = GetDC( m_hWindow );
+
+	// Copy the display buffer to the window
+	StretchDIBits( hDC, 0, 0, w, h, 0, h + 1, w, -h, pPixels, &bitmap_info, DIB_RGB_COLORS, SRCCOPY ); // We flip h because Bitmaps store pixel data upside down.
+	
+	ReleaseDC( m_hWindow, hDC );
+
+	QueryPerformanceCounter( &after );
+
+	double elapsedTime = ( after.QuadPart - before.QuadPart ) * 1000.0 / frequency.QuadPart;
+
+	return elapsedTime;
+}
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
+{
+	// Convert filename from single to wide string for GDI+ compatibility
+	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
+	wchar_t* wcstring = new wchar_t[newsize];
+	size_t convertedChars = 0;
+	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+
+	HBITMAP hBitmap = NULL;
+
+	// Use GDI+ to load file into Bitmap structure
+	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
+	int status = bitmap->GetLastStatus();
+
+	if( status != Gdiplus::Ok )
+		return -status;
+
+	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+
+	width = bitmap->GetWidth();
+	height = bitmap->GetHeight();
+
+	delete bitmap;
+	delete[] wcstring;
+
+	return 1;
+}
+
+int PlayWindow::LoadPNGImage( std::string& fileAndPath, PixelData& destImage )
+{
+	// Convert filename from single to wide string for GDI+ compatibility
+	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
+	wchar_t* wcstring = new wchar_t[newsize];
+	size_t convertedChars = 0;
+	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+
+	HBITMAP hBitmap = NULL;
+
+	// Use GDI+ to load file into Bitmap structure
+	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
+	int status = bitmap->GetLastStatus();
+
+	if( status != Gdiplus::Ok )
+		return -status;
+
+	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+
+	// Create BitmapData structure to pull the data into
+	Gdiplus::BitmapData* bitmapData = new Gdiplus::BitmapData;
+
+	destImage.width = bitmap->GetWidth();
+	destImage.height = bitmap->GetHeight();
+
+	// Lock the bitmap in advance of reading its data
+	Gdiplus::Rect rect( 0, 0, destImage.width, destImage.height );
+	bitmap->LockBits( &rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, bitmapData );
+
+	// Get a pointer to the actual bit data
+	Pixel* sourcePixels = static_cast<Pixel*>( bitmapData->Scan0 );
+
+	destImage.pPixels = new Pixel[destImage.width * destImage.height];
+	memset( destImage.pPixels, 0, sizeof( Pixel ) * destImage.width * destImage.height );
+
+	Pixel* destPixels = destImage.pPixels;
+
+	// Copy the data across
+	for( int b = 0; b < destImage.width * destImage.height; b++ )
+		*destPixels++ = *sourcePixels++;
+
+	//Unlock the bitmap
+	bitmap->UnlockBits( bitmapData );
+
+	delete bitmap;
+	delete bitmapData;
+	delete[] wcstring;
+
+	return 1;
+}
+
+#else
+
+//********************************************************************************************************************************
+// Headless functions
+//********************************************************************************************************************************
+
+int PlayWindow::HandleHeadless( int argc, char* argv[] )
+{
+	int maxFrames = 0;
+	bool bRealtime = m_bRealtime;
+	std::string frameTimesFile;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		std::string arg( argv[i] );
+
+		if( arg.rfind( "--play-frames=", 0 ) == 0 )
+		{
+			// Anything but a whole number of frames is refused, rather than throwing or quietly running forever
+			const char* pValue = arg.c_str() + 14;
+			char* pEnd = nullptr;
+			errno = 0;
+			long frames = strtol( pValue, &pEnd, 10 );
+			if( pEnd == pValue || *pEnd != '\0' || errno == ERANGE || frames <= 0 || frames > INT_MAX )
+			{
+				DebugOutput( "PlayBuffer: --play-frames needs a number of frames above zero, not " + arg.substr( 14 ) + "\n" );
+				MainGameExit();
+				return 1;
+			}
+			maxFrames = static_cast<int>( frames );
+		}
+		else if( arg == "--play-realtime" )
+			bRealtime = true;
+		else if( arg.rfind( "--play-input=", 0 ) == 0 )
+			PlayInput::Instance().LoadInputScript( arg.substr( 13 ).c_str() );
+		else if( arg == "--play-checksum" )
+			m_bPrintChecksum = true;
+		else if( arg.rfind( "--play-frame-times=", 0 ) == 0 )
+			frameTimesFile = arg.substr( 19 );
+	}
+
+	bool quit = false;
+	m_pacer.ResetStats();
+
+	for( int frame = 0; !quit && ( maxFrames == 0 || frame < maxFrames ); frame++ )
+	{
+#ifdef PLAY_PLATFORM_X11
+		if( !HandleX11Events() )
+			break;
+#endif
+		PlayInput& input = PlayInput::Instance();
+		input.RunInputScript( frame );
+
+		// With no display to keep up with the frames can run back to back, with the game seeing the usual frame time
+		double elapsedTime = bRealtime ? m_pacer.WaitForNextFrame() : m_pacer.GetFrameTime();
+		StartFrame();
+
+		// A replay is a fixed workload, so the run ends with it
+		if( input.IsReplayFinished() )
+			break;
+		elapsedTime = input.UpdateRecording( elapsedTime );
+
+		// Call the main game update function
+		PLAY_PROFILE_SCOPE( PlayProfiler::FRAME_SCOPE );
+		if( m_tickRate > 0 )
+			quit = RunFixedTicks( elapsedTime );
+		else
+			quit = MainGameUpdate( static_cast<float>( elapsedTime ) );
+	}
+
+	PlayProfiler::ExportOnExit();
+	if( !frameTimesFile.empty() && !ExportFrameTimes( frameTimesFile.c_str() ) )
+		PLAY_ASSERT_MSG( false, ( "Couldn't write the frame times to " + frameTimesFile ).c_str() );
+
+	// Call the main game cleanup function
+	return MainGameExit();
+}
+
+double PlayWindow::PresentPixels( const PixelData& frame )
+{
+	PLAY_PROFILE_SCOPE( "PresentPixels" );
+	std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+
+	bool bPresented = false;
+#ifdef PLAY_PLATFORM_X11
+	bPresented = PresentX11( frame );
+#endif
+	// Copy the display buffer to the offscreen framebuffer in place of the window, or as well as it for the checksum
+	if( !bPresented || m_bPrintChecksum )
+	{
+		m_vFramebuffer.resize( static_cast<size_t>( m_width ) * m_scale * m_height * m_scale );
+		Upscale( frame, m_vFramebuffer.data() );
+	}
+
+	return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - before ).count();
+}
+
+#ifdef PLAY_PLATFORM_X11
+
+//********************************************************************************************************************************
+// X11 functions
+//********************************************************************************************************************************
+
+// Set by the error handler when the X server can't attach a shared memory segment, which happens on remote displays
+static bool s_bX11AttachFailed = false;
+
+static int X11AttachErrorHandler( Display*, XErrorEvent* )
+{
+	s_bX11AttachFailed = true;
+	return 0;
+}
+
+// Picks out the events for the window pointed to by pWindow
+static Bool IsX11WindowEvent( Display*, XEvent* pEvent, XPointer pWindow )
+{
+	return pEvent->xany.window == *reinterpret_cast<::Window*>( pWindow );
+}
+
+bool PlayWindow::OpenX11Display()
+{
+	if( !s_pDisplay && !s_bDisplayTried )
+	{
+		s_bDisplayTried = true;
+		// The present thread uses the connection too
+		XInitThreads();
+		s_pDisplay = XOpenDisplay( nullptr );
+	}
+
+	return s_pDisplay != nullptr;
+}
+
+int PlayWindow::HandleX11( int argc, char* argv[] )
+{
+	std::unique_lock<std::mutex> lock( s_displayMutex );
+
+	if( !OpenX11Display() )
+	{
+		lock.unlock();
+		DebugOutput( "PlayBuffer: Unable to open the X display, running headless instead\n" );
+		return HandleHeadless( argc, argv );
+	}
+
+	int screen = DefaultScreen( s_pDisplay );
+	int w = m_width * m_scale;
+	int h = m_height * m_scale;
+
+	m_xWindow = XCreateSimpleWindow( s_pDisplay, RootWindow( s_pDisplay, screen ), 0, 0, w, h, 0, BlackPixel( s_pDisplay, screen ), BlackPixel( s_pDisplay, screen ) );
+	s_nWindows++;
+	XStoreName( s_pDisplay, m_xWindow, "PlayBuffer" );
+	XSelectInput( s_pDisplay, m_xWindow, ExposureMask | KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask | PointerMotionMask | LeaveWindowMask );
+
+	// Fixed size, like the Windows version
+	XSizeHints* pHints = XAllocSizeHints();
+	pHints->flags = PMinSize | PMaxSize;
+	pHints->min_width = pHints->max_width = w;
+	pHints->min_height = pHints->max_height = h;
+	XSetWMNormalHints( s_pDisplay, m_xWindow, pHints );
+	XFree( pHints );
+
+	// Ask to be told when the window is closed rather than having the connection dropped
+	m_wmDeleteWindow = XInternAtom( s_pDisplay, "WM_DELETE_WINDOW", False );
+	XSetWMProtocols( s_pDisplay, m_xWindow, &m_wmDeleteWindow, 1 );
+
+	// Held keys would otherwise send a stream of release and press pairs
+	XkbSetDetectableAutoRepeat( s_pDisplay, True, nullptr );
+
+	m_gc = XCreateGC( s_pDisplay, m_xWindow, 0, nullptr );
+
+	if( m_scale > 1 )
+		m_pScaledImage = CreateX11Image( w, h );
+
+	XMapWindow( s_pDisplay, m_xWindow );
+	XSync( s_pDisplay, False );
+	lock.unlock();
+
+	// A window is being shown so the frames are paced rather than run back to back
+	m_bRealtime = true;
+
+	return HandleHeadless( argc, argv );
+}
+
+bool PlayWindow::HandleX11Events()
+{
+	if( !m_xWindow )
+		return true;
+
+	// Other contexts can have windows on the same display, so only this window's events are taken from the queue
+	XEvent event;
+	while( XCheckIfEvent( s_pDisplay, &event, IsX11WindowEvent, reinterpret_cast<XPointer>( &m_xWindow ) ) )
+	{
+		switch( event.type )
+		{
+			case Expose:
+				// The present thread will be along with a new frame soon enough
+				if( event.xexpose.count == 0 && m_presentQueueDepth == 0 )
+					PresentX11( *m_pPlayBuffer );
+				break;
+			case KeyPress:
+			case KeyRelease:
+			{
+				int vKey = KeySymToVirtualKey( XkbKeycodeToKeysym( s_pDisplay, static_cast<KeyCode>( event.xkey.keycode ), 0, 0 ) );
+				if( vKey )
+					PlayInput::Instance().SetKeyDown( vKey, event.type == KeyPress );
+				break;
+			}
+			case ButtonPress:
+			case ButtonRelease:
+				if( event.xbutton.button == Button1 )
+					PlayInput::Instance().SetKeyDown( VK_LBUTTON, event.type == ButtonPress );
+				else if( event.xbutton.button == Button3 )
+					PlayInput::Instance().SetKeyDown( VK_RBUTTON, event.type == ButtonPress );
+				break;
+			case MotionNotify:
+				if( m_pMouseData )
+				{
+					m_pMouseData->pos.x = static_cast<float>( event.xmotion.x / m_scale );
+					m_pMouseData->pos.y = static_cast<float>( event.xmotion.y / m_scale );
+				}
+				break;
+			case LeaveNotify:
+				if( m_pMouseData )
+				{
+					m_pMouseData->pos.x = -1;
+					m_pMouseData->pos.y = -1;
+				}
+				break;
+			case ClientMessage:
+				if( static_cast<Atom>( event.xclient.data.l[0] ) == m_wmDeleteWindow )
+					return false;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return true;
+}
+
+int PlayWindow::KeySymToVirtualKey( KeySym keySym )
+{
+	if( keySym >= XK_a && keySym <= XK_z )
+		return static_cast<int>( 'A' + ( keySym - XK_a ) );
+	if( keySym >= XK_A && keySym <= XK_Z )
+		return static_cast<int>( 'A' + ( keySym - XK_A ) );
+	if( keySym >= XK_0 && keySym <= XK_9 )
+		return static_cast<int>( '0' + ( keySym - XK_0 ) );
+	if( keySym >= XK_F1 && keySym <= XK_F12 )
+		return static_cast<int>( VK_F1 + ( keySym - XK_F1 ) );
+
+	switch( keySym )
+	{
+		case XK_BackSpace: return VK_BACK;
+		case XK_Tab: return VK_TAB;
+		case XK_Return: return VK_RETURN;
+		case XK_Shift_L: case XK_Shift_R: return VK_SHIFT;
+		case XK_Control_L: case XK_Control_R: return VK_CONTROL;
+		case XK_Alt_L: case XK_Alt_R: return VK_MENU;
+		case XK_Escape: return VK_ESCAPE;
+		case XK_space: return VK_SPACE;
+		case XK_Prior: return VK_PRIOR;
+		case XK_Next: return VK_NEXT;
+		case XK_End: return VK_END;
+		case XK_Home: return VK_HOME;
+		case XK_Left: return VK_LEFT;
+		case XK_Up: return VK_UP;
+		case XK_Right: return VK_RIGHT;
+		case XK_Down: return VK_DOWN;
+		case XK_Insert: return VK_INSERT;
+		case XK_Delete: return VK_DELETE;
+		default: return 0;
+	}
+}
+
+bool PlayWindow::PresentX11( const PixelData& frame )
+{
+	if( !m_xWindow )
+		return false;
+
+	X11Image* pPresent = nullptr;
+
+	if( frame.width != m_width * m_scale || frame.height != m_height * m_scale )
+	{
+		// Only created once a frame needs it, as a reduced resolution may never be used
+		if( !m_pScaledImage )
+		{
+			std::lock_guard<std::mutex> lock( s_displayMutex );
+			m_pScaledImage = CreateX11Image( m_width * m_scale, m_height * m_scale );
+		}
+
+		Upscale( frame, reinterpret_cast<Pixel*>( m_pScaledImage->pImage->data ) );
+		pPresent = m_pScaledImage;
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock( s_displayMutex );
+		for( X11Image* pImage : s_vDisplayImages )
+		{
+			if( reinterpret_cast<Pixel*>( pImage->pImage->data ) == frame.pPixels )
+				pPresent = pImage;
+		}
+	}
+
+	// The display buffer wasn't allocated by CreateDisplayPixels() so has to be presented through a temporary image
+	XImage* pTemporary = nullptr;
+	if( !pPresent )
+	{
+		int screen = DefaultScreen( s_pDisplay );
+		pTemporary = XCreateImage( s_pDisplay, DefaultVisual( s_pDisplay, screen ), DefaultDepth( s_pDisplay, screen ), ZPixmap, 0, reinterpret_cast<char*>( frame.pPixels ), frame.width, frame.height, 32, 0 );
+	}
+
+	XImage* pImage = pPresent ? pPresent->pImage : pTemporary;
+
+	if( pPresent && pPresent->bShared )
+		XShmPutImage( s_pDisplay, m_xWindow, m_gc, pImage, 0, 0, 0, 0, pImage->width, pImage->height, False );
+	else
+		XPutImage( s_pDisplay, m_xWindow, m_gc, pImage, 0, 0, 0, 0, pImage->width, pImage->height );
+
+	// Wait for the server to finish reading the pixels, as the next frame is drawn straight into them
+	XSync( s_pDisplay, False );
+
+	if( pTemporary )
+	{
+		// The pixels belong to the display buffer, not the image
+		pTemporary->data = nullptr;
+		XDestroyImage( pTemporary );
+	}
+
+	return true;
+}
+
+bool PlayWindow::X11WindowMatchesFramebuffer() const
+{
+	int w = m_width * m_scale;
+	int h = m_height * m_scale;
+
+	if( m_vFramebuffer.size() != static_cast<size_t>( w ) * h )
+		return false;
+
+	XImage* pImage = XGetImage( s_pDisplay, m_xWindow, 0, 0, w, h, AllPlanes, ZPixmap );
+	if( !pImage )
+		return false;
+
+	bool bMatches = pImage->bits_per_pixel == 32;
+	for( int y = 0; y < h && bMatches; y++ )
+	{
+		const uint32_t* pRow = reinterpret_cast<const uint32_t*>( pImage->data + static_cast<size_t>( y ) * pImage->bytes_per_line );
+		for( int x = 0; x < w && bMatches; x++ )
+			bMatches = ( ( pRow[x] ^ m_vFramebuffer[static_cast<size_t>( y ) * w + x].bits ) & 0xFFFFFF ) == 0;
+	}
+
+	XDestroyImage( pImage );
+	return bMatches;
+}
+
+PlayWindow::X11Image* PlayWindow::CreateX11Image( int width, int height )
+{
+	int screen = DefaultScreen( s_pDisplay );
+	Visual* pVisual = DefaultVisual( s_pDisplay, screen );
+	int depth = DefaultDepth( s_pDisplay, screen );
+
+	X11Image* pImage = new X11Image;
+
+	if( !s_bX11NoShm && XShmQueryExtension( s_pDisplay ) )
+	{
+		pImage->pImage = XShmCreateImage( s_pDisplay, pVisual, depth, ZPixmap, nullptr, &pImage->shmInfo, width, height );
+
+		if( pImage->pImage )
+		{
+			pImage->shmInfo.shmid = shmget( IPC_PRIVATE, static_cast<size_t>( pImage->pImage->bytes_per_line ) * pImage->pImage->height, IPC_CREAT | 0600 );
+			pImage->shmInfo.shmaddr = reinterpret_cast<char*>( -1 );
+
+			if( pImage->shmInfo.shmid >= 0 )
+			{
+				pImage->shmInfo.shmaddr = static_cast<char*>( shmat( pImage->shmInfo.shmid, nullptr, 0 ) );
+				pImage->shmInfo.readOnly = False;
+
+				if( pImage->shmInfo.shmaddr != reinterpret_cast<char*>( -1 ) )
+				{
+					// A failed attach is reported as an X error rather than by the return value
+					s_bX11AttachFailed = false;
+					XErrorHandler oldHandler = XSetErrorHandler( X11AttachErrorHandler );
+					bool bAttached = XShmAttach( s_pDisplay, &pImage->shmInfo );
+					XSync( s_pDisplay, False );
+					XSetErrorHandler( oldHandler );
+					pImage->bShared = bAttached && !s_bX11AttachFailed;
+				}
+
+				// The segment is only freed once both sides have detached, so this stops it leaking if the game crashes
+				shmctl( pImage->shmInfo.shmid, IPC_RMID, nullptr );
+			}
+
+			if( pImage->bShared )
+			{
+				pImage->pImage->data = pImage->shmInfo.shmaddr;
+			}
+			else
+			{
+				if( pImage->shmInfo.shmaddr != reinterpret_cast<char*>( -1 ) )
+					shmdt( pImage->shmInfo.shmaddr );
+				pImage->pImage->data = nullptr;
+				XDestroyImage( pImage->pImage );
+				pImage->pImage = nullptr;
+				pImage->shmInfo = XShmSegmentInfo();
+			}
+		}
+	}
+
+	if( !pImage->pImage )
+	{
+		// XDestroyImage() frees the pixels with free()
+		char* pData = static_cast<char*>( malloc( static_cast<size_t>( width ) * height * sizeof( Pixel ) ) );
+		pImage->pImage = XCreateImage( s_pDisplay, pVisual, depth, ZPixmap, 0, pData, width, height, 32, 0 );
+	}
+
+	PLAY_ASSERT_MSG( pImage->pImage && pImage->pImage->bits_per_pixel == 32 && pImage->pImage->red_mask == 0xFF0000 && pImage->pImage->bytes_per_line == width * static_cast<int>( sizeof( Pixel ) ),
+					 "The X display must use 32-bit pixels in the same format as the display buffer" );
+
+	return pImage;
+}
+
+void PlayWindow::DestroyX11Image( X11Image* pImage )
+{
+	if( pImage->bShared )
+	{
+		XShmDetach( s_pDisplay, &pImage->shmInfo );
+		XSync( s_pDisplay, False );
+		shmdt( pImage->shmInfo.shmaddr );
+		pImage->pImage->data = nullptr;
+	}
+
+	XDestroyImage( pImage->pImage );
+	delete pImage;
+}
+
+void PlayWindow::CloseX11Display()
+{
+	if( !s_pDisplay || !s_vDisplayImages.empty() || s_nWindows > 0 )
+		return;
+
+	XCloseDisplay( s_pDisplay );
+	s_pDisplay = nullptr;
+	s_bDisplayTried = false;
+}
+
+#endif
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
+{
+	return PlayPNG::ReadSize( NativePath( fileAndPath ), width, height );
+}
+
+int PlayWindow::LoadPNGImage( std::string& fileAndPath, PixelData& destImage )
+{
+	int status = PlayPNG::Load( NativePath( fileAndPath ), destImage );
+	PLAY_ASSERT_MSG( status > 0, std::string( "Unable to load png image: " + fileAndPath ).c_str() );
+	return status;
+}
+
+#endif
+
+std::string PlayWindow::NativePath( const std::string& path )
+{
+#ifdef PLAY_PLATFORM_WINDOWS
+	return path;
+#else
+	std::string native( path );
+	std::replace( native.begin(), native.end(), '\\', '/' );
+
+	if( native.empty() || std::filesystem::exists( native ) )
+		return native;
+
+	// Windows file names aren't case sensitive, so look for each part of the path ignoring case
+	auto equalsIgnoreCase = []( const std::string& a, const std::string& b )
+	{
+		return a.size() == b.size() && std::equal( a.begin(), a.end(), b.begin(), []( char x, char y ) { return toupper( x ) == toupper( y ); } );
+	};
+
+	std::filesystem::path matched = native[0] == '/' ? std::filesystem::path( "/" ) : std::filesystem::path();
+
+	for( const std::filesystem::path& part : std::filesystem::path( native ).relative_path() )
+	{
+		std::filesystem::path next = matched / part;
+
+		if( !std::filesystem::exists( next ) )
+		{
+			std::error_code error;
+			for( const auto& entry : std::filesystem::directory_iterator( matched.empty() ? "." : matched, error ) )
+			{
+				if( equalsIgnoreCase( entry.path().filename().string(), part.string() ) )
+				{
+					next = matched / entry.path().filename();
+					break;
+				}
+			}
+		}
+
+		matched = next;
+	}
+
+	// Keep the trailing separator on directories
+	std::string result = matched.string();
+	if( native.back() == '/' && ( result.empty() || result.back() != '/' ) )
+		result += '/';
+
+	return result;
+#endif
+}
+
+//********************************************************************************************************************************
+// Miscellaneous functions
+//********************************************************************************************************************************
+
+void AssertFailMessage( const char* message, const char* file, long line )
+{
+	// file - the file in which the assertion failed ( __FILE__ )
+	// line - the line of code where the assertion failed ( __LINE__ )
+	std::filesystem::path p = file;
+	std::string s = p.filename().string() + " : LINE " + std::to_string( line );
+	s += "\n" + std::string( message );
+#ifdef PLAY_PLATFORM_WINDOWS
+	int wide_count = MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, NULL, 0 );
+	wchar_t* wide = new wchar_t[wide_count];
+	MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, wide, wide_count );
+	MessageBox( NULL, wide, (LPCWSTR)L"Assertion Failure", MB_ICONWARNING );
+	delete[] wide;
+#else
+	fprintf( stderr, "Assertion Failure: %s\n", s.c_str() );
+#endif
+}
+
+void DebugOutput( const char* s )
+{
+#ifdef PLAY_PLATFORM_WINDOWS
+	OutputDebugStringA( s );
+#else
+	fputs( s, stderr );
+#endif
+}
+
+void DebugOutput( std::string s )
+{
+	DebugOutput( s.c_str() );
+}
+
+void TracePrintf( const char* file, int line, const char* fmt, ... )
+{
+	constexpr size_t kMaxBufferSize = 512u;
+	char buffer[kMaxBufferSize];
+
+	va_list args;
+	va_start( args, fmt );
+	// format should be double click-able in VS 
+	int len = snprintf( buffer, kMaxBufferSize, "%s(%d): ", file, line );
+	vsnprintf( buffer + len, kMaxBufferSize - len, fmt, args );
+	DebugOutput( buffer );
+	va_end( args );
+}
+
+//********************************************************************************************************************************
+// File:		PlayBlitter.cpp
+// Description:	A software pixel renderer for drawing 2D primitives into a PixelData buffer
+// Platform:	Independent
+//********************************************************************************************************************************
+
+
+PlayBlitter::PlayBlitter( PixelData* pRenderTarget )
+{
+	m_pRenderTarget = pRenderTarget;
+}
+
+
+void PlayBlitter::DrawPixel( int posX, int posY, Pixel srcPix )
+{
+	if( srcPix.a == 0x00 || posX < 0 || posX >= m_pRenderTarget->width || posY < 0 || posY >= m_pRenderTarget->height )
+		return;
+
+	Pixel* destPix = &m_pRenderTarget->pPixels[( posY * m_pRenderTarget->width ) + posX];
+#if PLAY_BLITTER_STATS
+	if( uint8_t* pCounts = GetOverdrawCounts() )
+		AddOverdraw( pCounts[destPix - m_pRenderTarget->pPixels] );
+#endif
+
+	if( srcPix.a == 0xFF ) // Completely opaque pixel - no need to blend
+	{
+		*destPix = srcPix.bits;
+	}
+	else
+	{
+		Pixel blendPix = *destPix;
+		float srcAlpha = srcPix.a / 255.0f;
+		float oneMinusSrcAlpha = 1.0f - srcAlpha;
+
+		blendPix.a = 0xFF;
+		blendPix.r = static_cast<uint8_t>( ( srcAlpha * srcPix.r ) + ( oneMinusSrcAlpha * blendPix.r ) );
+		blendPix.g = static_cast<uint8_t>( ( srcAlpha * srcPix.g ) + ( oneMinusSrcAlpha * blendPix.g ) );
+		blendPix.b = static_cast<uint8_t>( ( srcAlpha * srcPix.b ) + ( oneMinusSrcAlpha * blendPix.b ) );
+
+		*destPix = blendPix.bits;
+	}
+
+	return;
+}
+
+void PlayBlitter::DrawLine( int startX, int startY, int endX, int endY, Pixel pix )
+{
+	//Implementation of Bresenham's Line Drawing Algorithm
+	int dx = abs( endX - startX );
+	int sx = 1;
+	if( endX < startX ) { sx = -1; }
+
+	int dy = -abs( endY - startY );
+	int sy = 1;
+	if( endY < startY ) { sy = -1; }
+
+	int err = dx + dy;
+
+	if( err == 0 ) return;
+
+	int x = startX;
+	int y = startY;
+
+	while( true )
+	{
+		DrawPixel( x, y, pix );
+
+		if( x == endX && y == endY )
+			break;
+
+		int e2 = 2 * err;
+		if( e2 >= dy )
+		{
+			err += dy;
+			x += sx;
+		}
+		if( e2 <= dx )
+		{
+			err += dx;
+			y += sy;
+		}
+	}
+}
+
+//********************************************************************************************************************************
+// Function:	BlitPixels - draws image data with and without a global alpha multiply
+// Parameters:	spriteId = the id of the sprite to draw
+//				xpos, ypos = the position you want to draw the sprite
+//				frameIndex = which frame of the animation to draw (wrapped)
+// Notes:		Alpha multiply approach is relatively unoptimized
+//********************************************************************************************************************************
+void PlayBlitter::BlitPixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	PLAY_BLIT_STAT( m_lastBlitStats = BlitStats(); m_lastBlitStats.calls = 1; )
+
+	// Nothing within the display buffer to draw
+	if( blitX > m_pRenderTarget->width || blitX + blitWidth < 0 || blitY > m_pRenderTarget->height || blitY + blitHeight < 0 )
+	{
+		PLAY_BLIT_STAT( m_lastBlitStats.clipped = static_cast<unsigned long long>( blitWidth ) * blitHeight; )
+		return;
+	}
+
+	// Work out if we need to clip to the display buffer (and by how much)
+	int xClipStart = -blitX;
+	if( xClipStart < 0 ) { xClipStart = 0; }
+
+	int xClipEnd = ( blitX + blitWidth ) - m_pRenderTarget->width;
+	if( xClipEnd < 0 ) { xClipEnd = 0; }
+
+	int yClipStart = -blitY;
+	if( yClipStart < 0 ) { yClipStart = 0; }
+
+	int yClipEnd = ( blitY + blitHeight ) - m_pRenderTarget->height;
+	if( yClipEnd < 0 ) { yClipEnd = 0; }
+
+	// Set up the source and destination pointers based on clipping
+	int destOffset = ( m_pRenderTarget->width * ( blitY + yClipStart ) ) + ( blitX + xClipStart );
+	uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + destOffset;
+
+	int srcClipOffset = ( srcPixelData.width * yClipStart ) + xClipStart;
+	uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + srcClipOffset;
+
+	// Work out in advance how much we need to add to src and dest to reach the next row 
+	int destInc = m_pRenderTarget->width - blitWidth + xClipEnd + xClipStart;
+	int srcInc = srcPixelData.width - blitWidth + xClipEnd + xClipStart;
+
+	//Work out final pixel in destination.
+	int destColOffset = ( m_pRenderTarget->width * ( blitHeight - yClipEnd - yClipStart - 1 ) ) + ( blitWidth - xClipEnd - xClipStart );
+	uint32_t* destColEnd = destPixels + destColOffset;
+
+	//How many pixels per row in sprite.
+	int endRow = blitWidth - xClipEnd - xClipStart;
+
+	PLAY_BLIT_STAT( unsigned long long nBlended = 0; unsigned long long nSkipped = 0; )
+	PLAY_BLIT_STAT( uint8_t* pCounts = GetOverdrawCounts(); const uint32_t* pDestBase = &m_pRenderTarget->pPixels->bits; )
+
+	if( alphaMultiply < 1.0f )
+	{
+		// *******************************************************************************************************************************************************
+		// A basic (unoptimized) approach which separates the channels and performs a 'typical' alpha blending operation: (src * srcAlpha)+(dest * (1-srcAlpha))
+		// Has the advantage that a global alpha multiplication can be easily added over the top, so we use this method when a global multiply is required
+		// *******************************************************************************************************************************************************
+
+		// Slightly more optimised iterations without the additions in the loop
+		while( destPixels < destColEnd )
+		{
+			uint32_t* destRowEnd = destPixels + endRow;
+
+			while( destPixels < destRowEnd )
+			{
+				uint32_t src = *srcPixels++;
+				uint32_t dest = *destPixels;
+
+				// If this isn't a fully transparent pixel 
+				if( src < 0xFF000000 )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+
+					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
+					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
+					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
+					int destBlue = constAlpha * ( src & 0xFF );
+
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
+					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
+					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
+					destBlue += invSrcAlpha * ( dest & 0xFF );
+
+					// Bring back to the range 0-255
+					destRed >>= 8;
+					destGreen >>= 8;
+					destBlue >>= 8;
+
+					// Put ARGB components back together again
+					*destPixels++ = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+					PLAY_BLIT_STAT( nBlended++; if( pCounts ) AddOverdraw( pCounts[destPixels - 1 - pDestBase] ); )
+				}
+				else
+				{
+					// If this is a fully transparent pixel then the low bits store how many there are in a row
+					// This means we can skip to the next pixel which isn't fully transparent
+					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
+					src = src & 0x00FFFFFF;
+					if( skip > src ) skip = src;
+
+					srcPixels += skip;
+					++destPixels += skip;
+					PLAY_BLIT_STAT( nSkipped += skip; )
+				}
+			}
+			// Increase buffers by pre-calculated amounts
+			destPixels += destInc;
+			srcPixels += srcInc;
+		}
+
+	}
+	else
+	{
+		// *******************************************************************************************************************************************************
+		// An optimized approach which uses pre-multiplied alpha, parallel channel multiplication and pixel skipping to achieve the same 'typical' alpha 
+		// blending operation (src * srcAlpha)+(dest * (1-srcAlpha)). Not easy to apply a global alpha multiplication over the top, but used everywhere else.
+		// *******************************************************************************************************************************************************
+
+		// Slightly more optimised iterations without the additions in the loop
+		while( destPixels < destColEnd )
+		{
+			uint32_t* destRowEnd = destPixels + endRow;
+
+			while( destPixels < destRowEnd )
+			{
+				uint32_t src = *srcPixels++;
+				uint32_t dest = *destPixels;
+
+				// If this isn't a fully transparent pixel 
+				if( src < 0xFF000000 )
+				{
+					// This performes the dest*(1-srcAlpha) calculation for all channels in parallel with minor accuracy loss in dest colour.
+					// It does this by shifting all the destination channels down by 4 bits in order to "make room" for the later multiplication.
+					// After shifting down, it masks out the bits which have shifted into the adjacent channel data.
+					// This causes the RGB data to be rounded down to their nearest 16 producing a reduction in colour accuracy.
+					// This is then multiplied by the inverse alpha (inversed in PreMultiplyAlpha), also divided by 16 (hence >> 8+8+8+4).
+					// The multiplication brings our RGB values back up to their original bit ranges (albeit rounded to the nearest 16).
+					// As the colour accuracy only affects the destination pixels behind semi-transparent source pixels and so isn't very obvious.
+					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
+					// Add the (pre-multiplied Alpha) source to the destination and force alpha to opaque
+					*destPixels++ = ( src + dest ) | 0xFF000000;
+					PLAY_BLIT_STAT( nBlended++; if( pCounts ) AddOverdraw( pCounts[destPixels - 1 - pDestBase] ); )
+				}
+				else
+				{
+					// If this is a fully transparent pixel then the low bits store how many there are in a row
+					// This means we can skip to the next pixel which isn't fully transparent
+					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
+					src = src & 0x00FFFFFF;
+					if( skip > src ) skip = src;
+
+					srcPixels += skip;
+					++destPixels += skip;
+					PLAY_BLIT_STAT( nSkipped += skip; )
+				}
+			}
+			// Increase buffers by pre-calculated amounts
+			destPixels += destInc;
+			srcPixels += srcInc;
+		}
+
+	}
+
+#if PLAY_BLITTER_STATS
+	unsigned long long visibleArea = static_cast<unsigned long long>( std::max( endRow, 0 ) ) * std::max( blitHeight - yClipEnd - yClipStart, 0 );
+	m_lastBlitStats.visited = visibleArea - nSkipped;
+	m_lastBlitStats.blended = nBlended;
+	m_lastBlitStats.skipped = nSkipped;
+	m_lastBlitStats.clipped = static_cast<unsigned long long>( blitWidth ) * blitHeight - visibleArea;
+#endif
+	return;
+}
+
+//********************************************************************************************************************************
+// Function:	RotateScaleSprite - draws a rotated and scaled sprite with global alpha multiply
+// Parameters:	s = the sprite to draw
+//				xpos, ypos = the position of the center of rotation.
+//				frameIndex = which frame of the animation to draw (wrapped)
+//				angle = rotation angle
+//				scale = parameter to magnify the sprite.
+//				rotOffX, rotOffY = offset of centre of rotation to the top left of the sprite
+//				alpha = the fraction defining the amount of sprite and background that is draw. 255 = all sprite, 0 = all background.
+// Notes:		Pre-calculates roughly where the sprite will be in the display buffer and only processes those pixels. 
+//				Approx 15 times slower than not rotating.
+//********************************************************************************************************************************
+void PlayBlitter::RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+
+	//pointers to start of source and destination buffers
+	uint32_t* pSrcBase = &srcPixelData.pPixels->bits + srcOffset;
+	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
+
+	//the centre of rotation in the sprite frame relative to the top corner
+	float fRotCentreU = static_cast<float>( originX );
+	float fRotCentreV = static_cast<float>( originY );
+
+	//u/v are co-ordinates in the rotated sprite frame. x/y are screen buffer co-ordinates.
+	//change in u/v for a unit change in x/y.
+	float sinAngle, cosAngle;
+	Play::FastSinCos( -angle, sinAngle, cosAngle );
+	float dUdX = cosAngle * ( 1.0f / scale );
+	float dVdX = sinAngle * ( 1.0f / scale );
+	float dUdY = -dVdX;
+	float dVdY = dUdX;
+
+	//Position in the sprite rotated frame with origin at the center of rotation of the sprite corners.
+	float leftU = -fRotCentreU * scale;
+	float rightU = ( blitWidth + -fRotCentreU ) * scale;
+	float topV = ( -fRotCentreV ) * scale;
+	float bottomV = ( blitHeight - fRotCentreV ) * scale;
+
+	//Scale added in to cancel out the scale in dUdX.
+	float boundingBoxCorners[4][2]
+	{
+		{ ( dUdX * leftU + dVdX * topV ) * scale,			( dUdY * leftU + dVdY * topV ) * scale		},	// Top left
+		{ ( dUdX * leftU + dVdX * bottomV ) * scale,		( dUdY * leftU + dVdY * bottomV ) * scale		},	// Bottom left
+		{ ( dUdX * rightU + dVdX * bottomV ) * scale,		( dUdY * rightU + dVdY * bottomV ) * scale	},	// Bottom right
+		{ ( dUdX * rightU + dVdX * topV ) * scale,			( dUdY * rightU + dVdY * topV ) * scale,		},	// Top right
+	};
+
+	float minX = std::numeric_limits<float>::infinity();
+	float minY = std::numeric_limits<float>::infinity();
+	float maxX = -std::numeric_limits<float>::infinity();
+	float maxY = -std::numeric_limits<float>::infinity();
+
+	//calculate the extremes of the rotated corners.
+	for( int i = 0; i < 4; i++ )
+	{
+		minX = std::min( minX, boundingBoxCorners[i][0] );
+		maxX = std::max( maxX, boundingBoxCorners[i][0] );
+		minY = std::min( minY, boundingBoxCorners[i][1] );
+		maxY = std::max( maxY, boundingBoxCorners[i][1] );
+	}
+
+	PLAY_BLIT_STAT( m_lastBlitStats = BlitStats(); m_lastBlitStats.calls = 1; )
+	PLAY_BLIT_STAT( long long boundsArea = static_cast<long long>( static_cast<int>( maxX ) - static_cast<int>( minX ) ) * ( static_cast<int>( maxY ) - static_cast<int>( minY ) ); )
+
+	//clip the starting and finishing positions.
+	int startY = blitY + static_cast<int>( minY );
+	if( startY < 0 ) { startY = 0; minY = static_cast<float>( -blitY ); }
+
+	int endY = blitY + static_cast<int>( maxY );
+	if( endY > m_pRenderTarget->height ) { endY = m_pRenderTarget->height; }
+
+	int startX = blitX + static_cast<int>( minX );
+	if( startX < 0 ) { startX = 0; minX = static_cast<float>( -blitX ); }
+
+	int endX = blitX + static_cast<int>( maxX );
+	if( endX > m_pRenderTarget->width ) { endX = m_pRenderTarget->width; }
+
+	//rotate the basis so we get the edge of the bounding box in the sprite frame.
+	float startingU = dUdX * minX + dUdY * minY + fRotCentreU;
+	float startingV = dVdY * minY + dVdX * minX + fRotCentreV;
+
+	float rowU = startingU;
+	float rowV = startingV;
+
+	uint32_t* destPixels = pDstBase + ( static_cast<size_t>( m_pRenderTarget->width ) * startY ) + startX;
+	int nextRow = m_pRenderTarget->width - ( endX - startX );
+
+	uint32_t* srcPixels = pSrcBase;
+	PLAY_BLIT_STAT( unsigned long long nBlended = 0; uint8_t* pCounts = GetOverdrawCounts(); )
+
+	//Start of double for loop. 
+	for( int y = startY; y < endY; y++ )
+	{
+		float u = rowU;
+		float v = rowV;
+
+		for( int x = startX; x < endX; x++ )
+		{
+			//Check to see if u and v correspond to a valid pixel in sprite.
+			if( u > 0 && v > 0 && u < blitWidth && v < blitHeight )
+			{
+				srcPixels = pSrcBase + static_cast<size_t>( u ) + ( static_cast<size_t>( v ) * srcPixelData.width );
+				uint32_t src = *srcPixels;
+
+				if( src < 0xFF000000 )
+				{
+					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
+					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+
+					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
+					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
+					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
+					int destBlue = constAlpha * ( src & 0xFF );
+
+					uint32_t dest = *destPixels;
+					int invSrcAlpha = 0xFF - srcAlpha;
+
+					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
+					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
+					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
+					destBlue += invSrcAlpha * ( dest & 0xFF );
+
+					// Bring back to the range 0-255
+					destRed >>= 8;
+					destGreen >>= 8;
+					destBlue >>= 8;
+
+					// Put ARGB components back together again
+					*destPixels = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+					PLAY_BLIT_STAT( nBlended++; if( pCounts ) AddOverdraw( pCounts[destPixels - pDstBase] ); )
+				}
+			}
+
+			destPixels++;
+
+			// Change the position in the sprite frame for changing X in the display
+			u += dUdX;
+			v += dVdX;
+		}
+
+		// Work out the change in the sprite frame for changing Y in the display
+		rowU += dUdY;
+		rowV += dVdY;
+		// Next row
+		destPixels += nextRow;
+	}
+
+#if PLAY_BLITTER_STATS
+	// Every pixel in the rotated bounding box is looked at, as there aren't any runs to skip
+	long long visibleArea = static_cast<long long>( std::max( endX - startX, 0 ) ) * std::max( endY - startY, 0 );
+	m_lastBlitStats.visited = visibleArea;
+	m_lastBlitStats.blended = nBlended;
+	m_lastBlitStats.clipped = std::max( boundsArea - visibleArea, 0LL );
+#endif
+
+}
+
+
+void PlayBlitter::ClearRenderTarget( Pixel colour )
+{
+	Pixel* pBuffEnd = m_pRenderTarget->pPixels + ( m_pRenderTarget->width * m_pRenderTarget->height );
+	for( Pixel* pBuff = m_pRenderTarget->pPixels; pBuff < pBuffEnd; *pBuff++ = colour.bits );
+	m_pRenderTarget->preMultiplied = false;
+#if PLAY_BLITTER_STATS
+	if( uint8_t* pCounts = GetOverdrawCounts() )
+		AddOverdraw( pCounts, static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height );
+#endif
+}
+
+void PlayBlitter::BlitBackground( PixelData& backgroundImage )
+{
+	PLAY_ASSERT_MSG( backgroundImage.height == m_pRenderTarget->height && backgroundImage.width == m_pRenderTarget->width, "Background size doesn't match render target!" );
+	// Takes about 1ms for 720p screen on i7-8550U
+	memcpy( m_pRenderTarget->pPixels, backgroundImage.pPixels, sizeof( Pixel ) * m_pRenderTarget->width * m_pRenderTarget->height );
+
+#if PLAY_BLITTER_STATS
+	m_lastBlitStats = BlitStats();
+	m_lastBlitStats.calls = 1;
+	m_lastBlitStats.visited = m_lastBlitStats.blended = static_cast<unsigned long long>( m_pRenderTarget->width ) * m_pRenderTarget->height;
+	if( uint8_t* pCounts = GetOverdrawCounts() )
+		AddOverdraw( pCounts, static_cast<size_t>( m_pRenderTarget->width ) * m_pRenderTarget->height );
+#endif
+}
+
+// Repeats each pixel in a row SCALE times, four source pixels at a time with SSE2
+template< int SCALE >
+static void UpscaleRow( const Pixel* pSrc, Pixel* pDest, int width )
+{
+	int x = 0;
+
+#ifdef PLAY_SIMD_SSE2
+	for( ; x + 4 <= width; x += 4 )
+	{
+		__m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSrc + x ) );
+		__m128i* pOut = reinterpret_cast<__m128i*>( pDest + x * SCALE );
+
+		if constexpr( SCALE == 2 )
+		{
+			_mm_storeu_si128( pOut, _mm_unpacklo_epi32( p, p ) );
+			_mm_storeu_si128( pOut + 1, _mm_unpackhi_epi32( p, p ) );
+		}
+		else if constexpr( SCALE == 3 )
+		{
+			_mm_storeu_si128( pOut, _mm_shuffle_epi32( p, _MM_SHUFFLE( 1, 0, 0, 0 ) ) );
+			_mm_storeu_si128( pOut + 1, _mm_shuffle_epi32( p, _MM_SHUFFLE( 2, 2, 1, 1 ) ) );
+			_mm_storeu_si128( pOut + 2, _mm_shuffle_epi32( p, _MM_SHUFFLE( 3, 3, 3, 2 ) ) );
+		}
+		else
+		{
+			_mm_storeu_si128( pOut, _mm_shuffle_epi32( p, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+			_mm_storeu_si128( pOut + 1, _mm_shuffle_epi32( p, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+			_mm_storeu_si128( pOut + 2, _mm_shuffle_epi32( p, _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+			_mm_storeu_si128( pOut + 3, _mm_shuffle_epi32( p, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+		}
+	}
+#endif
+
+	for( ; x < width; x++ )
+	{
+		for( int s = 0; s < SCALE; s++ )
+			pDest[x * SCALE + s] = pSrc[x];
+	}
+}
+
+void PlayBlitter::UpscalePixels( const PixelData& srcImage, int scale, int startRow, int endRow ) const
+{
+	PLAY_ASSERT_MSG( m_pRenderTarget->width == srcImage.width * scale && m_pRenderTarget->height == srcImage.height * scale, "Render target isn't the scaled up size of the source image!" );
+	PLAY_ASSERT_MSG( startRow >= 0 && endRow <= srcImage.height, "Rows to upscale are outside the source image!" );
+
+	int destWidth = m_pRenderTarget->width;
+
+	for( int y = startRow; y < endRow; y++ )
+	{
+		const Pixel* pSrc = srcImage.pPixels + static_cast<size_t>( y ) * srcImage.width;
+		Pixel* pDest = m_pRenderTarget->pPixels + static_cast<size_t>( y ) * scale * destWidth;
+
+		switch( scale )
+		{
+			case 1: memcpy( pDest, pSrc, sizeof( Pixel ) * destWidth ); break;
+			case 2: UpscaleRow<2>( pSrc, pDest, srcImage.width ); break;
+			case 3: UpscaleRow<3>( pSrc, pDest, srcImage.width ); break;
+			case 4: UpscaleRow<4>( pSrc, pDest, srcImage.width ); break;
+			default:
+				for( int x = 0; x < destWidth; x++ )
+					pDest[x] = pSrc[x / scale];
+				break;
+		}
+
+		// The rest of the rows are the same as the first, which is still in the cache
+		for( int s = 1; s < scale; s++ )
+			memcpy( pDest + static_cast<size_t>( s ) * destWidth, pDest, sizeof( Pixel ) * destWidth );
+	}
+}
+
+void PlayBlitter::ResamplePixels( const PixelData& srcImage, int startRow, int endRow ) const
+{
+	PLAY_ASSERT_MSG( startRow >= 0 && endRow <= m_pRenderTarget->height, "Rows to resample are outside the render target!" );
+
+	int destWidth = m_pRenderTarget->width;
+	int destHeight = m_pRenderTarget->height;
+
+	// 16.16 fixed point step through the source for each pixel across, starting from the middle of the first one
+	uint32_t stepX = static_cast<uint32_t>( ( static_cast<uint64_t>( srcImage.width ) << 16 ) / destWidth );
+	int lastSrcY = -1;
+
+#if PLAY_BLITTER_STATS
+	if( uint8_t* pCounts = GetOverdrawCounts() )
+		AddOverdraw( pCounts + static_cast<size_t>( startRow ) * destWidth, static_cast<size_t>( endRow - startRow ) * destWidth );
+#endif
+
+	for( int y = startRow; y < endRow; y++ )
+	{
+		int srcY = static_cast<int>( ( ( 2LL * y + 1 ) * srcImage.height ) / ( 2LL * destHeight ) );
+		Pixel* pDest = m_pRenderTarget->pPixels + static_cast<size_t>( y ) * destWidth;
+
+		// When scaling up neighbouring rows often come from the same source row
+		if( srcY == lastSrcY )
+		{
+			memcpy( pDest, pDest - destWidth, sizeof( Pixel ) * destWidth );
+			continue;
+		}
+
+		const Pixel* pSrc = srcImage.pPixels + static_cast<size_t>( srcY ) * srcImage.width;
+		uint32_t u = stepX / 2;
+
+		for( int x = 0; x < destWidth; x++, u += stepX )
+			pDest[x] = pSrc[u >> 16];
+
+		lastSrcY = srcY;
+	}
+}
+
+
+//********************************************************************************************************************************
+// File:		PlayGraphics.cpp
+// Description:	Manages 2D graphics operations on a PixelData buffer 
+// Platform:	Independent
+// Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
+//********************************************************************************************************************************
+
+
+std::map< std::string, PlayGraphics::SharedSprites > PlayGraphics::s_sharedSprites;
+std::mutex PlayGraphics::s_sharedSpritesMutex;
+
+//********************************************************************************************************************************
+// Constructor / Destructor (Private)
+//********************************************************************************************************************************
+
+PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
+{
+	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
+	m_playBuffer.width = bufferWidth;
+	m_playBuffer.height = bufferHeight;
+	// Allocated by the window so it can live wherever the platform presents from most cheaply
+	m_bufferWidth = bufferWidth;
+	m_bufferHeight = bufferHeight;
+	m_playBuffer.pPixels = PlayWindow::CreateDisplayPixels( bufferWidth, bufferHeight );
+	m_vDrawingBuffers.push_back( m_playBuffer.pPixels );
+	m_playBuffer.preMultiplied = false;
+	PLAY_ASSERT( m_playBuffer.pPixels );
+
+	memset( m_playBuffer.pPixels, 0, sizeof( uint32_t ) * bufferWidth * bufferHeight );
+
+	// Make the display buffer the render target for the blitter
+	m_blitter.SetRenderTarget( &m_playBuffer );
+
+	LoadSprites( path );
+}
+
+void PlayGraphics::LoadSprites( const char* path )
+{
+	std::string nativePath = PlayWindow::NativePath( path );
+	PLAY_ASSERT_MSG( std::filesystem::exists( nativePath ), "PlayBuffer: Drectory provided does not exist." );
+	m_spriteDirectory = nativePath;
+
+	// Held while loading, so contexts created at the same time only load the directory once
+	std::lock_guard<std::mutex> lock( s_sharedSpritesMutex );
+	SharedSprites& shared = s_sharedSprites[m_spriteDirectory];
+
+	if( shared.nUsers == 0 )
+	{
+		// Iterate through the directory
+		for( const auto& p : std::filesystem::directory_iterator( nativePath ) )
+		{
+			// Switch everything to uppercase to avoid need to check case each time
+			std::string filename = p.path().string();
+			for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+
+			// Only attempt to load PNG files
+			if( filename.find( ".PNG" ) != std::string::npos )
+			{
+				std::ifstream png_infile;
+				png_infile.open( p.path().string(), std::ios::binary ); // Don't do this as part of the constructor or we lose 16 bytes!
+
+				// If the PNG was opened okay
+				if( png_infile )
+				{
+					int spriteId = LoadSpriteSheet( p.path().parent_path().string() + "\\", p.path().stem().string() );
+
+					// Now we check for .inf file for each sprite and load origins
+					int originX = 0, originY = 0;
+
+					std::string info_filename = PlayWindow::NativePath( filename.replace( filename.find( ".PNG" ), 4, ".INF" ) );
+
+					if( std::filesystem::exists( info_filename ) )
+					{
+						std::ifstream info_infile;
+						info_infile.open( info_filename, std::ios::in );
+
+						PLAY_ASSERT_MSG( info_infile.is_open(), std::string( "Unable to load existing .inf file: " + info_filename ).c_str() );
+						if( info_infile.is_open() )
+						{
+							std::string type;
+							info_infile >> type;
+							info_infile >> originX;
+							info_infile >> originY;
+						}
+
+						info_infile.close();
+					}
+
+					SetSpriteOrigin( spriteId, { originX, originY } );
+				}
+
+				png_infile.close();
+			}
+		}
+
+		shared.vSprites = vSpriteData;
+	}
+	else
+	{
+		vSpriteData = shared.vSprites;
+		m_nTotalSprites = static_cast<int>( vSpriteData.size() );
+	}
+
+	shared.nUsers++;
+
+	// The pixels belong to the shared sprites from now on, while the rest of each sprite (like its origin) is this context's own
+	for( Sprite& spr : vSpriteData )
+		spr.bSharedCanvas = spr.bSharedPreMultAlpha = true;
+}
+
+PlayGraphics::~PlayGraphics()
+{
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.canvasBuffer.pPixels && !s.bSharedCanvas )
+			delete[] s.canvasBuffer.pPixels;
+
+		if( s.preMultAlpha.pPixels && !s.bSharedPreMultAlpha )
+			delete[] s.preMultAlpha.pPixels;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( s_sharedSpritesMutex );
+		SharedSprites& shared = s_sharedSprites[m_spriteDirectory];
+
+		// The last context using the shared sprites frees them
+		if( --shared.nUsers <= 0 )
+		{
+			for( Sprite& s : shared.vSprites )
+			{
+				delete[] s.canvasBuffer.pPixels;
+				delete[] s.preMultAlpha.pPixels;
+			}
+			s_sharedSprites.erase( m_spriteDirectory );
+		}
+	}
+
+	for( PixelData& pBgBuffer : vBackgroundData )
+		delete[] pBgBuffer.pPixels;
+
+	if( m_pDebugFontBuffer )
+		delete[] m_pDebugFontBuffer;
+
+	for( Pixel* pPixels : m_vDrawingBuffers )
+		PlayWindow::DestroyDisplayPixels( pPixels );
+}
+
+//********************************************************************************************************************************
+// Instance functions
+//********************************************************************************************************************************
+
+PlayGraphics& PlayGraphics::Instance()
+{
+	PlayGraphics* pInstance = Play::Context::Current().pGraphics;
+	PLAY_ASSERT_MSG( pInstance, "Trying to use PlayGraphics without initialising it!" );
+	return *pInstance;
+}
+
+PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
+{
+	PlayGraphics*& pInstance = Play::Context::Current().pGraphics;
+	PLAY_ASSERT_MSG( !pInstance, "Trying to create multiple instances of singleton class!" );
+	pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
+	return *pInstance;
+}
+
+void PlayGraphics::Destroy()
+{
+	PlayGraphics*& pInstance = Play::Context::Current().pGraphics;
+	PLAY_ASSERT_MSG( pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
+	delete pInstance;
+	pInstance = nullptr;
+}
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+int PlayGraphics::LoadSpriteSheet( const std::string& path, const std::string& filename )
+{
+	PixelData canvasBuffer;
+	std::string spriteName = filename;
+	int hCount = 1;
+	int vCount = 1;
+
+	// Switch everything to uppercase to avoid need to check case each time
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	// Look for the final number in the filename to pull out the number of frames across the width
+	size_t frameWidthEnd = spriteName.find_last_of( "0123456789" );
+	size_t frameWidthStart = spriteName.find_last_not_of( "0123456789" );
+
+	if( frameWidthEnd == spriteName.length() - 1 )
+	{
+		// Grab the number of frames
+		std::string widthString = spriteName.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+
+		// Make sure the number is valid 
+		size_t num = widthString.find_first_of( "0123456789" );
+		PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+
+		hCount = stoi( widthString );
+
+		if( spriteName[frameWidthStart] == 'X' )
+		{
+			//Two dimensional sprite sheet so the width was actually the height: copy it over and work out the real width
+			vCount = hCount;
+
+			// Cut off the last number we just found plus an "x", then check for another number indicating a frame height (optional)
+			std::string truncated = spriteName.substr( 0, frameWidthStart );
+			frameWidthEnd = truncated.find_last_of( "0123456789" );
+			frameWidthStart = truncated.find_last_not_of( "0123456789" );
+
+			if( frameWidthEnd == truncated.length() - 1 && frameWidthStart != std::string::npos )
+			{
+				// Grab the number of images in the height
+				widthString = truncated.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+
+				// Make sure the number is valid
+				num = widthString.find_first_of( "0123456789" );
+				PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+
+				hCount = stoi( widthString );
+			}
+			else
+			{
+				PLAY_ASSERT_MSG( false, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+			}
+		}
+		else
+		{
+			vCount = 1;
+		}
+	}
+
+	std::string fileAndPath( path + spriteName + ".PNG" );
+	PlayWindow::LoadPNGImage( fileAndPath, canvasBuffer ); // Allocates memory as we don't know the size
+	
+	return AddSprite( filename, canvasBuffer, hCount, vCount );
+}
+
+int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	Sprite s;
+	s.id = m_nTotalSprites++;
+	s.name = spriteName;
+	s.originX = s.originY = 0;
+	s.hCount = hCount;
+	s.vCount = vCount;
+	s.canvasBuffer = pixelData; // copy including pointer to pixel data
+
+	s.totalCount = s.hCount * s.vCount;
+	s.width = s.canvasBuffer.width / s.hCount;
+	s.height = s.canvasBuffer.height / s.vCount;
+
+	// Create a separate buffer with the pre-multiplyied alpha
+	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
+	s.preMultAlpha.width = s.canvasBuffer.width;
+	s.preMultAlpha.height = s.canvasBuffer.height;
+	memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
+	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
+	s.canvasBuffer.preMultiplied = true;
+
+	// Add the sprite to our vector
+	vSpriteData.push_back( s );
+
+	return s.id;
+}
+
+int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+{
+	// Switch everything to uppercase to avoid need to check case each time
+	std::string spriteName = name;
+	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.name.find( spriteName ) != std::string::npos )
+		{
+			// delete the old premultiplied buffer, unless it belongs to the shared sprites
+			if( !s.bSharedPreMultAlpha )
+				delete[] s.preMultAlpha.pPixels;
+			s.bSharedCanvas = s.bSharedPreMultAlpha = false;
+
+			s.hCount = hCount;
+			s.vCount = vCount;
+			s.canvasBuffer = pixelData; // copy including pointer to pixel data
+
+			s.totalCount = s.hCount * s.vCount;
+			s.width = s.canvasBuffer.width / s.hCount;
+			s.height = s.canvasBuffer.height / s.vCount;
+
+			// Create a new buffer with the pre-multiplyied alpha
+			s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
+			s.preMultAlpha.width = s.canvasBuffer.width;
+			s.preMultAlpha.height = s.canvasBuffer.height;
+			memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
+			PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
+			s.canvasBuffer.preMultiplied = true;
 
-// Undefine 'new' in this compilation unit only.
-#pragma push_macro("new")
-#undef new
+			return s.id;
+		}
+	}
 
-constexpr int MAX_ALLOCATIONS = 8192 * 4;
-constexpr int MAX_FILENAME = 1024;
+	return -1;
+}
 
-unsigned int g_allocId = 0;
 
-// A structure to store data on each memory allocation
-struct ALLOC
+int PlayGraphics::LoadBackground( const char* fileAndPath )
 {
-	void* address = 0;
-	char file[MAX_FILENAME] = { 0 };
-	int line = 0;
-	size_t size = 0;
-	int id = 0;
+	// The background image may not be the right size for the background so we make sure the buffer is 
+	PixelData backgroundImage;
+	Pixel* pSrc, * pDest;
 
-	ALLOC( void* a, const char* fn, int l, size_t s ) { address = a; line = l; size = s; id = g_allocId++; strcpy_s( file, fn ); };
-	ALLOC( void ) {};
-};
+	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_bufferWidth ) * m_bufferHeight];
+	PLAY_ASSERT( correctSizeBuffer );
 
-ALLOC g_allocations[MAX_ALLOCATIONS];
-unsigned int g_allocCount = 0;
+	std::string pngFile( fileAndPath );
+	PLAY_ASSERT_MSG( std::filesystem::exists( PlayWindow::NativePath( pngFile ) ), "The background png does not exist at the given location." );
+	PlayWindow::LoadPNGImage( pngFile, backgroundImage ); // Allocates memory in function as we don't know the size
 
+	pSrc = backgroundImage.pPixels;
+	pDest = correctSizeBuffer;
 
-void CreateStaticObject( void );
-void PrintAllocation( const char* tagText, ALLOC& a );
+	//Copy the image to our background buffer clipping where necessary
+	for( int h = 0; h < std::min( backgroundImage.height, m_bufferHeight ); h++ )
+	{
+		for( int w = 0; w < std::min( backgroundImage.width, m_bufferWidth ); w++ )
+			*pDest++ = *pSrc++;
 
-//********************************************************************************************************************************
-// Overrides for new operator (x4)
-//********************************************************************************************************************************
+		// Skip pixels if we're clipping
+		pDest += std::max( m_bufferWidth - backgroundImage.width, 0 );
+		pSrc += std::max( backgroundImage.width - m_bufferWidth, 0 );
+	}
 
-// The file and line are passed through using the macro defined in PlayMemory.h which redefines new. This will only happen if 
-// PlayMemory.h has been parsed in advance of the use of new in the relevant code. This approach is problematic for classes 
-// the safest approach. The two definitions of new without the file and line pick up any other memory allocations for completeness.
-void* operator new( size_t size, const char* file, int line )
-{
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, file, line, size };
-	return p;
-}
+	// Free up the loading buffer
+	delete backgroundImage.pPixels;
+	backgroundImage.pPixels = correctSizeBuffer;
 
-void* operator new[]( size_t size, const char* file, int line )
-{
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, file, line, size };
-	return p;
-}
+	vBackgroundData.push_back( backgroundImage );
 
-void* operator new( size_t size )
-{
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, "Unknown", 0, size };
-	return p;
+	return static_cast<int>( vBackgroundData.size() ) - 1;
 }
 
-void* operator new[]( size_t size )
-{
-	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
-	CreateStaticObject();
-	void* p = malloc( size );
-	g_allocations[g_allocCount++] = ALLOC{ p, "Unknown", 0, size };
-	return p;
-}
 
 //********************************************************************************************************************************
-// Overrides for delete operator (x4)
+// Sprite Getters and Setters
 //********************************************************************************************************************************
-
-// The definitions with file and line are only included for exception handling, where it looks for a form of delete that matches 
-// the new that was used to allocate it.
-void operator delete( void* p, const char* file, int line )
+int PlayGraphics::GetSpriteId( const char* name ) const
 {
-	UNREFERENCED_PARAMETER( line );
-	UNREFERENCED_PARAMETER( file );
-	operator delete( p );
-}
-
-int g_id = -1;
+	std::string tofind( name );
+	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
 
-void operator delete( void* p )
-{
-	for( unsigned int a = 0; a < g_allocCount; a++ )
+	for( const Sprite& s : vSpriteData )
 	{
-		if( g_allocations[a].address == p )
-		{
-			if( g_allocations[a].id == g_id )
-				g_allocations[a].id = g_id;
-
-			g_allocations[a] = g_allocations[g_allocCount - 1];
-			g_allocations[g_allocCount - 1].address = nullptr;
-			g_allocCount--;
-		}
+		if( s.name.find( tofind ) != std::string::npos )
+			return s.id;
 	}
-	free( p );
+	PLAY_ASSERT_MSG( false, "The sprite name is invalid!" );
+	return -1;
 }
 
-void operator delete[]( void* p, const char* file, int line )
+const std::string& PlayGraphics::GetSpriteName( int spriteId )
 {
-	UNREFERENCED_PARAMETER( line );
-	UNREFERENCED_PARAMETER( file );
-	operator delete[]( p );
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get name of invalid sprite id" );
+	return vSpriteData[spriteId].name;
 }
 
-void operator delete[]( void* p )
+Vector2f PlayGraphics::GetSpriteSize( int spriteId ) const
 {
-	for( unsigned int a = 0; a < g_allocCount; a++ )
-	{
-		if( g_allocations[a].address == p )
-		{
-			if( g_allocations[a].id == g_id )
-				g_allocations[a].id = g_id;
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get width of invalid sprite id" );
+	return { vSpriteData[spriteId].width, vSpriteData[spriteId].height };
+}
 
-			g_allocations[a] = g_allocations[g_allocCount - 1];
-			g_allocations[g_allocCount - 1].address = nullptr;
-			g_allocCount--;
-		}
-	}
-	free( p );
+int PlayGraphics::GetSpriteFrames( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get frames of invalid sprite id" );
+	return vSpriteData[spriteId].totalCount;
 }
 
-//********************************************************************************************************************************
-// Printing allocations
-//********************************************************************************************************************************
+Vector2f PlayGraphics::GetSpriteOrigin( int spriteId ) const
+{
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get origin with invalid sprite id" );
+	return { vSpriteData[spriteId].originX, vSpriteData[spriteId].originY };
+}
 
-// A method for printing out all the memory allocation immediately before program exit (or as close as you can get)
-// This is achieved by creating a class as a static object before the first memory allocation, which stays in scope until
-// after everything else is destroyed. When it is cleaned up its destructor prints the allocations to show us any leaks!
-class DestroyedLast
+void PlayGraphics::SetSpriteOrigin( int spriteId, Vector2f newOrigin, bool relative )
 {
-public:
-	DestroyedLast()
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to set origin with invalid sprite id" );
+	if( relative )
 	{
-		PrintAllocations( "<STARTUP>" );
+		vSpriteData[spriteId].originX += static_cast<int>( newOrigin.x );
+		vSpriteData[spriteId].originY += static_cast<int>( newOrigin.y );
 	}
-	~DestroyedLast()
+	else
 	{
-		if( g_allocCount > 0 )
-		{
-			PrintAllocations( "<MEMORY LEAK>" );
-		}
-		else
-		{
-			DebugOutput( "**************************************************\n" );
-			DebugOutput( "NO MEMORY LEAKS!\n" );
-			DebugOutput( "**************************************************\n" );
-		}
-
+		vSpriteData[spriteId].originX = static_cast<int>( newOrigin.x );
+		vSpriteData[spriteId].originY = static_cast<int>( newOrigin.y );
 	}
-};
-
-void CreateStaticObject( void )
-{
-	static DestroyedLast last;
 }
 
-void PrintAllocation( const char* tagText, ALLOC& a )
+void PlayGraphics::CentreSpriteOrigin( int spriteId )
 {
-	char buffer[MAX_FILENAME * 2] = { 0 };
-
-	if( a.address != nullptr )
-	{
-		char* lastSlash = strrchr( a.file, '\\' );
-		if( lastSlash )
-		{
-			strcpy_s( buffer, lastSlash + 1 );
-			strcpy_s( a.file, buffer );
-		}
-		// Format in such a way that VS can double click to jump to the allocation.
-		sprintf_s( buffer, "%s %s(%d): 0x%02X %d bytes [%d]\n", tagText, a.file, a.line, static_cast<int>( reinterpret_cast<long long>( a.address ) ), static_cast<int>( a.size ), a.id );
-		DebugOutput( buffer );
-	}
+	SetSpriteOrigin( spriteId, GetSpriteSize( spriteId ) / 2 );
 }
 
-void PrintAllocations( const char* tagText )
+void PlayGraphics::CentreAllSpriteOrigins( void )
 {
-	int bytes = 0;
-	char buffer[MAX_FILENAME * 2] = { 0 };
-	DebugOutput( "****************************************************\n" );
-	DebugOutput( "MEMORY ALLOCATED\n" );
-	DebugOutput( "****************************************************\n" );
-	for( unsigned int n = 0; n < g_allocCount; n++ )
-	{
-		ALLOC& a = g_allocations[n];
-		PrintAllocation( tagText, a );
-		bytes += a.size;
-	}
-	sprintf_s( buffer, "%s Total = %d bytes\n", tagText, bytes );
-	DebugOutput( buffer );
-	DebugOutput( "**************************************************\n" );
-
+	for( Sprite& s : vSpriteData )
+		CentreSpriteOrigin( s.id );
 }
 
-#pragma pop_macro("new")
-
-#endif
-
-//********************************************************************************************************************************
-// File:		PlayWindow.cpp
-// Description:	Platform specific code to provide a window to draw into
-// Platform:	Windows
-// Notes:		Uses a 32-bit ARGB display buffer
-//********************************************************************************************************************************
-
-// Instruct Visual Studio to add these to the list of libraries to link
-#pragma comment(lib, "gdiplus.lib")
-#pragma comment(lib, "dwmapi.lib")
-
-PlayWindow* PlayWindow::s_pInstance = nullptr;
-
-// External functions which must be implemented by the user 
-extern void MainGameEntry( int argc, char* argv[] ); 
-extern bool MainGameUpdate( float ); // Called every frame
-extern int MainGameExit( void ); // Called on quit
-
-ULONG_PTR g_pGDIToken = 0;
-
-int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd )
+void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, bool relative )
 {
-	// Initialize GDI+
-	Gdiplus::GdiplusStartupInput startupInput;
-	ULONG_PTR token;
-	Gdiplus::Status gdiStatus = Gdiplus::GdiplusStartup( &token, &startupInput, NULL );
-	PLAY_ASSERT( Gdiplus::Ok == gdiStatus );
-	g_pGDIToken = token;
-
-	MainGameEntry( __argc, __argv );
+	std::string tofind( rootName );
+	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
 
-	return PlayWindow::Instance().HandleWindows( hInstance, hPrevInstance, lpCmdLine, nShowCmd, L"PlayBuffer" );
+	for( Sprite& s : vSpriteData )
+	{
+		if( s.name.find( tofind ) != std::string::npos )
+		{
+			if( relative )
+			{
+				s.originX += static_cast<int>( newOrigin.x );
+				s.originY += static_cast<int>( newOrigin.y );
+			}
+			else
+			{
+				s.originX = static_cast<int>( newOrigin.x );
+				s.originY = static_cast<int>( newOrigin.y );
+			}
+		}
+	}
 }
 
 //********************************************************************************************************************************
-// Constructor / Destructor (Private)
+// Drawing functions
 //********************************************************************************************************************************
 
-PlayWindow::PlayWindow( PixelData* pDisplayBuffer, int nScale )
+void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
 {
-	PLAY_ASSERT( pDisplayBuffer );
-	PLAY_ASSERT( nScale > 0 );
-	m_pPlayBuffer = pDisplayBuffer;
-	m_scale = nScale;
-}
+	// Only the rotated draw can shrink the sprite to the render scale
+	if( GetDrawScale() != 1.0f )
+		return DrawRotated( spriteId, pos, frameIndex, 0.0f, 1.0f, alphaMultiply );
 
-PlayWindow::~PlayWindow( void )
-{
-	s_pInstance = nullptr;
-}
+	const Sprite& spr = vSpriteData[spriteId];
+	int destx = static_cast<int>( pos.x + 0.5f ) - spr.originX;
+	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
+	frameIndex = frameIndex % spr.totalCount;
+	int frameX = frameIndex % spr.hCount;
+	int frameY = frameIndex / spr.hCount;
+	int pixelX = frameX * spr.width;
+	int pixelY = frameY * spr.height;
+	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
 
-//********************************************************************************************************************************
-// Instance functions
-//********************************************************************************************************************************
+	m_blitter.BlitPixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, alphaMultiply );
+	CountBlit( spriteId );
+};
 
-PlayWindow& PlayWindow::Instance()
+void PlayGraphics::DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale, float alphaMultiply ) const
 {
-	if( !s_pInstance )
-		PLAY_ASSERT_MSG( false, "Trying to use PlayBuffer without initialising it!" );
+	const Sprite& spr = vSpriteData[spriteId];
+	float drawScale = GetDrawScale();
+	int destx = static_cast<int>( pos.x * drawScale + 0.5f );
+	int desty = static_cast<int>( pos.y * drawScale + 0.5f );
+	scale *= drawScale;
+	frameIndex = frameIndex % spr.totalCount;
+	int frameX = frameIndex % spr.hCount;
+	int frameY = frameIndex / spr.hCount;
+	int pixelX = frameX * spr.width;
+	int pixelY = frameY * spr.height;
+	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
 
-	return *s_pInstance;
+	m_blitter.RotateScalePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, angle, scale, alphaMultiply );
+	CountBlit( spriteId );
 }
 
-PlayWindow& PlayWindow::Instance( PixelData* pDisplayBuffer, int nScale )
+
+void PlayGraphics::DrawBackground( int backgroundId )
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayWindow( pDisplayBuffer, nScale );
-	return *s_pInstance;
+	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
+	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
+
+	if( GetDrawScale() != 1.0f )
+	{
+		PixelData background{ m_bufferWidth, m_bufferHeight, vBackgroundData[backgroundId].pPixels };
+		m_blitter.ResamplePixels( background, 0, m_playBuffer.height );
+		CountBlit( -1 );
+		return;
+	}
+
+	m_blitter.BlitBackground( vBackgroundData[backgroundId] );
+	CountBlit( -1 );
 }
 
-void PlayWindow::Destroy()
+void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayBuffer which hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
-}
+	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to colour invalid sprite id" );
 
-//********************************************************************************************************************************
-// Windows functions
-//********************************************************************************************************************************
+	Sprite& s = vSpriteData[spriteId];
+	uint32_t col = ( ( r & 0xFF ) << 16 ) | ( ( g & 0xFF ) << 8 ) | ( b & 0xFF );
 
-int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow, LPCWSTR windowName )
+	// The shared pixels are read only, so this context gets its own copy to colour
+	if( s.bSharedPreMultAlpha )
+	{
+		s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.preMultAlpha.width ) * s.preMultAlpha.height];
+		s.bSharedPreMultAlpha = false;
+	}
+
+	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, col );
+	s.canvasBuffer.preMultiplied = true;
+}
+
+int PlayGraphics::DrawString( int fontId, Point2f pos, std::string text ) const
 {
-	UNREFERENCED_PARAMETER( hPrevInstance );
-	UNREFERENCED_PARAMETER( lpCmdLine );
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
 
-	WNDCLASSEXW wcex;
+	int width = 0;
 
-	wcex.cbSize = sizeof( WNDCLASSEX );
+	for( char c : text )
+	{
+		Draw( fontId, { pos.x + width, pos.y }, c - 32 );
+		width += GetFontCharWidth( fontId, c );
+	}
+	return width;
+}
 
-	wcex.style = CS_HREDRAW | CS_VREDRAW;
-	wcex.lpfnWndProc = PlayWindow::WndProc;
-	wcex.cbClsExtra = 0;
-	wcex.cbWndExtra = 0;
-	wcex.hInstance = hInstance;
-	wcex.hIcon = LoadIcon( hInstance, IDI_APPLICATION );
-	wcex.hCursor = LoadCursor( nullptr, IDC_ARROW );
-	wcex.hbrBackground = (HBRUSH)( COLOR_WINDOW + 1 );
-	wcex.lpszMenuName = nullptr;
-	wcex.lpszClassName = windowName;
-	wcex.hIconSm = LoadIcon( wcex.hInstance, IDI_APPLICATION );
+int PlayGraphics::DrawStringCentred( int fontId, Point2f pos, std::string text ) const
+{
+	int totalWidth = 0;
 
-	RegisterClassExW( &wcex );
+	for( char c : text )
+		totalWidth += GetFontCharWidth( fontId, c );
 
-	int	w = m_pPlayBuffer->width * m_scale;
-	int h = m_pPlayBuffer->height * m_scale;
+	pos.x -= totalWidth / 2;
 
-	UINT dwStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU;
-	RECT rect = { 0, 0, w, h }; 
-	AdjustWindowRect( &rect, dwStyle, FALSE );
-	HWND hWnd = CreateWindowW( windowName, windowName, dwStyle, CW_USEDEFAULT, CW_USEDEFAULT, rect.right - rect.left, rect.bottom - rect.top, nullptr, nullptr, hInstance, nullptr );
+	DrawString( fontId, pos, text );
+	return totalWidth;
+}
 
-	if( !hWnd )
-		return FALSE;
+int PlayGraphics::DrawChar( int fontId, Point2f pos, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	Draw( fontId, { pos.x, pos.y }, c - 32 );
+	return GetFontCharWidth( fontId, c );
+}
 
-	m_hWindow = hWnd;
+int PlayGraphics::DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	DrawRotated( fontId, { pos.x, pos.y }, c - 32, angle, scale );
+	return GetFontCharWidth( fontId, c );
+}
 
-	ShowWindow( hWnd, nCmdShow );
-	UpdateWindow( hWnd );
+int PlayGraphics::GetFontCharWidth( int fontId, char c ) const
+{
+	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	return (vSpriteData[fontId].canvasBuffer.pPixels + ( c - 32 ))->b; // character width hidden in pixel data
+}
 
-	HACCEL hAccelTable = LoadAccelerators( hInstance, windowName );
 
-	LARGE_INTEGER frequency;        
-	double elapsedTime = 0.0;
-	static LARGE_INTEGER lastDrawTime;
-	LARGE_INTEGER now;
 
-	MSG msg{};
-	bool quit = false;
 
-	// Set up counters for timing the frame
-	QueryPerformanceCounter( &lastDrawTime );
-	QueryPerformanceFrequency( &frequency );
+//********************************************************************************************************************************
+// Function:	SpriteCollide: function that checks by pixel if two sprites collide
+// Parameters:	s1Xpos, s1Ypos, s2Xpos, s2Ypos = the origin of rotation for both sprites.
+//				s1Id, s2Id = the ids of both sprites
+//				s1angle, s2angle = the angle of rotation for both sprites, clockwise. 0 = unrotated.
+//				s1Pixelcoll, s2Pixelcoll = the top left and bottom right co-ordinates defining the collision rectangle of both sprites
+//				
+// Returns: true if a single pixel or more overlap between the two sprites and false if not.
+// Notes:	rounding errors may cause it not to be pixel perfect.	
+//********************************************************************************************************************************
+bool PlayGraphics::SpriteCollide( int id_1, Point2f pos_1, int frame_1, float angle_1, int s1PixelColl[4], int id_2, Point2f pos_2, int frame_2, float angle_2, int s2PixelColl[4] ) const
+{
+	//transform all co-ordinates of sprite2 into the frame of sprite 1.
 
-	// Standard windows message loop
-	while( !quit )
-	{
-		// Hangle windows messages
-		if( PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE ) )
-		{
-			if( msg.message == WM_QUIT )
-				break;
+	//To do this we'll set up three co-ordinate systems.
+	//X,Y are screen, u,v are sprite 1 and a,b are sprite 2.
+	//The input is position of centre of rotation in screen and position of centre of rotation in sprite1 and sprite2.
 
-			if( !TranslateAccelerator( msg.hwnd, hAccelTable, &msg ) )
-			{
-				TranslateMessage( &msg );
-				DispatchMessage( &msg );
-			}
-		}
+	//We define the origin of the sprite1 as the beginning of its buffer.
+	//First I calculate the offset vector for sprite one in the screen.
+	//in sprite offsetu = rotOffX, offsetv = rotOffY.
+	//When I refer to origin of the sprite I mean the 0,0 pixel.
 
-		do
-		{
-			QueryPerformanceCounter( &now );
-			elapsedTime = ( now.QuadPart - lastDrawTime.QuadPart ) * 1000.0 / frequency.QuadPart;
 
-		} while( elapsedTime < 1000.0f / FRAMES_PER_SECOND );
+	//Next define corners of sprite
+	const Sprite& s1 = vSpriteData[id_1];
+	const Sprite& s2 = vSpriteData[id_2];
 
-		// Call the main game update function
-		quit = MainGameUpdate( static_cast<float>( elapsedTime ) / 1000.0f );
-		lastDrawTime = now;
+	//Convert collision box locations from relative to sprite origin to relative to sprite top left. Hence TL.
+	int s1PixelCollTL[4]{ 0 };
+	int s2PixelCollTL[4]{ 0 };
 
-		DwmFlush(); // Waits for DWM compositor to finish
+	for( int i{ 0 }; i < 2; i++ )
+	{
+		s1PixelCollTL[2 * i] = s1PixelColl[2 * i] + s1.originX;
+		s1PixelCollTL[2 * i + 1] = s1PixelColl[2 * i + 1] + s1.originY;
+		s2PixelCollTL[2 * i] = s2PixelColl[2 * i] + s2.originX;
+		s2PixelCollTL[2 * i + 1] = s2PixelColl[2 * i + 1] + s2.originY;
 	}
 
-	// Call the main game cleanup function
-	MainGameExit();
+	//in screen
+	float sinAngle1, cosAngle1;
+	Play::FastSinCos( angle_1, sinAngle1, cosAngle1 );
+	float offsetSprite1X = cosAngle1 * s1.originX - sinAngle1 * s1.originY;
+	float offsetSprite1Y = cosAngle1 * s1.originY + sinAngle1 * s1.originX;
 
-	PLAY_ASSERT( g_pGDIToken );
-	Gdiplus::GdiplusShutdown( g_pGDIToken );
+	//Next I calculate the sprite origin in the screen.
+	float originSprite1X = pos_1.x - offsetSprite1X;
+	float originSprite1Y = pos_1.y - offsetSprite1Y;
 
-	return static_cast<int>( msg.wParam );
-}
+	//Repeat for other sprite.
+	float sinAngle2, cosAngle2;
+	Play::FastSinCos( angle_2, sinAngle2, cosAngle2 );
+	float offsetSprite2X = cosAngle2 * s2.originX - sinAngle2 * s2.originY;
+	float offsetSprite2Y = cosAngle2 * s2.originY + sinAngle2 * s2.originX;
 
-LRESULT CALLBACK PlayWindow::WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
-{
-	switch( message )
-	{
-		case WM_PAINT:
-			PAINTSTRUCT ps;
-			BeginPaint( hWnd, &ps );
-			EndPaint( hWnd, &ps );
-			break;
+	//Next I calculate the sprite origin in the screen.
+	float originSprite2X = pos_2.x - offsetSprite2X;
+	float originSprite2Y = pos_2.y - offsetSprite2Y;
 
-		case WM_DESTROY:
-			PostQuitMessage( 0 );
-			break;
-		case WM_LBUTTONDOWN:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->left = true;
-			break;
-		case WM_LBUTTONUP:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->left = false;
-			break;
-		case WM_RBUTTONDOWN:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->right = true;
-			break;
-		case WM_RBUTTONUP:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->right = false;
-			break;
-		case WM_MOUSEMOVE:
-			if( s_pInstance->m_pMouseData )
-			{
-				s_pInstance->m_pMouseData->pos.x = static_cast<float>( GET_X_LPARAM( lParam ) / s_pInstance->m_scale );
-				s_pInstance->m_pMouseData->pos.y = static_cast<float>( GET_Y_LPARAM( lParam ) / s_pInstance->m_scale );
-			}
-			break;
-		case WM_MOUSELEAVE:
-			s_pInstance->m_pMouseData->pos.x = -1;
-			s_pInstance->m_pMouseData->pos.y = -1;
-			break;
-		default:
-			return DefWindowProc( hWnd, message, wParam, lParam );
-	}
-	return 0;
-}
+	//calculate the difference between two sprite origins in screen
+	float originDiffX = originSprite2X - originSprite1X;
+	float originDiffY = originSprite2Y - originSprite1Y;
 
-double PlayWindow::Present( void )
-{
-	LARGE_INTEGER frequency;
-	LARGE_INTEGER before;
-	LARGE_INTEGER after;
-	QueryPerformanceCounter( &before );
-	QueryPerformanceFrequency( &frequency );
+	//calculation of the difference between two sprite origins in frame of sprite 1.
+	float originDiffu = originDiffX * cosAngle1 + originDiffY * sinAngle1;
+	float originDiffv = originDiffY * cosAngle1 - originDiffX * sinAngle1;
+
+	int s2Width = s2.width;
+	int s2Height = s2.height;
+	int s1Width = s1.width;
 
-	// Set up a BitmapInfo structure to represent the pixel format of the display buffer
-	BITMAPINFOHEADER bitmap_info_header
+	float cosAngleDiff = cos( angle_2 - angle_1 );
+	float sinAngleDiff = sin( angle_2 - angle_1 );
+	//top left, top right, bottom right, bottom left.
+	float s2Cu[4]
 	{
-			sizeof( BITMAPINFOHEADER ),								// size of its own data,
-			m_pPlayBuffer->width, m_pPlayBuffer->height,		// width and height
-			1, 32, BI_RGB,				// planes must always be set to 1 (docs), 32-bit pixel data, uncompressed 
-			0, 0, 0, 0, 0				// rest can be set to 0 as this is uncompressed and has no palette
+		0,
+		s2Width * cosAngleDiff,
+		s2Width * cosAngleDiff - s2Height * sinAngleDiff,
+		-s2Height * sinAngleDiff
 	};
 
-	BITMAPINFO bitmap_info{ bitmap_info_header, { 0,0,0,0 } };	// No palette data required for this bitmap
-
-	HDC hDC = GetDC( m_hWindow );
+	float s2Cv[4]
+	{
+		0,
+		s2Width * sinAngleDiff,
+		s2Width * sinAngleDiff + s2Height * cosAngleDiff,
+		s2Height * cosAngleDiff
+	};
 
-	// Copy the display buffer to the window: GDI only implements up scaling using simple pixel duplication, but that's what we want
-	// Note that GDI+ DrawImage would do the same thing, but it's much slower! 
-	StretchDIBits( hDC, 0, 0, m_pPlayBuffer->width * m_scale, m_pPlayBuffer->height * m_scale, 0, m_pPlayBuffer->height + 1, m_pPlayBuffer->width, -m_pPlayBuffer->height, m_pPlayBuffer->pPixels, &bitmap_info, DIB_RGB_COLORS, SRCCOPY ); // We flip h because Bitmaps store pixel data upside down.
-	
-	ReleaseDC( m_hWindow, hDC );
 
-	QueryPerformanceCounter( &after );
+	float minCu{ std::numeric_limits<float>::infinity() };
+	float minCv{ std::numeric_limits<float>::infinity() };
+	float maxCu{ -std::numeric_limits<float>::infinity() };
+	float maxCv{ -std::numeric_limits<float>::infinity() };
 
-	double elapsedTime = ( after.QuadPart - before.QuadPart ) * 1000.0 / frequency.QuadPart;
+	//calculate the extremes of the rotated sprite2.
+	for( int i = 0; i < 4; i++ )
+	{
+		minCu = std::min( s2Cu[i], minCu );
+		minCv = std::min( s2Cv[i], minCv );
+		maxCu = std::max( s2Cu[i], maxCu );
+		maxCv = std::max( s2Cv[i], maxCv );
+	}
 
-	return elapsedTime;
-}
+	//calculate the maximum and minimum positions in the sprite1 frame of the sprite2 corners.
+	float maxu = (originDiffu)+( maxCu );
+	float maxv = (originDiffv)+( maxCv );
+	float minu = (originDiffu)+( minCu );
+	float minv = (originDiffv)+( minCv );
 
-//********************************************************************************************************************************
-// Loading functions
-//********************************************************************************************************************************
+	if( minu > s1PixelCollTL[2] || minv > s1PixelCollTL[3] || maxu < s1PixelCollTL[0] || maxv < s1PixelCollTL[1] )
+	{
+		return false;
+	}
+	else
+	{
+		//wrap both frame indexes just in case.
+		frame_1 = frame_1 % s1.totalCount;
+		frame_2 = frame_2 % s2.totalCount;
 
-int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
-{
-	// Convert filename from single to wide string for GDI+ compatibility
-	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
-	wchar_t* wcstring = new wchar_t[newsize];
-	size_t convertedChars = 0;
-	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+		//clip so we loop through sprite 1.
+		//Restrict the range we look in for pixel based collisions.
+		minv = ( minv < s1PixelCollTL[1] ) ? static_cast<float>( s1PixelCollTL[1] ) : minv;
+		maxv = ( maxv > s1PixelCollTL[3] ) ? static_cast<float>( s1PixelCollTL[3] ) : maxv;
+		minu = ( minu < s1PixelCollTL[0] ) ? static_cast<float>( s1PixelCollTL[0] ) : minu;
+		maxu = ( maxu > s1PixelCollTL[2] ) ? static_cast<float>( s1PixelCollTL[2] ) : maxu;
 
-	HBITMAP hBitmap = NULL;
+		//Set up the starting position in sprite 2 frame. We know the box corners in u, v relative to the sprite 2 origin but we need to get them in a,b.
+		float minCa = ( minu - originDiffu ) * cosAngleDiff + ( minv - originDiffv ) * sinAngleDiff;
+		float minCb = -( minu - originDiffu ) * sinAngleDiff + ( minv - originDiffv ) * cosAngleDiff;
 
-	// Use GDI+ to load file into Bitmap structure
-	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
-	int status = bitmap->GetLastStatus();
+		//rounding at this point
+		int iminu = static_cast<int>( minu );
+		int iminv = static_cast<int>( minv );
+		int imaxu = static_cast<int>( maxu );
+		int imaxv = static_cast<int>( maxv );
 
-	if( status != Gdiplus::Ok )
-		return -status;
+		float startinga = minCa;
+		float startingb = minCb;
 
-	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+		float rowstarta = startinga;
+		float rowstartb = startingb;
 
-	width = bitmap->GetWidth();
-	height = bitmap->GetHeight();
+		//Set up starting and finishing pointers for both the sprite 1 buffer and sprite 2 buffer 
+		//starting pointer for the sprite 1 buffer is the minu and minv.
+		int sprite1Offset = s1Width * frame_1 + iminu + iminv * s1.canvasBuffer.width;
+		Pixel* sprite1Src = s1.canvasBuffer.pPixels + sprite1Offset;
 
-	delete bitmap;
-	delete[] wcstring;
+		//The base pointer for the sprite2 will just be start of the correct frame in the canvas buffer.
+		int sprite2Offset = s2Width * frame_2;
+		Pixel* sprite2Base = s2.canvasBuffer.pPixels + sprite2Offset;
+		//Define the number which we need to add to get down a row in sprite1.
+		int sprite1ChangeRow = s1.canvasBuffer.width - ( imaxu - iminu );
 
-	return 1;
-}
+		//Start of double for loop.
+		//Go through the overlapping region (warning may go out of the buffer of sprite 2.)
+		for( int v{ iminv }; v < imaxv; v++ )
+		{
+			//store a and b to be the start of the row.
+			float a = rowstarta;
+			float b = rowstartb;
 
-int PlayWindow::LoadPNGImage( std::string& fileAndPath, PixelData& destImage )
-{
-	// Convert filename from single to wide string for GDI+ compatibility
-	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
-	wchar_t* wcstring = new wchar_t[newsize];
-	size_t convertedChars = 0;
-	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+			for( int u{ iminu }; u < imaxu; u++ )
+			{
 
-	HBITMAP hBitmap = NULL;
+				//Edit this part to add a collision box.
+				//If we are in sprite 2 then extract the look at the pixels.
+				if( a >= s2PixelCollTL[0] && b >= s2PixelCollTL[1] && a < s2PixelCollTL[2] && b < s2PixelCollTL[3] )
+				{
+					int sprite2Pixel = static_cast<int>( a ) + static_cast<int>( b ) * s2.canvasBuffer.width;
+					Pixel sprite2Src = *( sprite2Base + sprite2Pixel );
 
-	// Use GDI+ to load file into Bitmap structure
-	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
-	int status = bitmap->GetLastStatus();
+					//If both pixels at that position are opaque then there is a collision. 
+					if( sprite2Src.bits > 0x00FFFFFF && (*sprite1Src).bits > 0x00FFFFFF )
+					{
+						return true;
+					}
 
-	if( status != Gdiplus::Ok )
-		return -status;
+				}
+				//add change in for going along u. go along a row.
+				a += cosAngleDiff;
+				b += -sinAngleDiff;
 
-	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+				sprite1Src++;
 
-	// Create BitmapData structure to pull the data into
-	Gdiplus::BitmapData* bitmapData = new Gdiplus::BitmapData;
+			}
+			//increment for row of sprite 1.
+			sprite1Src += sprite1ChangeRow;
 
-	destImage.width = bitmap->GetWidth();
-	destImage.height = bitmap->GetHeight();
+			//work out start of next row based on start of previous row. 
+			rowstarta += sinAngleDiff;
+			rowstartb += cosAngleDiff;
+		}
+	}
+	return false;
+}
 
-	// Lock the bitmap in advance of reading its data
-	Gdiplus::Rect rect( 0, 0, destImage.width, destImage.height );
-	bitmap->LockBits( &rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, bitmapData );
 
-	// Get a pointer to the actual bit data
-	Pixel* sourcePixels = static_cast<Pixel*>( bitmapData->Scan0 );
 
-	destImage.pPixels = new Pixel[destImage.width * destImage.height];
-	memset( destImage.pPixels, 0, sizeof( Pixel ) * destImage.width * destImage.height );
 
-	Pixel* destPixels = destImage.pPixels;
+//********************************************************************************************************************************
+// Function:	PreMultiplyAlpha - calculates the (src*srcAlpha) alpha blending calculation in advance as it doesn't change
+// Parameters:	s = the sprite to pre-calculate data for
+// Notes:		Also inverts the alpha ready for the (dest*(1-srcAlpha)) calculation and stores information in the new
+//				buffer which provides the number of fully-transparent pixels in a row (so they can be skipped)
+//********************************************************************************************************************************
+void PlayGraphics::PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply = 1.0f, Pixel colourMultiply = 0x00FFFFFF )
+{
+	Pixel* pSourcePixels = source;
+	Pixel* pDestPixels = dest;
 
-	// Copy the data across
-	for( int b = 0; b < destImage.width * destImage.height; b++ )
-		*destPixels++ = *sourcePixels++;
+	// Iterate through all the pixels in the entire canvas
+	for( int bh = 0; bh < height; bh++ )
+	{
+		for( int bw = 0; bw < width; bw++ )
+		{
+			Pixel src = *pSourcePixels;
 
-	//Unlock the bitmap
-	bitmap->UnlockBits( bitmapData );
+			// Separate the channels and calculate src*srcAlpha
+			int srcAlpha = static_cast<int>( ( src.bits >> 24 ) * alphaMultiply );
 
-	delete bitmap;
-	delete bitmapData;
-	delete[] wcstring;
+			int destRed = ( srcAlpha * ( ( src.bits >> 16 ) & 0xFF ) ) >> 8;
+			int destGreen = ( srcAlpha * ( ( src.bits >> 8 ) & 0xFF ) ) >> 8;
+			int destBlue = ( srcAlpha * ( src.bits & 0xFF ) ) >> 8;
 
-	return 1;
-}
+			destRed = ( destRed * ( ( colourMultiply.bits >> 16 ) & 0xFF ) ) >> 8;
+			destGreen = ( destGreen * ( ( colourMultiply.bits >> 8 ) & 0xFF ) ) >> 8;
+			destBlue = ( destBlue * ( colourMultiply.bits & 0xFF ) ) >> 8;
 
-//********************************************************************************************************************************
-// Miscellaneous functions
-//********************************************************************************************************************************
+			srcAlpha = 0xFF - srcAlpha; // invert the alpha ready to multiply with the destination pixels
+			*pDestPixels = ( srcAlpha << 24 ) | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
 
-void AssertFailMessage( const char* message, const char* file, long line )
-{
-	// file - the file in which the assertion failed ( __FILE__ )
-	// line - the line of code where the assertion failed ( __LINE__ )
-	std::filesystem::path p = file;
-	std::string s = p.filename().string() + " : LINE " + std::to_string( line );
-	s += "\n" + std::string( message );
-	int wide_count = MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, NULL, 0 );
-	wchar_t* wide = new wchar_t[wide_count];
-	MultiByteToWideChar( CP_UTF8, 0, s.c_str(), -1, wide, wide_count );
-	MessageBox( NULL, wide, (LPCWSTR)L"Assertion Failure", MB_ICONWARNING );
-	delete[] wide;
-}
+			if( srcAlpha == 0xFF ) // Completely transparent pixel
+			{
+				int repeats = 0;
 
-void DebugOutput( const char* s )
-{
-	OutputDebugStringA( s );
-}
+				// We can only skip to the end of the row because the sprite frames are arranged on a continuous canvas
+				int maxSkip = maxSkipWidth - ( bw % maxSkipWidth );
 
-void DebugOutput( std::string s )
-{
-	OutputDebugStringA( s.c_str() );
-}
+				for( int zw = 1; zw < maxSkip; zw++ )
+				{
+					if( ( pSourcePixels + zw )->bits >> 24 == 0x00 ) // Another transparent pixel
+						repeats++;
+					else
+						break;
+				}
 
-void TracePrintf( const char* file, int line, const char* fmt, ... )
-{
-	constexpr size_t kMaxBufferSize = 512u;
-	char buffer[kMaxBufferSize];
+				*pDestPixels = 0xFF000000 | repeats; // Doesn't matter what the colour was so we use it to store the skip value
+			}
 
-	va_list args;
-	va_start( args, fmt );
-	// format should be double click-able in VS 
-	int len = sprintf_s( buffer, kMaxBufferSize, "%s(%d): ", file, line );
-	vsprintf_s( buffer + len, kMaxBufferSize - len, fmt, args );
-	DebugOutput( buffer );
-	va_end( args );
+			pDestPixels++;
+			pSourcePixels++;
+		}
+	}
 }
 
 //********************************************************************************************************************************
-// File:		PlayBlitter.cpp
-// Description:	A software pixel renderer for drawing 2D primitives into a PixelData buffer
-// Platform:	Independent
+// Basic drawing functions
 //********************************************************************************************************************************
 
 
-PlayBlitter::PlayBlitter( PixelData* pRenderTarget )
+
+void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
 {
-	m_pRenderTarget = pRenderTarget;
+	// Convert floating point co-ordinates to pixels
+	float drawScale = GetDrawScale();
+	m_blitter.DrawPixel( static_cast<int>( pos.x * drawScale + 0.5f ), static_cast<int>( pos.y * drawScale + 0.5f ), srcPix );
 }
 
-
-void PlayBlitter::DrawPixel( int posX, int posY, Pixel srcPix )
+void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
 {
-	if( srcPix.a == 0x00 || posX < 0 || posX >= m_pRenderTarget->width || posY < 0 || posY >= m_pRenderTarget->height )
-		return;
+	// Convert floating point co-ordinates to pixels
+	float drawScale = GetDrawScale();
+	int x1 = static_cast<int>( startPos.x * drawScale + 0.5f );
+	int y1 = static_cast<int>( startPos.y * drawScale + 0.5f );
+	int x2 = static_cast<int>( endPos.x * drawScale + 0.5f );
+	int y2 = static_cast<int>( endPos.y * drawScale + 0.5f );
 
-	Pixel* destPix = &m_pRenderTarget->pPixels[( posY * m_pRenderTarget->width ) + posX];
+	m_blitter.DrawLine( x1, y1, x2, y2, pix );
+}
 
-	if( srcPix.a == 0xFF ) // Completely opaque pixel - no need to blend
+
+
+
+void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
+{
+	// Convert floating point co-ordinates to pixels
+	float drawScale = GetDrawScale();
+	int x1 = static_cast<int>( topLeft.x * drawScale + 0.5f );
+	int x2 = static_cast<int>( bottomRight.x * drawScale + 0.5f );
+	int y1 = static_cast<int>( topLeft.y * drawScale + 0.5f );
+	int y2 = static_cast<int>( bottomRight.y * drawScale + 0.5f );
+
+	if( fill )
 	{
-		*destPix = srcPix.bits;
+		for( int x = x1; x < x2; x++ )
+		{
+			for( int y = y1; y < y2; y++ )
+				m_blitter.DrawPixel( x, y, pix );
+		}
 	}
 	else
 	{
-		Pixel blendPix = *destPix;
-		float srcAlpha = srcPix.a / 255.0f;
-		float oneMinusSrcAlpha = 1.0f - srcAlpha;
-
-		blendPix.a = 0xFF;
-		blendPix.r = static_cast<uint8_t>( ( srcAlpha * srcPix.r ) + ( oneMinusSrcAlpha * blendPix.r ) );
-		blendPix.g = static_cast<uint8_t>( ( srcAlpha * srcPix.g ) + ( oneMinusSrcAlpha * blendPix.g ) );
-		blendPix.b = static_cast<uint8_t>( ( srcAlpha * srcPix.b ) + ( oneMinusSrcAlpha * blendPix.b ) );
-
-		*destPix = blendPix.bits;
+		m_blitter.DrawLine( x1, y1, x2, y1, pix );
+		m_blitter.DrawLine( x2, y1, x2, y2, pix );
+		m_blitter.DrawLine( x2, y2, x1, y2, pix );
+		m_blitter.DrawLine( x1, y2, x1, y1, pix );
 	}
-
-	return;
 }
 
-void PlayBlitter::DrawLine( int startX, int startY, int endX, int endY, Pixel pix )
+// Private function called by DrawCircle
+void PlayGraphics::DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix )
 {
-	//Implementation of Bresenham's Line Drawing Algorithm
-	int dx = abs( endX - startX );
-	int sx = 1;
-	if( endX < startX ) { sx = -1; }
-
-	int dy = -abs( endY - startY );
-	int sy = 1;
-	if( endY < startY ) { sy = -1; }
+	// Already scaled by DrawCircle() so these go straight to the blitter
+	m_blitter.DrawPixel( posX + offX, posY + offY, pix );
+	m_blitter.DrawPixel( posX - offX, posY + offY, pix );
+	m_blitter.DrawPixel( posX + offX, posY - offY, pix );
+	m_blitter.DrawPixel( posX - offX, posY - offY, pix );
+	m_blitter.DrawPixel( posX - offY, posY + offX, pix );
+	m_blitter.DrawPixel( posX + offY, posY - offX, pix );
+	m_blitter.DrawPixel( posX - offY, posY - offX, pix );
+	m_blitter.DrawPixel( posX + offY, posY + offX, pix );
+}
 
-	int err = dx + dy;
+void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix )
+{
+	// Convert floating point co-ordinates to pixels
+	float drawScale = GetDrawScale();
+	int x = static_cast<int>( pos.x * drawScale + 0.5f );
+	int y = static_cast<int>( pos.y * drawScale + 0.5f );
+	radius = static_cast<int>( radius * drawScale + 0.5f );
 
-	if( err == 0 ) return;
+	int dx = 0;
+	int dy = radius;
 
-	int x = startX;
-	int y = startY;
+	int d = 3 - 2 * radius;
+	DrawCircleOctants( x, y, dx, dy, pix );
 
-	while( true )
+	while( dy >= dx )
 	{
-		DrawPixel( x, y, pix );
-
-		if( x == endX && y == endY )
-			break;
-
-		int e2 = 2 * err;
-		if( e2 >= dy )
+		dx++;
+		if( d > 0 )
 		{
-			err += dy;
-			x += sx;
+			dy--;
+			d = static_cast<int>( d + 4 * ( dx - dy ) + 10 );
 		}
-		if( e2 <= dx )
+		else
 		{
-			err += dx;
-			y += sy;
+			d = static_cast<int>( d + 4 * dx + 6 );
 		}
+		DrawCircleOctants( x, y, dx, dy, pix );
 	}
-}
+};
 
-//********************************************************************************************************************************
-// Function:	BlitPixels - draws image data with and without a global alpha multiply
-// Parameters:	spriteId = the id of the sprite to draw
-//				xpos, ypos = the position you want to draw the sprite
-//				frameIndex = which frame of the animation to draw (wrapped)
-// Notes:		Alpha multiply approach is relatively unoptimized
-//********************************************************************************************************************************
-void PlayBlitter::BlitPixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, float alphaMultiply ) const
+void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha )
 {
-	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	if( !pixelData->preMultiplied )
+	{
+		PreMultiplyAlpha( pixelData->pPixels, pixelData->pPixels, pixelData->width, pixelData->height, pixelData->width );
+		pixelData->preMultiplied = true;
+	}
 
-	// Nothing within the display buffer to draw
-	if( blitX > m_pRenderTarget->width || blitX + blitWidth < 0 || blitY > m_pRenderTarget->height || blitY + blitHeight < 0 )
+	float drawScale = GetDrawScale();
+	if( drawScale != 1.0f )
+	{
+		m_blitter.RotateScalePixels( *pixelData, 0, static_cast<int>( pos.x * drawScale ), static_cast<int>( pos.y * drawScale ), pixelData->width, pixelData->height, 0, 0, 0.0f, drawScale, alpha );
+		CountBlit( -1 );
 		return;
+	}
 
-	// Work out if we need to clip to the display buffer (and by how much)
-	int xClipStart = -blitX;
-	if( xClipStart < 0 ) { xClipStart = 0; }
-
-	int xClipEnd = ( blitX + blitWidth ) - m_pRenderTarget->width;
-	if( xClipEnd < 0 ) { xClipEnd = 0; }
+	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.x), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
+	CountBlit( -1 );
+}
 
-	int yClipStart = -blitY;
-	if( yClipStart < 0 ) { yClipStart = 0; }
 
-	int yClipEnd = ( blitY + blitHeight ) - m_pRenderTarget->height;
-	if( yClipEnd < 0 ) { yClipEnd = 0; }
+//********************************************************************************************************************************
+// Debug font functions
+//********************************************************************************************************************************
 
-	// Set up the source and destination pointers based on clipping
-	int destOffset = ( m_pRenderTarget->width * ( blitY + yClipStart ) ) + ( blitX + xClipStart );
-	uint32_t* destPixels = &m_pRenderTarget->pPixels->bits + destOffset;
+// Settings for the embedded debug font
+#define FONT_IMAGE_WIDTH	96
+#define FONT_IMAGE_HEIGHT	36
+#define FONT_CHAR_WIDTH		6
+#define FONT_CHAR_HEIGHT	12
 
-	int srcClipOffset = ( srcPixelData.width * yClipStart ) + xClipStart;
-	uint32_t* srcPixels = &srcPixelData.pPixels->bits + srcOffset + srcClipOffset;
+// A 96x36 font image @ 1bpp containing basic ASCII characters from 0x30 (0) to 0x5F (underscore) at 6x12 pixels each
+static const uint32_t debugFontData[] =
+{
+	0x87304178, 0x0800861F, 0xFFFFFFE1, 0x7BBFBE79, 0xF7FE79EF, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EF, 0xFFEE3DFE, 0x6BB86080,
+	0x1078860F, 0xE3DFFEFE, 0x5BB7FEFB, 0xE7BE7BEF, 0xFFBFFF41, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFDFFEDF, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFEE3DDF, 0x7BB7FEFB, 0xE7BE7BEF, 0xFFFFFFFF, 0x7BB7BEF9, 0xE7BE7BEF,
+	0xFFFFFFDF, 0x87B001F8, 0x187E87EF, 0xFFFFFFDF, 0x86106104, 0x00007A30, 0x1E7C5061, 0x79E79E79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E,
+	0x59E79F79, 0xF7DF7B7F, 0x597DA79E, 0x58005F78, 0x30D0037F, 0x477DA79E, 0x59E79F79, 0xF7DE7B7F, 0x597DA79E, 0x59E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x41E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x7DE79F79,
+	0xF7DE7B7F, 0x5E7DA79E, 0x7DE79E79, 0xF7DE7B7F, 0x5E7DA79E, 0x81E06104, 0x07C17A38, 0xDE01A7A1, 0x06106101, 0xE79E79E0, 0x337F3FFF, 0x79E79EED, 0xE79E79EF, 0xB77FBFFF, 0x79E79FED, 0xE79E79EF,
+	0xB7BFBFFF, 0x79E79FED, 0xE79A79EF, 0xB7BFBFFF, 0x79E75FED, 0xE79AB5EF, 0x77DFBFFF, 0x05E0E1ED, 0xE79ACC0E, 0xF7DFBFFF, 0x7DE77EED, 0xE79AB7ED, 0xF7EFBFFF, 0x7DE7BEED, 0xE79A7BEB, 0xF7EFBFFF,
+	0x7DE7BEED, 0xE79A7BE7, 0xF7F7BFFF, 0x7DA7BEED, 0xE79A7BE7, 0xF7F7BCFF, 0x7DD79EED, 0xEB5A7BE7, 0xF7FBBCFF, 0x7C27A1EE, 0x1CE57810, 0x33FB3EC0
+};
 
-	// Work out in advance how much we need to add to src and dest to reach the next row 
-	int destInc = m_pRenderTarget->width - blitWidth + xClipEnd + xClipStart;
-	int srcInc = srcPixelData.width - blitWidth + xClipEnd + xClipStart;
+void PlayGraphics::DecompressDubugFont( void )
+{
+	m_pDebugFontBuffer = new uint8_t[FONT_IMAGE_WIDTH * FONT_IMAGE_HEIGHT];
 
-	//Work out final pixel in destination.
-	int destColOffset = ( m_pRenderTarget->width * ( blitHeight - yClipEnd - yClipStart - 1 ) ) + ( blitWidth - xClipEnd - xClipStart );
-	uint32_t* destColEnd = destPixels + destColOffset;
+	for( int y = 0; y < FONT_IMAGE_HEIGHT; y++ )
+	{
+		for( int x = 0; x < FONT_IMAGE_WIDTH; x++ )
+		{
+			int bufferIndex = ( y * FONT_IMAGE_WIDTH ) + x;
+			int dataIndex = bufferIndex / 32;
+			int dataShift = 31 - ( bufferIndex % 32 );
 
-	//How many pixels per row in sprite.
-	int endRow = blitWidth - xClipEnd - xClipStart;
+			// Convert 1bpp to an 8-bit array for easy data access
+			if( ( debugFontData[dataIndex] >> dataShift ) & 0x01 )
+				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + x] = 0; // not ARGB just 0 (no pixel)
+			else
+				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + x] = 1; // not ARGB just 1 (a pixel)
+		}
+	}
+}
 
-	if( alphaMultiply < 1.0f )
+int PlayGraphics::DrawDebugCharacter( Point2f pos, char c, Pixel pix )
+{
+	// Limited character set in the font (0x30-0x5F) so includes translation of useful chars outside that range
+	switch( c )
 	{
-		// *******************************************************************************************************************************************************
-		// A basic (unoptimized) approach which separates the channels and performs a 'typical' alpha blending operation: (src * srcAlpha)+(dest * (1-srcAlpha))
-		// Has the advantage that a global alpha multiplication can be easily added over the top, so we use this method when a global multiply is required
-		// *******************************************************************************************************************************************************
-
-		// Slightly more optimised iterations without the additions in the loop
-		while( destPixels < destColEnd )
-		{
-			uint32_t* destRowEnd = destPixels + endRow;
+		case 0x2C: c = 0x5E; break; // Map full stop to comma (nearly the same!)
+		case 0x2D: c = 0x3B; break; // Map minus to semi-colon (rarely used)
+		case 0x28: c = 0x5B; break; // Map brackets to square brackets
+		case 0x29: c = 0x5D; break; // Map brackets to square brackets
+		case 0x2E: c = 0x5E; break; // Map full stop to carot (never used)
+	}
 
-			while( destPixels < destRowEnd )
-			{
-				uint32_t src = *srcPixels++;
-				uint32_t dest = *destPixels;
+	if( c < 0x30 || c > 0x5F )
+		return FONT_CHAR_WIDTH;
 
-				// If this isn't a fully transparent pixel 
-				if( src < 0xFF000000 )
-				{
-					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
-					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+	int sourceX = ( ( c - 0x30 ) % 16 ) * FONT_CHAR_WIDTH;
+	int sourceY = ( ( c - 0x30 ) / 16 ) * FONT_CHAR_HEIGHT;
 
-					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
-					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
-					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
-					int destBlue = constAlpha * ( src & 0xFF );
+	// Loop over the bounding box of the glyph
+	for( int x = 0; x < FONT_CHAR_WIDTH; x++ )
+	{
+		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
+		{
+			if( m_pDebugFontBuffer[( ( sourceY + y ) * FONT_IMAGE_WIDTH ) + ( sourceX + x )] > 0 )
+				DrawPixel( { pos.x + x, pos.y + y }, pix );
+		}
+	}
 
-					int invSrcAlpha = 0xFF - srcAlpha;
+	return FONT_CHAR_WIDTH;
+}
 
-					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
-					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
-					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
-					destBlue += invSrcAlpha * ( dest & 0xFF );
+int PlayGraphics::DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred )
+{
+	if( m_pDebugFontBuffer == nullptr )
+		DecompressDubugFont();
 
-					// Bring back to the range 0-255
-					destRed >>= 8;
-					destGreen >>= 8;
-					destBlue >>= 8;
+	if( centred )
+		pos.x -= GetDebugStringWidth( s ) / 2;
 
-					// Put ARGB components back together again
-					*destPixels++ = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
-				}
-				else
-				{
-					// If this is a fully transparent pixel then the low bits store how many there are in a row
-					// This means we can skip to the next pixel which isn't fully transparent
-					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
-					src = src & 0x00FFFFFF;
-					if( skip > src ) skip = src;
+	pos.y -= 6; // half the height of the debug font
 
-					srcPixels += skip;
-					++destPixels += skip;
-				}
-			}
-			// Increase buffers by pre-calculated amounts
-			destPixels += destInc;
-			srcPixels += srcInc;
-		}
+	for( char c : s )
+		pos.x += DrawDebugCharacter( pos, static_cast<char>( toupper( c ) ), pix ) + 1;
 
-	}
-	else
-	{
-		// *******************************************************************************************************************************************************
-		// An optimized approach which uses pre-multiplied alpha, parallel channel multiplication and pixel skipping to achieve the same 'typical' alpha 
-		// blending operation (src * srcAlpha)+(dest * (1-srcAlpha)). Not easy to apply a global alpha multiplication over the top, but used everywhere else.
-		// *******************************************************************************************************************************************************
+	// Return horizontal position at the end of the string so strings can be concatenated easily
+	return static_cast<int>( pos.x );
+}
 
-		// Slightly more optimised iterations without the additions in the loop
-		while( destPixels < destColEnd )
-		{
-			uint32_t* destRowEnd = destPixels + endRow;
+int PlayGraphics::GetDebugStringWidth( const std::string& s )
+{
+	return static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 );
+}
 
-			while( destPixels < destRowEnd )
-			{
-				uint32_t src = *srcPixels++;
-				uint32_t dest = *destPixels;
+//********************************************************************************************************************************
+// Drawing buffer functions
+//********************************************************************************************************************************
 
-				// If this isn't a fully transparent pixel 
-				if( src < 0xFF000000 )
-				{
-					// This performes the dest*(1-srcAlpha) calculation for all channels in parallel with minor accuracy loss in dest colour.
-					// It does this by shifting all the destination channels down by 4 bits in order to "make room" for the later multiplication.
-					// After shifting down, it masks out the bits which have shifted into the adjacent channel data.
-					// This causes the RGB data to be rounded down to their nearest 16 producing a reduction in colour accuracy.
-					// This is then multiplied by the inverse alpha (inversed in PreMultiplyAlpha), also divided by 16 (hence >> 8+8+8+4).
-					// The multiplication brings our RGB values back up to their original bit ranges (albeit rounded to the nearest 16).
-					// As the colour accuracy only affects the destination pixels behind semi-transparent source pixels and so isn't very obvious.
-					dest = ( ( ( dest >> 4 ) & 0x000F0F0F ) * ( src >> 28 ) );
-					// Add the (pre-multiplied Alpha) source to the destination and force alpha to opaque
-					*destPixels++ = ( src + dest ) | 0xFF000000;
-				}
-				else
-				{
-					// If this is a fully transparent pixel then the low bits store how many there are in a row
-					// This means we can skip to the next pixel which isn't fully transparent
-					uint32_t skip = static_cast<uint32_t>( destRowEnd - destPixels ) - 1;
-					src = src & 0x00FFFFFF;
-					if( skip > src ) skip = src;
+void PlayGraphics::SetDrawingBufferCount( int count )
+{
+	PLAY_ASSERT_MSG( count > 0 && count <= MAX_DRAWING_BUFFERS, "The drawing buffer count must be between 1 and MAX_DRAWING_BUFFERS" );
 
-					srcPixels += skip;
-					++destPixels += skip;
-				}
-			}
-			// Increase buffers by pre-calculated amounts
-			destPixels += destInc;
-			srcPixels += srcInc;
-		}
+	// Keep the current buffer so nothing already drawn this frame is lost
+	std::swap( m_vDrawingBuffers[0], m_vDrawingBuffers[m_drawingBufferIndex] );
+	m_drawingBufferIndex = 0;
 
+	while( GetDrawingBufferCount() > count )
+	{
+		PlayWindow::DestroyDisplayPixels( m_vDrawingBuffers.back() );
+		m_vDrawingBuffers.pop_back();
 	}
 
-	return;
+	while( GetDrawingBufferCount() < count )
+	{
+		Pixel* pPixels = PlayWindow::CreateDisplayPixels( m_bufferWidth, m_bufferHeight );
+		PLAY_ASSERT( pPixels );
+		std::fill_n( pPixels, static_cast<size_t>( m_bufferWidth ) * m_bufferHeight, Pixel( 0 ) );
+		m_vDrawingBuffers.push_back( pPixels );
+	}
+}
+
+Pixel* PlayGraphics::NextDrawingBuffer()
+{
+	Pixel* pFinished = m_vDrawingBuffers[m_drawingBufferIndex];
+	m_drawingBufferIndex = ( m_drawingBufferIndex + 1 ) % GetDrawingBufferCount();
+	m_playBuffer.pPixels = m_vDrawingBuffers[m_drawingBufferIndex];
+	return pFinished;
 }
 
 //********************************************************************************************************************************
-// Function:	RotateScaleSprite - draws a rotated and scaled sprite with global alpha multiply
-// Parameters:	s = the sprite to draw
-//				xpos, ypos = the position of the center of rotation.
-//				frameIndex = which frame of the animation to draw (wrapped)
-//				angle = rotation angle
-//				scale = parameter to magnify the sprite.
-//				rotOffX, rotOffY = offset of centre of rotation to the top left of the sprite
-//				alpha = the fraction defining the amount of sprite and background that is draw. 255 = all sprite, 0 = all background.
-// Notes:		Pre-calculates roughly where the sprite will be in the display buffer and only processes those pixels. 
-//				Approx 15 times slower than not rotating.
+// Render scale functions
 //********************************************************************************************************************************
-void PlayBlitter::RotateScalePixels( const PixelData& srcPixelData, int srcOffset, int blitX, int blitY, int blitWidth, int blitHeight, int originX, int originY, float angle, float scale, float alphaMultiply ) const
+
+// How much of each new frame time goes into the moving average, so a single slow frame doesn't change the scale on its own
+constexpr double DYNAMIC_RESOLUTION_SMOOTHING = 0.1;
+// Frames to wait after a change before another, so the average reflects the new scale
+constexpr int DYNAMIC_RESOLUTION_SETTLE_FRAMES = 30;
+// Fraction of the budget the average frame time has to exceed before the scale drops
+constexpr double DYNAMIC_RESOLUTION_DROP = 0.9;
+// Fraction of the budget the predicted frame time has to be under before the scale rises
+// > Lower than the drop threshold so the scale doesn't flip back and forth between two levels
+constexpr double DYNAMIC_RESOLUTION_RAISE = 0.7;
+
+void PlayGraphics::SetRenderScale( float scale )
 {
-	PLAY_ASSERT_MSG( m_pRenderTarget, "Render target not set for PlayBlitter" );
+	PLAY_ASSERT_MSG( scale > 0.0f && scale <= 1.0f, "The render scale must be more than 0 and no more than 1" );
 
-	//pointers to start of source and destination buffers
-	uint32_t* pSrcBase = &srcPixelData.pPixels->bits + srcOffset;
-	uint32_t* pDstBase = &m_pRenderTarget->pPixels->bits;
+	m_renderScale = scale;
+	m_playBuffer.width = std::max( 1, static_cast<int>( m_bufferWidth * scale + 0.5f ) );
+	m_playBuffer.height = std::max( 1, static_cast<int>( m_bufferHeight * scale + 0.5f ) );
+}
 
-	//the centre of rotation in the sprite frame relative to the top corner
-	float fRotCentreU = static_cast<float>( originX );
-	float fRotCentreV = static_cast<float>( originY );
+void PlayGraphics::SetDynamicResolution( double frameBudgetMs )
+{
+	PLAY_ASSERT_MSG( frameBudgetMs >= 0.0, "The frame budget can't be negative" );
 
-	//u/v are co-ordinates in the rotated sprite frame. x/y are screen buffer co-ordinates.
-	//change in u/v for a unit change in x/y.
-	float dUdX = static_cast<float>( cos( -angle ) ) * ( 1.0f / scale );
-	float dVdX = static_cast<float>( sin( -angle ) ) * ( 1.0f / scale );
-	float dUdY = -dVdX;
-	float dVdY = dUdX;
+	m_frameBudgetMs = frameBudgetMs;
+	m_averageFrameMs = 0.0;
+	m_renderScaleLevel = 0;
+	m_framesSinceScaleChange = 0;
+	SetRenderScale( DYNAMIC_RENDER_SCALES[0] );
+}
 
-	//Position in the sprite rotated frame with origin at the center of rotation of the sprite corners.
-	float leftU = -fRotCentreU * scale;
-	float rightU = ( blitWidth + -fRotCentreU ) * scale;
-	float topV = ( -fRotCentreV ) * scale;
-	float bottomV = ( blitHeight - fRotCentreV ) * scale;
+void PlayGraphics::UpdateDynamicResolution( double frameMs )
+{
+	if( m_frameBudgetMs <= 0.0 )
+		return;
 
-	//Scale added in to cancel out the scale in dUdX.
-	float boundingBoxCorners[4][2]
-	{
-		{ ( dUdX * leftU + dVdX * topV ) * scale,			( dUdY * leftU + dVdY * topV ) * scale		},	// Top left
-		{ ( dUdX * leftU + dVdX * bottomV ) * scale,		( dUdY * leftU + dVdY * bottomV ) * scale		},	// Bottom left
-		{ ( dUdX * rightU + dVdX * bottomV ) * scale,		( dUdY * rightU + dVdY * bottomV ) * scale	},	// Bottom right
-		{ ( dUdX * rightU + dVdX * topV ) * scale,			( dUdY * rightU + dVdY * topV ) * scale,		},	// Top right
-	};
+	m_averageFrameMs += ( frameMs - m_averageFrameMs ) * DYNAMIC_RESOLUTION_SMOOTHING;
 
-	float minX = std::numeric_limits<float>::infinity();
-	float minY = std::numeric_limits<float>::infinity();
-	float maxX = -std::numeric_limits<float>::infinity();
-	float maxY = -std::numeric_limits<float>::infinity();
+	if( ++m_framesSinceScaleChange < DYNAMIC_RESOLUTION_SETTLE_FRAMES )
+		return;
 
-	//calculate the extremes of the rotated corners.
-	for( int i = 0; i < 4; i++ )
+	constexpr int levels = static_cast<int>( sizeof( DYNAMIC_RENDER_SCALES ) / sizeof( DYNAMIC_RENDER_SCALES[0] ) );
+	int level = m_renderScaleLevel;
+
+	if( m_averageFrameMs > m_frameBudgetMs * DYNAMIC_RESOLUTION_DROP && level < levels - 1 )
 	{
-		minX = std::min( minX, boundingBoxCorners[i][0] );
-		maxX = std::max( maxX, boundingBoxCorners[i][0] );
-		minY = std::min( minY, boundingBoxCorners[i][1] );
-		maxY = std::max( maxY, boundingBoxCorners[i][1] );
+		level++;
+	}
+	else if( level > 0 )
+	{
+		// The drawing cost goes roughly with the number of pixels, which goes with the square of the scale
+		double ratio = DYNAMIC_RENDER_SCALES[level - 1] / DYNAMIC_RENDER_SCALES[level];
+		if( m_averageFrameMs * ratio * ratio < m_frameBudgetMs * DYNAMIC_RESOLUTION_RAISE )
+			level--;
 	}
 
-	//clip the starting and finishing positions.
-	int startY = blitY + static_cast<int>( minY );
-	if( startY < 0 ) { startY = 0; minY = static_cast<float>( -blitY ); }
+	if( level == m_renderScaleLevel )
+		return;
 
-	int endY = blitY + static_cast<int>( maxY );
-	if( endY > m_pRenderTarget->height ) { endY = m_pRenderTarget->height; }
+	// Start the average off from the predicted cost at the new scale rather than waiting for it to catch up
+	double ratio = DYNAMIC_RENDER_SCALES[level] / DYNAMIC_RENDER_SCALES[m_renderScaleLevel];
+	m_averageFrameMs *= ratio * ratio;
+	m_renderScaleLevel = level;
+	m_framesSinceScaleChange = 0;
+	SetRenderScale( DYNAMIC_RENDER_SCALES[level] );
+}
 
-	int startX = blitX + static_cast<int>( minX );
-	if( startX < 0 ) { startX = 0; minX = static_cast<float>( -blitX ); }
+//********************************************************************************************************************************
+// Timing bar functions
+//********************************************************************************************************************************
 
-	int endX = blitX + static_cast<int>( maxX );
-	if( endX > m_pRenderTarget->width ) { endX = m_pRenderTarget->width; }
+long long PlayGraphics::EndTimingSegment()
+{
+	int size = static_cast<int>( m_vTimings.size() );
 
-	//rotate the basis so we get the edge of the bounding box in the sprite frame.
-	float startingU = dUdX * minX + dUdY * minY + fRotCentreU;
-	float startingV = dVdY * minY + dVdX * minX + fRotCentreV;
+	// The same clock as the profiler, so the segments line up with its scopes
+	long long now = PlayProfiler::Now();
 
-	float rowU = startingU;
-	float rowV = startingV;
+	if( size > 0 )
+	{
+		m_vTimings[size - 1].end = now;
+		m_vTimings[size - 1].millisecs = static_cast<float>( ( m_vTimings[size - 1].end - m_vTimings[size - 1].begin ) / 1000000.0 );
+	}
 
-	uint32_t* destPixels = pDstBase + ( static_cast<size_t>( m_pRenderTarget->width ) * startY ) + startX;
-	int nextRow = m_pRenderTarget->width - ( endX - startX );
+	return now;
+}
 
-	uint32_t* srcPixels = pSrcBase;
+int PlayGraphics::SetTimingBarColour( Pixel pix )
+{
+	TimingSegment newData;
+	newData.pix = pix;
+	newData.begin = EndTimingSegment();
 
-	//Start of double for loop. 
-	for( int y = startY; y < endY; y++ )
-	{
-		float u = rowU;
-		float v = rowV;
+	m_vTimings.push_back( newData );
 
-		for( int x = startX; x < endX; x++ )
-		{
-			//Check to see if u and v correspond to a valid pixel in sprite.
-			if( u > 0 && v > 0 && u < blitWidth && v < blitHeight )
-			{
-				srcPixels = pSrcBase + static_cast<size_t>( u ) + ( static_cast<size_t>( v ) * srcPixelData.width );
-				uint32_t src = *srcPixels;
+	return static_cast<int>( m_vTimings.size() );
+};
 
-				if( src < 0xFF000000 )
-				{
-					int srcAlpha = static_cast<int>( ( 0xFF - ( src >> 24 ) ) * alphaMultiply );
-					int constAlpha = static_cast<int>( 255 * alphaMultiply );
+void PlayGraphics::DrawTimingBar( Point2f pos, Point2f size )
+{
+	EndTimingSegment();
 
-					// Source pixels are already multiplied by srcAlpha so we just apply the constant alpha multiplier
-					int destRed = constAlpha * ( ( src >> 16 ) & 0xFF );
-					int destGreen = constAlpha * ( ( src >> 8 ) & 0xFF );
-					int destBlue = constAlpha * ( src & 0xFF );
+	int startPixel{ 0 };
+	int endPixel{ 0 };
+	for( const TimingSegment& t : m_vPrevTimings )
+	{
+		endPixel += static_cast<int>( ( size.width * t.millisecs ) / 16.667f );
+		DrawRect( { pos.x + startPixel, pos.y }, { pos.x + endPixel, pos.y + size.height }, t.pix, true );
+		startPixel = endPixel;
+	}
 
-					uint32_t dest = *destPixels;
-					int invSrcAlpha = 0xFF - srcAlpha;
+	DrawRect( { pos.x, pos.y }, { pos.x + size.width, pos.y + size.height }, PIX_BLACK, false );
+	DrawRect( { pos.x - 1, pos.y - 1 }, { pos.x + size.width + 1 , pos.y + size.height + 1 }, PIX_WHITE, false );
+}
 
-					// Apply a standard Alpha blend [ src*srcAlpha + dest*(1-SrcAlpha) ]
-					destRed += invSrcAlpha * ( ( dest >> 16 ) & 0xFF );
-					destGreen += invSrcAlpha * ( ( dest >> 8 ) & 0xFF );
-					destBlue += invSrcAlpha * ( dest & 0xFF );
+float PlayGraphics::GetTimingSegmentDuration( int id ) const
+{
+	PLAY_ASSERT_MSG( static_cast<size_t>(id) < m_vTimings.size(), "Invalid id for timing data." );
+	return m_vTimings[id].millisecs;
+}
 
-					// Bring back to the range 0-255
-					destRed >>= 8;
-					destGreen >>= 8;
-					destBlue >>= 8;
+void PlayGraphics::TimingBarBegin( Pixel pix )
+{
+	EndTimingSegment();
+	m_vPrevTimings = m_vTimings;
+	m_vTimings.clear();
+	SetTimingBarColour( pix );
+}
 
-					// Put ARGB components back together again
-					*destPixels = 0xFF000000 | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
-				}
-			}
+#if PLAY_BLITTER_STATS
 
-			destPixels++;
+//********************************************************************************************************************************
+// Blitter statistics functions
+//********************************************************************************************************************************
 
-			// Change the position in the sprite frame for changing X in the display
-			u += dUdX;
-			v += dVdX;
-		}
+void PlayGraphics::AddBlitStats( int spriteId ) const
+{
+	const BlitStats& blit = m_blitter.GetLastBlitStats();
+	m_blitStats.total += blit;
 
-		// Work out the change in the sprite frame for changing Y in the display
-		rowU += dUdY;
-		rowV += dVdY;
-		// Next row
-		destPixels += nextRow;
+	if( spriteId >= 0 )
+	{
+		if( static_cast<size_t>( spriteId ) >= m_blitStats.vSprites.size() )
+			m_blitStats.vSprites.resize( spriteId + 1 );
+		m_blitStats.vSprites[spriteId] += blit;
 	}
 
+	if( m_blitStatsObjectType != -1 )
+		m_blitStats.objectTypes[m_blitStatsObjectType] += blit;
 }
 
-
-void PlayBlitter::ClearRenderTarget( Pixel colour )
+void PlayGraphics::EndBlitStatsFrame()
 {
-	Pixel* pBuffEnd = m_pRenderTarget->pPixels + ( m_pRenderTarget->width * m_pRenderTarget->height );
-	for( Pixel* pBuff = m_pRenderTarget->pPixels; pBuff < pBuffEnd; *pBuff++ = colour.bits );
-	m_pRenderTarget->preMultiplied = false;
+	std::swap( m_lastFrameBlitStats, m_blitStats );
+	m_lastFramePixelsBlended.store( m_lastFrameBlitStats.total.blended, std::memory_order_relaxed );
+	m_blitStats.total = BlitStats();
+	m_blitStats.vSprites.assign( m_blitStats.vSprites.size(), BlitStats() );
+	m_blitStats.objectTypes.clear();
 }
 
-void PlayBlitter::BlitBackground( PixelData& backgroundImage )
+// The heatmap colour for each overdraw count, with the last used for anything higher
+static const uint32_t OVERDRAW_COLOURS[] =
+{
+	0xFF000000, // Never drawn
+	0xFF0000A0, // Once
+	0xFF00A000,
+	0xFFE0E000,
+	0xFFFF8000,
+	0xFFFF0000,
+	0xFFFF00FF,
+	0xFFFFFFFF, // 7 or more times
+};
+
+void PlayGraphics::EndOverdrawFrame()
 {
-	PLAY_ASSERT_MSG( backgroundImage.height == m_pRenderTarget->height && backgroundImage.width == m_pRenderTarget->width, "Background size doesn't match render target!" );
-	// Takes about 1ms for 720p screen on i7-8550U
-	memcpy( m_pRenderTarget->pPixels, backgroundImage.pPixels, sizeof( Pixel ) * m_pRenderTarget->width * m_pRenderTarget->height );
+	if( m_overdrawView != OVERDRAW_OFF )
+	{
+		constexpr int maxColour = static_cast<int>( sizeof( OVERDRAW_COLOURS ) / sizeof( OVERDRAW_COLOURS[0] ) ) - 1;
+		size_t nPixels = static_cast<size_t>( m_playBuffer.width ) * m_playBuffer.height;
+		unsigned long long total = 0;
+		size_t nHigh = 0;
+		int max = 0;
+
+		for( size_t i = 0; i < nPixels; i++ )
+		{
+			int count = m_vOverdrawCounts[i];
+			total += count;
+			nHigh += ( count > OVERDRAW_HIGH );
+			max = std::max( max, count );
+
+			uint32_t colour = OVERDRAW_COLOURS[std::min( count, maxColour )];
+			uint32_t& pixel = m_playBuffer.pPixels[i].bits;
+			if( m_overdrawView == OVERDRAW_BLEND )
+				pixel = 0xFF000000 | ( ( ( pixel >> 1 ) & 0x007F7F7F ) + ( ( colour >> 1 ) & 0x007F7F7F ) );
+			else
+				pixel = colour;
+		}
+
+		m_lastOverdrawStats.mean = static_cast<float>( static_cast<double>( total ) / nPixels );
+		m_lastOverdrawStats.max = max;
+		m_lastOverdrawStats.percentHigh = static_cast<float>( 100.0 * nHigh / nPixels );
+
+		// Written after the heatmap so it can be read, and without being counted in the next frame's overdraw
+		if( m_overdrawSummaryY >= 0 )
+		{
+			m_blitter.SetOverdrawCounts( nullptr, nullptr );
+			char line[160];
+			snprintf( line, sizeof( line ), "Overdraw mean %.2f max %d over %dx %.1f percent", m_lastOverdrawStats.mean, max, OVERDRAW_HIGH, m_lastOverdrawStats.percentHigh );
+			DrawDebugString( { 11, m_overdrawSummaryY + 1 }, line, PIX_BLACK, false );
+			DrawDebugString( { 10, m_overdrawSummaryY }, line, PIX_YELLOW, false );
+		}
+	}
+	m_overdrawSummaryY = -1;
+
+	OverdrawView view = m_overdrawViewRequest;
+	if( view == OVERDRAW_OFF )
+	{
+		if( m_overdrawView != OVERDRAW_OFF )
+		{
+			m_blitter.SetOverdrawCounts( nullptr, nullptr );
+			std::vector<uint8_t>().swap( m_vOverdrawCounts );
+			m_lastOverdrawStats = OverdrawStats();
+		}
+	}
+	else
+	{
+		// Sized for the full buffer, as the render scale can change between frames
+		m_vOverdrawCounts.assign( static_cast<size_t>( m_bufferWidth ) * m_bufferHeight, 0 );
+		m_blitter.SetOverdrawCounts( &m_playBuffer, m_vOverdrawCounts.data() );
+	}
+	m_overdrawView = view;
 }
 
-
+#endif
 //********************************************************************************************************************************
-// File:		PlayGraphics.cpp
-// Description:	Manages 2D graphics operations on a PixelData buffer 
-// Platform:	Independent
-// Notes:		Uses PNG format. The end of the filename indicates the number of frames e.g. "bat_4.png" or "tiles_10x10.png"
+// File:		PlaySpeaker.cpp
+// Description:	Implementation of a very simple audio manager using the MCI
+// Platform:	Windows / Headless
+// Notes:		Uses MP3 format. The Windows multimedia library is extremely basic, but very quick easy to work with. 
+//				Playback isn't always instantaneous and can trigger small frame glitches when StartSound is called. 
+//				Consider XAudio2 as a potential next step.
+//				The headless platform has nothing to play sounds on, so it checks the names and discards the sound.
 //********************************************************************************************************************************
 
-
-PlayGraphics* PlayGraphics::s_pInstance = nullptr;
+#ifdef PLAY_PLATFORM_WINDOWS
+// Instruct Visual Studio to link the multimedia library  
+#pragma comment(lib, "winmm.lib")
+#endif
 
 //********************************************************************************************************************************
-// Constructor / Destructor (Private)
+// Constructor and destructor (private)
 //********************************************************************************************************************************
-
-PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
+PlayAudio::PlayAudio( const char* path )
 {
-	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
-	m_playBuffer.width = bufferWidth;
-	m_playBuffer.height = bufferHeight;
-	m_playBuffer.pPixels = new Pixel[static_cast<size_t>( bufferWidth ) * bufferHeight];
-	m_playBuffer.preMultiplied = false;
-	PLAY_ASSERT( m_playBuffer.pPixels );
-
-	memset( m_playBuffer.pPixels, 0, sizeof( uint32_t ) * bufferWidth * bufferHeight );
-
-	// Make the display buffer the render target for the blitter
-	m_blitter.SetRenderTarget( &m_playBuffer );
+	std::string nativePath = PlayWindow::NativePath( path );
+	PLAY_ASSERT_MSG( std::filesystem::is_directory( nativePath ), "Audio directory does not exist!" );
 
 	// Iterate through the directory
-	PLAY_ASSERT_MSG( std::filesystem::exists( path ), "PlayBuffer: Drectory provided does not exist." );
-
-	for( const auto& p : std::filesystem::directory_iterator( path ) )
+	for( auto& p : std::filesystem::directory_iterator( nativePath ) )
 	{
 		// Switch everything to uppercase to avoid need to check case each time
 		std::string filename = p.path().string();
 		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
 
-		// Only attempt to load PNG files
-		if( filename.find( ".PNG" ) != std::string::npos )
+		// Only load .mp3 files
+		if( filename.find( ".MP3" ) != std::string::npos )
 		{
-			std::ifstream png_infile;
-			png_infile.open( filename, std::ios::binary ); // Don't do this as part of the constructor or we lose 16 bytes!
+			vSoundStrings.push_back( filename );
+			vSoundLengths.push_back( 0 );
+			vSoundEnds.push_back( std::chrono::steady_clock::time_point() );
+#ifdef PLAY_PLATFORM_WINDOWS
+			std::string command = "open \"" + filename + "\" type mpegvideo alias " + filename;
+			mciSendStringA( command.c_str(), NULL, 0, 0 );
 
-			// If the PNG was opened okay
-			if( png_infile )
-			{
-				int spriteId = LoadSpriteSheet( p.path().parent_path().string() + "\\", p.path().stem().string() );
+			char length[32] = {};
+			command = "status " + filename + " length";
+			if( mciSendStringA( command.c_str(), length, sizeof( length ), 0 ) == 0 )
+				vSoundLengths.back() = atoll( length );
+#endif
+		}
+	}
+}
 
-				// Now we check for .inf file for each sprite and load origins
-				int originX = 0, originY = 0;
+PlayAudio::~PlayAudio( void )
+{
+#ifdef PLAY_PLATFORM_WINDOWS
+	for( std::string& s : vSoundStrings )
+	{
+		std::string command = "close " + s;
+		mciSendStringA( command.c_str(), NULL, 0, 0 );
+	}
+#endif
+}
 
-				std::string info_filename = filename.replace( filename.find( ".PNG" ), 4, ".INF" );
+//********************************************************************************************************************************
+// Instance access functions
+//********************************************************************************************************************************
 
-				if( std::filesystem::exists( info_filename ) )
-				{
-					std::ifstream info_infile;
-					info_infile.open( info_filename, std::ios::in );
+PlayAudio& PlayAudio::Instance()
+{
+	PlayAudio* pInstance = Play::Context::Current().pAudio;
+	PLAY_ASSERT_MSG( pInstance, "Trying to use PlayAudio without initialising it!" );
+	return *pInstance;
+}
 
-					PLAY_ASSERT_MSG( info_infile.is_open(), std::string( "Unable to load existing .inf file: " + info_filename ).c_str() );
-					if( info_infile.is_open() )
-					{
-						std::string type;
-						info_infile >> type;
-						info_infile >> originX;
-						info_infile >> originY;
-					}
+PlayAudio& PlayAudio::Instance( const char* path )
+{
+	PlayAudio*& pInstance = Play::Context::Current().pAudio;
+	PLAY_ASSERT_MSG( !pInstance, "Trying to create multiple instances of singleton class!" );
+	pInstance = new PlayAudio( path );
+	return *pInstance;
+}
 
-					info_infile.close();
-				}
+void PlayAudio::Destroy()
+{
+	PlayAudio*& pInstance = Play::Context::Current().pAudio;
+	PLAY_ASSERT_MSG( pInstance, "Trying to use destroy PlayAudio which hasn't been instanced!" );
+	delete pInstance;
+	pInstance = nullptr;
+}
 
-				SetSpriteOrigin( spriteId, { originX, originY } );
-			}
+//********************************************************************************************************************************
+// Sound playing functions
+//********************************************************************************************************************************
+void PlayAudio::StartAudio( const char* name, bool bLoop )
+{
+	std::string filename( name );
+	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
 
-			png_infile.close();
+	// Iterate through the sound data 
+	for( size_t i = 0; i < vSoundStrings.size(); i++ )
+	{
+		std::string& s = vSoundStrings[i];
+		if( s.find( filename ) != std::string::npos )
+		{
+			vSoundEnds[i] = bLoop ? std::chrono::steady_clock::time_point::max() :
+				std::chrono::steady_clock::now() + std::chrono::milliseconds( vSoundLengths[i] );
+#ifdef PLAY_PLATFORM_WINDOWS
+			std::string command = "play " + s + " from 0";
+			if( bLoop ) command += " repeat";
+			mciSendStringA( command.c_str(), NULL, 0, 0 );
+#else
+			static_cast<void>( bLoop ); // Nothing to play the sound on
+#endif
+			return;
 		}
 	}
+	PLAY_ASSERT_MSG( false, std::string( "Trying to play unknown sound effect: " + std::string( name ) ).c_str() );
 }
 
-PlayGraphics::~PlayGraphics()
+void PlayAudio::StopAudio( const char* name )
 {
-	for( Sprite& s : vSpriteData )
-	{
-		if( s.canvasBuffer.pPixels )
-			delete[] s.canvasBuffer.pPixels;
+	std::string filename( name );
+	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
 
-		if( s.preMultAlpha.pPixels )
-			delete[] s.preMultAlpha.pPixels;
+	// Iterate through the sound data 
+	for( size_t i = 0; i < vSoundStrings.size(); i++ )
+	{
+		std::string& s = vSoundStrings[i];
+		if( s.find( filename ) != std::string::npos )
+		{
+			vSoundEnds[i] = std::chrono::steady_clock::time_point();
+#ifdef PLAY_PLATFORM_WINDOWS
+			std::string command = "stop " + s;
+			mciSendStringA( command.c_str(), NULL, 0, 0 );
+#endif
+			return;
+		}
 	}
+	PLAY_ASSERT_MSG( false, std::string( "Trying to stop unknown sound effect: " + std::string( name ) ).c_str() );
+}
 
-	for( PixelData& pBgBuffer : vBackgroundData )
-		delete[] pBgBuffer.pPixels;
+int PlayAudio::GetVoiceCount() const
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	return static_cast<int>( std::count_if( vSoundEnds.begin(), vSoundEnds.end(),
+		[now]( const std::chrono::steady_clock::time_point& end ) { return end > now; } ) );
+}
+//********************************************************************************************************************************
+// File:		PlayInput.cpp
+// Description:	Manages keyboard and mouse input 
+// Platform:	Windows / Headless
+// Notes:		Obtains mouse data from PlayWindow via MouseData structure. Input can also be scripted.
+//********************************************************************************************************************************
 
-	if( m_pDebugFontBuffer )
-		delete[] m_pDebugFontBuffer;
 
-	delete[] m_playBuffer.pPixels;
+//********************************************************************************************************************************
+// Constructor and destructor (private)
+//********************************************************************************************************************************
+PlayInput::PlayInput( void )
+{
+}
+
+PlayInput::~PlayInput( void )
+{
 }
 
 //********************************************************************************************************************************
-// Instance functions
+// Instance access functions
 //********************************************************************************************************************************
 
-PlayGraphics& PlayGraphics::Instance()
+PlayInput& PlayInput::Instance()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayGraphics without initialising it!" );
-	return *s_pInstance;
+	PlayInput*& pInstance = Play::Context::Current().pInput;
+	if( !pInstance )
+		pInstance = new PlayInput();
+
+	return *pInstance;
 }
 
-PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
+void PlayInput::Destroy()
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
-	return *s_pInstance;
+	PlayInput*& pInstance = Play::Context::Current().pInput;
+	if( pInstance )
+		delete pInstance;
+
+	pInstance = nullptr;
 }
 
-void PlayGraphics::Destroy()
+//********************************************************************************************************************************
+// Mouse functions
+//********************************************************************************************************************************
+
+bool PlayInput::GetMouseDown( MouseButton button ) const
+{
+	PLAY_ASSERT_MSG( button == BUTTON_LEFT || button == BUTTON_RIGHT, "Invalid mouse button selected." );
+
+	if( button == BUTTON_LEFT )
+		return m_mouseData.left;
+	else
+		return m_mouseData.right;
+};
+
+bool PlayInput::KeyPressed( int vKey )
+{
+	bool& held = m_keyPressed[vKey];
+
+	if( KeyDown( vKey ) && !held )
+	{
+		held = true;
+		return true;
+	}
+
+	if( !KeyDown( vKey ) )
+		held = false;
+
+	return false;
+}
+
+bool PlayInput::KeyDown( int vKey )
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	bool bScripted = vKey >= 0 && vKey < 256 && m_keyDown[vKey];
+#ifdef PLAY_PLATFORM_WINDOWS
+	// The recording holds the whole keyboard while replaying
+	return bScripted || ( !m_bReplaying && ( GetAsyncKeyState( vKey ) & 0x8000 ) ); // Don't want multiple calls to KeyState
+#else
+	return bScripted;
+#endif
 }
 
 //********************************************************************************************************************************
-// Loading functions
+// Scripted input functions
 //********************************************************************************************************************************
 
-int PlayGraphics::LoadSpriteSheet( const std::string& path, const std::string& filename )
+void PlayInput::SetKeyDown( int vKey, bool bDown )
 {
-	PixelData canvasBuffer;
-	std::string spriteName = filename;
-	int hCount = 1;
-	int vCount = 1;
+	PLAY_ASSERT_MSG( vKey >= 0 && vKey < 256, "Invalid virtual key code" );
+	if( vKey < 0 || vKey >= 256 )
+		return;
 
-	// Switch everything to uppercase to avoid need to check case each time
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+	m_keyDown[vKey] = bDown;
 
-	// Look for the final number in the filename to pull out the number of frames across the width
-	size_t frameWidthEnd = spriteName.find_last_of( "0123456789" );
-	size_t frameWidthStart = spriteName.find_last_not_of( "0123456789" );
+	if( vKey == VK_LBUTTON )
+		m_mouseData.left = bDown;
+	else if( vKey == VK_RBUTTON )
+		m_mouseData.right = bDown;
+}
 
-	if( frameWidthEnd == spriteName.length() - 1 )
+int PlayInput::KeyFromName( const std::string& name )
+{
+	static const std::map<std::string, int> keyNames = {
+		{ "LBUTTON", VK_LBUTTON }, { "RBUTTON", VK_RBUTTON }, { "BACK", VK_BACK }, { "TAB", VK_TAB }, { "RETURN", VK_RETURN },
+		{ "SHIFT", VK_SHIFT }, { "CONTROL", VK_CONTROL }, { "MENU", VK_MENU }, { "ESCAPE", VK_ESCAPE }, { "SPACE", VK_SPACE },
+		{ "PRIOR", VK_PRIOR }, { "NEXT", VK_NEXT }, { "END", VK_END }, { "HOME", VK_HOME }, { "LEFT", VK_LEFT }, { "UP", VK_UP },
+		{ "RIGHT", VK_RIGHT }, { "DOWN", VK_DOWN }, { "INSERT", VK_INSERT }, { "DELETE", VK_DELETE },
+	};
+
+	std::string upper( name );
+	for( char& c : upper ) c = static_cast<char>( toupper( c ) );
+
+	if( upper.rfind( "VK_", 0 ) == 0 )
+		upper = upper.substr( 3 );
+
+	auto it = keyNames.find( upper );
+	if( it != keyNames.end() )
+		return it->second;
+
+	// Letters and digits use their ASCII codes
+	if( upper.length() == 1 && isalnum( static_cast<unsigned char>( upper[0] ) ) )
+		return upper[0];
+
+	if( upper.length() >= 2 && upper[0] == 'F' && isdigit( static_cast<unsigned char>( upper[1] ) ) )
 	{
-		// Grab the number of frames
-		std::string widthString = spriteName.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+		int f = atoi( upper.c_str() + 1 );
+		return ( f >= 1 && f <= 12 ) ? VK_F1 + f - 1 : -1;
+	}
 
-		// Make sure the number is valid 
-		size_t num = widthString.find_first_of( "0123456789" );
-		PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+	if( isdigit( static_cast<unsigned char>( upper[0] ) ) )
+		return atoi( upper.c_str() );
 
-		hCount = stoi( widthString );
+	return -1;
+}
 
-		if( spriteName[frameWidthStart] == 'X' )
-		{
-			//Two dimensional sprite sheet so the width was actually the height: copy it over and work out the real width
-			vCount = hCount;
+void PlayInput::LoadInputScript( const char* filename )
+{
+	std::ifstream file( PlayWindow::NativePath( filename ) );
+	PLAY_ASSERT_MSG( file.is_open(), std::string( "Unable to open input script: " + std::string( filename ) ).c_str() );
 
-			// Cut off the last number we just found plus an "x", then check for another number indicating a frame height (optional)
-			std::string truncated = spriteName.substr( 0, frameWidthStart );
-			frameWidthEnd = truncated.find_last_of( "0123456789" );
-			frameWidthStart = truncated.find_last_not_of( "0123456789" );
+	m_vScript.clear();
+	m_nextScripted = 0;
 
-			if( frameWidthEnd == truncated.length() - 1 && frameWidthStart != std::string::npos )
-			{
-				// Grab the number of images in the height
-				widthString = truncated.substr( frameWidthStart + 1, frameWidthEnd - frameWidthStart );
+	std::string line;
+	while( std::getline( file, line ) )
+	{
+		std::istringstream words( line );
+		ScriptedInput input;
+		std::string key;
 
-				// Make sure the number is valid
-				num = widthString.find_first_of( "0123456789" );
-				PLAY_ASSERT_MSG( num == 0, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+		if( !( words >> input.frame >> key ) || key[0] == '#' )
+			continue;
 
-				hCount = stoi( widthString );
-			}
-			else
+		// Lines which can't be understood are skipped, as an unknown key would otherwise be taken for a mouse move
+		if( key == "MOUSE" || key == "mouse" )
+		{
+			if( !( words >> input.mousePos.x >> input.mousePos.y ) )
 			{
-				PLAY_ASSERT_MSG( false, std::string( "Incorrectly named sprite: " + filename ).c_str() );
+				DebugOutput( "PlayBuffer: Skipping mouse move without a position in input script: " + line + "\n" );
+				continue;
 			}
 		}
 		else
 		{
-			vCount = 1;
+			std::string state;
+			words >> state;
+			input.vKey = KeyFromName( key );
+			input.bDown = ( state == "down" || state == "DOWN" );
+
+			if( input.vKey < 0 || input.vKey >= 256 )
+			{
+				DebugOutput( "PlayBuffer: Skipping unknown key in input script: " + line + "\n" );
+				continue;
+			}
+			if( !input.bDown && state != "up" && state != "UP" )
+			{
+				DebugOutput( "PlayBuffer: Skipping key without down or up in input script: " + line + "\n" );
+				continue;
+			}
 		}
+
+		m_vScript.push_back( input );
 	}
 
-	std::string fileAndPath( path + spriteName + ".PNG" );
-	PlayWindow::LoadPNGImage( fileAndPath, canvasBuffer ); // Allocates memory as we don't know the size
-	
-	return AddSprite( filename, canvasBuffer, hCount, vCount );
+	// Events for the same frame stay in the order they were written
+	std::stable_sort( m_vScript.begin(), m_vScript.end(), []( const ScriptedInput& a, const ScriptedInput& b ) { return a.frame < b.frame; } );
 }
 
-int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+void PlayInput::RunInputScript( int frame )
 {
-	// Switch everything to uppercase to avoid need to check case each time
-	std::string spriteName = name;
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
+	while( m_nextScripted < m_vScript.size() && m_vScript[m_nextScripted].frame <= frame )
+	{
+		const ScriptedInput& input = m_vScript[m_nextScripted++];
 
-	Sprite s;
-	s.id = m_nTotalSprites++;
-	s.name = spriteName;
-	s.originX = s.originY = 0;
-	s.hCount = hCount;
-	s.vCount = vCount;
-	s.canvasBuffer = pixelData; // copy including pointer to pixel data
+		if( input.vKey < 0 )
+			m_mouseData.pos = input.mousePos;
+		else if( input.vKey < 256 )
+			SetKeyDown( input.vKey, input.bDown );
+	}
 
-	s.totalCount = s.hCount * s.vCount;
-	s.width = s.canvasBuffer.width / s.hCount;
-	s.height = s.canvasBuffer.height / s.vCount;
+	if( m_inputDriver )
+		m_inputDriver( frame );
+}
 
-	// Create a separate buffer with the pre-multiplyied alpha
-	s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
-	s.preMultAlpha.width = s.canvasBuffer.width;
-	s.preMultAlpha.height = s.canvasBuffer.height;
-	memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
-	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
-	s.canvasBuffer.preMultiplied = true;
+//********************************************************************************************************************************
+// Recording and replay functions
+//********************************************************************************************************************************
+
+// The start of every recording: the magic number, the version and the random seed
+constexpr uint32_t RECORDING_MAGIC = 0x43455250; // "PREC"
+constexpr uint32_t RECORDING_VERSION = 1;
 
-	// Add the sprite to our vector
-	vSpriteData.push_back( s );
+void PlayInput::StartRecording( const char* filename, unsigned int seed )
+{
+	m_recording.open( PlayWindow::NativePath( filename ), std::ios::binary );
+	PLAY_ASSERT_MSG( m_recording.is_open(), std::string( "Unable to create input recording: " + std::string( filename ) ).c_str() );
 
-	return s.id;
+	uint32_t header[3] = { RECORDING_MAGIC, RECORDING_VERSION, seed };
+	m_recording.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+
+	// The first frame always writes everything
+	memset( m_recordedKeys, 0xFF, sizeof( m_recordedKeys ) );
+	m_recordedMousePos = { -1.0f, -1.0f };
+	m_recordedTime = -1.0;
 }
 
-int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, int hCount, int vCount )
+unsigned int PlayInput::StartReplay( const char* filename )
 {
-	// Switch everything to uppercase to avoid need to check case each time
-	std::string spriteName = name;
-	for( char& c : spriteName ) c = static_cast<char>( toupper( c ) );
-
-	for( Sprite& s : vSpriteData )
-	{
-		if( s.name.find( spriteName ) != std::string::npos )
-		{
-			// delete the old premultiplied buffer
-			delete s.preMultAlpha.pPixels;
+	std::ifstream file( PlayWindow::NativePath( filename ), std::ios::binary );
+	PLAY_ASSERT_MSG( file.is_open(), std::string( "Unable to open input recording: " + std::string( filename ) ).c_str() );
 
-			s.hCount = hCount;
-			s.vCount = vCount;
-			s.canvasBuffer = pixelData; // copy including pointer to pixel data
+	m_vReplay.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
 
-			s.totalCount = s.hCount * s.vCount;
-			s.width = s.canvasBuffer.width / s.hCount;
-			s.height = s.canvasBuffer.height / s.vCount;
+	uint32_t header[3]{};
+	if( m_vReplay.size() >= sizeof( header ) )
+		memcpy( header, m_vReplay.data(), sizeof( header ) );
+	PLAY_ASSERT_MSG( header[0] == RECORDING_MAGIC && header[1] == RECORDING_VERSION, std::string( "Not an input recording: " + std::string( filename ) ).c_str() );
 
-			// Create a new buffer with the pre-multiplyied alpha
-			s.preMultAlpha.pPixels = new Pixel[static_cast<size_t>( s.canvasBuffer.width ) * s.canvasBuffer.height];
-			s.preMultAlpha.width = s.canvasBuffer.width;
-			s.preMultAlpha.height = s.canvasBuffer.height;
-			memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
-			PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
-			s.canvasBuffer.preMultiplied = true;
+	m_replayPos = sizeof( header );
+	m_bReplaying = true;
+	memset( m_recordedKeys, 0, sizeof( m_recordedKeys ) );
+	return header[2];
+}
 
-			return s.id;
+double PlayInput::UpdateRecording( double elapsedTime )
+{
+	if( m_bReplaying )
+	{
+		// A recording which runs out leaves every key released
+		if( m_replayPos >= m_vReplay.size() )
+		{
+			memset( m_keyDown, 0, sizeof( m_keyDown ) );
+			m_mouseData.left = m_mouseData.right = false;
+			return elapsedTime;
 		}
-	}
 
-	return -1;
-}
+		uint8_t changes = m_vReplay[m_replayPos++];
+		size_t size = ( changes & RECORDED_KEYS ? sizeof( m_recordedKeys ) : 0 ) + ( changes & RECORDED_MOUSE ? 2 * sizeof( float ) : 0 ) + ( changes & RECORDED_TIME ? sizeof( double ) : 0 );
+		PLAY_ASSERT_MSG( m_replayPos + size <= m_vReplay.size(), "The input recording is truncated" );
+		if( m_replayPos + size > m_vReplay.size() )
+		{
+			m_replayPos = m_vReplay.size();
+			return elapsedTime;
+		}
 
+		const uint8_t* pData = m_vReplay.data() + m_replayPos;
+		m_replayPos += size;
 
-int PlayGraphics::LoadBackground( const char* fileAndPath )
-{
-	// The background image may not be the right size for the background so we make sure the buffer is 
-	PixelData backgroundImage;
-	Pixel* pSrc, * pDest;
+		if( changes & RECORDED_KEYS )
+		{
+			memcpy( m_recordedKeys, pData, sizeof( m_recordedKeys ) );
+			pData += sizeof( m_recordedKeys );
+		}
+		if( changes & RECORDED_MOUSE )
+		{
+			memcpy( &m_recordedMousePos.x, pData, sizeof( float ) );
+			memcpy( &m_recordedMousePos.y, pData + sizeof( float ), sizeof( float ) );
+			pData += 2 * sizeof( float );
+		}
+		if( changes & RECORDED_TIME )
+			memcpy( &m_recordedTime, pData, sizeof( double ) );
 
-	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_playBuffer.width ) * m_playBuffer.height];
-	PLAY_ASSERT( correctSizeBuffer );
+		for( int vKey = 0; vKey < 256; vKey++ )
+			m_keyDown[vKey] = ( m_recordedKeys[vKey >> 3] >> ( vKey & 7 ) ) & 1;
+		m_mouseData.left = m_keyDown[VK_LBUTTON];
+		m_mouseData.right = m_keyDown[VK_RBUTTON];
+		m_mouseData.pos = m_recordedMousePos;
 
-	std::string pngFile( fileAndPath );
-	PLAY_ASSERT_MSG( std::filesystem::exists( fileAndPath ), "The background png does not exist at the given location." );
-	PlayWindow::LoadPNGImage( pngFile, backgroundImage ); // Allocates memory in function as we don't know the size
+		return m_recordedTime;
+	}
 
-	pSrc = backgroundImage.pPixels;
-	pDest = correctSizeBuffer;
+	if( !m_recording.is_open() )
+		return elapsedTime;
 
-	//Copy the image to our background buffer clipping where necessary
-	for( int h = 0; h < std::min( backgroundImage.height, m_playBuffer.height ); h++ )
+	uint8_t keys[32]{};
+	for( int vKey = 0; vKey < 256; vKey++ )
 	{
-		for( int w = 0; w < std::min( backgroundImage.width, m_playBuffer.width ); w++ )
-			*pDest++ = *pSrc++;
-
-		// Skip pixels if we're clipping
-		pDest += std::max( m_playBuffer.width - backgroundImage.width, 0 );
-		pSrc += std::max( backgroundImage.width - m_playBuffer.width, 0 );
+		if( KeyDown( vKey ) )
+			keys[vKey >> 3] |= static_cast<uint8_t>( 1 << ( vKey & 7 ) );
 	}
 
-	// Free up the loading buffer
-	delete backgroundImage.pPixels;
-	backgroundImage.pPixels = correctSizeBuffer;
+	uint8_t changes = 0;
+	if( memcmp( keys, m_recordedKeys, sizeof( keys ) ) != 0 )
+		changes |= RECORDED_KEYS;
+	if( m_mouseData.pos.x != m_recordedMousePos.x || m_mouseData.pos.y != m_recordedMousePos.y )
+		changes |= RECORDED_MOUSE;
+	if( elapsedTime != m_recordedTime )
+		changes |= RECORDED_TIME;
 
-	vBackgroundData.push_back( backgroundImage );
+	m_recording.put( static_cast<char>( changes ) );
+	if( changes & RECORDED_KEYS )
+	{
+		memcpy( m_recordedKeys, keys, sizeof( keys ) );
+		m_recording.write( reinterpret_cast<const char*>( keys ), sizeof( keys ) );
+	}
+	if( changes & RECORDED_MOUSE )
+	{
+		m_recordedMousePos = m_mouseData.pos;
+		m_recording.write( reinterpret_cast<const char*>( &m_recordedMousePos.x ), sizeof( float ) );
+		m_recording.write( reinterpret_cast<const char*>( &m_recordedMousePos.y ), sizeof( float ) );
+	}
+	if( changes & RECORDED_TIME )
+	{
+		m_recordedTime = elapsedTime;
+		m_recording.write( reinterpret_cast<const char*>( &m_recordedTime ), sizeof( double ) );
+	}
 
-	return static_cast<int>( vBackgroundData.size() ) - 1;
+	return elapsedTime;
 }
+//********************************************************************************************************************************
+// File:		PlayJobs.cpp
+// Description:	A work-stealing job system shared by everything in PlayBuffer which runs on more than one thread
+// Platform:	Independent
+// Notes:		Each thread has its own queue of jobs and steals from the others when it runs out
+//********************************************************************************************************************************
 
+std::atomic<PlayJobs*> PlayJobs::s_pInstance{ nullptr };
+std::mutex PlayJobs::s_instanceMutex;
+thread_local int PlayJobs::s_threadIndex = -1;
 
 //********************************************************************************************************************************
-// Sprite Getters and Setters
+// Constructor and destructor (private)
 //********************************************************************************************************************************
-int PlayGraphics::GetSpriteId( const char* name ) const
+
+PlayJobs::PlayJobs()
+	// hardware_concurrency can return 0 if it doesn't know
+	: m_vQueues( std::max( 1, PLAY_THREAD_COUNT > 0 ? PLAY_THREAD_COUNT : static_cast<int>( std::thread::hardware_concurrency() ) ) )
 {
-	std::string tofind( name );
-	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+	// The thread which creates PlayJobs is the main thread and uses queue 0
+	s_threadIndex = 0;
 
-	for( const Sprite& s : vSpriteData )
-	{
-		if( s.name.find( tofind ) != std::string::npos )
-			return s.id;
-	}
-	PLAY_ASSERT_MSG( false, "The sprite name is invalid!" );
-	return -1;
+	for( int i = 1; i < GetThreadCount(); i++ )
+		m_vWorkers.emplace_back( &PlayJobs::WorkerLoop, this, i );
 }
 
-const std::string& PlayGraphics::GetSpriteName( int spriteId )
+PlayJobs::~PlayJobs()
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get name of invalid sprite id" );
-	return vSpriteData[spriteId].name;
+	{
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+		m_bQuit = true;
+	}
+	m_sleepCondition.notify_all();
+
+	for( std::thread& worker : m_vWorkers )
+		worker.join();
+
+	s_threadIndex = -1;
 }
 
-Vector2f PlayGraphics::GetSpriteSize( int spriteId ) const
+//********************************************************************************************************************************
+// Instance functions
+//********************************************************************************************************************************
+
+PlayJobs& PlayJobs::Instance()
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get width of invalid sprite id" );
-	return { vSpriteData[spriteId].width, vSpriteData[spriteId].height };
+	PlayJobs* pInstance = s_pInstance;
+	if( pInstance )
+		return *pInstance;
+
+	std::lock_guard<std::mutex> lock( s_instanceMutex );
+	if( !s_pInstance )
+		s_pInstance = new PlayJobs();
+
+	return *s_pInstance;
 }
 
-int PlayGraphics::GetSpriteFrames( int spriteId ) const
+void PlayJobs::Destroy()
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get frames of invalid sprite id" );
-	return vSpriteData[spriteId].totalCount;
+	std::lock_guard<std::mutex> lock( s_instanceMutex );
+	delete s_pInstance.exchange( nullptr );
 }
 
-Vector2f PlayGraphics::GetSpriteOrigin( int spriteId ) const
+//********************************************************************************************************************************
+// Job functions
+//********************************************************************************************************************************
+
+void PlayJobs::Run( std::function<void()> fn, JobCounter* pCounter )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to get origin with invalid sprite id" );
-	return { vSpriteData[spriteId].originX, vSpriteData[spriteId].originY };
+	if( pCounter )
+		pCounter->m_count++;
+
+	Push( { std::move( fn ), pCounter, &Play::Context::Current() } );
 }
 
-void PlayGraphics::SetSpriteOrigin( int spriteId, Vector2f newOrigin, bool relative )
+void PlayJobs::RunAfter( JobCounter& dependency, std::function<void()> fn, JobCounter* pCounter )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to set origin with invalid sprite id" );
-	if( relative )
-	{
-		vSpriteData[spriteId].originX += static_cast<int>( newOrigin.x );
-		vSpriteData[spriteId].originY += static_cast<int>( newOrigin.y );
-	}
-	else
+	if( pCounter )
+		pCounter->m_count++;
+
 	{
-		vSpriteData[spriteId].originX = static_cast<int>( newOrigin.x );
-		vSpriteData[spriteId].originY = static_cast<int>( newOrigin.y );
+		// FinishJob takes the same lock after the count reaches zero, so the job can't be missed
+		std::lock_guard<std::mutex> lock( dependency.m_mutex );
+		if( dependency.m_count > 0 )
+		{
+			dependency.m_vContinuations.push_back( { std::move( fn ), pCounter, &Play::Context::Current() } );
+			return;
+		}
 	}
-}
-
-void PlayGraphics::CentreSpriteOrigin( int spriteId )
-{
-	SetSpriteOrigin( spriteId, GetSpriteSize( spriteId ) / 2 );
-}
 
-void PlayGraphics::CentreAllSpriteOrigins( void )
-{
-	for( Sprite& s : vSpriteData )
-		CentreSpriteOrigin( s.id );
+	Push( { std::move( fn ), pCounter, &Play::Context::Current() } );
 }
 
-void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, bool relative )
+void PlayJobs::Wait( JobCounter& counter )
 {
-	std::string tofind( rootName );
-	for( char& c : tofind ) c = static_cast<char>( toupper( c ) );
+	int threadIndex = GetThreadIndex();
+	int nIdle = 0;
 
-	for( Sprite& s : vSpriteData )
+	while( !counter.IsDone() )
 	{
-		if( s.name.find( tofind ) != std::string::npos )
+		if( RunOneJob( threadIndex ) )
 		{
-			if( relative )
-			{
-				s.originX += static_cast<int>( newOrigin.x );
-				s.originY += static_cast<int>( newOrigin.y );
-			}
-			else
-			{
-				s.originX = static_cast<int>( newOrigin.x );
-				s.originY = static_cast<int>( newOrigin.y );
-			}
+			nIdle = 0;
+			continue;
 		}
+
+		// The jobs we are waiting for are running on other threads
+		// > They're usually short so yielding catches the end quickly, but a long one shouldn't keep this core spinning
+		if( ++nIdle < WAIT_YIELDS )
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for( std::chrono::microseconds( WAIT_SLEEP_US ) );
 	}
-}
 
-//********************************************************************************************************************************
-// Drawing functions
-//********************************************************************************************************************************
+	// Makes sure FinishJob has let go of the counter before the caller is allowed to destroy it
+	std::lock_guard<std::mutex> lock( counter.m_mutex );
+}
 
-void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
+void PlayJobs::ParallelFor( int nChunks, const std::function<void( int )>& fn )
 {
-	const Sprite& spr = vSpriteData[spriteId];
-	int destx = static_cast<int>( pos.x + 0.5f ) - spr.originX;
-	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
-	frameIndex = frameIndex % spr.totalCount;
-	int frameX = frameIndex % spr.hCount;
-	int frameY = frameIndex / spr.hCount;
-	int pixelX = frameX * spr.width;
-	int pixelY = frameY * spr.height;
-	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+	if( nChunks <= 0 )
+		return;
 
-	m_blitter.BlitPixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, alphaMultiply );
-};
+	// Not worth queueing anything for
+	if( nChunks == 1 || m_vWorkers.empty() )
+	{
+		for( int i = 0; i < nChunks; i++ )
+			fn( i );
+		return;
+	}
 
-void PlayGraphics::DrawRotated( int spriteId, Point2f pos, int frameIndex, float angle, float scale, float alphaMultiply ) const
-{
-	const Sprite& spr = vSpriteData[spriteId];
-	int destx = static_cast<int>( pos.x + 0.5f );
-	int desty = static_cast<int>( pos.y + 0.5f );
-	frameIndex = frameIndex % spr.totalCount;
-	int frameX = frameIndex % spr.hCount;
-	int frameY = frameIndex / spr.hCount;
-	int pixelX = frameX * spr.width;
-	int pixelY = frameY * spr.height;
-	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
+	JobCounter counter;
 
-	m_blitter.RotateScalePixels( spr.preMultAlpha, frameOffset, destx, desty, spr.width, spr.height, spr.originX, spr.originY, angle, scale, alphaMultiply );
-}
+	// This thread takes the first chunk itself, so only the rest need to be queued
+	for( int i = 1; i < nChunks; i++ )
+		Run( [&fn, i]() { fn( i ); }, &counter );
 
+	fn( 0 );
+	Wait( counter );
+}
 
-void PlayGraphics::DrawBackground( int backgroundId )
+void PlayJobs::Push( Job&& job )
 {
-	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
-	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
-	m_blitter.BlitBackground( vBackgroundData[backgroundId] );
+	JobQueue& queue = m_vQueues[GetThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		queue.jobs.push_back( std::move( job ) );
+	}
+	m_nQueuedJobs++;
+
+	// Taking the lock makes sure a worker which is about to sleep sees the new job first
+	{
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+	}
+	m_sleepCondition.notify_one();
 }
 
-void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
+bool PlayJobs::RunOneJob( int threadIndex )
 {
-	PLAY_ASSERT_MSG( spriteId >= 0 && spriteId < m_nTotalSprites, "Trying to colour invalid sprite id" );
+	Job job;
+	bool bFound = false;
+	int nQueues = GetThreadCount();
 
-	Sprite& s = vSpriteData[spriteId];
-	uint32_t col = ( ( r & 0xFF ) << 16 ) | ( ( g & 0xFF ) << 8 ) | ( b & 0xFF );
+	// Newest job from our own queue first, as its data is most likely to still be in the cache
+	{
+		JobQueue& queue = m_vQueues[threadIndex];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if( !queue.jobs.empty() )
+		{
+			job = std::move( queue.jobs.back() );
+			queue.jobs.pop_back();
+			bFound = true;
+		}
+	}
 
-	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, col );
-	s.canvasBuffer.preMultiplied = true;
-}
+	// Otherwise steal the oldest job from somebody else
+	for( int i = 1; i < nQueues && !bFound; i++ )
+	{
+		JobQueue& queue = m_vQueues[( threadIndex + i ) % nQueues];
+		std::lock_guard<std::mutex> lock( queue.mutex );
+		if( !queue.jobs.empty() )
+		{
+			job = std::move( queue.jobs.front() );
+			queue.jobs.pop_front();
+			bFound = true;
+		}
+	}
 
-int PlayGraphics::DrawString( int fontId, Point2f pos, std::string text ) const
-{
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
+	if( !bFound )
+		return false;
 
-	int width = 0;
+	m_nQueuedJobs--;
 
-	for( char c : text )
+	// Jobs can be taken from other contexts' queues, so each runs in the context it was queued from
+	Play::Context* pPrevious = job.pContext->MakeCurrent();
 	{
-		Draw( fontId, { pos.x + width, pos.y }, c - 32 );
-		width += GetFontCharWidth( fontId, c );
+		PLAY_PROFILE_SCOPE( "Job" );
+		job.fn();
 	}
-	return width;
+	FinishJob( job.pCounter );
+	pPrevious->MakeCurrent();
+	return true;
 }
 
-int PlayGraphics::DrawStringCentred( int fontId, Point2f pos, std::string text ) const
+void PlayJobs::FinishJob( JobCounter* pCounter )
 {
-	int totalWidth = 0;
-
-	for( char c : text )
-		totalWidth += GetFontCharWidth( fontId, c );
+	if( !pCounter )
+		return;
 
-	pos.x -= totalWidth / 2;
+	std::vector<JobCounter::Continuation> vContinuations;
+	{
+		std::lock_guard<std::mutex> lock( pCounter->m_mutex );
+		if( --pCounter->m_count > 0 )
+			return;
+		vContinuations.swap( pCounter->m_vContinuations );
+	}
 
-	DrawString( fontId, pos, text );
-	return totalWidth;
+	// The counter may belong to a Wait which has now returned, so it mustn't be touched after this point
+	for( JobCounter::Continuation& c : vContinuations )
+		Push( { std::move( c.fn ), c.pCounter, c.pContext } );
 }
 
-int PlayGraphics::DrawChar( int fontId, Point2f pos, char c ) const
+void PlayJobs::WorkerLoop( int threadIndex )
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	Draw( fontId, { pos.x, pos.y }, c - 32 );
-	return GetFontCharWidth( fontId, c );
+	s_threadIndex = threadIndex;
+
+	for( ;; )
+	{
+		if( RunOneJob( threadIndex ) )
+			continue;
+
+		std::unique_lock<std::mutex> lock( m_sleepMutex );
+		m_sleepCondition.wait( lock, [&] { return m_bQuit || m_nQueuedJobs > 0; } );
+
+		if( m_bQuit )
+			return;
+	}
 }
+//********************************************************************************************************************************
+// File:		PlayManager.cpp
+// Description:	A manager for providing simplified access to the PlayBuffer framework
+// Platform:	Independent
+// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+//********************************************************************************************************************************
+
+//**************************************************************************************************
+// GameObject Class Definition
+//**************************************************************************************************
+
+thread_local PlayRandomScope* PlayRandomScope::s_pCurrent = nullptr;
+
+// Define this to opt in to the PlayManager
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
 
-int PlayGraphics::DrawCharRotated( int fontId, Point2f pos, float angle, float scale, char c ) const
+namespace Play
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	DrawRotated( fontId, { pos.x, pos.y }, c - 32, angle, scale );
-	return GetFontCharWidth( fontId, c );
+	// Gets the key for the next piece of work to be split between threads (see PlayRandomScope)
+	static uint64_t NextRandomWorkKey();
 }
 
-int PlayGraphics::GetFontCharWidth( int fontId, char c ) const
+// Constructor for the GameObject struct - kept as simple as possible
+GameObject::GameObject( int type, Point2f newPos, int collisionRadius, int spriteId = 0 )
+	: type( type, this ), pos( newPos ), oldPos( newPos ), radius( collisionRadius ), spriteId( spriteId )
 {
-	PLAY_ASSERT_MSG( fontId >= 0 && fontId < m_nTotalSprites, "Trying to use invalid sprite id for font" );
-	return (vSpriteData[fontId].canvasBuffer.pPixels + ( c - 32 ))->b; // character width hidden in pixel data
+	// Member variables are assigned default values in the class header
+	// The unique id is assigned by PlayObjects when the object is created in its pool
 }
 
+//**************************************************************************************************
+// PlayObjects Class Definition
+//**************************************************************************************************
 
-
-
-//********************************************************************************************************************************
-// Function:	SpriteCollide: function that checks by pixel if two sprites collide
-// Parameters:	s1Xpos, s1Ypos, s2Xpos, s2Ypos = the origin of rotation for both sprites.
-//				s1Id, s2Id = the ids of both sprites
-//				s1angle, s2angle = the angle of rotation for both sprites, clockwise. 0 = unrotated.
-//				s1Pixelcoll, s2Pixelcoll = the top left and bottom right co-ordinates defining the collision rectangle of both sprites
-//				
-// Returns: true if a single pixel or more overlap between the two sprites and false if not.
-// Notes:	rounding errors may cause it not to be pixel perfect.	
-//********************************************************************************************************************************
-bool PlayGraphics::SpriteCollide( int id_1, Point2f pos_1, int frame_1, float angle_1, int s1PixelColl[4], int id_2, Point2f pos_2, int frame_2, float angle_2, int s2PixelColl[4] ) const
+// Stores all the managed GameObjects and keeps track of them by their unique id and by their type
+// > GameObjects are constructed in pages of recycled slots, so creating and destroying them doesn't touch the heap
+// > An object's id combines its slot with a generation count, so ids of destroyed objects are never found again
+// > ResetWorld drops whole levels at once by moving the pool on to a new epoch: slots from an old epoch are just free space
+// > Every type has its own list so type queries don't have to search through every object
+// > A singleton class accessed using PlayObjects::Instance()
+class PlayObjects
 {
-	//transform all co-ordinates of sprite2 into the frame of sprite 1.
-
-	//To do this we'll set up three co-ordinate systems.
-	//X,Y are screen, u,v are sprite 1 and a,b are sprite 2.
-	//The input is position of centre of rotation in screen and position of centre of rotation in sprite1 and sprite2.
+public:
+	// Creates / Returns the PlayObjects instance
+	static PlayObjects& Instance();
+	// Destroys the PlayObjects instance (and all of the GameObjects it is managing)
+	static void Destroy();
 
-	//We define the origin of the sprite1 as the beginning of its buffer.
-	//First I calculate the offset vector for sprite one in the screen.
-	//in sprite offsetu = rotOffX, offsetv = rotOffY.
-	//When I refer to origin of the sprite I mean the 0,0 pixel.
+	// Constructs a new GameObject in a free slot and starts managing it
+	GameObject& Create( int type, Point2f pos, int collisionRadius, int spriteId );
+	// Destroys a managed GameObject immediately and recycles its slot
+	void Release( GameObject& obj );
+	// Flags a managed GameObject to be destroyed by the next call to FlushDestroyQueue
+	// > The object stays in place (and in its type list) until then, so Find and the draws still see it
+	void QueueDestroy( GameObject& obj );
+	// Destroys all the queued GameObjects in a single pass
+	void FlushDestroyQueue();
+	// Makes sure count objects of the given type can be created without any further allocations
+	void Reserve( int type, int count );
+	// Stores an archetype and returns its id
+	int RegisterArchetype( const GameObjectArchetype& archetype );
+	// Creates count GameObjects from an archetype in one go, calling the initializer on each of them
+	int SpawnBatch( int archetypeId, int count, PlayFunctionRef<void( GameObject&, int )> initializer );
+	// Drops every GameObject whose type isn't in keepTypes without visiting them
+	// > Their slots are recycled (and their destructors run) when they are next needed by Create
+	void ResetWorld( const std::vector<int>& keepTypes );
+	// Moves a managed GameObject from the list for its old type to the list for its new type
+	// > Called whenever a GameObject's type is changed, so it does nothing for objects which aren't managed (e.g. noObject)
+	static void OnTypeChanged( GameObject& obj );
+	// Calls fn on every GameObject of the given type using PlayJobs
+	// > Creating objects and changing their types only update the type lists after all the objects have been visited
+	void ParallelForEach( int type, const std::function<void( GameObject& )>& fn );
+	// Starts deferring changes to the type lists so that several threads can work on GameObjects at once
+	// > Returns false if changes were already being deferred, in which case the caller shouldn't call EndDeferredChanges
+	bool BeginDeferredChanges();
+	// Stops deferring changes and applies the ones which were made in the meantime
+	void EndDeferredChanges();
+
+	// Finds the GameObject with the given id
+	// > Returns nullptr if there isn't one
+	// > Safe to call from any thread while objects are being created in parallel
+	GameObject* Find( int id ) const;
+	// Finds the first GameObject in the list for the given type
+	// > Returns nullptr if there isn't one
+	GameObject* FindFirstOfType( int type );
+	// Gets a view of the ids in the list for the given type
+	GameObjectIdSpan GetIdsOfType( int type );
+	// Collects the ids of all the GameObjects in the order they were created, whichever slots they are in
+	std::vector<int> CollectAllIds() const;
+	// Calls fn( type, count ) for every type which has objects in its list, negative types first
+	template< typename Fn > void ForEachTypeCount( Fn fn )
+	{
+		CompactTypeLists();
+		for( const std::pair<const int, TypeList>& i : m_negativeTypeLists )
+			if( !i.second.objects.empty() ) fn( i.first, static_cast<int>( i.second.objects.size() ) );
+		for( size_t t = 0; t < m_typeLists.size(); t++ )
+			if( !m_typeLists[t].objects.empty() ) fn( static_cast<int>( t ), static_cast<int>( m_typeLists[t].objects.size() ) );
+	}
 
+private:
+	PlayObjects();
+	~PlayObjects();
+	PlayObjects& operator=( const PlayObjects& ) = delete;
+	PlayObjects( const PlayObjects& ) = delete;
+
+	// Ids are made up of a slot index in the low bits and the slot's generation in the high bits
+	// > A slot is retired once its generation reaches GENERATION_MASK, rather than wrapping round to ids which were used before
+	static constexpr int SLOT_BITS = 20;
+	static constexpr int SLOT_MASK = ( 1 << SLOT_BITS ) - 1;
+	static constexpr int GENERATION_MASK = 0x7FF; // Keeps ids positive
+	static constexpr int SLOTS_PER_PAGE = 256;
+	static constexpr int MAX_PAGES = ( SLOT_MASK + 1 ) / SLOTS_PER_PAGE;
+
+	enum SlotState : uint8_t
+	{
+		SLOT_FREE = 0,
+		SLOT_LIVE,
+		SLOT_DESTROY_QUEUED,
+		SLOT_RETIRED, // Every generation has been used, so it's never used again
+	};
 
-	//Next define corners of sprite
-	const Sprite& s1 = vSpriteData[id_1];
-	const Sprite& s2 = vSpriteData[id_2];
+	// The memory for one GameObject along with its bookkeeping
+	// > A live or queued slot holds a constructed object, but it's only live if it belongs to the current epoch
+	struct Slot
+	{
+		alignas( GameObject ) unsigned char memory[sizeof( GameObject )];
+		uint32_t epoch{ 0 };
+		// When the slot's object was created, counting every object the pool has created
+		uint32_t created{ 0 };
+		uint16_t generation{ 0 };
+		// Set by QueueDestroy while other threads may be looking the object up
+		std::atomic<SlotState> state{ SLOT_FREE };
 
-	//Convert collision box locations from relative to sprite origin to relative to sprite top left. Hence TL.
-	int s1PixelCollTL[4]{ 0 };
-	int s2PixelCollTL[4]{ 0 };
+		GameObject& Object() { return *reinterpret_cast<GameObject*>( memory ); }
+	};
 
-	for( int i{ 0 }; i < 2; i++ )
+	// An object created or changed while the type lists were being iterated over, and the chunk of work which did it
+	struct DeferredObject
 	{
-		s1PixelCollTL[2 * i] = s1PixelColl[2 * i] + s1.originX;
-		s1PixelCollTL[2 * i + 1] = s1PixelColl[2 * i + 1] + s1.originY;
-		s2PixelCollTL[2 * i] = s2PixelColl[2 * i] + s2.originX;
-		s2PixelCollTL[2 * i + 1] = s2PixelColl[2 * i + 1] + s2.originY;
-	}
-
-	//in screen
-	float cosAngle1 = cos( angle_1 );
-	float sinAngle1 = sin( angle_1 );
-	float offsetSprite1X = cosAngle1 * s1.originX - sinAngle1 * s1.originY;
-	float offsetSprite1Y = cosAngle1 * s1.originY + sinAngle1 * s1.originX;
+		GameObject* pObj;
+		uint64_t chunk;
+		uint64_t change;
+	};
 
-	//Next I calculate the sprite origin in the screen.
-	float originSprite1X = pos_1.x - offsetSprite1X;
-	float originSprite1Y = pos_1.y - offsetSprite1Y;
+	// The addresses of all the objects of one type in the order they were added (their ids are read from the objects)
+	// > Objects which have been removed leave a null gap until the list is next looked at
+	struct TypeList
+	{
+		std::vector<GameObject*> objects;
+		// The first gap left by RemoveFromTypeList (-1 if there aren't any)
+		int firstGap{ -1 };
+		// Whether the type is in m_vGappedTypes, which it stays in even if its gaps are closed before CompactTypeLists
+		bool bInGappedTypes{ false };
+	};
 
-	//Repeat for other sprite.
-	float cosAngle2 = cos( angle_2 );
-	float sinAngle2 = sin( angle_2 );
-	float offsetSprite2X = cosAngle2 * s2.originX - sinAngle2 * s2.originY;
-	float offsetSprite2Y = cosAngle2 * s2.originY + sinAngle2 * s2.originX;
+	// Gets the slot with the given index
+	Slot& GetSlot( int slot ) const { return m_vPages[slot / SLOTS_PER_PAGE][slot % SLOTS_PER_PAGE]; }
+	// Checks whether the slot holds a constructed object, which may have been dropped by ResetWorld
+	static bool HoldsObject( const Slot& s ) { SlotState state = s.state; return state == SLOT_LIVE || state == SLOT_DESTROY_QUEUED; }
+	// Checks whether the slot holds an object which hasn't been destroyed or dropped by ResetWorld
+	bool IsLive( const Slot& s ) const { return HoldsObject( s ) && s.epoch == m_epoch; }
+	// Checks whether an object is in a type list, which objects dropped by ResetWorld aren't even though they still have a list index
+	bool IsManaged( const GameObject& obj ) const { return obj.m_typeSlot >= 0 && IsLive( GetSlot( obj.m_id & SLOT_MASK ) ); }
+	// Checks whether a new object can go in the slot, retiring it instead if its generation has run out
+	bool IsReusable( Slot& s );
+	// Finds a slot which isn't live, adding a new one if there aren't any
+	int AllocateSlot();
+	// Adds pages of slots using a single allocation
+	void AddPages( int nPages );
+	// Gets the list for the given type, creating it if it doesn't exist yet
+	TypeList& GetTypeList( int type );
+	// Gets the list for the given type if it exists
+	const TypeList* FindTypeList( int type ) const;
+	// Gets the list for the given type if it exists, closing any gaps in it first
+	const TypeList* FindCompactTypeList( int type );
+	// Adds an object to the end of the list for its type
+	void AddToTypeList( GameObject& obj );
+	// Removes an object from the list it is in, leaving a gap so the other objects stay in order
+	// > The gap is only closed when the list is next looked at, so removing lots of objects moves each of the others at most once
+	void RemoveFromTypeList( GameObject& obj );
+	// Closes the gaps left in one list by RemoveFromTypeList
+	void CompactTypeList( TypeList& list );
+	// Closes the gaps left in all the lists by RemoveFromTypeList
+	void CompactTypeLists();
+	// Destroys an object and recycles its slot, leaving a gap in its type list
+	void FreeObject( GameObject& obj );
+	// Updates the type lists for the objects created or changed during ParallelForEach
+	// > They're sorted by the chunk which made each change first, so the lists end up in the same order every run
+	void ApplyDeferredChanges();
+	// Adds an object to the changes to apply later (with m_parallelMutex held)
+	void DeferChange( GameObject& obj );
+
+	// Pages of slots which are never moved or freed until the manager is destroyed
+	// > The table is created at its full size, so other threads can look objects up while new pages are being added
+	std::vector<Slot*> m_vPages;
+	// Number of pages in m_vPages which have been added
+	int m_nPages{ 0 };
+	// The allocations the pages are carved out of (a batch may need several pages at once)
+	std::vector<Slot*> m_vBlocks;
+	// Number of slots which have been used at least once
+	// > Only increased once the new slot's object is constructed, so Find never looks at a slot that is still being filled in
+	std::atomic<int> m_nSlots{ 0 };
+	// Slots which have been released since the last ResetWorld and can be reused, oldest first from m_nFreeHead
+	// > Reusing the slot which has been free longest spreads the generations over every slot, so slots are retired as late as possible
+	// > May contain slots which have since been reused by the scan, so they are checked again when taken
+	std::vector<int> m_vFreeSlots;
+	// The oldest entry in m_vFreeSlots which hasn't been taken yet
+	int m_nFreeHead{ 0 };
+	// Slots below this have already been checked for reuse since the last ResetWorld
+	int m_nScanSlot{ 0 };
+	// Incremented by ResetWorld to drop every object which isn't brought forward into the new epoch
+	uint32_t m_epoch{ 0 };
+	// Number of objects created so far
+	uint32_t m_nCreated{ 0 };
+	// Ids of the objects waiting to be destroyed by FlushDestroyQueue
+	std::vector<int> m_vDestroyQueue;
+	// The types whose lists may have gaps to close
+	std::vector<int> m_vGappedTypes;
+	// Lists of GameObjects for each type indexed directly by the type
+	std::vector<TypeList> m_typeLists;
+	// Negative types are unusual, so they don't get direct indexing
+	std::map<int, TypeList> m_negativeTypeLists;
+	// Registered templates for spawning GameObjects
+	std::vector<GameObjectArchetype> m_vArchetypes;
+	// Set while ParallelForEach or several systems are running, when changes to the type lists have to wait
+	bool m_bParallel{ false };
+	// Protects the pool, the destroy queue and the deferred list while m_bParallel is set
+	std::mutex m_parallelMutex;
+	// Objects which were created or changed type while m_bParallel was set
+	std::vector<DeferredObject> m_vDeferredObjects;
+};
 
-	//Next I calculate the sprite origin in the screen.
-	float originSprite2X = pos_2.x - offsetSprite2X;
-	float originSprite2Y = pos_2.y - offsetSprite2Y;
+PlayObjects& PlayObjects::Instance()
+{
+	PlayObjects*& pInstance = Play::Context::Current().pObjects;
+	if( !pInstance )
+		pInstance = new PlayObjects();
 
-	//calculate the difference between two sprite origins in screen
-	float originDiffX = originSprite2X - originSprite1X;
-	float originDiffY = originSprite2Y - originSprite1Y;
+	return *pInstance;
+}
 
-	//calculation of the difference between two sprite origins in frame of sprite 1.
-	float originDiffu = originDiffX * cosAngle1 + originDiffY * sinAngle1;
-	float originDiffv = originDiffY * cosAngle1 - originDiffX * sinAngle1;
+void PlayObjects::Destroy()
+{
+	PlayObjects*& pInstance = Play::Context::Current().pObjects;
+	if( pInstance )
+		delete pInstance;
 
-	int s2Width = s2.width;
-	int s2Height = s2.height;
-	int s1Width = s1.width;
+	pInstance = nullptr;
+}
 
-	float cosAngleDiff = cos( angle_2 - angle_1 );
-	float sinAngleDiff = sin( angle_2 - angle_1 );
-	//top left, top right, bottom right, bottom left.
-	float s2Cu[4]
-	{
-		0,
-		s2Width * cosAngleDiff,
-		s2Width * cosAngleDiff - s2Height * sinAngleDiff,
-		-s2Height * sinAngleDiff
-	};
+PlayObjects::PlayObjects()
+{
+	// Neither the page table nor the list of blocks ever reallocates, so adding pages for a batch is a single allocation
+	m_vPages.resize( MAX_PAGES, nullptr );
+	m_vBlocks.reserve( MAX_PAGES );
+}
 
-	float s2Cv[4]
+PlayObjects::~PlayObjects()
+{
+	for( int i = 0; i < m_nSlots; i++ )
 	{
-		0,
-		s2Width * sinAngleDiff,
-		s2Width * sinAngleDiff + s2Height * cosAngleDiff,
-		s2Height * cosAngleDiff
-	};
+		if( HoldsObject( GetSlot( i ) ) )
+			GetSlot( i ).Object().~GameObject();
+	}
 
+	for( Slot* pBlock : m_vBlocks )
+		delete[] pBlock;
+}
 
-	float minCu{ std::numeric_limits<float>::infinity() };
-	float minCv{ std::numeric_limits<float>::infinity() };
-	float maxCu{ -std::numeric_limits<float>::infinity() };
-	float maxCv{ -std::numeric_limits<float>::infinity() };
+// The memory tracker's #define new doesn't work with placement new
+#pragma push_macro("new")
+#undef new
 
-	//calculate the extremes of the rotated sprite2.
-	for( int i = 0; i < 4; i++ )
-	{
-		minCu = std::min( s2Cu[i], minCu );
-		minCv = std::min( s2Cv[i], minCv );
-		maxCu = std::max( s2Cu[i], maxCu );
-		maxCv = std::max( s2Cv[i], maxCv );
-	}
+GameObject& PlayObjects::Create( int type, Point2f pos, int collisionRadius, int spriteId )
+{
+	std::unique_lock<std::mutex> lock( m_parallelMutex, std::defer_lock );
+	if( m_bParallel )
+		lock.lock();
 
-	//calculate the maximum and minimum positions in the sprite1 frame of the sprite2 corners.
-	float maxu = (originDiffu)+( maxCu );
-	float maxv = (originDiffv)+( maxCv );
-	float minu = (originDiffu)+( minCu );
-	float minv = (originDiffv)+( minCv );
+	int index = AllocateSlot();
+	Slot& s = GetSlot( index );
 
-	if( minu > s1PixelCollTL[2] || minv > s1PixelCollTL[3] || maxu < s1PixelCollTL[0] || maxv < s1PixelCollTL[1] )
+	if( HoldsObject( s ) )
 	{
-		return false;
+		// Dropped by ResetWorld, so finish destroying it now and make sure its old id isn't found again
+		s.Object().~GameObject();
+		s.generation = static_cast<uint16_t>( s.generation + 1 );
 	}
-	else
-	{
-		//wrap both frame indexes just in case.
-		frame_1 = frame_1 % s1.totalCount;
-		frame_2 = frame_2 % s2.totalCount;
-
-		//clip so we loop through sprite 1.
-		//Restrict the range we look in for pixel based collisions.
-		minv = ( minv < s1PixelCollTL[1] ) ? static_cast<float>( s1PixelCollTL[1] ) : minv;
-		maxv = ( maxv > s1PixelCollTL[3] ) ? static_cast<float>( s1PixelCollTL[3] ) : maxv;
-		minu = ( minu < s1PixelCollTL[0] ) ? static_cast<float>( s1PixelCollTL[0] ) : minu;
-		maxu = ( maxu > s1PixelCollTL[2] ) ? static_cast<float>( s1PixelCollTL[2] ) : maxu;
 
-		//Set up the starting position in sprite 2 frame. We know the box corners in u, v relative to the sprite 2 origin but we need to get them in a,b.
-		float minCa = ( minu - originDiffu ) * cosAngleDiff + ( minv - originDiffv ) * sinAngleDiff;
-		float minCb = -( minu - originDiffu ) * sinAngleDiff + ( minv - originDiffv ) * cosAngleDiff;
+	GameObject* pObj = new( s.memory ) GameObject( type, pos, collisionRadius, spriteId );
+	pObj->m_id = ( s.generation << SLOT_BITS ) | index;
+	s.epoch = m_epoch;
+	s.created = m_nCreated++;
+	s.state = SLOT_LIVE;
 
-		//rounding at this point
-		int iminu = static_cast<int>( minu );
-		int iminv = static_cast<int>( minv );
-		int imaxu = static_cast<int>( maxu );
-		int imaxv = static_cast<int>( maxv );
+	// A new slot only becomes visible to Find now that it's filled in
+	if( index == m_nSlots.load( std::memory_order_relaxed ) )
+		m_nSlots.store( index + 1, std::memory_order_release );
 
-		float startinga = minCa;
-		float startingb = minCb;
+	if( m_bParallel )
+		DeferChange( *pObj ); // The type lists are being iterated over
+	else
+		AddToTypeList( *pObj );
 
-		float rowstarta = startinga;
-		float rowstartb = startingb;
+	return *pObj;
+}
 
-		//Set up starting and finishing pointers for both the sprite 1 buffer and sprite 2 buffer 
-		//starting pointer for the sprite 1 buffer is the minu and minv.
-		int sprite1Offset = s1Width * frame_1 + iminu + iminv * s1.canvasBuffer.width;
-		Pixel* sprite1Src = s1.canvasBuffer.pPixels + sprite1Offset;
+#pragma pop_macro("new")
 
-		//The base pointer for the sprite2 will just be start of the correct frame in the canvas buffer.
-		int sprite2Offset = s2Width * frame_2;
-		Pixel* sprite2Base = s2.canvasBuffer.pPixels + sprite2Offset;
-		//Define the number which we need to add to get down a row in sprite1.
-		int sprite1ChangeRow = s1.canvasBuffer.width - ( imaxu - iminu );
+int PlayObjects::AllocateSlot()
+{
+	int nSlots = m_nSlots.load( std::memory_order_relaxed );
 
-		//Start of double for loop.
-		//Go through the overlapping region (warning may go out of the buffer of sprite 2.)
-		for( int v{ iminv }; v < imaxv; v++ )
+	// Other threads may be looking up old ids while m_bParallel is set, so only new slots are used until it's cleared
+	if( !m_bParallel )
+	{
+		// Slots released since the last reset
+		while( m_nFreeHead < static_cast<int>( m_vFreeSlots.size() ) )
 		{
-			//store a and b to be the start of the row.
-			float a = rowstarta;
-			float b = rowstartb;
+			int index = m_vFreeSlots[m_nFreeHead++];
 
-			for( int u{ iminu }; u < imaxu; u++ )
-			{
+			if( IsReusable( GetSlot( index ) ) )
+				return index;
+		}
 
-				//Edit this part to add a collision box.
-				//If we are in sprite 2 then extract the look at the pixels.
-				if( a >= s2PixelCollTL[0] && b >= s2PixelCollTL[1] && a < s2PixelCollTL[2] && b < s2PixelCollTL[3] )
-				{
-					int sprite2Pixel = static_cast<int>( a ) + static_cast<int>( b ) * s2.canvasBuffer.width;
-					Pixel sprite2Src = *( sprite2Base + sprite2Pixel );
+		// Slots which were in use before the last reset
+		while( m_nScanSlot < nSlots )
+		{
+			int index = m_nScanSlot++;
 
-					//If both pixels at that position are opaque then there is a collision. 
-					if( sprite2Src.bits > 0x00FFFFFF && (*sprite1Src).bits > 0x00FFFFFF )
-					{
-						return true;
-					}
+			if( IsReusable( GetSlot( index ) ) )
+				return index;
+		}
+	}
 
-				}
-				//add change in for going along u. go along a row.
-				a += cosAngleDiff;
-				b += -sinAngleDiff;
+	PLAY_ASSERT_MSG( nSlots <= SLOT_MASK, "Too many GameObjects!" );
+	if( nSlots == m_nPages * SLOTS_PER_PAGE )
+		AddPages( 1 );
 
-				sprite1Src++;
+	// The new slot is counted by Create once its object is constructed
+	if( m_nScanSlot == nSlots )
+		m_nScanSlot = nSlots + 1;
+	return nSlots;
+}
 
-			}
-			//increment for row of sprite 1.
-			sprite1Src += sprite1ChangeRow;
+bool PlayObjects::IsReusable( Slot& s )
+{
+	if( IsLive( s ) || s.state == SLOT_RETIRED )
+		return false;
 
-			//work out start of next row based on start of previous row. 
-			rowstarta += sinAngleDiff;
-			rowstartb += cosAngleDiff;
-		}
+	// Objects dropped by ResetWorld have their generation bumped by Create, so a slot on its last generation is retired instead
+	if( HoldsObject( s ) && s.generation == GENERATION_MASK )
+	{
+		s.Object().~GameObject();
+		s.state = SLOT_RETIRED;
+		return false;
 	}
-	return false;
-}
 
+	return true;
+}
 
+void PlayObjects::AddPages( int nPages )
+{
+	Slot* pBlock = new Slot[nPages * SLOTS_PER_PAGE];
+	m_vBlocks.push_back( pBlock );
 
+	PLAY_ASSERT_MSG( m_nPages + nPages <= MAX_PAGES, "Too many GameObjects!" );
+	for( int i = 0; i < nPages; i++ )
+		m_vPages[m_nPages++] = pBlock + i * SLOTS_PER_PAGE;
+}
 
-//********************************************************************************************************************************
-// Function:	PreMultiplyAlpha - calculates the (src*srcAlpha) alpha blending calculation in advance as it doesn't change
-// Parameters:	s = the sprite to pre-calculate data for
-// Notes:		Also inverts the alpha ready for the (dest*(1-srcAlpha)) calculation and stores information in the new
-//				buffer which provides the number of fully-transparent pixels in a row (so they can be skipped)
-//********************************************************************************************************************************
-void PlayGraphics::PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int height, int maxSkipWidth, float alphaMultiply = 1.0f, Pixel colourMultiply = 0x00FFFFFF )
+void PlayObjects::Reserve( int type, int count )
 {
-	Pixel* pSourcePixels = source;
-	Pixel* pDestPixels = dest;
-
-	// Iterate through all the pixels in the entire canvas
-	for( int bh = 0; bh < height; bh++ )
-	{
-		for( int bw = 0; bw < width; bw++ )
-		{
-			Pixel src = *pSourcePixels;
+	// Grows the list geometrically, so a run of small batches doesn't reallocate it every time
+	TypeList& list = GetTypeList( type );
+	size_t needed = list.objects.size() + count;
+	if( list.objects.capacity() < needed )
+		list.objects.reserve( std::max( needed, list.objects.capacity() * 2 ) );
 
-			// Separate the channels and calculate src*srcAlpha
-			int srcAlpha = static_cast<int>( ( src.bits >> 24 ) * alphaMultiply );
+	// Slots from the free list or left over from before a reset may turn out to be live, so this is a best guess
+	int nReusable = static_cast<int>( m_vFreeSlots.size() ) - m_nFreeHead + ( m_nSlots - m_nScanSlot );
+	int nUnused = m_nPages * SLOTS_PER_PAGE - m_nSlots;
+	int nNeeded = count - nReusable - nUnused;
 
-			int destRed = ( srcAlpha * ( ( src.bits >> 16 ) & 0xFF ) ) >> 8;
-			int destGreen = ( srcAlpha * ( ( src.bits >> 8 ) & 0xFF ) ) >> 8;
-			int destBlue = ( srcAlpha * ( src.bits & 0xFF ) ) >> 8;
+	if( nNeeded > 0 )
+		AddPages( ( nNeeded + SLOTS_PER_PAGE - 1 ) / SLOTS_PER_PAGE );
+}
 
-			destRed = ( destRed * ( ( colourMultiply.bits >> 16 ) & 0xFF ) ) >> 8;
-			destGreen = ( destGreen * ( ( colourMultiply.bits >> 8 ) & 0xFF ) ) >> 8;
-			destBlue = ( destBlue * ( colourMultiply.bits & 0xFF ) ) >> 8;
+int PlayObjects::RegisterArchetype( const GameObjectArchetype& archetype )
+{
+	m_vArchetypes.push_back( archetype );
+	return static_cast<int>( m_vArchetypes.size() ) - 1;
+}
 
-			srcAlpha = 0xFF - srcAlpha; // invert the alpha ready to multiply with the destination pixels
-			*pDestPixels = ( srcAlpha << 24 ) | ( destRed << 16 ) | ( destGreen << 8 ) | destBlue;
+int PlayObjects::SpawnBatch( int archetypeId, int count, PlayFunctionRef<void( GameObject&, int )> initializer )
+{
+	PLAY_ASSERT_MSG( archetypeId >= 0 && archetypeId < static_cast<int>( m_vArchetypes.size() ), "Invalid archetype id" );
 
-			if( srcAlpha == 0xFF ) // Completely transparent pixel
-			{
-				int repeats = 0;
+	const GameObjectArchetype& a = m_vArchetypes[archetypeId];
+	int firstId = -1;
 
-				// We can only skip to the end of the row because the sprite frames are arranged on a continuous canvas
-				int maxSkip = maxSkipWidth - ( bw % maxSkipWidth );
+	if( !m_bParallel )
+		Reserve( a.type, count ); // The type list can't be reallocated while it is being iterated over
 
-				for( int zw = 1; zw < maxSkip; zw++ )
-				{
-					if( ( pSourcePixels + zw )->bits >> 24 == 0x00 ) // Another transparent pixel
-						repeats++;
-					else
-						break;
-				}
+	for( int i = 0; i < count; i++ )
+	{
+		GameObject& obj = Create( a.type, { 0.0f, 0.0f }, a.radius, a.spriteId );
+		obj.animSpeed = a.animSpeed;
+		obj.velocity = a.velocity;
+		obj.rotation = a.rotation;
+		obj.rotSpeed = a.rotSpeed;
 
-				*pDestPixels = 0xFF000000 | repeats; // Doesn't matter what the colour was so we use it to store the skip value
-			}
+		if( i == 0 )
+			firstId = obj.GetId();
 
-			pDestPixels++;
-			pSourcePixels++;
-		}
+		if( initializer )
+			initializer( obj, i );
+
+		// Stops interpolated drawing sliding new objects in from the origin
+		obj.oldPos = obj.pos;
+		obj.oldRot = obj.rotation;
 	}
-}
 
-//********************************************************************************************************************************
-// Basic drawing functions
-//********************************************************************************************************************************
+	return firstId;
+}
 
+void PlayObjects::Release( GameObject& obj )
+{
+	PLAY_ASSERT_MSG( IsManaged( obj ), "Trying to release a GameObject which isn't being managed" );
+	PLAY_ASSERT_MSG( !m_bParallel, "GameObjects can't be destroyed while other threads are using them: use QueueDestroy instead" );
 
+	FreeObject( obj ); // The gap in its list is closed when the list is next looked at
+}
 
-void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
+void PlayObjects::FreeObject( GameObject& obj )
 {
-	// Convert floating point co-ordinates to pixels
-	m_blitter.DrawPixel( static_cast<int>( pos.x + 0.5f ), static_cast<int>( pos.y + 0.5f ), srcPix );
+	int index = obj.m_id & SLOT_MASK;
+	Slot& s = GetSlot( index );
+
+	RemoveFromTypeList( obj );
+	obj.~GameObject();
+
+	// Wrapping the generation round would let ids from long ago find new objects, so the slot is never used again
+	if( s.generation == GENERATION_MASK )
+	{
+		s.state = SLOT_RETIRED;
+		return;
+	}
+
+	// Bumping the generation means the old id won't find whatever uses this slot next
+	s.generation = static_cast<uint16_t>( s.generation + 1 );
+	s.state = SLOT_FREE;
+
+	// Once at least half the list has been taken it's shuffled down, which keeps its capacity so churn doesn't allocate
+	if( m_nFreeHead > 0 && m_nFreeHead * 2 >= static_cast<int>( m_vFreeSlots.size() ) )
+	{
+		m_vFreeSlots.erase( m_vFreeSlots.begin(), m_vFreeSlots.begin() + m_nFreeHead );
+		m_nFreeHead = 0;
+	}
+	m_vFreeSlots.push_back( index );
 }
 
-void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
+void PlayObjects::QueueDestroy( GameObject& obj )
 {
-	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( startPos.x + 0.5f );
-	int y1 = static_cast<int>( startPos.y + 0.5f );
-	int x2 = static_cast<int>( endPos.x + 0.5f );
-	int y2 = static_cast<int>( endPos.y + 0.5f );
+	std::unique_lock<std::mutex> lock( m_parallelMutex, std::defer_lock );
+	if( m_bParallel )
+		lock.lock();
 
-	m_blitter.DrawLine( x1, y1, x2, y2, pix );
+	if( !IsManaged( obj ) ) return; // Dropped by ResetWorld
+
+	Slot& s = GetSlot( obj.m_id & SLOT_MASK );
+
+	if( s.state != SLOT_LIVE ) return; // Already queued
+
+	s.state = SLOT_DESTROY_QUEUED;
+	m_vDestroyQueue.push_back( obj.m_id );
 }
 
+void PlayObjects::FlushDestroyQueue()
+{
+	// Objects queued from several threads at once are freed in the same order every run, so their slots are reused in the same order
+	std::sort( m_vDestroyQueue.begin(), m_vDestroyQueue.end() );
 
+	for( int id : m_vDestroyQueue )
+	{
+		// The object may have been destroyed directly since it was queued
+		GameObject* pObj = Find( id );
+		if( pObj )
+			FreeObject( *pObj );
+	}
 
+	// The lists are closed up once, however many objects were destroyed
+	CompactTypeLists();
+	m_vDestroyQueue.clear(); // Keeps its capacity for the next frame
+}
 
-void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
+void PlayObjects::ResetWorld( const std::vector<int>& keepTypes )
 {
-	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( topLeft.x + 0.5f );
-	int x2 = static_cast<int>( bottomRight.x + 0.5f );
-	int y1 = static_cast<int>( topLeft.y + 0.5f );
-	int y2 = static_cast<int>( bottomRight.y + 0.5f );
+	PLAY_ASSERT_MSG( !m_bParallel, "The world can't be reset while other threads are using it" );
 
-	if( fill )
+	uint32_t newEpoch = m_epoch + 1;
+
+	// Only the kept objects are visited: they are brought forward into the new epoch
+	for( int type : keepTypes )
 	{
-		for( int x = x1; x < x2; x++ )
+		const TypeList* pList = FindCompactTypeList( type );
+
+		if( pList )
 		{
-			for( int y = y1; y < y2; y++ )
-				m_blitter.DrawPixel( x, y, pix );
+			for( GameObject* pObj : pList->objects )
+				GetSlot( pObj->m_id & SLOT_MASK ).epoch = newEpoch;
 		}
 	}
-	else
+
+	// The lists for the other types are emptied (along with their gaps) but keep their capacity for the next level
+	// > Their objects are left as they are: being from an old epoch is enough for IsManaged to ignore them
+	auto DropList = []( TypeList& list )
 	{
-		m_blitter.DrawLine( x1, y1, x2, y1, pix );
-		m_blitter.DrawLine( x2, y1, x2, y2, pix );
-		m_blitter.DrawLine( x2, y2, x1, y2, pix );
-		m_blitter.DrawLine( x1, y2, x1, y1, pix );
+		list.objects.clear();
+		list.firstGap = -1;
+	};
+
+	for( size_t t = 0; t < m_typeLists.size(); t++ )
+	{
+		if( std::find( keepTypes.begin(), keepTypes.end(), static_cast<int>( t ) ) == keepTypes.end() )
+			DropList( m_typeLists[t] );
+	}
+
+	for( std::pair<const int, TypeList>& i : m_negativeTypeLists )
+	{
+		if( std::find( keepTypes.begin(), keepTypes.end(), i.first ) == keepTypes.end() )
+			DropList( i.second );
 	}
+
+	// Every slot is reusable now unless it holds a kept object
+	m_epoch = newEpoch;
+	m_vFreeSlots.clear();
+	m_nFreeHead = 0;
+	m_nScanSlot = 0;
 }
 
-// Private function called by DrawCircle
-void PlayGraphics::DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix )
+void PlayObjects::OnTypeChanged( GameObject& obj )
 {
-	DrawPixel( { posX + offX , posY + offY }, pix );
-	DrawPixel( { posX - offX , posY + offY }, pix );
-	DrawPixel( { posX + offX , posY - offY }, pix );
-	DrawPixel( { posX - offX , posY - offY }, pix );
-	DrawPixel( { posX - offY , posY + offX }, pix );
-	DrawPixel( { posX + offY , posY - offX }, pix );
-	DrawPixel( { posX - offY , posY - offX }, pix );
-	DrawPixel( { posX + offY , posY + offX }, pix );
+	PlayObjects* pInstance = Play::Context::Current().pObjects;
+	if( !pInstance || !pInstance->IsManaged( obj ) ) return; // Not a managed object (or created during ParallelForEach or dropped by ResetWorld)
+
+	if( pInstance->m_bParallel )
+	{
+		std::lock_guard<std::mutex> lock( pInstance->m_parallelMutex );
+		pInstance->DeferChange( obj );
+		return;
+	}
+
+	// Changing the type of every object in a list only leaves gaps, which are closed together when the list is next looked at
+	pInstance->RemoveFromTypeList( obj );
+	pInstance->AddToTypeList( obj );
 }
 
-void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix )
+void PlayObjects::ParallelForEach( int type, const std::function<void( GameObject& )>& fn )
 {
-	// Convert floating point co-ordinates to pixels
-	int x = static_cast<int>( pos.x + 0.5f );
-	int y = static_cast<int>( pos.y + 0.5f );
+	const TypeList* pList = FindCompactTypeList( type );
 
-	int dx = 0;
-	int dy = radius;
+	if( !pList || pList->objects.empty() )
+		return;
 
-	int d = 3 - 2 * radius;
-	DrawCircleOctants( x, y, dx, dy, pix );
+	// The list won't change until ApplyDeferredChanges, so the workers can share it directly
+	GameObject* const* ppObjects = pList->objects.data();
+	int nObjects = static_cast<int>( pList->objects.size() );
+
+	// Enough chunks for a few per thread balances the load, and chunks which are whole cache lines of the list don't share any
+	// > The chunks don't depend on the number of threads, as each has its own random numbers which have to be the same every run
+	PlayJobs& jobs = PlayJobs::Instance();
+	constexpr int OBJECTS_PER_LINE = PLAY_CACHE_LINE_SIZE / sizeof( GameObject* );
+	constexpr int MIN_CHUNK_SIZE = OBJECTS_PER_LINE * 8;
+	constexpr int MAX_CHUNKS = 64;
+	int chunkSize = nObjects / MAX_CHUNKS;
+	chunkSize = std::max( MIN_CHUNK_SIZE, ( chunkSize + OBJECTS_PER_LINE - 1 ) / OBJECTS_PER_LINE * OBJECTS_PER_LINE );
+	int nChunks = ( nObjects + chunkSize - 1 ) / chunkSize;
+
+	// May already be deferring if this is one of several systems running at once
+	bool bDeferring = BeginDeferredChanges();
+	uint64_t randomKey = Play::NextRandomWorkKey();
+
+	jobs.ParallelFor( nChunks, [&]( int chunk )
+	{
+		PlayRandomScope random( PlayRandom::Mix( randomKey, chunk ) );
+		int end = std::min( nObjects, ( chunk + 1 ) * chunkSize );
+		for( int i = chunk * chunkSize; i < end; i++ )
+			fn( *ppObjects[i] );
+	} );
+
+	if( bDeferring )
+		EndDeferredChanges();
+}
 
-	while( dy >= dx )
+bool PlayObjects::BeginDeferredChanges()
+{
+	if( m_bParallel )
+		return false;
+
+	// The lists are read from several threads until EndDeferredChanges, so none of them can be left to close their gaps then
+	CompactTypeLists();
+	m_bParallel = true;
+	return true;
+}
+
+void PlayObjects::EndDeferredChanges()
+{
+	m_bParallel = false;
+	ApplyDeferredChanges();
+}
+
+void PlayObjects::DeferChange( GameObject& obj )
+{
+	// Outside a chunk (when PlayJobs is used directly) the changes are applied in the order they were made
+	PlayRandomScope* pScope = PlayRandomScope::Current();
+	if( pScope )
+		m_vDeferredObjects.push_back( { &obj, pScope->GetKey(), pScope->NextChange() } );
+	else
+		m_vDeferredObjects.push_back( { &obj, 0, m_vDeferredObjects.size() } );
+}
+
+void PlayObjects::ApplyDeferredChanges()
+{
+	std::sort( m_vDeferredObjects.begin(), m_vDeferredObjects.end(), []( const DeferredObject& a, const DeferredObject& b )
 	{
-		dx++;
-		if( d > 0 )
+		return a.chunk != b.chunk ? a.chunk < b.chunk : a.change < b.change;
+	} );
+
+	for( const DeferredObject& deferred : m_vDeferredObjects )
+	{
+		GameObject* pObj = deferred.pObj;
+		if( pObj->m_typeSlot < 0 )
 		{
-			dy--;
-			d = static_cast<int>( d + 4 * ( dx - dy ) + 10 );
+			AddToTypeList( *pObj ); // Created during ParallelForEach
 		}
-		else
+		else if( pObj->m_listType != pObj->type )
 		{
-			d = static_cast<int>( d + 4 * dx + 6 );
+			RemoveFromTypeList( *pObj );
+			AddToTypeList( *pObj );
 		}
-		DrawCircleOctants( x, y, dx, dy, pix );
 	}
-};
 
-void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha )
+	CompactTypeLists();
+	m_vDeferredObjects.clear();
+}
+
+GameObject* PlayObjects::Find( int id ) const
 {
-	if( !pixelData->preMultiplied )
-	{
-		PreMultiplyAlpha( pixelData->pPixels, pixelData->pPixels, pixelData->width, pixelData->height, pixelData->width );
-		pixelData->preMultiplied = true;
-	}
-	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.x), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
+	if( id < 0 )
+		return nullptr;
+
+	int index = id & SLOT_MASK;
+
+	// Slots beyond the count may still be being filled in by another thread
+	if( index >= m_nSlots.load( std::memory_order_acquire ) )
+		return nullptr;
+
+	Slot& s = GetSlot( index );
+
+	if( !IsLive( s ) || s.generation != ( id >> SLOT_BITS ) )
+		return nullptr;
+
+	return &s.Object();
 }
 
+GameObject* PlayObjects::FindFirstOfType( int type )
+{
+	const TypeList* pList = FindCompactTypeList( type );
 
-//********************************************************************************************************************************
-// Debug font functions
-//********************************************************************************************************************************
+	if( !pList || pList->objects.empty() )
+		return nullptr;
 
-// Settings for the embedded debug font
-#define FONT_IMAGE_WIDTH	96
-#define FONT_IMAGE_HEIGHT	36
-#define FONT_CHAR_WIDTH		6
-#define FONT_CHAR_HEIGHT	12
+	return pList->objects.front();
+}
 
-// A 96x36 font image @ 1bpp containing basic ASCII characters from 0x30 (0) to 0x5F (underscore) at 6x12 pixels each
-static const uint32_t debugFontData[] =
+GameObjectIdSpan PlayObjects::GetIdsOfType( int type )
 {
-	0x87304178, 0x0800861F, 0xFFFFFFE1, 0x7BBFBE79, 0xF7FE79EF, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EC, 0xFFFFFFFE, 0x7BBFBE79, 0xF7FE79EF, 0xFFEE3DFE, 0x6BB86080,
-	0x1078860F, 0xE3DFFEFE, 0x5BB7FEFB, 0xE7BE7BEF, 0xFFBFFF41, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFDFFEDF, 0x7BB7FEFB, 0xE7BE7BEC, 0xFFEE3DDF, 0x7BB7FEFB, 0xE7BE7BEF, 0xFFFFFFFF, 0x7BB7BEF9, 0xE7BE7BEF,
-	0xFFFFFFDF, 0x87B001F8, 0x187E87EF, 0xFFFFFFDF, 0x86106104, 0x00007A30, 0x1E7C5061, 0x79E79E79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E, 0x79E79F79, 0xF7DF7B7F, 0x5E7DA79E,
-	0x59E79F79, 0xF7DF7B7F, 0x597DA79E, 0x58005F78, 0x30D0037F, 0x477DA79E, 0x59E79F79, 0xF7DE7B7F, 0x597DA79E, 0x59E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x41E79F79, 0xF7DE7B7F, 0x5E7DA79E, 0x7DE79F79,
-	0xF7DE7B7F, 0x5E7DA79E, 0x7DE79E79, 0xF7DE7B7F, 0x5E7DA79E, 0x81E06104, 0x07C17A38, 0xDE01A7A1, 0x06106101, 0xE79E79E0, 0x337F3FFF, 0x79E79EED, 0xE79E79EF, 0xB77FBFFF, 0x79E79FED, 0xE79E79EF,
-	0xB7BFBFFF, 0x79E79FED, 0xE79A79EF, 0xB7BFBFFF, 0x79E75FED, 0xE79AB5EF, 0x77DFBFFF, 0x05E0E1ED, 0xE79ACC0E, 0xF7DFBFFF, 0x7DE77EED, 0xE79AB7ED, 0xF7EFBFFF, 0x7DE7BEED, 0xE79A7BEB, 0xF7EFBFFF,
-	0x7DE7BEED, 0xE79A7BE7, 0xF7F7BFFF, 0x7DA7BEED, 0xE79A7BE7, 0xF7F7BCFF, 0x7DD79EED, 0xEB5A7BE7, 0xF7FBBCFF, 0x7C27A1EE, 0x1CE57810, 0x33FB3EC0
-};
+	const TypeList* pList = FindCompactTypeList( type );
 
-void PlayGraphics::DecompressDubugFont( void )
+	if( !pList || pList->objects.empty() )
+		return {};
+
+	return { pList->objects.data(), pList->objects.data() + pList->objects.size() };
+}
+
+std::vector<int> PlayObjects::CollectAllIds() const
 {
-	m_pDebugFontBuffer = new uint8_t[FONT_IMAGE_WIDTH * FONT_IMAGE_HEIGHT];
+	std::vector<std::pair<uint32_t, int>> vCreated;
 
-	for( int y = 0; y < FONT_IMAGE_HEIGHT; y++ )
+	for( int i = 0; i < m_nSlots; i++ )
 	{
-		for( int x = 0; x < FONT_IMAGE_WIDTH; x++ )
-		{
-			int bufferIndex = ( y * FONT_IMAGE_WIDTH ) + x;
-			int dataIndex = bufferIndex / 32;
-			int dataShift = 31 - ( bufferIndex % 32 );
-
-			// Convert 1bpp to an 8-bit array for easy data access
-			if( ( debugFontData[dataIndex] >> dataShift ) & 0x01 )
-				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + x] = 0; // not ARGB just 0 (no pixel)
-			else
-				m_pDebugFontBuffer[( y * FONT_IMAGE_WIDTH ) + x] = 1; // not ARGB just 1 (a pixel)
-		}
+		Slot& s = GetSlot( i );
+		if( IsLive( s ) )
+			vCreated.push_back( { s.created, s.Object().GetId() } );
 	}
+
+	std::sort( vCreated.begin(), vCreated.end() );
+
+	std::vector<int> vIds;
+	vIds.reserve( vCreated.size() );
+	for( const std::pair<uint32_t, int>& i : vCreated )
+		vIds.push_back( i.second );
+
+	return vIds;
 }
 
-int PlayGraphics::DrawDebugCharacter( Point2f pos, char c, Pixel pix )
+PlayObjects::TypeList& PlayObjects::GetTypeList( int type )
 {
-	// Limited character set in the font (0x30-0x5F) so includes translation of useful chars outside that range
-	switch( c )
+	if( type < 0 )
+		return m_negativeTypeLists[type];
+
+	if( static_cast<size_t>( type ) >= m_typeLists.size() )
+		m_typeLists.resize( static_cast<size_t>( type ) + 1 );
+
+	return m_typeLists[type];
+}
+
+const PlayObjects::TypeList* PlayObjects::FindTypeList( int type ) const
+{
+	if( type < 0 )
 	{
-		case 0x2C: c = 0x5E; break; // Map full stop to comma (nearly the same!)
-		case 0x2D: c = 0x3B; break; // Map minus to semi-colon (rarely used)
-		case 0x28: c = 0x5B; break; // Map brackets to square brackets
-		case 0x29: c = 0x5D; break; // Map brackets to square brackets
-		case 0x2E: c = 0x5E; break; // Map full stop to carot (never used)
+		std::map<int, TypeList>::const_iterator i = m_negativeTypeLists.find( type );
+		return i == m_negativeTypeLists.end() ? nullptr : &i->second;
 	}
 
-	if( c < 0x30 || c > 0x5F )
-		return FONT_CHAR_WIDTH;
+	if( static_cast<size_t>( type ) >= m_typeLists.size() )
+		return nullptr;
 
-	int sourceX = ( ( c - 0x30 ) % 16 ) * FONT_CHAR_WIDTH;
-	int sourceY = ( ( c - 0x30 ) / 16 ) * FONT_CHAR_HEIGHT;
+	return &m_typeLists[type];
+}
 
-	// Loop over the bounding box of the glyph
-	for( int x = 0; x < FONT_CHAR_WIDTH; x++ )
+const PlayObjects::TypeList* PlayObjects::FindCompactTypeList( int type )
+{
+	const TypeList* pList = FindTypeList( type );
+
+	// Lists are never left with gaps while m_bParallel is set, so this doesn't change anything other threads are reading
+	if( !pList || pList->firstGap < 0 )
+		return pList;
+
+	TypeList& list = GetTypeList( type ); // Already exists, so isn't created here
+	CompactTypeList( list );
+	return &list;
+}
+
+void PlayObjects::AddToTypeList( GameObject& obj )
+{
+	TypeList& list = GetTypeList( obj.type );
+	obj.m_typeSlot = static_cast<int>( list.objects.size() );
+	obj.m_listType = obj.type;
+	list.objects.push_back( &obj );
+}
+
+void PlayObjects::RemoveFromTypeList( GameObject& obj )
+{
+	TypeList& list = GetTypeList( obj.m_listType );
+	list.objects[obj.m_typeSlot] = nullptr;
+
+	if( list.firstGap < 0 )
+		list.firstGap = obj.m_typeSlot;
+	else
+		list.firstGap = std::min( list.firstGap, obj.m_typeSlot );
+
+	if( !list.bInGappedTypes )
 	{
-		for( int y = 0; y < FONT_CHAR_HEIGHT; y++ )
-		{
-			if( m_pDebugFontBuffer[( ( sourceY + y ) * FONT_IMAGE_WIDTH ) + ( sourceX + x )] > 0 )
-				DrawPixel( { pos.x + x, pos.y + y }, pix );
-		}
+		list.bInGappedTypes = true;
+		m_vGappedTypes.push_back( obj.m_listType );
 	}
 
-	return FONT_CHAR_WIDTH;
+	obj.m_typeSlot = -1;
 }
 
-int PlayGraphics::DrawDebugString( Point2f pos, const std::string& s, Pixel pix, bool centred )
+void PlayObjects::CompactTypeList( TypeList& list )
 {
-	if( m_pDebugFontBuffer == nullptr )
-		DecompressDubugFont();
+	int nKept = list.firstGap;
 
-	if( centred )
-		pos.x -= GetDebugStringWidth( s ) / 2;
+	// Everything before the first gap is already in place
+	for( int i = list.firstGap; i < static_cast<int>( list.objects.size() ); i++ )
+	{
+		GameObject* pObj = list.objects[i];
+		if( !pObj )
+			continue;
 
-	pos.y -= 6; // half the height of the debug font
+		list.objects[nKept] = pObj;
+		pObj->m_typeSlot = nKept++;
+	}
 
-	for( char c : s )
-		pos.x += DrawDebugCharacter( pos, static_cast<char>( toupper( c ) ), pix ) + 1;
+	list.objects.resize( nKept );
+	list.firstGap = -1;
+}
 
-	// Return horizontal position at the end of the string so strings can be concatenated easily
-	return static_cast<int>( pos.x );
+void PlayObjects::CompactTypeLists()
+{
+	// Lists which have been looked at or dropped by ResetWorld since they were given gaps have no gaps left
+	for( int type : m_vGappedTypes )
+	{
+		TypeList& list = GetTypeList( type );
+		if( list.firstGap >= 0 )
+			CompactTypeList( list );
+		list.bInGappedTypes = false;
+	}
+
+	m_vGappedTypes.clear();
 }
 
-int PlayGraphics::GetDebugStringWidth( const std::string& s )
+GameObjectTypeField& GameObjectTypeField::operator=( int newType )
 {
-	return static_cast<int>( s.length() ) * ( FONT_CHAR_WIDTH + 1 );
+	if( newType != m_type )
+	{
+		m_type = newType;
+		PlayObjects::OnTypeChanged( *m_pOwner );
+	}
+	return *this;
 }
 
-//********************************************************************************************************************************
-// Timing bar functions
-//********************************************************************************************************************************
+//**************************************************************************************************
+// PlaySystems Class Definition
+//**************************************************************************************************
 
-LARGE_INTEGER PlayGraphics::EndTimingSegment()
+// Runs the game's update systems as a series of steps, where the systems in each step don't conflict with each other
+// > A system goes in the step after the last earlier-registered system it conflicts with
+// > A singleton class accessed using PlaySystems::Instance()
+class PlaySystems
 {
-	int size = static_cast<int>( m_vTimings.size() );
+public:
+	// Creates / Returns the PlaySystems instance
+	static PlaySystems& Instance();
+	// Destroys the PlaySystems instance
+	static void Destroy();
 
-	LARGE_INTEGER now, freq;
-	QueryPerformanceCounter( &now );
-	QueryPerformanceFrequency( &freq );
+	// Adds a system to the end of the list
+	void Register( const char* name, const std::function<void()>& fn, const SystemAccess& access );
+	// Runs all of the systems
+	void Run();
+	// Runs each step's systems one at a time on the calling thread
+	void SetSerial( bool bSerial ) { m_bSerial = bSerial; }
 
-	if( size > 0 )
+private:
+	PlaySystems() = default;
+	~PlaySystems() = default;
+	PlaySystems& operator=( const PlaySystems& ) = delete;
+	PlaySystems( const PlaySystems& ) = delete;
+
+	struct System
+	{
+		std::string name;
+		std::function<void()> fn;
+		SystemAccess access;
+		// The name the profiler times it under
+		const char* profileName;
+	};
+
+	// Runs one system inside a profiler scope
+	void RunSystem( int index )
 	{
-		m_vTimings[size - 1].end = now.QuadPart;
-		m_vTimings[size - 1].millisecs = static_cast<float>( m_vTimings[size - 1].end - m_vTimings[size - 1].begin );
-		m_vTimings[size - 1].millisecs = static_cast<float>( ( m_vTimings[size - 1].millisecs * 1000.0f ) / freq.QuadPart );
+		PLAY_PROFILE_SCOPE( m_vSystems[index].profileName );
+		m_vSystems[index].fn();
 	}
 
-	return now;
+	// Checks whether two systems have to run one after the other
+	static bool Conflicts( const SystemAccess& a, const SystemAccess& b );
+	// Checks whether two lists of types have a type in common (ALL_TYPES is in common with every type)
+	static bool Overlaps( const std::vector<int>& a, const std::vector<int>& b );
+	// Sorts the systems into steps
+	void BuildSteps();
+
+	std::vector<System> m_vSystems;
+	// The indices of the systems in each step, in registration order
+	std::vector<std::vector<int>> m_vSteps;
+	bool m_bStepsValid{ true };
+	bool m_bSerial{ false };
+};
+
+PlaySystems& PlaySystems::Instance()
+{
+	PlaySystems*& pInstance = Play::Context::Current().pSystems;
+	if( !pInstance )
+		pInstance = new PlaySystems();
+
+	return *pInstance;
 }
 
-int PlayGraphics::SetTimingBarColour( Pixel pix )
+void PlaySystems::Destroy()
 {
-	TimingSegment newData;
-	newData.pix = pix;
-	newData.begin = EndTimingSegment().QuadPart;
+	PlaySystems*& pInstance = Play::Context::Current().pSystems;
+	if( pInstance )
+		delete pInstance;
 
-	m_vTimings.push_back( newData );
+	pInstance = nullptr;
+}
 
-	return static_cast<int>( m_vTimings.size() );
-};
+void PlaySystems::Register( const char* name, const std::function<void()>& fn, const SystemAccess& access )
+{
+	m_vSystems.push_back( { name, fn, access, PlayProfiler::InternName( name ) } );
+	m_bStepsValid = false;
+}
 
-void PlayGraphics::DrawTimingBar( Point2f pos, Point2f size )
+void PlaySystems::Run()
+{
+	if( !m_bStepsValid )
+		BuildSteps();
+
+	PlayObjects& objects = PlayObjects::Instance();
+
+	for( std::vector<int>& step : m_vSteps )
+	{
+		// A system on its own can change anything straight away, just like a normal function call
+		if( step.size() == 1 )
+		{
+			RunSystem( step[0] );
+			continue;
+		}
+
+		objects.BeginDeferredChanges();
+
+		// Each system gets the same random numbers whichever thread it runs on, and whether or not it's serial
+		uint64_t randomKey = Play::NextRandomWorkKey();
+		if( m_bSerial )
+		{
+			for( size_t i = 0; i < step.size(); i++ )
+			{
+				PlayRandomScope random( PlayRandom::Mix( randomKey, i ) );
+				RunSystem( step[i] );
+			}
+		}
+		else
+		{
+			PlayJobs::Instance().ParallelFor( static_cast<int>( step.size() ), [&]( int i )
+			{
+				PlayRandomScope random( PlayRandom::Mix( randomKey, i ) );
+				RunSystem( step[i] );
+			} );
+		}
+
+		objects.EndDeferredChanges();
+	}
+}
+
+bool PlaySystems::Overlaps( const std::vector<int>& a, const std::vector<int>& b )
 {
-	EndTimingSegment();
+	if( a.empty() || b.empty() )
+		return false;
 
-	int startPixel{ 0 };
-	int endPixel{ 0 };
-	for( const TimingSegment& t : m_vPrevTimings )
+	for( int type : a )
 	{
-		endPixel += static_cast<int>( ( size.width * t.millisecs ) / 16.667f );
-		DrawRect( { pos.x + startPixel, pos.y }, { pos.x + endPixel, pos.y + size.height }, t.pix, true );
-		startPixel = endPixel;
+		if( type == Play::ALL_TYPES || std::find( b.begin(), b.end(), type ) != b.end() )
+			return true;
 	}
 
-	DrawRect( { pos.x, pos.y }, { pos.x + size.width, pos.y + size.height }, PIX_BLACK, false );
-	DrawRect( { pos.x - 1, pos.y - 1 }, { pos.x + size.width + 1 , pos.y + size.height + 1 }, PIX_WHITE, false );
-}
-
-float PlayGraphics::GetTimingSegmentDuration( int id ) const
-{
-	PLAY_ASSERT_MSG( static_cast<size_t>(id) < m_vTimings.size(), "Invalid id for timing data." );
-	return m_vTimings[id].millisecs;
+	return std::find( b.begin(), b.end(), Play::ALL_TYPES ) != b.end();
 }
 
-void PlayGraphics::TimingBarBegin( Pixel pix )
+bool PlaySystems::Conflicts( const SystemAccess& a, const SystemAccess& b )
 {
-	EndTimingSegment();
-	m_vPrevTimings = m_vTimings;
-	m_vTimings.clear();
-	SetTimingBarColour( pix );
-}
-//********************************************************************************************************************************
-// File:		PlaySpeaker.cpp
-// Description:	Implementation of a very simple audio manager using the MCI
-// Platform:	Windows
-// Notes:		Uses MP3 format. The Windows multimedia library is extremely basic, but very quick easy to work with. 
-//				Playback isn't always instantaneous and can trigger small frame glitches when StartSound is called. 
-//				Consider XAudio2 as a potential next step.
-//********************************************************************************************************************************
+	// A system which writes ALL_TYPES always runs on its own
+	std::vector<int> allTypes{ Play::ALL_TYPES };
+	if( Overlaps( a.writeTypes, allTypes ) || Overlaps( b.writeTypes, allTypes ) )
+		return true;
 
+	if( a.writeResources & ( b.readResources | b.writeResources ) )
+		return true;
 
-// Instruct Visual Studio to link the multimedia library  
-#pragma comment(lib, "winmm.lib")
+	if( b.writeResources & a.readResources )
+		return true;
 
-PlayAudio* PlayAudio::s_pInstance = nullptr;
+	return Overlaps( a.writeTypes, b.readTypes ) || Overlaps( a.writeTypes, b.writeTypes ) || Overlaps( a.readTypes, b.writeTypes );
+}
 
-//********************************************************************************************************************************
-// Constructor and destructor (private)
-//********************************************************************************************************************************
-PlayAudio::PlayAudio( const char* path )
+void PlaySystems::BuildSteps()
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "PlayAudio is a singleton class: multiple instances not allowed!" );
-	PLAY_ASSERT_MSG( std::filesystem::is_directory( path ), "Audio directory does not exist!" );
+	std::vector<int> vSystemStep( m_vSystems.size(), 0 );
+	m_vSteps.clear();
 
-	// Iterate through the directory
-	for( auto& p : std::filesystem::directory_iterator( path ) )
+	for( size_t i = 0; i < m_vSystems.size(); i++ )
 	{
-		// Switch everything to uppercase to avoid need to check case each time
-		std::string filename = p.path().string();
-		for( char& c : filename ) c = static_cast<char>( toupper( c ) );
-
-		// Only load .mp3 files
-		if( filename.find( ".MP3" ) != std::string::npos )
+		for( size_t j = 0; j < i; j++ )
 		{
-			vSoundStrings.push_back( filename );
-			std::string command = "open \"" + filename + "\" type mpegvideo alias " + filename;
-			mciSendStringA( command.c_str(), NULL, 0, 0 );
+			if( Conflicts( m_vSystems[i].access, m_vSystems[j].access ) )
+				vSystemStep[i] = std::max( vSystemStep[i], vSystemStep[j] + 1 );
 		}
+
+		if( vSystemStep[i] >= static_cast<int>( m_vSteps.size() ) )
+			m_vSteps.resize( vSystemStep[i] + 1 );
+
+		m_vSteps[vSystemStep[i]].push_back( static_cast<int>( i ) );
 	}
 
-	s_pInstance = this;
+	m_bStepsValid = true;
 }
 
-PlayAudio::~PlayAudio( void )
+#endif
+
+// The PlayManager is namespace rather than a class
+namespace Play
 {
-	for( std::string& s : vSoundStrings )
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+	// Used instead of Null return values, PlayMangager operations performed on this GameObject should fail transparently
+	static GameObject noObject{ -1,{ 0, 0 }, 0, -1 };
+
+#endif 
+
+	// A set of default colour definitions
+	Colour cBlack{ 0.0f, 0.0f, 0.0f };
+	Colour cRed{ 100.0f, 0.0f, 0.0f };
+	Colour cGreen{ 0.0f, 100.0f, 0.0f };
+	Colour cBlue{ 0.0f, 0.0f, 100.0f };
+	Colour cMagenta{ 100.0f, 0.0f, 100.0f };
+	Colour cCyan{ 0.0f, 100.0f, 100.0f };
+	Colour cYellow{ 100.0f, 100.0f, 0.0f };
+	Colour cOrange{ 100.0f, 50.0f, 0.0f };
+	Colour cWhite{ 100.0f, 100.0f, 100.0f };
+	Colour cGrey{ 50.0f, 50.0f, 50.0f };
+
+	// A sprite drawing operation, or a reference to a more general one, recorded for drawing later
+	struct RenderItem
+	{
+		enum Kind : uint8_t { SPRITE, SPRITE_TRANSPARENT, SPRITE_ROTATED, COMMAND };
+
+		Kind kind;
+		// The sprite to draw, or the index of the command for anything which isn't a sprite
+		int id;
+		int frame;
+		// Positions and angles at the last two ticks, so the sprite can be drawn part way between them
+		Point2f oldPos;
+		Point2f pos;
+		float oldRotation;
+		float rotation;
+		float scale;
+		float opacity;
+#if PLAY_BLITTER_STATS
+		// The type of GameObject the sprite belongs to, for counting the pixels it draws
+		int objectType{ -1 };
+#endif
+	};
+
+	// Everything drawn in a frame, kept in order
+	// > Sprites are stored compactly as they make up most of a frame, anything else is stored as a function to call
+	struct RenderSnapshot
 	{
-		std::string command = "close " + s;
-		mciSendStringA( command.c_str(), NULL, 0, 0 );
+		std::vector<RenderItem> vItems;
+		std::vector<std::function<void()>> vCommands;
+		// The tick the snapshot was recorded on
+		unsigned long long tick{ 0 };
+		// How far to draw sprites between their last two positions
+		float interpolation{ 1.0f };
+
+		void Clear() { vItems.clear(); vCommands.clear(); }
+	};
+
+	struct ManagerState
+	{
+		// Drawing operations recorded during a fixed rate tick, or for the render thread, drawn when the frame is presented
+		RenderSnapshot drawList;
+		// Toggled with F1 to draw extra information about the GameObjects
+		bool bDebugInfo{ false };
+
+		// The render thread and the snapshots passed to it
+		bool bRenderThread{ false };
+		std::thread renderThread;
+		PlayTripleBuffer<RenderSnapshot> renderSnapshots;
+		// Only used for sleeping and waking the render thread: the snapshots themselves are passed without locking
+		std::mutex renderMutex;
+		std::condition_variable renderCondition;
+		bool bStopRenderThread{ false };
+
+		// The seed RandomRoll was last started from, and whether it was chosen before CreateManager
+		unsigned int randomSeed{ 0 };
+		bool bRandomSeeded{ false };
+		// The stream RandomRoll uses on every thread except the job system's workers
+		PlayRandom random;
+		// Changes whenever the seed is set, so the workers know to restart their own streams
+		std::atomic<unsigned int> randomGeneration{ 0 };
+		// Pieces of work split between threads since the seed was set, which their random streams are made from
+		uint64_t randomWork{ 0 };
+
+		// The shared memory the metrics are published to, once PublishMetrics has been called
+		PlayMetricsMapping metrics;
+		uint64_t metricsFrame{ 0 };
+		uint32_t metricsHitches{ 0 };
+		unsigned long long metricsAllocations{ 0 };
+	};
+
+	// True while the frame is being drawn, so drawing operations go straight to the buffer
+	// > Per thread, as the render thread draws while the game thread records
+	static thread_local bool s_bDrawingFrame{ false };
+	// The number of contexts with a manager, so the job system they share is only destroyed along with the last one
+	static std::atomic<int> s_nManagers{ 0 };
+
+	thread_local Context* Context::s_pCurrent = nullptr;
+
+	Context::Context()
+	{
+		pManager = new ManagerState;
 	}
 
-	s_pInstance = nullptr;
-}
+	Context::~Context()
+	{
+		PLAY_ASSERT_MSG( this == &Default() || ( !pWindow && !pGraphics && !pAudio ), "Call Play::DestroyManager() before destroying the context it was created in" );
 
-//********************************************************************************************************************************
-// Instance access functions
-//********************************************************************************************************************************
+		// Anything created on demand since then is destroyed through the current context
+		Context* pPrevious = MakeCurrent();
+		PlayInput::Destroy();
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		PlaySystems::Destroy();
+		PlayObjects::Destroy();
+#endif
+		delete pManager;
+		s_pCurrent = ( pPrevious == this ) ? nullptr : pPrevious;
+	}
 
-PlayAudio& PlayAudio::Instance()
-{
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayAudio without initialising it!" );
-	return *s_pInstance;
-}
+	Context* Context::MakeCurrent()
+	{
+		Context* pPrevious = &Current();
+		s_pCurrent = this;
+		return pPrevious;
+	}
 
-PlayAudio& PlayAudio::Instance( const char* path )
-{
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayAudio( path );
-	return *s_pInstance;
-}
+	Context& Context::Default()
+	{
+		// Created on first use, so it's there for anything which runs before main()
+		static Context s_default;
+		return s_default;
+	}
 
-void PlayAudio::Destroy()
-{
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayAudio which hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
-}
+	// Gets the state behind the Play:: functions for the current context
+	static ManagerState& State()
+	{
+		return *Context::Current().pManager;
+	}
 
-//********************************************************************************************************************************
-// Sound playing functions
-//********************************************************************************************************************************
-void PlayAudio::StartAudio( const char* name, bool bLoop )
-{
-	std::string filename( name );
-	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+	// Returns true if drawing operations need to be recorded rather than performed straight away
+	static bool IsRecordingDraws()
+	{
+		return !s_bDrawingFrame && ( State().bRenderThread || PlayWindow::Instance().IsFixedTick() );
+	}
 
-	// Iterate through the sound data 
-	for( std::string& s : vSoundStrings )
+	// Returns true if the current drawing operation should be added to the draw list
+	// > Operations from ticks which don't get drawn are thrown away
+	static bool StartRecording()
 	{
-		if( s.find( filename ) != std::string::npos )
+		PlayWindow& window = PlayWindow::Instance();
+		ManagerState& state = State();
+
+		if( !window.IsDrawingTick() )
+			return false;
+
+		if( window.GetTickRate() > 0 && state.drawList.tick != window.GetTickCount() )
 		{
-			std::string command = "play " + s + " from 0";
-			if( bLoop ) command += " repeat";
-			mciSendStringA( command.c_str(), NULL, 0, 0 );
-			return;
+			state.drawList.Clear();
+			state.drawList.tick = window.GetTickCount();
 		}
-	}
-	PLAY_ASSERT_MSG( false, std::string( "Trying to play unknown sound effect: " + std::string( name ) ).c_str() );
-}
 
-void PlayAudio::StopAudio( const char* name )
-{
-	std::string filename( name );
-	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
+		return true;
+	}
 
-	// Iterate through the sound data 
-	for( std::string& s : vSoundStrings )
+	// Adds a drawing operation to the draw list
+	static void RecordDraw( std::function<void()>&& draw )
 	{
-		if( s.find( filename ) != std::string::npos )
-		{
-			std::string command = "stop " + s;
-			mciSendStringA( command.c_str(), NULL, 0, 0 );
+		if( !StartRecording() )
 			return;
-		}
+
+		ManagerState& state = State();
+		state.drawList.vItems.push_back( { RenderItem::COMMAND, static_cast<int>( state.drawList.vCommands.size() ), 0, {}, {}, 0.0f, 0.0f, 0.0f, 0.0f } );
+		state.drawList.vCommands.push_back( std::move( draw ) );
 	}
-	PLAY_ASSERT_MSG( false, std::string( "Trying to stop unknown sound effect: " + std::string( name ) ).c_str() );
-}
-//********************************************************************************************************************************
-// File:		PlayInput.cpp
-// Description:	Manages keyboard and mouse input 
-// Platform:	Windows
-// Notes:		Obtains mouse data from PlayWindow via MouseData structure
-//********************************************************************************************************************************
 
+	// Adds a sprite to the draw list
+	static void RecordSprite( const RenderItem& item )
+	{
+		if( StartRecording() )
+			State().drawList.vItems.push_back( item );
+	}
 
-PlayInput* PlayInput::s_pInstance = nullptr;
+	// Gets a position part way between the last two ticks
+	// > Big jumps (e.g. wrapping around the screen) aren't interpolated
+	static Point2f InterpolatePos( Point2f oldPos, Point2f pos, float interpolation )
+	{
+		Vector2f delta = pos - oldPos;
+		if( std::abs( delta.x ) > GetBufferWidth() / 2 || std::abs( delta.y ) > GetBufferHeight() / 2 )
+			return pos;
 
-//********************************************************************************************************************************
-// Constructor and destructor (private)
-//********************************************************************************************************************************
-PlayInput::PlayInput( void )
-{
-	PLAY_ASSERT_MSG( !s_pInstance, "PlayInput is a singleton class: multiple instances not allowed!" );
-	s_pInstance = this;
-}
+		return oldPos + delta * interpolation;
+	}
 
-PlayInput::~PlayInput( void )
-{
-	s_pInstance = nullptr;
-}
+	// Gets an angle part way between the last two ticks, taking the shortest way round
+	static float InterpolateRot( float oldRot, float rot, float interpolation )
+	{
+		float delta = std::remainder( rot - oldRot, 2.0f * PLAY_PI );
+		return oldRot + delta * interpolation;
+	}
 
-//********************************************************************************************************************************
-// Instance access functions
-//********************************************************************************************************************************
+	// Draws everything recorded in a snapshot
+	static void DrawSnapshot( const RenderSnapshot& snapshot )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
 
-PlayInput& PlayInput::Instance()
-{
-	if( !s_pInstance )
-		s_pInstance = new PlayInput();
+		for( const RenderItem& item : snapshot.vItems )
+		{
+			PLAY_BLIT_STAT( graphics.SetBlitStatsObjectType( item.objectType ); )
+			switch( item.kind )
+			{
+				case RenderItem::SPRITE:
+					graphics.Draw( item.id, InterpolatePos( item.oldPos, item.pos, snapshot.interpolation ), item.frame );
+					break;
+				case RenderItem::SPRITE_TRANSPARENT:
+					graphics.DrawTransparent( item.id, InterpolatePos( item.oldPos, item.pos, snapshot.interpolation ), item.frame, item.opacity );
+					break;
+				case RenderItem::SPRITE_ROTATED:
+					graphics.DrawRotated( item.id, InterpolatePos( item.oldPos, item.pos, snapshot.interpolation ), item.frame,
+										  InterpolateRot( item.oldRotation, item.rotation, snapshot.interpolation ), item.scale, item.opacity );
+					break;
+				case RenderItem::COMMAND:
+					snapshot.vCommands[item.id]();
+					break;
+			}
+		}
+		PLAY_BLIT_STAT( graphics.SetBlitStatsObjectType( -1 ); )
+	}
 
-	return *s_pInstance;
-}
+	// Draws the F1 debug overlay showing the sprite bounds of every GameObject
+	static void DrawDebugInfo();
 
-void PlayInput::Destroy()
-{
-	if( s_pInstance )
-		delete s_pInstance;
-}
+	// Copies the drawing buffer to the window
+	static void PresentFrame()
+	{
+		PlayWindow& window = PlayWindow::Instance();
 
-//********************************************************************************************************************************
-// Mouse functions
-//********************************************************************************************************************************
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		graphics.EndBlitCountFrame();
+		PLAY_BLIT_STAT( graphics.EndBlitStatsFrame(); )
+		PLAY_BLIT_STAT( graphics.EndOverdrawFrame(); )
 
-bool PlayInput::GetMouseDown( MouseButton button ) const
-{
-	PLAY_ASSERT_MSG( button == BUTTON_LEFT || button == BUTTON_RIGHT, "Invalid mouse button selected." );
+		// With a present thread drawing carries on straight away in the next buffer
+		if( window.GetPresentQueueDepth() > 0 )
+		{
+			// The size is taken first, as it belongs with the frame rather than the buffer
+			PixelData frame = *graphics.GetDrawingBuffer();
+			frame.pPixels = graphics.NextDrawingBuffer();
+			window.QueuePresent( frame );
+		}
+		else
+		{
+			window.Present();
+		}
+	}
 
-	if( button == BUTTON_LEFT )
-		return m_mouseData.left;
-	else
-		return m_mouseData.right;
-};
+	// Draws and presents the latest snapshot each time the game thread publishes one
+	static void RenderThread( Context* pContext )
+	{
+		PlayProfiler::SetThreadName( "Render" );
+		pContext->MakeCurrent();
+		ManagerState& state = State();
+		s_bDrawingFrame = true;
 
-bool PlayInput::KeyPressed( int vKey )
-{
-	static std::map< int, bool > keyMap;
+		for( ;; )
+		{
+			{
+				std::unique_lock<std::mutex> lock( state.renderMutex );
+				state.renderCondition.wait( lock, [&state]() { return state.renderSnapshots.HasNew() || state.bStopRenderThread; } );
+			}
+
+			if( !state.renderSnapshots.Acquire() )
+				break;
 
-	bool& held = keyMap[vKey];
+			PLAY_PROFILE_SCOPE( "RenderFrame" );
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			DrawSnapshot( state.renderSnapshots.GetReadBuffer() );
+			PresentFrame();
 
-	if( KeyDown( vKey ) && !held )
+			// Only drawing and presenting can slow this thread down, so that's what the render scale has to fit into the frame
+			// > Replays have to draw the same pixels however long the frames take
+			if( !PlayInput::Instance().IsReplaying() )
+				PlayGraphics::Instance().UpdateDynamicResolution( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() );
+		}
+	}
+
+	// Stops the render thread once it's drawn the last snapshot, returning true if it was running
+	static bool StopRenderThread()
 	{
-		held = true;
+		ManagerState& state = State();
+		if( !state.bRenderThread )
+			return false;
+
+		{
+			std::lock_guard<std::mutex> lock( state.renderMutex );
+			state.bStopRenderThread = true;
+		}
+
+		state.renderCondition.notify_one();
+		state.renderThread.join();
+		state.bRenderThread = false;
 		return true;
 	}
 
-	if( !KeyDown( vKey ) )
-		held = false;
-
-	return false;
-}
+	// Starts drawing and presenting frames on a render thread for the current context
+	static void StartRenderThread()
+	{
+		ManagerState& state = State();
+		state.bStopRenderThread = false;
+		state.bRenderThread = true;
+		state.renderThread = std::thread( RenderThread, &Context::Current() );
+	}
 
-bool PlayInput::KeyDown( int vKey )
-{
-	return GetAsyncKeyState( vKey ) & 0x8000; // Don't want multiple calls to KeyState
-}
-//********************************************************************************************************************************
-// File:		PlayManager.cpp
-// Description:	A manager for providing simplified access to the PlayBuffer framework
-// Platform:	Independent
-// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
-//********************************************************************************************************************************
+	// Draws the frame into the window, replaying the draw list when using a fixed tick rate
+	// > With a render thread the draw list is handed over for it to draw instead
+	static void DrawFrame()
+	{
+		PLAY_PROFILE_SCOPE( "DrawFrame" );
+		PlayWindow& window = PlayWindow::Instance();
+		ManagerState& state = State();
 
-//**************************************************************************************************
-// GameObject Class Definition
-//**************************************************************************************************
+		// Nothing was drawn on the last tick
+		if( window.GetTickRate() > 0 && state.drawList.tick != window.GetTickCount() )
+			state.drawList.Clear();
 
-// Define this to opt in to the PlayManager
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		state.drawList.interpolation = window.GetInterpolation();
 
-// Constructor for the GameObject struct - kept as simple as possible
-GameObject::GameObject( int type, Point2f newPos, int collisionRadius, int spriteId = 0 )
-	: type( type ), pos( newPos ), radius( collisionRadius ), spriteId( spriteId )
-{
-	// Member variables are assigned default values in the class header
-	static int uniqueId = 0;
-	m_id = uniqueId++;
-}
+		if( state.bRenderThread )
+		{
+			// Copied rather than swapped, as frames in between ticks draw the same list again
+			state.renderSnapshots.GetWriteBuffer() = state.drawList;
+			state.renderSnapshots.Publish();
 
-#endif
+			// Locking, however briefly, stops the render thread missing the wake up between checking for a snapshot and sleeping
+			{
+				std::lock_guard<std::mutex> lock( state.renderMutex );
+			}
+			state.renderCondition.notify_one();
 
-// The PlayManager is namespace rather than a class
-namespace Play
-{
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+			if( window.GetTickRate() == 0 )
+				state.drawList.Clear();
+			return;
+		}
 
-	// A map is used internally to store all the GameObjects and their unique ids
-	static std::map<int, GameObject&> objectMap;
+		s_bDrawingFrame = true;
 
-	// Used instead of Null return values, PlayMangager operations performed on this GameObject should fail transparently
-	static GameObject noObject{ -1,{ 0, 0 }, 0, -1 };
+		if( window.GetTickRate() > 0 )
+			DrawSnapshot( state.drawList );
 
-#endif 
+		if( state.bDebugInfo )
+			DrawDebugInfo();
 
-	// A set of default colour definitions
-	Colour cBlack{ 0.0f, 0.0f, 0.0f };
-	Colour cRed{ 100.0f, 0.0f, 0.0f };
-	Colour cGreen{ 0.0f, 100.0f, 0.0f };
-	Colour cBlue{ 0.0f, 0.0f, 100.0f };
-	Colour cMagenta{ 100.0f, 0.0f, 100.0f };
-	Colour cCyan{ 0.0f, 100.0f, 100.0f };
-	Colour cYellow{ 100.0f, 100.0f, 0.0f };
-	Colour cOrange{ 100.0f, 50.0f, 0.0f };
-	Colour cWhite{ 100.0f, 100.0f, 100.0f };
-	Colour cGrey{ 50.0f, 50.0f, 50.0f };
+		PresentFrame();
+		if( !PlayInput::Instance().IsReplaying() )
+			PlayGraphics::Instance().UpdateDynamicResolution( window.GetFrameElapsedMs() );
+		s_bDrawingFrame = false;
+	}
 
 	//**************************************************************************************************
 	// Manager creation and deletion
@@ -3494,22 +9716,32 @@ namespace Play
 		PlayGraphics::Instance( displayWidth, displayHeight, "Data\\Sprites\\" );
 		PlayWindow::Instance( PlayGraphics::Instance().GetDrawingBuffer(), displayScale );
 		PlayWindow::Instance().RegisterMouse( PlayInput::Instance().GetMouseData() );
+		PlayWindow::Instance().RegisterRedraw( DrawFrame );
 		PlayAudio::Instance( "Data\\Audio\\" );
-		// Seed the game's random number generator based on the time
-		srand( (int)time( NULL ) );
+		PlayJobs::Instance();
+		s_nManagers++;
+		// Seed the game's random number generator based on the time, unless a recording or replay has already chosen the seed
+		if( !State().bRandomSeeded )
+			SetRandomSeed( static_cast<unsigned int>( time( NULL ) ) );
 	}
 
 	void DestroyManager()
 	{
+		// Stop drawing and presenting before the drawing buffers are freed
+		StopRenderThread();
+		PlayWindow::Instance().SetPresentQueueDepth( 0 );
 		PlayAudio::Destroy();
 		PlayGraphics::Destroy();
 		PlayWindow::Destroy();
 		PlayInput::Destroy();
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
-		for( std::pair<const int, GameObject&>& p : objectMap )
-			delete& p.second;
-		objectMap.clear();
+		PlaySystems::Destroy();
+		PlayObjects::Destroy();
 #endif
+		// Other contexts may still be using the job system
+		if( --s_nManagers == 0 )
+			PlayJobs::Destroy();
+		State().bRandomSeeded = false;
 	}
 
 	int GetBufferWidth()
@@ -3522,12 +9754,146 @@ namespace Play
 		return PlayWindow::Instance().GetHeight();
 	}
 
+	void SetFrameRate( int framesPerSecond )
+	{
+		PlayWindow::Instance().SetFrameRate( framesPerSecond );
+	}
+
+	FramePacingStats GetFramePacingStats()
+	{
+		return PlayWindow::Instance().GetFramePacingStats();
+	}
+
+	PresentHistogram GetPresentHistogram()
+	{
+		return PlayWindow::Instance().GetPresentHistogram();
+	}
+
+	FrameTimeStats GetFrameTimeStats()
+	{
+		return PlayWindow::Instance().GetFrameTimeStats();
+	}
+
+	bool ExportFrameTimes( const char* filename )
+	{
+		return PlayWindow::Instance().ExportFrameTimes( filename );
+	}
+
+	bool PublishMetrics( const char* name )
+	{
+		ManagerState& state = State();
+		state.metricsFrame = 0;
+		state.metricsHitches = 0;
+		state.metricsAllocations = GetAllocationCount();
+		return state.metrics.Open( name, true );
+	}
+
+	// Fills in the metrics for the frame just finished and publishes them
+	static void PublishFrameMetrics()
+	{
+		ManagerState& state = State();
+		PlayWindow& window = PlayWindow::Instance();
+		PlayMetricsFrame frame{};
+
+		const FrameTimeHistory& times = window.GetFrameTimeHistory();
+		if( times.GetCount() > 0 )
+			frame.frameMs = static_cast<float>( times.Get( times.GetCount() - 1 ) );
+		if( frame.frameMs > window.GetFrameTime() * 1000.0 + FRAME_HITCH_MARGIN_MS )
+			state.metricsHitches++;
+
+		frame.frame = ++state.metricsFrame;
+		frame.hitches = state.metricsHitches;
+#ifdef _WIN32
+		frame.processId = GetCurrentProcessId();
+#else
+		frame.processId = static_cast<uint32_t>( getpid() );
+#endif
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		PlayObjects::Instance().ForEachTypeCount( [&frame]( int type, int count )
+		{
+			frame.objects += count;
+			if( frame.typeCount < PlayMetricsFrame::MAX_TYPES )
+			{
+				frame.types[frame.typeCount] = type;
+				frame.typeObjects[frame.typeCount++] = count;
+			}
+		} );
+#endif
+
+		// The render thread may still be drawing this frame, in which case these are for the one before
+		frame.blits = PlayGraphics::Instance().GetLastFrameBlitCount();
+#if PLAY_BLITTER_STATS
+		frame.flags |= PlayMetricsFrame::PIXEL_COUNTS;
+		frame.pixelsBlended = PlayGraphics::Instance().GetLastFramePixelsBlended();
+#endif
+
+#if defined( _DEBUG ) || PLAY_COUNT_ALLOCATIONS
+		frame.flags |= PlayMetricsFrame::ALLOCATION_COUNTS;
+#endif
+		unsigned long long allocations = GetAllocationCount();
+		frame.allocations = allocations - state.metricsAllocations;
+		state.metricsAllocations = allocations;
+
+		if( ::PlayAudio* pAudio = Context::Current().pAudio )
+			frame.audioVoices = pAudio->GetVoiceCount();
+
+		state.metrics.Get()->Publish( frame );
+	}
+
+	void SetPresentQueueDepth( int depth )
+	{
+		// Waits for the queue to empty, so none of the buffers are in use
+		bool bRenderThread = StopRenderThread();
+		PlayWindow::Instance().SetPresentQueueDepth( depth );
+		PlayGraphics::Instance().SetDrawingBufferCount( depth + 1 );
+
+		if( bRenderThread )
+			StartRenderThread();
+	}
+
+	void SetRenderThread( bool bEnable )
+	{
+		if( bEnable && !State().bRenderThread )
+			StartRenderThread();
+		else if( !bEnable )
+			StopRenderThread();
+	}
+
+	void SetUpscaleBands( int bands )
+	{
+		PlayWindow::Instance().SetUpscaleBands( bands );
+	}
+
+	void SetDynamicResolution( bool bEnable )
+	{
+		// The render thread changes the render scale between frames, so it can't be running while this does too
+		bool bRenderThread = StopRenderThread();
+		PlayGraphics::Instance().SetDynamicResolution( bEnable ? PlayWindow::Instance().GetFrameTime() * 1000.0 : 0.0 );
+
+		if( bRenderThread )
+			StartRenderThread();
+	}
+
+	PresentQueueStats GetPresentQueueStats()
+	{
+		return PlayWindow::Instance().GetPresentQueueStats();
+	}
+
+	void SetFixedTickRate( int ticksPerSecond )
+	{
+		PlayWindow::Instance().SetTickRate( ticksPerSecond );
+		State().drawList.Clear();
+	}
+
 	//**************************************************************************************************
 	// PlayGraphics functions
 	//**************************************************************************************************
 
 	void ClearDrawingBuffer( Colour c )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=]() { ClearDrawingBuffer( c ); } ); return; }
+
 		int r = static_cast<int>( c.red * 2.55f );
 		int g = static_cast<int>( c.green * 2.55f );
 		int b = static_cast<int>( c.blue * 2.55f );
@@ -3541,65 +9907,259 @@ namespace Play
 
 	void DrawBackground( int background )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=]() { DrawBackground( background ); } ); return; }
+		PLAY_PROFILE_SCOPE( "DrawBackground" );
 		PlayGraphics::Instance().DrawBackground( background );
 	}
 
 	void DrawDebugText( Point2D pos, const char* text, Colour c, bool centred )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=, s = std::string( text )]() { DrawDebugText( pos, s.c_str(), c, centred ); } ); return; }
 		PlayGraphics::Instance().DrawDebugString( pos, text, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, centred );
 	}
 
+	// The file F3 writes the frame times to
+	constexpr const char* FRAME_TIMES_FILE = "frame_times.csv";
+
 	void PresentDrawingBuffer()
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		static bool debugInfo = false;
+		PlayWindow& window = PlayWindow::Instance();
 
 		if( KeyPressed( VK_F1 ) )
-			debugInfo = !debugInfo;
+			State().bDebugInfo = !State().bDebugInfo;
+
+		if( KeyPressed( VK_F3 ) && !ExportFrameTimes( FRAME_TIMES_FILE ) )
+			PLAY_ASSERT_MSG( false, ( std::string( "Couldn't write the frame times to " ) + FRAME_TIMES_FILE ).c_str() );
+
+#if PLAY_BLITTER_STATS
+		// F2 steps through the overdraw views
+		if( KeyPressed( VK_F2 ) )
+		{
+			PlayGraphics& graphics = PlayGraphics::Instance();
+			graphics.SetOverdrawView( static_cast<PlayGraphics::OverdrawView>( ( graphics.GetOverdrawView() + 1 ) % PlayGraphics::OVERDRAW_VIEW_COUNT ) );
+		}
+#endif
 
-		if( debugInfo )
+		// With a fixed tick rate only the last tick before the frame gets drawn
+		bool bDrawn = !window.IsFixedTick() || window.IsDrawingTick();
+		if( bDrawn )
 		{
-			int textX = 10;
-			int textY = 10;
-			std::string s = "PlayBuffer Version:" + std::string( PLAY_VERSION );
-			pblt.DrawDebugString( { textX - 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX - 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false );
+			// The render thread can't look at the GameObjects, so the overlay is recorded along with everything else
+			if( State().bDebugInfo && State().bRenderThread )
+				DrawDebugInfo();
+
+			DrawFrame();
+		}
 
 #ifdef PLAY_USING_GAMEOBJECT_MANAGER
-			
-			for( std::pair<const int, GameObject&>& i : objectMap )
-			{
-				GameObject& obj = i.second;
-				int id = obj.spriteId;
-				Vector2D size = pblt.GetSpriteSize( obj.spriteId );
-				Vector2D origin = pblt.GetSpriteOrigin( id );
+		// The end of the frame is the one point where nobody should be looping over GameObjects
+		PlayObjects::Instance().FlushDestroyQueue();
+#endif
+
+		if( bDrawn && State().metrics.Get() )
+			PublishFrameMetrics();
+	}
+
+	// The most lines of the profile the F1 overlay has room for
+	constexpr int MAX_PROFILE_LINES = 30;
+	// The number of frames in the F1 overlay's frame time graph, one pixel across each
+	constexpr int FRAME_GRAPH_FRAMES = 300;
+	// The height of the frame time graph in pixels, which is twice the frame time budget
+	constexpr int FRAME_GRAPH_HEIGHT = 60;
+
+	// Draws a bar for each frame time with its bottom left corner at pos, red for the hitches
+	static void DrawFrameGraph( Point2f pos, const std::vector<float>& vMs, double budgetMs )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		graphics.DrawRect( { pos.x - 1, pos.y - FRAME_GRAPH_HEIGHT - 1 }, { pos.x + FRAME_GRAPH_FRAMES, pos.y + 1 }, PIX_BLACK, true );
 
-				// Corners of sprite drawing area
-				Point2D p0 = obj.pos - origin;
-				Point2D p2 = { obj.pos.x + size.width - origin.x, obj.pos.y + size.height - origin.y };
-				Point2D p1 = { p2.x, p0.y };
-				Point2D p3 = { p0.x, p2.y };
+		for( size_t i = 0; i < vMs.size(); i++ )
+		{
+			float height = std::min( static_cast<float>( vMs[i] / ( 2.0 * budgetMs ) ), 1.0f ) * FRAME_GRAPH_HEIGHT;
+			float x = pos.x + i;
+			graphics.DrawLine( { x, pos.y }, { x, pos.y - height }, vMs[i] > budgetMs + FRAME_HITCH_MARGIN_MS ? PIX_RED : PIX_GREEN );
+		}
+
+		// The budget is half way up
+		graphics.DrawLine( { pos.x, pos.y - FRAME_GRAPH_HEIGHT / 2 }, { pos.x + FRAME_GRAPH_FRAMES - 1, pos.y - FRAME_GRAPH_HEIGHT / 2 }, PIX_YELLOW );
+	}
+
+#if PLAY_BLITTER_STATS
+	// The number of sprites the F1 overlay lists the blitter's pixel counts for, busiest first
+	constexpr int MAX_BLIT_STATS_SPRITES = 8;
+
+	// Draws the blitter's pixel counts for the last frame into the F1 overlay, starting below textY
+	// > Called on whichever thread draws the frames, as that's where the counts are kept
+	static void DrawBlitStats( int textY )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		const PlayGraphics::BlitFrameStats& stats = graphics.GetLastFrameBlitStats();
+		char line[160];
+
+		auto drawLine = [&]( int indent, Pixel pix )
+		{
+			textY += 14;
+			graphics.DrawDebugString( { 11 + indent, textY + 1 }, line, PIX_BLACK, false );
+			graphics.DrawDebugString( { 10 + indent, textY }, line, pix, false );
+		};
+		auto format = [&line]( const char* name, const BlitStats& b )
+		{
+			snprintf( line, sizeof( line ), "%s x%llu: visited %llu blended %llu skipped %llu clipped %llu", name, b.calls, b.visited, b.blended, b.skipped, b.clipped );
+		};
+
+		format( "Blits", stats.total );
+		drawLine( 0, PIX_YELLOW );
+
+		// The heatmap replaces everything drawn so far, so the overdraw line is left for EndOverdrawFrame to write on top
+		if( graphics.GetOverdrawView() != PlayGraphics::OVERDRAW_OFF )
+		{
+			textY += 14;
+			graphics.ShowOverdrawSummary( textY );
+		}
+
+		// The sprites which covered the most pixels
+		std::vector<int> vSpriteIds;
+		for( size_t id = 0; id < stats.vSprites.size(); id++ )
+		{
+			if( stats.vSprites[id].calls > 0 )
+				vSpriteIds.push_back( static_cast<int>( id ) );
+		}
+		auto covered = [&stats]( int id ) { return stats.vSprites[id].visited + stats.vSprites[id].skipped; };
+		std::sort( vSpriteIds.begin(), vSpriteIds.end(), [&covered]( int a, int b ) { return covered( a ) > covered( b ); } );
+		if( vSpriteIds.size() > MAX_BLIT_STATS_SPRITES )
+			vSpriteIds.resize( MAX_BLIT_STATS_SPRITES );
 
-				DrawLine( p0, p1, cRed );
-				DrawLine( p1, p2, cRed );
-				DrawLine( p2, p3, cRed );
-				DrawLine( p3, p0, cRed );
+		for( int id : vSpriteIds )
+		{
+			format( graphics.GetSpriteName( id ).c_str(), stats.vSprites[id] );
+			drawLine( 12, PIX_WHITE );
+		}
 
-				DrawCircle( obj.pos, obj.radius, cBlue );
+		for( const std::pair<const int, BlitStats>& type : stats.objectTypes )
+		{
+			format( ( "Type " + std::to_string( type.first ) ).c_str(), type.second );
+			drawLine( 12, PIX_CYAN );
+		}
+	}
+#endif
 
-				DrawLine( { obj.pos.x - 20,  obj.pos.y - 20 }, { obj.pos.x + 20, obj.pos.y + 20 }, cWhite );
-				DrawLine( { obj.pos.x + 20, obj.pos.y - 20 }, { obj.pos.x - 20, obj.pos.y + 20 }, cWhite );
+	static void DrawDebugInfo()
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
 
-				s = pblt.GetSpriteName( obj.spriteId ) + " f[" + std::to_string( obj.frame ) + "]";
-				pblt.DrawDebugString( { ( p0.x + p1.x ) / 2.0f, p0.y - 20 }, s, PIX_WHITE, true );
+		auto drawString = [&pblt]( Point2f pos, const std::string& s, Pixel pix, bool centred )
+		{
+			if( IsRecordingDraws() ) { RecordDraw( [=]() { PlayGraphics::Instance().DrawDebugString( pos, s, pix, centred ); } ); return; }
+			pblt.DrawDebugString( pos, s, pix, centred );
+		};
+
+		int textX = 10;
+		int textY = 10;
+		std::string s = "PlayBuffer Version:" + std::string( PLAY_VERSION );
+		drawString( { textX - 1, textY - 1 }, s, PIX_BLACK, false );
+		drawString( { textX + 1, textY + 1 }, s, PIX_BLACK, false );
+		drawString( { textX + 1, textY - 1 }, s, PIX_BLACK, false );
+		drawString( { textX - 1, textY + 1 }, s, PIX_BLACK, false );
+		drawString( { textX, textY }, s, PIX_YELLOW, false );
+
+		// The last frame's PLAY_PROFILE_SCOPE timings, nested under the scopes they were called from
+		ProfileFrame frame;
+		if( PlayProfiler::GetLastFrame( frame ) )
+		{
+			char line[128];
+			auto drawLine = [&]( int indent, Pixel pix )
+			{
+				textY += 14;
+				drawString( { textX + indent + 1, textY + 1 }, line, PIX_BLACK, false );
+				drawString( { textX + indent, textY }, line, pix, false );
+			};
+
+			snprintf( line, sizeof( line ), "Frame %.2fms", frame.ms );
+			drawLine( 0, PIX_YELLOW );
+			int nLines = std::min( static_cast<int>( frame.vLines.size() ), MAX_PROFILE_LINES );
+			for( int i = 0; i < nLines; i++ )
+			{
+				const ProfileLine& p = frame.vLines[i];
+				if( p.calls > 1 )
+					snprintf( line, sizeof( line ), "%s %.2fms x%d", p.name, p.ms, p.calls );
+				else
+					snprintf( line, sizeof( line ), "%s %.2fms", p.name, p.ms );
+				drawLine( ( p.depth + 1 ) * 12, PIX_WHITE );
+			}
+			for( const std::pair<std::string, double>& thread : frame.vOtherThreadMs )
+			{
+				snprintf( line, sizeof( line ), "%s busy %.2fms", thread.first.c_str(), thread.second );
+				drawLine( 0, PIX_CYAN );
 			}
+		}
+
+#if PLAY_BLITTER_STATS
+		if( IsRecordingDraws() )
+			RecordDraw( [textY]() { DrawBlitStats( textY ); } );
+		else
+			DrawBlitStats( textY );
 #endif
+
+		// The spread of the recent frame times in the top right, as the odd slow frame doesn't show up in an average
+		{
+			PlayWindow& window = PlayWindow::Instance();
+			FrameTimeStats times = window.GetFrameTimeStats();
+			const FrameTimeHistory& history = window.GetFrameTimeHistory();
+			int x = GetBufferWidth() - FRAME_GRAPH_FRAMES - 10;
+			int y = 100;
+			char line[128];
+
+			snprintf( line, sizeof( line ), "Last %d frames (F3 saves)", times.frames );
+			drawString( { x + 1, y + 1 }, line, PIX_BLACK, false );
+			drawString( { x, y }, line, PIX_YELLOW, false );
+			snprintf( line, sizeof( line ), "p50 %.2f p95 %.2f p99 %.2f max %.2fms", times.p50Ms, times.p95Ms, times.p99Ms, times.maxMs );
+			drawString( { x + 1, y + 15 }, line, PIX_BLACK, false );
+			drawString( { x, y + 14 }, line, PIX_WHITE, false );
+			snprintf( line, sizeof( line ), "Hitches %d over %.2fms %d over %.2fms", times.hitches, times.budgetMs + FRAME_HITCH_MARGIN_MS, times.bigHitches, 2.0 * times.budgetMs );
+			drawString( { x + 1, y + 29 }, line, PIX_BLACK, false );
+			drawString( { x, y + 28 }, line, times.hitches > 0 ? PIX_ORANGE : PIX_WHITE, false );
+
+			std::vector<float> vMs;
+			for( int i = std::max( history.GetCount() - FRAME_GRAPH_FRAMES, 0 ); i < history.GetCount(); i++ )
+				vMs.push_back( history.Get( i ) );
+
+			Point2f graphPos( x, y + 46 + FRAME_GRAPH_HEIGHT );
+			if( IsRecordingDraws() )
+				RecordDraw( [graphPos, vMs = std::move( vMs ), budgetMs = times.budgetMs]() { DrawFrameGraph( graphPos, vMs, budgetMs ); } );
+			else
+				DrawFrameGraph( graphPos, vMs, times.budgetMs );
 		}
 
-		PlayWindow::Instance().Present();
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		
+		PlayObjects& objects = PlayObjects::Instance();
+		for( int objId : objects.CollectAllIds() )
+		{
+			GameObject& obj = *objects.Find( objId );
+			int id = obj.spriteId;
+			Vector2D size = pblt.GetSpriteSize( obj.spriteId );
+			Vector2D origin = pblt.GetSpriteOrigin( id );
+
+			// Corners of sprite drawing area
+			Point2D p0 = obj.pos - origin;
+			Point2D p2 = { obj.pos.x + size.width - origin.x, obj.pos.y + size.height - origin.y };
+			Point2D p1 = { p2.x, p0.y };
+			Point2D p3 = { p0.x, p2.y };
+
+			DrawLine( p0, p1, cRed );
+			DrawLine( p1, p2, cRed );
+			DrawLine( p2, p3, cRed );
+			DrawLine( p3, p0, cRed );
+
+			DrawCircle( obj.pos, obj.radius, cBlue );
+
+			DrawLine( { obj.pos.x - 20,  obj.pos.y - 20 }, { obj.pos.x + 20, obj.pos.y + 20 }, cWhite );
+			DrawLine( { obj.pos.x + 20, obj.pos.y - 20 }, { obj.pos.x - 20, obj.pos.y + 20 }, cWhite );
+
+			s = pblt.GetSpriteName( obj.spriteId ) + " f[" + std::to_string( obj.frame ) + "]";
+			drawString( { ( p0.x + p1.x ) / 2.0f, p0.y - 20 }, s, PIX_WHITE, true );
+		}
+#endif
 	}
 
 	Point2D GetMousePos()
@@ -3684,6 +10244,8 @@ namespace Play
 
 	void ColourSprite( const char* spriteName, Colour c )
 	{
+		// Colouring has to happen in the same order as the drawing it affects
+		if( IsRecordingDraws() ) { RecordDraw( [=, s = std::string( spriteName )]() { ColourSprite( s.c_str(), c ); } ); return; }
 		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
 		PlayGraphics::Instance().ColourSprite( spriteId, static_cast<int>( c.red * 2.55f ), static_cast<int>( c.green * 2.55f), static_cast<int>( c.blue * 2.55f ) );
 	}
@@ -3746,51 +10308,59 @@ namespace Play
 
 	void DrawSprite( const char* spriteName, Point2D pos, int frameIndex )
 	{
-		PlayGraphics::Instance().Draw( PlayGraphics::Instance().GetSpriteId( spriteName ), pos, frameIndex );
+		DrawSprite( PlayGraphics::Instance().GetSpriteId( spriteName ), pos, frameIndex );
 	}
 
 	void DrawSprite( int spriteID, Point2D pos, int frameIndex )
 	{
+		if( IsRecordingDraws() ) { RecordSprite( { RenderItem::SPRITE, spriteID, frameIndex, pos, pos, 0.0f, 0.0f, 1.0f, 1.0f } ); return; }
 		PlayGraphics::Instance().Draw( spriteID, pos, frameIndex );
 	}
 
 	void DrawSpriteTransparent( const char* spriteName, Point2D pos, int frameIndex, float opacity )
 	{
-		PlayGraphics::Instance().DrawTransparent( PlayGraphics::Instance().GetSpriteId( spriteName ), pos, frameIndex, opacity );
+		DrawSpriteTransparent( PlayGraphics::Instance().GetSpriteId( spriteName ), pos, frameIndex, opacity );
 	}
 
 	void DrawSpriteTransparent( int spriteID, Point2D pos, int frameIndex, float opacity )
 	{
+		if( IsRecordingDraws() ) { RecordSprite( { RenderItem::SPRITE_TRANSPARENT, spriteID, frameIndex, pos, pos, 0.0f, 0.0f, 1.0f, opacity } ); return; }
 		PlayGraphics::Instance().DrawTransparent( spriteID, pos, frameIndex, opacity );
 	}
 
 	void DrawSpriteRotated( const char* spriteName, Point2D pos, int frameIndex, float angle, float scale, float opacity )
 	{
-		PlayGraphics::Instance().DrawRotated( PlayGraphics::Instance().GetSpriteId( spriteName ), pos, frameIndex, angle, scale, opacity );
+		DrawSpriteRotated( PlayGraphics::Instance().GetSpriteId( spriteName ), pos, frameIndex, angle, scale, opacity );
 	}
 
 	void DrawSpriteRotated( int spriteID, Point2D pos, int frameIndex, float angle, float scale, float opacity )
 	{
+		if( IsRecordingDraws() ) { RecordSprite( { RenderItem::SPRITE_ROTATED, spriteID, frameIndex, pos, pos, angle, angle, scale, opacity } ); return; }
 		PlayGraphics::Instance().DrawRotated( spriteID, pos, frameIndex, angle, scale, opacity );
 	}
 
 	void DrawLine( Point2f start, Point2f end, Colour c )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=]() { DrawLine( start, end, c ); } ); return; }
 		return PlayGraphics::Instance().DrawLine( start, end, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }  );
 	}
 
 	void DrawCircle( Point2D pos, int radius, Colour c )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=]() { DrawCircle( pos, radius, c ); } ); return; }
 		PlayGraphics::Instance().DrawCircle( pos, radius, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f } );
 	}
 
 	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour c, bool fill )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=]() { DrawRect( topLeft, bottomRight, c, fill ); } ); return; }
 		PlayGraphics::Instance().DrawRect( topLeft, bottomRight, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, fill );
 	}
 
 	void DrawSpriteLine( Point2f startPos, Point2f endPos, const char* penSprite, Colour c )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=, s = std::string( penSprite )]() { DrawSpriteLine( startPos, endPos, s.c_str(), c ); } ); return; }
+
 		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
 		ColourSprite( penSprite, c );
 
@@ -3849,6 +10419,8 @@ namespace Play
 
 	void DrawSpriteCircle( int x, int y, int radius, const char* penSprite, Colour c )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=, s = std::string( penSprite )]() { DrawSpriteCircle( x, y, radius, s.c_str(), c ); } ); return; }
+
 		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
 		ColourSprite( penSprite, c );
 
@@ -3874,6 +10446,8 @@ namespace Play
 
 	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=, s = std::string( fontId )]() { DrawFontText( s.c_str(), text, pos, justify ); } ); return; }
+
 		int font = PlayGraphics::Instance().GetSpriteId( fontId );
 
 		int totalWidth{ 0 };
@@ -3907,6 +10481,7 @@ namespace Play
 
 	void DrawTimingBar( Point2f pos, Point2f size )
 	{
+		if( IsRecordingDraws() ) { RecordDraw( [=]() { DrawTimingBar( pos, size ); } ); return; }
 		PlayGraphics::Instance().DrawTimingBar( pos, size );
 	}
 
@@ -3920,53 +10495,49 @@ namespace Play
 	int CreateGameObject( int type, Point2f newPos, int collisionRadius, const char* spriteName )
 	{
 		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
-		// Deletion is handled in DestroyGameObject()
-		GameObject* pObj = new GameObject( type, newPos, collisionRadius, spriteId );
-		int id = pObj->GetId();
-		objectMap.insert( std::map<int, GameObject&>::value_type( id, *pObj ) );
-		return id;
+		// Deletion is handled in DestroyGameObject() or QueueDestroy()
+		return PlayObjects::Instance().Create( type, newPos, collisionRadius, spriteId ).GetId();
 	}
 
 	GameObject& GetGameObject( int ID )
 	{
-		std::map<int, GameObject&>::iterator i = objectMap.find( ID );
+		GameObject* pObj = PlayObjects::Instance().Find( ID );
 
-		if( i == objectMap.end() )
+		if( !pObj )
 			return noObject;
 
-		return i->second;
+		return *pObj;
 	}
 
 	GameObject& GetGameObjectByType( int type )
 	{
-		for( std::pair<const int, GameObject&>& i : objectMap )
-		{
-			if( i.second.type == type )
-				return i.second;
-		}
+		GameObject* pObj = PlayObjects::Instance().FindFirstOfType( type );
+
+		if( !pObj )
+			return noObject;
 
-		return noObject;
+		return *pObj;
 	}
 
 	std::vector<int> CollectGameObjectIDsByType( int type )
 	{
-		std::vector<int> vec;
-		for( std::pair<const int, GameObject&>& i : objectMap )
-		{
-			if( i.second.type == type )
-				vec.push_back( i.first );
-		}
-		return vec; // Returning a copy of the vector
+		GameObjectIdSpan ids = PlayObjects::Instance().GetIdsOfType( type );
+		return std::vector<int>( ids.begin(), ids.end() ); // Returning a copy so the objects can be changed while looping
 	}
 
-	std::vector<int> CollectAllGameObjectIDs()
+	GameObjectIdSpan GetGameObjectIDsByType( int type )
 	{
-		std::vector<int> vec;
+		return PlayObjects::Instance().GetIdsOfType( type );
+	}
 
-		for( std::pair<const int, GameObject&>& i : objectMap )
-			vec.push_back( i.first );
+	int CountGameObjectsByType( int type )
+	{
+		return static_cast<int>( PlayObjects::Instance().GetIdsOfType( type ).size() );
+	}
 
-		return vec; // Returning a copy of the vector
+	std::vector<int> CollectAllGameObjectIDs()
+	{
+		return PlayObjects::Instance().CollectAllIds(); // Returning a copy of the vector
 	}
 
 	void UpdateGameObject( GameObject& obj, bool bWrap, int wrapBorderSize )
@@ -4010,17 +10581,41 @@ namespace Play
 
 	}
 
+	void UpdateGameObjects( int type, bool bWrap, int wrapBorderSize )
+	{
+		PlayObjects::Instance().ParallelForEach( type, [=]( GameObject& obj ) { UpdateGameObject( obj, bWrap, wrapBorderSize ); } );
+	}
+
+	void ParallelForEach( int type, const std::function<void( GameObject& )>& fn )
+	{
+		PlayObjects::Instance().ParallelForEach( type, fn );
+	}
+
 	void DestroyGameObject( int ID )
 	{
-		if( objectMap.find( ID ) == objectMap.end() )
+		GameObject* go = PlayObjects::Instance().Find( ID );
+
+		if( !go )
+		{
+			PLAY_ASSERT_MSG( false, "Unable to find object with given ID" );
+		}
+		else
+		{
+			PlayObjects::Instance().Release( *go );
+		}
+	}
+
+	void QueueDestroy( int ID )
+	{
+		GameObject* go = PlayObjects::Instance().Find( ID );
+
+		if( !go )
 		{
 			PLAY_ASSERT_MSG( false, "Unable to find object with given ID" );
 		}
 		else
 		{
-			GameObject* go = &objectMap.find( ID )->second;
-			delete go;
-			objectMap.erase( ID );
+			PlayObjects::Instance().QueueDestroy( *go );
 		}
 	}
 
@@ -4031,6 +10626,45 @@ namespace Play
 			DestroyGameObject( typeVec[i] );
 	}
 
+	void ResetWorld( const std::vector<int>& keepTypes )
+	{
+		PlayObjects::Instance().ResetWorld( keepTypes );
+	}
+
+	int RegisterArchetype( int type, const char* spriteName, int collisionRadius, float animSpeed, Vector2D velocity, float rotation, float rotSpeed )
+	{
+		GameObjectArchetype archetype;
+		archetype.type = type;
+		archetype.spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
+		archetype.radius = collisionRadius;
+		archetype.animSpeed = animSpeed;
+		archetype.velocity = velocity;
+		archetype.rotation = rotation;
+		archetype.rotSpeed = rotSpeed;
+		return PlayObjects::Instance().RegisterArchetype( archetype );
+	}
+
+	int SpawnBatch( int archetypeId, int count, PlayFunctionRef<void( GameObject&, int )> initializer )
+	{
+		return PlayObjects::Instance().SpawnBatch( archetypeId, count, initializer );
+	}
+
+	void RegisterSystem( const char* name, const std::function<void()>& fn, const SystemAccess& access )
+	{
+		PlaySystems::Instance().Register( name, fn, access );
+	}
+
+	void RunSystems()
+	{
+		PLAY_PROFILE_SCOPE( "RunSystems" );
+		PlaySystems::Instance().Run();
+	}
+
+	void SetSystemsSerial( bool bSerial )
+	{
+		PlaySystems::Instance().SetSerial( bSerial );
+	}
+
 	bool IsColliding( GameObject& object1, GameObject& object2 )
 	{
 		//Don't collide with noObject
@@ -4102,8 +10736,10 @@ namespace Play
 	{
 		if( obj.type == -1 ) return; // Not for noObject
 
-		obj.velocity.x = speed * sin( angle );
-		obj.velocity.y = speed * -cos( angle );
+		float sinAngle, cosAngle;
+		FastSinCos( angle, sinAngle, cosAngle );
+		obj.velocity.x = speed * sinAngle;
+		obj.velocity.y = speed * -cosAngle;
 	}
 
 	void PointGameObject( GameObject& obj, int speed, int targetX, int targetY )
@@ -4113,10 +10749,12 @@ namespace Play
 		float xdiff = obj.pos.x - targetX;
 		float ydiff = obj.pos.y - targetY;
 
-		obj.rotation = atan2( ydiff, xdiff ) - (PLAY_PI/2);
+		obj.rotation = FastAtan2( ydiff, xdiff ) - (PLAY_PI/2);
 
-		obj.velocity.x = speed * sin( obj.rotation );
-		obj.velocity.y = speed * -cos( obj.rotation );
+		float sinAngle, cosAngle;
+		FastSinCos( obj.rotation, sinAngle, cosAngle );
+		obj.velocity.x = speed * sinAngle;
+		obj.velocity.y = speed * -cosAngle;
 	}
 
 	void SetSprite( GameObject& obj, const char* spriteName, float animSpeed )
@@ -4129,22 +10767,56 @@ namespace Play
 		obj.animSpeed = animSpeed;
 	}
 
+	// The GameObject might not exist by the time a recorded draw is replayed so everything needed is copied
 	void DrawObject( GameObject& obj )
 	{
 		if( obj.type == -1 ) return; // Don't draw noObject
+
+		if( IsRecordingDraws() )
+		{
+			RenderItem item{ RenderItem::SPRITE, obj.spriteId, obj.frame, obj.oldPos, obj.pos, 0.0f, 0.0f, 1.0f, 1.0f };
+			PLAY_BLIT_STAT( item.objectType = obj.type; )
+			RecordSprite( item );
+			return;
+		}
+
+		PLAY_BLIT_STAT( PlayGraphics::Instance().SetBlitStatsObjectType( obj.type ); )
 		PlayGraphics::Instance().Draw( obj.spriteId, obj.pos, obj.frame );
+		PLAY_BLIT_STAT( PlayGraphics::Instance().SetBlitStatsObjectType( -1 ); )
 	}
 
 	void DrawObjectTransparent( GameObject& obj, float opacity )
 	{
 		if( obj.type == -1 ) return; // Don't draw noObject
+
+		if( IsRecordingDraws() )
+		{
+			RenderItem item{ RenderItem::SPRITE_TRANSPARENT, obj.spriteId, obj.frame, obj.oldPos, obj.pos, 0.0f, 0.0f, 1.0f, opacity };
+			PLAY_BLIT_STAT( item.objectType = obj.type; )
+			RecordSprite( item );
+			return;
+		}
+
+		PLAY_BLIT_STAT( PlayGraphics::Instance().SetBlitStatsObjectType( obj.type ); )
 		PlayGraphics::Instance().DrawTransparent( obj.spriteId, obj.pos, obj.frame, opacity );
+		PLAY_BLIT_STAT( PlayGraphics::Instance().SetBlitStatsObjectType( -1 ); )
 	}
 
 	void DrawObjectRotated( GameObject& obj, float opacity )
 	{
 		if( obj.type == -1 ) return; // Don't draw noObject
+
+		if( IsRecordingDraws() )
+		{
+			RenderItem item{ RenderItem::SPRITE_ROTATED, obj.spriteId, obj.frame, obj.oldPos, obj.pos, obj.oldRot, obj.rotation, obj.scale, opacity };
+			PLAY_BLIT_STAT( item.objectType = obj.type; )
+			RecordSprite( item );
+			return;
+		}
+
+		PLAY_BLIT_STAT( PlayGraphics::Instance().SetBlitStatsObjectType( obj.type ); )
 		PlayGraphics::Instance().DrawRotated( obj.spriteId, obj.pos, obj.frame, obj.rotation, obj.scale, opacity );
+		PLAY_BLIT_STAT( PlayGraphics::Instance().SetBlitStatsObjectType( -1 ); )
 	}
 
 #endif
@@ -4163,19 +10835,138 @@ namespace Play
 		return PlayInput::Instance().KeyDown( vKey );
 	}
 
+	void SetKeyDown( int vKey, bool bDown )
+	{
+		PlayInput::Instance().SetKeyDown( vKey, bDown );
+	}
+
+	void SetInputDriver( std::function<void( int frame )> driver )
+	{
+		PlayInput::Instance().SetInputDriver( std::move( driver ) );
+	}
+
+	// Unique across every context, so a worker can tell whose seed its stream came from
+	static std::atomic<unsigned int> s_randomGeneration{ 0 };
+
+	void SetRandomSeed( unsigned int seed )
+	{
+		ManagerState& state = State();
+		state.randomSeed = seed;
+		state.bRandomSeeded = true;
+		state.random.Seed( seed );
+		state.randomWork = 0;
+		state.randomGeneration.store( ++s_randomGeneration, std::memory_order_release );
+	}
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+	static uint64_t NextRandomWorkKey()
+	{
+		// Inside a chunk the key comes from the chunk, as several chunks could be splitting up work at once
+		if( PlayRandomScope* pScope = PlayRandomScope::Current() )
+			return pScope->NextKey();
+
+		ManagerState& state = State();
+		return PlayRandom::Mix( state.randomSeed, ++state.randomWork );
+	}
+#endif
+
+	// Gets the calling thread's stream of random numbers
+	// > Chunks of ParallelForEach and parallel system steps use their PlayRandomScope's stream, so they're repeatable
+	// > Otherwise workers (running jobs from PlayJobs::Run) each jump to their own part of the seed's sequence, which
+	// > isn't repeatable as the jobs can run on any worker, while every other thread uses the context's stream 0
+	static PlayRandom& ThreadRandom()
+	{
+		if( PlayRandomScope* pScope = PlayRandomScope::Current() )
+			return pScope->Random();
+
+		int threadIndex = PlayJobs::GetCallingThreadIndex();
+		if( threadIndex <= 0 )
+			return State().random;
+
+		// One per context the worker has run jobs for, so switching between contexts doesn't restart the streams
+		struct WorkerStream
+		{
+			const ManagerState* pState;
+			PlayRandom random;
+			// Contexts which have never been seeded are on generation 0
+			unsigned int generation{ UINT_MAX };
+		};
+		static thread_local std::vector<WorkerStream> vWorkerStreams;
+		ManagerState& state = State();
+		WorkerStream* pWorker = nullptr;
+		for( WorkerStream& w : vWorkerStreams )
+		{
+			if( w.pState == &state )
+				pWorker = &w;
+		}
+		if( !pWorker )
+		{
+			vWorkerStreams.push_back( { &state, PlayRandom(), UINT_MAX } );
+			pWorker = &vWorkerStreams.back();
+		}
+
+		// Generations are unique across every context, so a stream left behind by a destroyed context is never reused as it is
+		unsigned int generation = state.randomGeneration.load( std::memory_order_acquire );
+		if( pWorker->generation != generation )
+		{
+			pWorker->random.Seed( state.randomSeed );
+			for( int i = 0; i < threadIndex; i++ )
+				pWorker->random.Jump();
+			pWorker->generation = generation;
+		}
+		return pWorker->random;
+	}
+
+	unsigned int GetRandomSeed()
+	{
+		return State().randomSeed;
+	}
+
+	void RecordInput( const char* filename )
+	{
+		// Before CreateManager the seed is chosen here instead
+		ManagerState& state = State();
+		unsigned int seed = state.bRandomSeeded ? state.randomSeed : static_cast<unsigned int>( time( NULL ) );
+		SetRandomSeed( seed );
+		PlayInput::Instance().StartRecording( filename, seed );
+	}
+
+	void ReplayInput( const char* filename )
+	{
+		SetRandomSeed( PlayInput::Instance().StartReplay( filename ) );
+	}
+
+	bool ExportProfile( const char* filename, int frames )
+	{
+		return PlayProfiler::ExportChromeTrace( filename, frames );
+	}
+
 	int RandomRoll( int sides )
 	{
-		return ( rand() % sides ) + 1;
+		PLAY_ASSERT_MSG( sides > 0, "RandomRoll needs at least one side" );
+		return static_cast<int>( ThreadRandom().Bounded( static_cast<uint32_t>( sides ) ) ) + 1;
 	}
 
 	int RandomRollRange( int begin, int end )
 	{
-		int range = abs( end - begin );
-		int rnd = ( rand() % ( range + 1 ) );
+		// Either way round is fine
 		if( end > begin )
-			return begin + rnd;
+			return ThreadRandom().Range( begin, end );
+		else
+			return ThreadRandom().Range( end, begin );
+	}
+
+	float RandomFloat()
+	{
+		return ThreadRandom().NextFloat();
+	}
+
+	void RandomRollFill( int* pResults, int count, int min, int max )
+	{
+		if( max > min )
+			ThreadRandom().Fill( pResults, count, min, max );
 		else
-			return end + rnd;
+			ThreadRandom().Fill( pResults, count, max, min );
 	}
 }
 #endif // PLAY_IMPLEMENTATION
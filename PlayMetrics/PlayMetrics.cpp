@@ -0,0 +1,123 @@
+// PlayMetrics
+// Watches the per-frame metrics a PlayBuffer game publishes to shared memory
+// ------------------------------------------
+// The game has to call Play::PublishMetrics() or be started with --play-metrics[=<name>]
+// Build: g++ -std=c++17 -I.. PlayMetrics.cpp -o PlayMetrics (add -lrt on older Linux), or add it to an empty console project
+// Usage: PlayMetrics [name] [--interval=<ms>] [--once]
+// ------------------------------------------
+
+// Only the inline PlayMetrics classes are used, so there's no PLAY_IMPLEMENTATION
+#include "Play.h"
+
+// How often a line is printed unless --interval is given
+constexpr int DEFAULT_INTERVAL_MS = 500;
+// How many times a read is tried while the game is in the middle of writing the block
+constexpr int MAX_READ_ATTEMPTS = 1000;
+
+// Copies the latest frame out of the block, retrying while the game is writing it
+static bool ReadFrame( const PlayMetricsBlock& block, PlayMetricsFrame& frame )
+{
+	for( int i = 0; i < MAX_READ_ATTEMPTS; i++ )
+	{
+		if( block.Read( frame ) )
+			return true;
+		std::this_thread::yield();
+	}
+	return false;
+}
+
+// Prints one line for a frame, with "-" for the counts the game isn't keeping
+static void PrintFrame( const PlayMetricsFrame& frame, bool bStalled )
+{
+	printf( "frame %llu  %.2f ms  hitches %u  objects %u", static_cast<unsigned long long>( frame.frame ), frame.frameMs, frame.hitches, frame.objects );
+
+	if( frame.typeCount > 0 )
+	{
+		printf( " (" );
+		for( uint32_t t = 0; t < frame.typeCount && t < PlayMetricsFrame::MAX_TYPES; t++ )
+			printf( t ? " %d:%u" : "%d:%u", frame.types[t], frame.typeObjects[t] );
+		printf( ")" );
+	}
+
+	printf( "  blits %llu", static_cast<unsigned long long>( frame.blits ) );
+	if( frame.flags & PlayMetricsFrame::PIXEL_COUNTS )
+		printf( "  blended %llu", static_cast<unsigned long long>( frame.pixelsBlended ) );
+	else
+		printf( "  blended -" );
+
+	if( frame.flags & PlayMetricsFrame::ALLOCATION_COUNTS )
+		printf( "  allocs %llu", static_cast<unsigned long long>( frame.allocations ) );
+	else
+		printf( "  allocs -" );
+
+	printf( "  voices %u%s\n", frame.audioVoices, bStalled ? "  (stalled)" : "" );
+	fflush( stdout );
+}
+
+int main( int argc, char* argv[] )
+{
+	std::string name = "PlayMetrics";
+	int intervalMs = DEFAULT_INTERVAL_MS;
+	bool bOnce = false;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		std::string arg( argv[i] );
+
+		if( arg.rfind( "--interval=", 0 ) == 0 )
+			intervalMs = std::max( atoi( arg.c_str() + 11 ), 1 );
+		else if( arg == "--once" )
+			bOnce = true;
+		else if( arg.rfind( "--", 0 ) == 0 )
+		{
+			printf( "Usage: PlayMetrics [name] [--interval=<ms>] [--once]\n" );
+			return 1;
+		}
+		else
+			name = arg;
+	}
+
+	// Waits for the game to create the block, unless it's only being read once
+	PlayMetricsMapping mapping;
+	bool bWaiting = false;
+	while( !mapping.Open( name.c_str(), false ) )
+	{
+		if( bOnce )
+		{
+			printf( "No metrics published as %s\n", name.c_str() );
+			return 1;
+		}
+		if( !bWaiting )
+		{
+			printf( "Waiting for a game to publish metrics as %s...\n", name.c_str() );
+			fflush( stdout );
+			bWaiting = true;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( intervalMs ) );
+	}
+
+	uint64_t lastFrame = 0;
+	uint32_t processId = 0;
+	for( ;; )
+	{
+		PlayMetricsFrame frame;
+		if( !ReadFrame( *mapping.Get(), frame ) )
+		{
+			printf( "Couldn't read a frame which wasn't being written\n" );
+			return 1;
+		}
+
+		if( frame.processId != processId )
+		{
+			printf( "Process %u\n", frame.processId );
+			processId = frame.processId;
+		}
+
+		PrintFrame( frame, frame.frame != 0 && frame.frame == lastFrame );
+		lastFrame = frame.frame;
+
+		if( bOnce )
+			return 0;
+		std::this_thread::sleep_for( std::chrono::milliseconds( intervalMs ) );
+	}
+}
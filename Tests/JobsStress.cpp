@@ -0,0 +1,136 @@
+// JobsStress
+// Checks that PlayJobs runs every job exactly once, however the jobs are nested and however long they take
+// ------------------------------------------
+// Each round runs a ParallelFor whose chunks each run a ParallelFor of their own, with random numbers of chunks of random sizes
+// Every inner chunk sums a run of numbers and counts how many times it was called, and both are checked afterwards
+// Each round also runs a group of jobs with Run and a job which adds up their results with RunAfter
+// ------------------------------------------
+
+#define PLAY_IMPLEMENTATION
+#include "Play.h"
+
+constexpr int DISPLAY_WIDTH = 64;
+constexpr int DISPLAY_HEIGHT = 64;
+constexpr int DISPLAY_SCALE = 1;
+// How many rounds of nested jobs are run
+constexpr int ROUND_COUNT = 200;
+// The most chunks in the outer and inner ParallelFor
+constexpr int MAX_OUTER_CHUNKS = 32;
+constexpr int MAX_INNER_CHUNKS = 64;
+// The most numbers an inner chunk adds up
+constexpr int MAX_CHUNK_SIZE = 20000;
+// How many jobs are in the group RunAfter waits for
+constexpr int GROUP_JOBS = 100;
+
+// The number of checks which failed
+static int s_nFailures = 0;
+
+static void Check( bool bPassed, const char* what, int round )
+{
+	if( bPassed )
+		return;
+	printf( "Round %d: %s\n", round, what );
+	s_nFailures++;
+}
+
+// The sum of 0 to n-1, worked out the long way so the chunks take different amounts of time
+static uint64_t SumTo( int n )
+{
+	uint64_t sum = 0;
+	for( int i = 0; i < n; i++ )
+		sum += static_cast<uint64_t>( i );
+	return sum;
+}
+
+// A ParallelFor of ParallelFors
+static void RunNestedRound( PlayJobs& jobs, PlayRandom& random, int round )
+{
+	std::vector<std::vector<int>> vSizes( random.Range( 1, MAX_OUTER_CHUNKS ) );
+	for( std::vector<int>& vInner : vSizes )
+	{
+		vInner.resize( random.Range( 1, MAX_INNER_CHUNKS ) );
+		random.Fill( vInner.data(), static_cast<int>( vInner.size() ), 0, MAX_CHUNK_SIZE );
+	}
+
+	std::vector<std::vector<uint64_t>> vSums( vSizes.size() );
+	std::vector<std::vector<std::atomic<int>>> vCalls( vSizes.size() );
+	for( size_t i = 0; i < vSizes.size(); i++ )
+	{
+		vSums[i].resize( vSizes[i].size() );
+		vCalls[i] = std::vector<std::atomic<int>>( vSizes[i].size() );
+	}
+
+	jobs.ParallelFor( static_cast<int>( vSizes.size() ), [&]( int outer )
+	{
+		jobs.ParallelFor( static_cast<int>( vSizes[outer].size() ), [&, outer]( int inner )
+		{
+			vSums[outer][inner] = SumTo( vSizes[outer][inner] );
+			vCalls[outer][inner]++;
+		} );
+	} );
+
+	for( size_t i = 0; i < vSizes.size(); i++ )
+	{
+		for( size_t j = 0; j < vSizes[i].size(); j++ )
+		{
+			Check( vCalls[i][j] == 1, "an inner chunk wasn't called exactly once", round );
+			Check( vSums[i][j] == SumTo( vSizes[i][j] ), "an inner chunk gave the wrong sum", round );
+		}
+	}
+}
+
+// A group of jobs and one which runs after them all
+static void RunDependencyRound( PlayJobs& jobs, PlayRandom& random, int round )
+{
+	std::vector<int> vSizes( GROUP_JOBS );
+	random.Fill( vSizes.data(), GROUP_JOBS, 0, MAX_CHUNK_SIZE );
+
+	std::vector<uint64_t> vSums( GROUP_JOBS );
+	uint64_t total = 0;
+	JobCounter group;
+	JobCounter done;
+
+	for( int i = 0; i < GROUP_JOBS; i++ )
+		jobs.Run( [&, i]() { vSums[i] = SumTo( vSizes[i] ); }, &group );
+
+	jobs.RunAfter( group, [&]()
+	{
+		for( uint64_t sum : vSums )
+			total += sum;
+	}, &done );
+
+	jobs.Wait( done );
+
+	uint64_t expected = 0;
+	for( int size : vSizes )
+		expected += SumTo( size );
+	Check( group.IsDone(), "RunAfter ran before its group had finished", round );
+	Check( total == expected, "RunAfter didn't see every job's result", round );
+}
+
+void MainGameEntry( int argc, char* argv[] )
+{
+	Play::CreateManager( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE );
+
+	PlayJobs& jobs = PlayJobs::Instance();
+	PlayRandom random( 31 );
+
+	for( int round = 0; round < ROUND_COUNT; round++ )
+	{
+		RunNestedRound( jobs, random, round );
+		RunDependencyRound( jobs, random, round );
+	}
+
+	printf( "JobsStress: %d rounds on %d threads, %d failures\n", ROUND_COUNT, jobs.GetThreadCount(), s_nFailures );
+}
+
+bool MainGameUpdate( float elapsedTime )
+{
+	return true; // Everything is done in MainGameEntry
+}
+
+int MainGameExit( void )
+{
+	Play::DestroyManager();
+	return s_nFailures > 0 ? 1 : PLAY_OK;
+}
@@ -0,0 +1,163 @@
+// MultiContext
+// Checks that several games can run side by side in their own Play::Context without disturbing each other
+// ------------------------------------------
+// Each game is seeded differently and run once on its own to get its checksum
+// Then they all run at the same time on their own threads, several times over, and each must give the same checksum again
+// The games keep their state in their context's pUserData and use ParallelForEach, so they share the job system too
+// Run by Tests/run_tests.sh from the HelloWorld directory, so the sprites are there to load
+// ------------------------------------------
+
+#define PLAY_IMPLEMENTATION
+#define PLAY_USING_GAMEOBJECT_MANAGER
+#include "Play.h"
+
+constexpr int DISPLAY_WIDTH = 320;
+constexpr int DISPLAY_HEIGHT = 240;
+constexpr int DISPLAY_SCALE = 1;
+// How many games run at the same time
+constexpr int GAME_COUNT = 8;
+// How many times all the games are run together
+constexpr int ROUND_COUNT = 4;
+// How many frames each game runs for
+constexpr int FRAME_COUNT = 120;
+// How many objects each game keeps alive
+constexpr int OBJECT_COUNT = 500;
+
+enum ObjectType
+{
+	TYPE_BALL = 0,
+};
+
+// The state of one game, kept with its context
+struct Game
+{
+	int index{ 0 };
+	int frame{ 0 };
+	int spawned{ 0 };
+};
+
+// The number of games which didn't give the checksum they gave on their own
+static std::atomic<int> s_nFailures{ 0 };
+
+static Game& CurrentGame()
+{
+	return *Play::Context::Current().GetUserData<Game>();
+}
+
+// Moves every ball on the worker threads and knocks some of them out, then tops them back up
+static void UpdateGame()
+{
+	Game& game = CurrentGame();
+
+	Play::ParallelForEach( TYPE_BALL, []( GameObject& obj )
+	{
+		obj.velocity = { static_cast<float>( Play::RandomRollRange( -2, 2 ) ), static_cast<float>( Play::RandomRollRange( -2, 2 ) ) };
+		Play::UpdateGameObject( obj, true );
+		if( Play::RandomRoll( 50 ) == 1 )
+			Play::QueueDestroy( obj.GetId() );
+	} );
+
+	for( int n = Play::CountGameObjectsByType( TYPE_BALL ); n < OBJECT_COUNT; n++ )
+	{
+		Point2f pos( static_cast<float>( Play::RandomRoll( DISPLAY_WIDTH ) ), static_cast<float>( Play::RandomRoll( DISPLAY_HEIGHT ) ) );
+		Play::CreateGameObject( TYPE_BALL, pos, 4, game.index % 2 ? "gem" : "particle" );
+		game.spawned++;
+	}
+
+	game.frame++;
+}
+
+static void DrawGame()
+{
+	Play::ClearDrawingBuffer( Play::cBlack );
+	for( int id : Play::CollectGameObjectIDsByType( TYPE_BALL ) )
+		Play::DrawObject( Play::GetGameObject( id ) );
+	Play::DrawDebugText( { DISPLAY_WIDTH / 2, 10 }, std::to_string( CurrentGame().spawned ).c_str() );
+	Play::PresentDrawingBuffer();
+}
+
+// FNV-1a over the last frame the current context presented
+static uint64_t FramebufferChecksum()
+{
+	PlayWindow& window = PlayWindow::Instance();
+	window.FlushPresents();
+
+	uint64_t checksum = 14695981039346656037ull;
+	for( Pixel pixel : window.GetFramebuffer() )
+	{
+		checksum ^= pixel.bits;
+		checksum *= 1099511628211ull;
+	}
+	return checksum;
+}
+
+// Runs a whole game in a context of its own and returns the checksum of its last frame
+static uint64_t RunGame( int index )
+{
+	Play::Context context;
+	Play::Context* pPrevious = context.MakeCurrent();
+
+	Game game;
+	game.index = index;
+	context.pUserData = &game;
+
+	Play::CreateManager( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE );
+	Play::CentreAllSpriteOrigins();
+	Play::SetRandomSeed( 1000 + index );
+
+	for( int frame = 0; frame < FRAME_COUNT; frame++ )
+	{
+		UpdateGame();
+		DrawGame();
+	}
+
+	uint64_t checksum = FramebufferChecksum();
+	PLAY_ASSERT_MSG( CurrentGame().frame == FRAME_COUNT, "The game's state was lost" );
+
+	Play::DestroyManager();
+	pPrevious->MakeCurrent();
+	return checksum;
+}
+
+void MainGameEntry( int argc, char* argv[] )
+{
+	// The default context keeps a manager for the whole run, so the job system is shared rather than restarted by each game
+	Play::CreateManager( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE );
+
+	uint64_t expected[GAME_COUNT];
+	for( int i = 0; i < GAME_COUNT; i++ )
+		expected[i] = RunGame( i );
+
+	for( int round = 0; round < ROUND_COUNT; round++ )
+	{
+		std::vector<std::thread> vThreads;
+		for( int i = 0; i < GAME_COUNT; i++ )
+		{
+			vThreads.emplace_back( [i, round, &expected]()
+			{
+				uint64_t checksum = RunGame( i );
+				if( checksum != expected[i] )
+				{
+					printf( "Game %d in round %d gave checksum %016llx instead of %016llx\n", i, round, static_cast<unsigned long long>( checksum ), static_cast<unsigned long long>( expected[i] ) );
+					s_nFailures++;
+				}
+			} );
+		}
+
+		for( std::thread& thread : vThreads )
+			thread.join();
+	}
+
+	printf( "MultiContext: %d games x %d rounds, %d failures\n", GAME_COUNT, ROUND_COUNT, s_nFailures.load() );
+}
+
+bool MainGameUpdate( float elapsedTime )
+{
+	return true; // Everything is done in MainGameEntry
+}
+
+int MainGameExit( void )
+{
+	Play::DestroyManager();
+	return s_nFailures > 0 ? 1 : PLAY_OK;
+}
@@ -0,0 +1,101 @@
+// RandomSystems
+// Checks that random numbers used inside parallel systems and Play::ParallelForEach replay exactly
+// ------------------------------------------
+// Two systems which don't conflict run in the same parallel step, and both roll random numbers for every object
+// Replaying a recording must draw the same last frame however many worker threads there are, and with --serial
+// Run by Tests/run_tests.sh from the HelloWorld directory, so the sprites are there to load
+// ------------------------------------------
+
+#define PLAY_IMPLEMENTATION
+#define PLAY_USING_GAMEOBJECT_MANAGER
+#include "Play.h"
+
+constexpr int DISPLAY_WIDTH = 640;
+constexpr int DISPLAY_HEIGHT = 360;
+constexpr int DISPLAY_SCALE = 1;
+// How many of each type are kept alive
+constexpr int OBJECT_COUNT = 2000;
+
+enum ObjectType
+{
+	TYPE_SPARK = 0,
+	TYPE_DUST,
+};
+
+// Keeps the number of objects of a type topped up, starting the new ones at random positions
+static void TopUp( int type, const char* spriteName )
+{
+	for( int n = Play::CountGameObjectsByType( type ); n < OBJECT_COUNT; n++ )
+	{
+		Point2f pos( static_cast<float>( Play::RandomRoll( DISPLAY_WIDTH ) ), static_cast<float>( Play::RandomRoll( DISPLAY_HEIGHT ) ) );
+		Play::CreateGameObject( type, pos, 4, spriteName );
+	}
+}
+
+// Jitters every spark on the worker threads, and burns some of them out
+static void UpdateSparks()
+{
+	Play::ParallelForEach( TYPE_SPARK, []( GameObject& obj )
+	{
+		obj.velocity = { static_cast<float>( Play::RandomRollRange( -3, 3 ) ), static_cast<float>( Play::RandomRollRange( -3, 3 ) ) };
+		Play::UpdateGameObject( obj, true );
+		if( Play::RandomRoll( 100 ) == 1 )
+			Play::QueueDestroy( obj.GetId() );
+	} );
+}
+
+// Drifts the dust one object at a time, on whichever thread runs the system
+static void UpdateDust()
+{
+	for( int id : Play::CollectGameObjectIDsByType( TYPE_DUST ) )
+	{
+		GameObject& obj = Play::GetGameObject( id );
+		obj.velocity = { Play::RandomFloat() - 0.5f, Play::RandomFloat() * 2.0f };
+		Play::UpdateGameObject( obj, true );
+		if( Play::RandomRoll( 200 ) == 1 )
+			Play::QueueDestroy( id );
+	}
+}
+
+static void DrawObjects()
+{
+	for( int type : { TYPE_DUST, TYPE_SPARK } )
+	{
+		for( int id : Play::CollectGameObjectIDsByType( type ) )
+			Play::DrawObject( Play::GetGameObject( id ) );
+	}
+}
+
+void MainGameEntry( int argc, char* argv[] )
+{
+	Play::CreateManager( DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE );
+	Play::CentreAllSpriteOrigins();
+
+	for( int i = 1; i < argc; i++ )
+	{
+		if( std::string( argv[i] ) == "--serial" )
+			Play::SetSystemsSerial( true );
+	}
+
+	// Neither declares RESOURCE_RANDOM, so they share a step and run at the same time
+	Play::RegisterSystem( "Sparks", UpdateSparks, { {}, { TYPE_SPARK }, 0, 0 } );
+	Play::RegisterSystem( "Dust", UpdateDust, { {}, { TYPE_DUST }, 0, 0 } );
+	Play::RegisterSystem( "Draw", DrawObjects, { { TYPE_SPARK, TYPE_DUST }, {}, 0, Play::RESOURCE_DRAWING } );
+}
+
+bool MainGameUpdate( float elapsedTime )
+{
+	TopUp( TYPE_SPARK, "particle" );
+	TopUp( TYPE_DUST, "gem" );
+
+	Play::ClearDrawingBuffer( Play::cBlack );
+	Play::RunSystems();
+	Play::PresentDrawingBuffer();
+	return false;
+}
+
+int MainGameExit( void )
+{
+	Play::DestroyManager();
+	return PLAY_OK;
+}
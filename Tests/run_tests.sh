@@ -0,0 +1,64 @@
+#!/bin/sh
+# Builds and runs the headless tests with g++ (Linux or any POSIX system)
+# Usage: Tests/run_tests.sh [build directory]
+# The games run from HelloWorld, so they can load its sprites
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=${1:-"$ROOT/Tests/build"}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++17 -O2"}
+FAILED=0
+
+mkdir -p "$BUILD" || exit 1
+cd "$ROOT/HelloWorld" || exit 1
+
+fail()
+{
+	echo "FAIL: $*"
+	FAILED=1
+}
+
+# Builds a test with any extra flags given: build <source> <output> [flags...]
+build()
+{
+	SOURCE=$1
+	OUTPUT=$2
+	shift 2
+	$CXX $CXXFLAGS -I"$ROOT" "$@" "$ROOT/Tests/$SOURCE" -o "$BUILD/$OUTPUT" -lpthread || { fail "building $OUTPUT"; return 1; }
+}
+
+# Prints the checksum of the last frame a headless run drew
+checksum()
+{
+	"$@" --play-checksum 2>/dev/null | sed -n 's/.*framebuffer checksum //p'
+}
+
+# Random numbers in parallel systems replay the same with any number of threads, and with the systems run serially
+if build RandomSystems.cpp RandomSystems2 -DPLAY_THREAD_COUNT=2 && build RandomSystems.cpp RandomSystems8 -DPLAY_THREAD_COUNT=8; then
+	RECORDING="$BUILD/RandomSystems.rec"
+	EXPECTED=$(checksum "$BUILD/RandomSystems8" --play-record="$RECORDING" --play-frames=240)
+	[ -n "$EXPECTED" ] || fail "RandomSystems recording gave no checksum"
+
+	for RUN in 1 2 3; do
+		for TEST in "RandomSystems2" "RandomSystems8" "RandomSystems8 --serial"; do
+			set -- $TEST
+			GOT=$(checksum "$BUILD/$1" $2 --play-replay="$RECORDING")
+			[ "$GOT" = "$EXPECTED" ] || fail "$TEST replay $RUN gave checksum $GOT instead of $EXPECTED"
+		done
+	done
+	[ $FAILED -eq 0 ] && echo "PASS: RandomSystems replays give checksum $EXPECTED"
+fi
+
+# Nested ParallelFors and RunAfter run every job exactly once, with a few workers or many
+if build JobsStress.cpp JobsStress2 -DPLAY_THREAD_COUNT=2 && build JobsStress.cpp JobsStress8 -DPLAY_THREAD_COUNT=8; then
+	"$BUILD/JobsStress2" || fail "JobsStress2"
+	"$BUILD/JobsStress8" || fail "JobsStress8"
+fi
+
+# Games running at the same time in their own contexts each draw what they draw on their own
+if build MultiContext.cpp MultiContext; then
+	"$BUILD/MultiContext" || fail "MultiContext"
+fi
+
+[ $FAILED -eq 0 ] && echo "All tests passed"
+exit $FAILED
@@ -0,0 +1,72 @@
+#!/bin/sh
+# Builds Sky High Spy for X11 and checks it draws the same frames in an Xvfb window as it does headless
+# Usage: Tests/run_x11_tests.sh [build directory] [frames]
+# Needs xvfb-run along with the X11 and Xext development libraries
+# A recording is made headless and then replayed through MIT-SHM, through the XPutImage fallback (--play-x11-no-shm) and headless again
+# Every run must give the same checksum, and --play-checksum also checks the window shows the last frame
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD=${1:-"$ROOT/Tests/build"}
+FRAMES=${2:-600}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++17 -O2"}
+# A screen big enough for the window, as xvfb-run's default is only 640x480 at 8 bits per pixel
+XVFB_ARGS=${XVFB_ARGS:-"-screen 0 1920x1080x24"}
+FAILED=0
+
+if ! command -v xvfb-run >/dev/null 2>&1; then
+	echo "SKIP: xvfb-run isn't installed"
+	exit 0
+fi
+
+mkdir -p "$BUILD" || exit 1
+cd "$ROOT/HelloWorld" || exit 1
+
+fail()
+{
+	echo "FAIL: $*"
+	FAILED=1
+}
+
+# Runs the game, keeping what it printed in a log: run <name> <command...>
+run()
+{
+	NAME=$1
+	shift
+	"$@" --play-checksum >"$BUILD/SkyHighX11-$NAME.log" 2>&1
+}
+
+# Prints the checksum of the last frame a run drew: checksum <name>
+checksum()
+{
+	sed -n 's/.*framebuffer checksum //p' "$BUILD/SkyHighX11-$1.log"
+}
+
+# Fails if a run didn't get a window, or its window didn't show the last frame: check_window <name>
+check_window()
+{
+	grep -q "running headless" "$BUILD/SkyHighX11-$1.log" && fail "$1 couldn't open the X display"
+	grep -q "doesn't show the last frame" "$BUILD/SkyHighX11-$1.log" && fail "$1 window doesn't show the last frame"
+}
+
+GAME="$BUILD/SkyHighX11"
+$CXX $CXXFLAGS -DPLAY_PLATFORM_X11 -I"$ROOT" "$ROOT/HelloWorld/MainGame.cpp" -o "$GAME" -lpthread -lX11 -lXext || { echo "FAIL: building SkyHighX11"; exit 1; }
+
+# Replays give every run the same frame times, which a window paced in real time wouldn't
+RECORDING="$BUILD/SkyHighX11.rec"
+run recording env -u DISPLAY "$GAME" --play-frames="$FRAMES" --play-record="$RECORDING"
+EXPECTED=$(checksum recording)
+[ -n "$EXPECTED" ] || fail "the recording gave no checksum"
+
+run MIT-SHM xvfb-run -a -s "$XVFB_ARGS" "$GAME" --play-replay="$RECORDING"
+run XPutImage xvfb-run -a -s "$XVFB_ARGS" "$GAME" --play-replay="$RECORDING" --play-x11-no-shm
+run headless env -u DISPLAY "$GAME" --play-replay="$RECORDING"
+
+for NAME in MIT-SHM XPutImage headless; do
+	[ "$NAME" = headless ] || check_window $NAME
+	GOT=$(checksum $NAME)
+	[ "$GOT" = "$EXPECTED" ] || fail "$NAME gave checksum $GOT instead of $EXPECTED"
+done
+
+[ $FAILED -eq 0 ] && echo "PASS: MIT-SHM, XPutImage and headless all give checksum $EXPECTED after $FRAMES frames"
+exit $FAILED